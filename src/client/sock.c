@@ -80,14 +80,18 @@ struct sdb_client {
 static ssize_t
 ssl_read(sdb_client_t *client, sdb_strbuf_t *buf, size_t n)
 {
-	char tmp[n];
+	char *tmp;
 	ssize_t ret;
 
+	tmp = sdb_strbuf_reserve(buf, n);
+	if (! tmp)
+		return -1;
+
 	ret = sdb_ssl_session_read(client->ssl_session, tmp, n);
 	if (ret <= 0)
 		return ret;
 
-	sdb_strbuf_memappend(buf, tmp, ret);
+	sdb_strbuf_commit(buf, (size_t)ret);
 	return ret;
 } /* ssl_read */
 
@@ -411,9 +415,6 @@ sdb_client_rpc(sdb_client_t *client,
 		uint32_t cmd, uint32_t msg_len, const char *msg,
 		uint32_t *code, sdb_strbuf_t *buf)
 {
-	uint32_t rcode = 0;
-	ssize_t status;
-
 	if (! buf)
 		return -1;
 
@@ -426,6 +427,21 @@ sdb_client_rpc(sdb_client_t *client,
 			*code = SDB_CONNECTION_ERROR;
 		return -1;
 	}
+	return sdb_client_collect(client, code, buf);
+} /* sdb_client_rpc */
+
+ssize_t
+sdb_client_collect(sdb_client_t *client, uint32_t *code, sdb_strbuf_t *buf)
+{
+	uint32_t rcode = 0;
+	ssize_t status;
+
+	size_t data_offset;
+	bool chunked = 0;
+
+	if (! buf)
+		return -1;
+	data_offset = sdb_strbuf_len(buf);
 
 	while (42) {
 		size_t offset = sdb_strbuf_len(buf);
@@ -451,13 +467,28 @@ sdb_client_rpc(sdb_client_t *client,
 			sdb_strbuf_skip(buf, offset, sdb_strbuf_len(buf) - offset);
 			continue;
 		}
+
+		/* assemble chunked replies; each chunk includes the result type */
+		if ((rcode == SDB_CONNECTION_DATA_CHUNK)
+				|| (chunked && (rcode == SDB_CONNECTION_DATA))) {
+			if (chunked)
+				sdb_strbuf_skip(buf, offset, sizeof(uint32_t));
+			chunked = 1;
+			if (rcode == SDB_CONNECTION_DATA_CHUNK)
+				continue;
+		}
+		else if (chunked) {
+			/* discard the partial result */
+			sdb_strbuf_skip(buf, data_offset, offset - data_offset);
+		}
 		break;
 	}
 
 	if (code)
 		*code = rcode;
-	return status;
-} /* sdb_client_rpc */
+	/* the size of the assembled reply, excluding any log messages */
+	return (ssize_t)(sdb_strbuf_len(buf) - data_offset);
+} /* sdb_client_collect */
 
 ssize_t
 sdb_client_send(sdb_client_t *client,
@@ -36,9 +36,13 @@
 #include "core/store.h"
 #include "utils/avltree.h"
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include <regex.h>
 
+#include <pthread.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -57,9 +61,14 @@ struct sdb_memstore_obj {
 	/* common meta information */
 	sdb_time_t last_update;
 	sdb_time_t interval; /* moving average */
-	char **backends;
-	size_t backends_num;
+	uint64_t backends; /* bitmap of backend IDs; see below */
 	sdb_memstore_obj_t *parent;
+
+	/* neighbours in the list of objects ordered by last_update */
+	sdb_memstore_obj_t *older;
+	sdb_memstore_obj_t *newer;
+	/* newer neighbours on the skip list levels above the list, if any */
+	sdb_memstore_obj_t **skip;
 };
 #define STORE_OBJ(obj) ((sdb_memstore_obj_t *)(obj))
 #define STORE_CONST_OBJ(obj) ((const sdb_memstore_obj_t *)(obj))
@@ -81,7 +90,7 @@ typedef struct {
 #define CONST_SVC(obj) ((const service_t *)(obj))
 
 typedef struct {
-	char *type;
+	const char *type; /* interned */
 	char *id;
 	sdb_time_t last_update;
 } metric_store_t;
@@ -95,12 +104,34 @@ typedef struct {
 } metric_t;
 #define METRIC(obj) ((metric_t *)(obj))
 
+/* objects ordered by last_update, least recently updated first; this is the
+ * bottom level of a skip list, heads[i] being the oldest object on level
+ * i + 1 */
+typedef struct {
+	sdb_memstore_obj_t *oldest;
+	sdb_memstore_obj_t *newest;
+	sdb_memstore_obj_t **heads;
+	size_t levels;
+	/* NULL if the list is protected by the lock of the owning host */
+	pthread_mutex_t *lock;
+} sdb_memstore_time_list_t;
+
 typedef struct {
 	sdb_memstore_obj_t super;
 
 	sdb_avltree_t *services;
 	sdb_avltree_t *metrics;
 	sdb_avltree_t *attributes;
+
+	sdb_memstore_time_list_t services_by_time;
+	sdb_memstore_time_list_t metrics_by_time;
+
+	/* protects the host and all of its children; the tree of hosts itself
+	 * may be read without locking */
+	pthread_rwlock_t lock;
+	/* set (while holding the lock) when the host expires; writers which
+	 * looked up the host before have to look it up again */
+	bool removed;
 } host_t;
 #define HOST(obj) ((host_t *)(obj))
 #define CONST_HOST(obj) ((const host_t *)(obj))
@@ -113,11 +144,53 @@ typedef struct {
  * querying
  */
 
+/* an attribute predicate which may be served by an index: the attribute
+ * 'key' of the objects of type 'type' has to be equal to 'value' or, if 'in'
+ * is set, has to be an element of the array 'value' */
+typedef struct {
+	int type; /* zero if there is no such predicate */
+	const char *key;
+	const sdb_data_t *value;
+	bool in;
+} sdb_memstore_index_pred_t;
+#define SDB_MEMSTORE_INDEX_PRED_INIT { 0, NULL, NULL, 0 }
+
+/* range predicates on the last_update and age fields of the objects of type
+ * 'type'; both ranges are inclusive */
+typedef struct {
+	int type; /* zero if there is no such predicate */
+	sdb_time_t last_update_min, last_update_max;
+	sdb_time_t age_min, age_max;
+} sdb_memstore_time_pred_t;
+#define SDB_MEMSTORE_TIME_PRED_INIT { 0, 0, UINT64_MAX, 0, UINT64_MAX }
+
 struct sdb_memstore_query {
 	sdb_object_t super;
 	sdb_ast_node_t *ast;
 	sdb_memstore_matcher_t *matcher;
 	sdb_memstore_matcher_t *filter;
+
+	/* predicates of the matcher which may be served by an index; all of
+	 * them have to be satisfied by all matching objects */
+	sdb_memstore_index_pred_t index[4];
+	size_t index_num;
+
+	/* the range of updates matching the matcher */
+	sdb_memstore_time_pred_t time;
+
+	/* the value by which to order the result of LIST and LOOKUP queries;
+	 * the direction and bounds of the result are taken from the AST */
+	sdb_memstore_expr_t *order_by;
+
+	/* the value by which to group the objects counted by COUNT queries */
+	sdb_memstore_expr_t *group_by;
+
+	/* the attributes to include in the result of LIST and LOOKUP queries
+	 * with a SELECT clause (names refer to the AST); full objects are
+	 * returned otherwise */
+	bool select;
+	const char **select_attrs;
+	size_t select_attrs_num;
 };
 #define QUERY(m) ((sdb_memstore_query_t *)(m))
 
@@ -184,6 +257,9 @@ enum {
 
 	/* a generic query */
 	MATCHER_QUERY,
+
+	/* a compiled matcher; see memstore_prog.c */
+	MATCHER_PROG,
 };
 
 #define MATCHER_SYM(t) \
@@ -205,6 +281,7 @@ enum {
 		: ((t) == MATCHER_REGEX) ? "=~" \
 		: ((t) == MATCHER_NREGEX) ? "!~" \
 		: ((t) == MATCHER_QUERY) ? "QUERY" \
+		: ((t) == MATCHER_PROG) ? "PROGRAM" \
 		: "UNKNOWN")
 
 /* matcher base type */
@@ -258,6 +335,238 @@ typedef struct {
 } unary_matcher_t;
 #define UNARY_M(m) ((unary_matcher_t *)(m))
 
+/*
+ * filters
+ */
+
+/* A visibility scope memoizes whether objects are visible through a filter
+ * while it is active in the current thread. It remembers the most recent
+ * decision for each object type (hosts, services, metrics, and attributes),
+ * which covers the order in which scans visit objects. */
+typedef struct sdb_memstore_visibility {
+	struct {
+		sdb_memstore_matcher_t *filter;
+		sdb_memstore_obj_t *obj;
+		bool visible;
+	} objs[4];
+
+	/* the scope which was active before this one */
+	struct sdb_memstore_visibility *prev;
+} sdb_memstore_visibility_t;
+
+/*
+ * sdb_memstore_visibility_begin, sdb_memstore_visibility_end:
+ * Activate or deactivate a visibility scope in the current thread. Scopes
+ * may be nested but have to be deactivated in reverse order.
+ *
+ * sdb_memstore_visibility_reset:
+ * Forget all decisions of a scope. This has to be done whenever any of the
+ * objects it knows about might have been modified, that is, when releasing
+ * the lock of a host.
+ */
+void
+sdb_memstore_visibility_begin(sdb_memstore_visibility_t *scope);
+void
+sdb_memstore_visibility_end(sdb_memstore_visibility_t *scope);
+void
+sdb_memstore_visibility_reset(sdb_memstore_visibility_t *scope);
+
+/*
+ * sdb_memstore_visible:
+ * Check whether an object is visible through the specified filter. Every
+ * object is visible if no filter has been specified. The decision is
+ * memoized in the visibility scope of the current thread, if any.
+ */
+bool
+sdb_memstore_visible(sdb_memstore_matcher_t *filter, sdb_memstore_obj_t *obj);
+
+/*
+ * sdb_memstore_prog_matches:
+ * Evaluate a compiled matcher (of type MATCHER_PROG); see
+ * sdb_memstore_matcher_matches. The filter is expected to have been applied
+ * to the object already.
+ */
+int
+sdb_memstore_prog_matches(sdb_memstore_matcher_t *m, sdb_memstore_obj_t *obj,
+		sdb_memstore_matcher_t *filter);
+
+/*
+ * sdb_memstore_prog_source:
+ * Returns the matcher a compiled matcher has been compiled from (without
+ * taking a reference).
+ */
+sdb_memstore_matcher_t *
+sdb_memstore_prog_source(sdb_memstore_matcher_t *m);
+
+/*
+ * sdb_memstore_matcher_prefix:
+ * Determine a literal prefix which the name of any object of type 'target'
+ * has to start with for a matcher to match. The matcher is assumed to be
+ * evaluated against objects of type 'type', which are either the 'target'
+ * objects themselves or their children. Prefixes are derived from anchored
+ * regular expressions (e.g., name =~ '^web-') and name comparisons in
+ * conjunctions. Like regular expressions, they are case-insensitive.
+ *
+ * At most 'size' bytes (including the terminating null byte) are stored in
+ * 'buf'; a truncated prefix remains a valid constraint.
+ *
+ * Returns:
+ *  - the length of the prefix
+ *  - zero if the matcher does not constrain the name
+ */
+size_t
+sdb_memstore_matcher_prefix(sdb_memstore_matcher_t *m, int type, int target,
+		char *buf, size_t size);
+
+/*
+ * attribute indexes
+ */
+
+/* a reference to an object stored in an attribute index */
+typedef struct {
+	char *host;
+	char *name; /* NULL for hosts */
+} sdb_memstore_index_ref_t;
+
+typedef struct sdb_memstore_index sdb_memstore_index_t;
+
+sdb_memstore_index_t *
+sdb_memstore_index_create(void);
+void
+sdb_memstore_index_destroy(sdb_memstore_index_t *idx);
+
+/*
+ * sdb_memstore_index_add_key:
+ * Start indexing attributes with the specified key. Attributes stored before
+ * will not be indexed.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a positive value if the key is indexed already
+ *  - a negative value else
+ */
+int
+sdb_memstore_index_add_key(sdb_memstore_index_t *idx, const char *key);
+
+/*
+ * sdb_memstore_index_has_key:
+ * Returns true if attributes with the specified key are indexed.
+ */
+bool
+sdb_memstore_index_has_key(sdb_memstore_index_t *idx, const char *key);
+
+/*
+ * sdb_memstore_index_update:
+ * Update the index after the value of an attribute changed from 'old_value'
+ * to 'new_value'. Either one may be NULL if the attribute has been added or
+ * removed. The lock of the attribute's host has to be held by the caller.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a negative value else
+ */
+int
+sdb_memstore_index_update(sdb_memstore_index_t *idx, sdb_memstore_obj_t *attr,
+		const sdb_data_t *old_value, const sdb_data_t *new_value);
+
+/*
+ * sdb_memstore_index_lookup:
+ * Look up all objects of the specified type having an attribute 'key' whose
+ * value is equal to 'value' (or one of its elements if 'in' is true). The
+ * result is a superset of the matching objects, sorted by host and object
+ * name. The result is allocated as a single block which has to be freed by
+ * the caller.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a positive value if the key is not indexed or if there are more than
+ *    'max' results
+ *  - a negative value else
+ */
+int
+sdb_memstore_index_lookup(sdb_memstore_index_t *idx, int type,
+		const char *key, const sdb_data_t *value, bool in, size_t max,
+		sdb_memstore_index_ref_t **refs, size_t *refs_num);
+
+/*
+ * sdb_memstore_yield_cb:
+ * A callback invoked by scans, if specified, each time they are done with a
+ * host and no longer hold any locks. It receives the user-data of the
+ * lookup callback and may block, e.g., to pass on results. The scan aborts
+ * with an error if it returns a negative value.
+ */
+typedef int (*sdb_memstore_yield_cb)(void *user_data);
+
+/*
+ * sdb_memstore_scan_yield:
+ * Scan the store like sdb_memstore_scan_after, calling 'yield' in between
+ * hosts.
+ */
+int
+sdb_memstore_scan_yield(sdb_memstore_t *store, int type,
+		const char *hostname, const char *name,
+		sdb_memstore_matcher_t *m, sdb_memstore_matcher_t *filter,
+		sdb_memstore_lookup_cb cb, sdb_memstore_yield_cb yield,
+		void *user_data);
+
+/*
+ * sdb_memstore_scan_index:
+ * Scan the store like sdb_memstore_scan_yield but only consider the objects
+ * provided by the attribute index for the specified predicate.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a positive value if there is no index for the predicate or if the
+ *    predicate is not selective enough for the index to pay off
+ *  - a negative value else
+ */
+int
+sdb_memstore_scan_index(sdb_memstore_t *store, int type,
+		const sdb_memstore_index_pred_t *pred,
+		sdb_memstore_matcher_t *m, sdb_memstore_matcher_t *filter,
+		sdb_memstore_lookup_cb cb, sdb_memstore_yield_cb yield,
+		void *user_data);
+
+/*
+ * sdb_memstore_scan_time:
+ * Scan the store like sdb_memstore_scan_yield but only consider the objects whose
+ * last update is within the specified range. Objects are looked up using
+ * the lists of objects ordered by their last update.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a positive value if there is no range or if it is not selective enough
+ *    for the lists to pay off
+ *  - a negative value else
+ */
+int
+sdb_memstore_scan_time(sdb_memstore_t *store, int type,
+		const sdb_memstore_time_pred_t *pred,
+		sdb_memstore_matcher_t *m, sdb_memstore_matcher_t *filter,
+		sdb_memstore_lookup_cb cb, sdb_memstore_yield_cb yield,
+		void *user_data);
+
+/*
+ * backends
+ */
+
+/* Backends are identified by their index into the global, append-only list
+ * of known backend names. Each object stores the set of its backends as a
+ * bitmap. */
+#define BACKENDS_MAX SDB_STORE_BACKENDS_MAX
+
+/*
+ * sdb_memstore_backend_names:
+ * Store the names of all known backends in 'names', which has to provide
+ * space for BACKENDS_MAX entries. Bit i of an object's backends bitmap
+ * refers to names[i].
+ *
+ * Returns:
+ *  - the number of known backends
+ */
+size_t
+sdb_memstore_backend_names(const char **names);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
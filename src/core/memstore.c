@@ -34,6 +34,7 @@
 #include "core/plugin.h"
 #include "utils/avltree.h"
 #include "utils/error.h"
+#include "utils/strings.h"
 
 #include <assert.h>
 
@@ -45,6 +46,7 @@
 #include <strings.h>
 
 #include <pthread.h>
+#include <sched.h>
 
 /*
  * private types
@@ -56,7 +58,22 @@ struct sdb_memstore {
 	/* hosts are the top-level entries and
 	 * reference everything else */
 	sdb_avltree_t *hosts;
-	pthread_rwlock_t host_lock;
+	/* serializes adding hosts; the tree of hosts may be read without any
+	 * locking and host_t's lock guards everything else */
+	pthread_mutex_t host_lock;
+
+	/* secondary indexes of attribute values */
+	sdb_memstore_index_t *index;
+
+	/* number of services and metrics in the store; children are added and
+	 * removed while holding the lock of their host only, so these are
+	 * updated atomically (hosts are counted by the tree) */
+	size_t services_num;
+	size_t metrics_num;
+
+	/* all hosts ordered by their last update; protected by time_lock */
+	sdb_memstore_time_list_t hosts_by_time;
+	pthread_mutex_t time_lock;
 };
 
 /* internal representation of a to-be-stored object */
@@ -69,27 +86,42 @@ typedef struct {
 	sdb_time_t interval;
 	const char * const *backends;
 	size_t backends_num;
+	/* the list ordering the object by its last update; may be NULL */
+	sdb_memstore_time_list_t *by_time;
+	/* the number of objects of the type; may be NULL */
+	size_t *counter;
 } store_obj_t;
-#define STORE_OBJ_INIT { NULL, NULL, 0, NULL, 0, 0, NULL, 0 }
+#define STORE_OBJ_INIT { NULL, NULL, 0, NULL, 0, 0, NULL, 0, NULL, NULL }
 
 static sdb_type_t host_type;
 static sdb_type_t service_type;
 static sdb_type_t metric_type;
 static sdb_type_t attribute_type;
 
+/* the list of backend names is append-only, so it may be read without
+ * locking; backend_lock serializes adding new names */
+static const char      *backend_names[BACKENDS_MAX];
+static size_t           backend_names_num = 0;
+static pthread_mutex_t  backend_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static int
 store_init(sdb_object_t *obj, va_list __attribute__((unused)) ap)
 {
 	int err;
-	if (! (SDB_MEMSTORE(obj)->hosts = sdb_avltree_create()))
+	if (! (SDB_MEMSTORE(obj)->hosts = sdb_avltree_create_indexed()))
+		return -1;
+	if (! (SDB_MEMSTORE(obj)->index = sdb_memstore_index_create()))
 		return -1;
-	if ((err = pthread_rwlock_init(&SDB_MEMSTORE(obj)->host_lock,
+	if ((err = pthread_mutex_init(&SDB_MEMSTORE(obj)->host_lock,
+					/* attr = */ NULL))
+			|| (err = pthread_mutex_init(&SDB_MEMSTORE(obj)->time_lock,
 					/* attr = */ NULL))) {
 		char errbuf[128];
 		sdb_log(SDB_LOG_ERR, "memstore: Failed to initialize lock: %s",
 				sdb_strerror(err, errbuf, sizeof(errbuf)));
 		return -1;
 	}
+	SDB_MEMSTORE(obj)->hosts_by_time.lock = &SDB_MEMSTORE(obj)->time_lock;
 	return 0;
 } /* store_init */
 
@@ -97,7 +129,8 @@ static void
 store_destroy(sdb_object_t *obj)
 {
 	int err;
-	if ((err = pthread_rwlock_destroy(&SDB_MEMSTORE(obj)->host_lock))) {
+	if ((err = pthread_mutex_destroy(&SDB_MEMSTORE(obj)->host_lock))
+			|| (err = pthread_mutex_destroy(&SDB_MEMSTORE(obj)->time_lock))) {
 		char errbuf[128];
 		sdb_log(SDB_LOG_ERR, "memstore: Failed to destroy lock: %s",
 				sdb_strerror(err, errbuf, sizeof(errbuf)));
@@ -105,6 +138,10 @@ store_destroy(sdb_object_t *obj)
 	}
 	sdb_avltree_destroy(SDB_MEMSTORE(obj)->hosts);
 	SDB_MEMSTORE(obj)->hosts = NULL;
+	free(SDB_MEMSTORE(obj)->hosts_by_time.heads);
+	SDB_MEMSTORE(obj)->hosts_by_time.heads = NULL;
+	sdb_memstore_index_destroy(SDB_MEMSTORE(obj)->index);
+	SDB_MEMSTORE(obj)->index = NULL;
 } /* store_destroy */
 
 static int
@@ -119,13 +156,10 @@ static void
 store_obj_destroy(sdb_object_t *obj)
 {
 	sdb_memstore_obj_t *sobj = STORE_OBJ(obj);
-	size_t i;
 
-	for (i = 0; i < sobj->backends_num; ++i)
-		free(sobj->backends[i]);
-	free(sobj->backends);
-	sobj->backends = NULL;
-	sobj->backends_num = 0;
+	sobj->backends = 0;
+	free(sobj->skip);
+	sobj->skip = NULL;
 
 	// We don't currently keep an extra reference for parent objects to
 	// avoid circular self-references which are not handled correctly by
@@ -137,6 +171,7 @@ static int
 host_init(sdb_object_t *obj, va_list ap)
 {
 	host_t *sobj = HOST(obj);
+	pthread_rwlockattr_t attr;
 	int ret;
 
 	/* this will consume the first argument (type) of ap */
@@ -144,13 +179,28 @@ host_init(sdb_object_t *obj, va_list ap)
 	if (ret)
 		return ret;
 
-	sobj->services = sdb_avltree_create();
+	pthread_rwlockattr_init(&attr);
+#ifdef PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP
+	/* don't let a steady stream of scans starve the host's writers */
+	pthread_rwlockattr_setkind_np(&attr,
+			PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+	ret = pthread_rwlock_init(&sobj->lock, &attr);
+	pthread_rwlockattr_destroy(&attr);
+	if (ret) {
+		char errbuf[128];
+		sdb_log(SDB_LOG_ERR, "memstore: Failed to initialize host lock: %s",
+				sdb_strerror(ret, errbuf, sizeof(errbuf)));
+		return -1;
+	}
+
+	sobj->services = sdb_avltree_create_indexed();
 	if (! sobj->services)
 		return -1;
-	sobj->metrics = sdb_avltree_create();
+	sobj->metrics = sdb_avltree_create_indexed();
 	if (! sobj->metrics)
 		return -1;
-	sobj->attributes = sdb_avltree_create();
+	sobj->attributes = sdb_avltree_create_indexed();
 	if (! sobj->attributes)
 		return -1;
 	return 0;
@@ -170,6 +220,10 @@ host_destroy(sdb_object_t *obj)
 		sdb_avltree_destroy(sobj->metrics);
 	if (sobj->attributes)
 		sdb_avltree_destroy(sobj->attributes);
+	free(sobj->services_by_time.heads);
+	free(sobj->metrics_by_time.heads);
+
+	pthread_rwlock_destroy(&sobj->lock);
 } /* host_destroy */
 
 static int
@@ -183,7 +237,7 @@ service_init(sdb_object_t *obj, va_list ap)
 	if (ret)
 		return ret;
 
-	sobj->attributes = sdb_avltree_create();
+	sobj->attributes = sdb_avltree_create_indexed();
 	if (! sobj->attributes)
 		return -1;
 	return 0;
@@ -212,7 +266,7 @@ metric_init(sdb_object_t *obj, va_list ap)
 	if (ret)
 		return ret;
 
-	sobj->attributes = sdb_avltree_create();
+	sobj->attributes = sdb_avltree_create_indexed();
 	if (! sobj->attributes)
 		return -1;
 
@@ -233,12 +287,9 @@ metric_destroy(sdb_object_t *obj)
 	if (sobj->attributes)
 		sdb_avltree_destroy(sobj->attributes);
 
-	for (i = 0; i < sobj->stores_num; ++i) {
-		if (sobj->stores[i].type)
-			free(sobj->stores[i].type);
+	for (i = 0; i < sobj->stores_num; ++i)
 		if (sobj->stores[i].id)
 			free(sobj->stores[i].id);
-	}
 	if (sobj->stores)
 		free(sobj->stores);
 	sobj->stores = NULL;
@@ -306,40 +357,296 @@ static sdb_type_t attribute_type = {
  * private helper functions
  */
 
+/* Look up the ID of the specified backend, registering it if necessary.
+ * Returns a negative value if it could not be registered. */
+static int
+backend_id(const char *name)
+{
+	size_t num = __atomic_load_n(&backend_names_num, __ATOMIC_ACQUIRE);
+	size_t i;
+
+	for (i = 0; i < num; ++i)
+		if ((backend_names[i] == name) || (! strcasecmp(backend_names[i], name)))
+			return (int)i;
+
+	pthread_mutex_lock(&backend_lock);
+	/* the backend might have been registered in the meantime */
+	for ( ; i < backend_names_num; ++i)
+		if (! strcasecmp(backend_names[i], name))
+			break;
+
+	if (i >= backend_names_num) {
+		if (backend_names_num >= BACKENDS_MAX) {
+			pthread_mutex_unlock(&backend_lock);
+			sdb_log(SDB_LOG_ERR, "memstore: Failed to register backend '%s' "
+					"- too many backends (max: %d)", name, BACKENDS_MAX);
+			return -1;
+		}
+		if (! (backend_names[i] = string_intern(name))) {
+			pthread_mutex_unlock(&backend_lock);
+			return -1;
+		}
+		__atomic_store_n(&backend_names_num, i + 1, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&backend_lock);
+	return (int)i;
+} /* backend_id */
+
+/* Store the names of all of the object's backends in 'names', which has to
+ * provide space for BACKENDS_MAX entries. Returns the number of backends. */
+static size_t
+get_backends(const sdb_memstore_obj_t *obj, const char **names)
+{
+	size_t num = 0;
+	int i;
+
+	for (i = 0; i < BACKENDS_MAX; ++i)
+		if (obj->backends & ((uint64_t)1 << i))
+			names[num++] = backend_names[i];
+	return num;
+} /* get_backends */
+
 static int
 record_backends(sdb_memstore_obj_t *obj,
 		const char * const *backends, size_t backends_num)
 {
-	char **tmp;
 	size_t i;
 
 	for (i = 0; i < backends_num; i++) {
-		bool found = 0;
-		size_t j;
+		int id = backend_id(backends[i]);
+		if (id < 0)
+			return -1;
+		obj->backends |= (uint64_t)1 << id;
+	}
+	return 0;
+} /* record_backends */
 
-		for (j = 0; j < obj->backends_num; ++j) {
-			if (!strcasecmp(obj->backends[j], backends[i])) {
-				found = 1;
-				break;
-			}
+/*
+ * Lists of objects ordered by their last update. Objects are re-inserted
+ * whenever they are updated. Updates usually belong at the end of the list,
+ * so most of them are appended right away. Any others (e.g., when loading a
+ * snapshot) are placed using a skip list, which costs O(log n) operations.
+ * Objects with the same last update are ordered by their address, making
+ * each position in the list unique.
+ */
+
+/* the maximum height of the skip list; four times as many objects as on the
+ * level above are on each level */
+#define TIME_LIST_LEVELS 16
+
+static int
+time_cmp(const sdb_memstore_obj_t *o1, const sdb_memstore_obj_t *o2)
+{
+	if (o1->last_update != o2->last_update)
+		return o1->last_update < o2->last_update ? -1 : 1;
+	if ((uintptr_t)o1 != (uintptr_t)o2)
+		return (uintptr_t)o1 < (uintptr_t)o2 ? -1 : 1;
+	return 0;
+} /* time_cmp */
+
+/* Determine the height of an object's tower in the skip list. The height is
+ * derived from the object's address, so it does not have to be stored. */
+static size_t
+time_height(const sdb_memstore_obj_t *obj)
+{
+	uint64_t h = (uint64_t)(uintptr_t)obj;
+	size_t height;
+
+	/* 64-bit finalizer of MurmurHash3 */
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+
+	height = 1 + (size_t)__builtin_ctzll(h | (1ULL << 63)) / 2;
+	return height < TIME_LIST_LEVELS ? height : TIME_LIST_LEVELS;
+} /* time_height */
+
+/* Returns the link to the next object on the specified level (> 0) after
+ * 'obj' or after the head of the list if 'obj' is NULL. */
+static sdb_memstore_obj_t **
+time_list_next(sdb_memstore_time_list_t *list, sdb_memstore_obj_t *obj,
+		size_t level)
+{
+	return obj ? obj->skip + level - 1 : list->heads + level - 1;
+} /* time_list_next */
+
+static void
+time_list_unlink(sdb_memstore_time_list_t *list, sdb_memstore_obj_t *obj)
+{
+	if ((! obj->older) && (list->oldest != obj))
+		return; /* not linked */
+
+	if (obj->skip) {
+		sdb_memstore_obj_t *pos = NULL, *next;
+		size_t level;
+
+		for (level = list->levels; level > 0; --level) {
+			while ((next = *time_list_next(list, pos, level))
+					&& (time_cmp(next, obj) < 0))
+				pos = next;
+			if (next == obj)
+				*time_list_next(list, pos, level) = obj->skip[level - 1];
 		}
-		if (found)
-			continue;
+	}
 
-		tmp = realloc(obj->backends,
-				(obj->backends_num + 1) * sizeof(*obj->backends));
-		if (! tmp)
-			return -1;
+	if (obj->older)
+		obj->older->newer = obj->newer;
+	else
+		list->oldest = obj->newer;
+	if (obj->newer)
+		obj->newer->older = obj->older;
+	else
+		list->newest = obj->older;
+	obj->older = obj->newer = NULL;
+} /* time_list_unlink */
+
+/* Prepare the list and the object for adding the object to all levels of its
+ * tower. Returns the number of levels to use, falling back to the bottom
+ * level only if running out of memory. */
+static size_t
+time_list_grow(sdb_memstore_time_list_t *list, sdb_memstore_obj_t *obj)
+{
+	size_t height = time_height(obj);
 
-		obj->backends = tmp;
-		obj->backends[obj->backends_num] = strdup(backends[i]);
-		if (! obj->backends[obj->backends_num])
-			return -1;
+	if (height == 1)
+		return 1;
 
-		++obj->backends_num;
+	if (! obj->skip) {
+		obj->skip = calloc(height - 1, sizeof(*obj->skip));
+		if (! obj->skip)
+			return 1;
+	}
+	if (list->levels < height - 1) {
+		sdb_memstore_obj_t **heads;
+
+		heads = realloc(list->heads, (height - 1) * sizeof(*heads));
+		if (! heads)
+			return 1;
+		memset(heads + list->levels, 0,
+				(height - 1 - list->levels) * sizeof(*heads));
+		list->heads = heads;
+		list->levels = height - 1;
+	}
+	return height;
+} /* time_list_grow */
+
+static void
+time_list_insert(sdb_memstore_time_list_t *list, sdb_memstore_obj_t *obj)
+{
+	sdb_memstore_obj_t *prev[TIME_LIST_LEVELS];
+	sdb_memstore_obj_t *pos = NULL, *next;
+	size_t height = time_list_grow(list, obj);
+	size_t level;
+
+	if ((height == 1) && list->newest && (time_cmp(list->newest, obj) < 0))
+		/* the common case: the object does not belong to any upper level
+		 * and it is the most recently updated one */
+		pos = list->newest;
+	else {
+		for (level = list->levels; level > 0; --level) {
+			while ((next = *time_list_next(list, pos, level))
+					&& (time_cmp(next, obj) < 0))
+				pos = next;
+			prev[level] = pos;
+		}
+		while ((next = pos ? pos->newer : list->oldest)
+				&& (time_cmp(next, obj) < 0))
+			pos = next;
+	}
+
+	obj->older = pos;
+	if (pos) {
+		obj->newer = pos->newer;
+		pos->newer = obj;
+	}
+	else {
+		obj->newer = list->oldest;
+		list->oldest = obj;
+	}
+	if (obj->newer)
+		obj->newer->older = obj;
+	else
+		list->newest = obj;
+
+	for (level = 1; level < height; ++level) {
+		sdb_memstore_obj_t **link = time_list_next(list, prev[level], level);
+		obj->skip[level - 1] = *link;
+		*link = obj;
+	}
+} /* time_list_insert */
+
+/* (Re-)insert an object after its last update changed. */
+static void
+time_list_update(sdb_memstore_time_list_t *list, sdb_memstore_obj_t *obj,
+		sdb_time_t last_update)
+{
+	if (list->lock)
+		pthread_mutex_lock(list->lock);
+	/* the object has to be unlinked using its previous position */
+	time_list_unlink(list, obj);
+	obj->last_update = last_update;
+	time_list_insert(list, obj);
+	if (list->lock)
+		pthread_mutex_unlock(list->lock);
+} /* time_list_update */
+
+static void
+time_list_remove(sdb_memstore_time_list_t *list, sdb_memstore_obj_t *obj)
+{
+	if (list->lock)
+		pthread_mutex_lock(list->lock);
+	time_list_unlink(list, obj);
+	if (list->lock)
+		pthread_mutex_unlock(list->lock);
+} /* time_list_remove */
+
+/*
+ * Update the meta-data of a (new or existing) object. Unless specified
+ * explicitly, the update interval is determined as a moving average of the
+ * time between two updates. Returns a positive value if the update is not
+ * newer than the stored object, in which case nothing will be changed.
+ */
+static int
+update_obj(sdb_memstore_obj_t *new, store_obj_t *obj)
+{
+	sdb_time_t interval = obj->interval;
+
+	if (new->last_update) {
+		if (obj->last_update <= new->last_update) {
+			if (obj->last_update < new->last_update)
+				sdb_log(SDB_LOG_DEBUG, "memstore: Cannot update %s '%s' - "
+						"value too old (%"PRIsdbTIME" < %"PRIsdbTIME")",
+						SDB_STORE_TYPE_TO_NAME(obj->type), obj->name,
+						obj->last_update, new->last_update);
+			return 1;
+		}
+
+		if (! interval) {
+			interval = obj->last_update - new->last_update;
+			if (new->interval)
+				interval = (sdb_time_t)((0.9 * (double)new->interval)
+						+ (0.1 * (double)interval));
+		}
+	}
+
+	new->interval = interval;
+	if (obj->by_time)
+		time_list_update(obj->by_time, new, obj->last_update);
+	else
+		new->last_update = obj->last_update;
+
+	if (new->parent != obj->parent) {
+		// Avoid circular self-references which are not handled
+		// correctly by the ref-count based management layer.
+		//sdb_object_deref(SDB_OBJ(new->parent));
+		//sdb_object_ref(SDB_OBJ(obj->parent));
+		new->parent = obj->parent;
 	}
-	return 0;
-} /* record_backends */
+
+	return record_backends(new, obj->backends, obj->backends_num);
+} /* update_obj */
 
 static int
 store_obj(store_obj_t *obj, sdb_memstore_obj_t **updated_obj)
@@ -372,6 +679,8 @@ store_obj(store_obj_t *obj, sdb_memstore_obj_t **updated_obj)
 
 		if (new) {
 			status = sdb_avltree_insert(obj->parent_tree, SDB_OBJ(new));
+			if ((! status) && obj->counter)
+				__atomic_add_fetch(obj->counter, 1, __ATOMIC_RELAXED);
 
 			/* pass control to the tree or destroy in case of an error */
 			sdb_object_deref(SDB_OBJ(new));
@@ -389,23 +698,10 @@ store_obj(store_obj_t *obj, sdb_memstore_obj_t **updated_obj)
 		return status;
 	assert(new);
 
-	new->last_update = obj->last_update;
-	new->interval = obj->interval;
-
-	if (new->parent != obj->parent) {
-		// Avoid circular self-references which are not handled
-		// correctly by the ref-count based management layer.
-		//sdb_object_deref(SDB_OBJ(new->parent));
-		//sdb_object_ref(SDB_OBJ(obj->parent));
-		new->parent = obj->parent;
-	}
-
 	if (updated_obj)
 		*updated_obj = new;
 
-	if (record_backends(new, obj->backends, obj->backends_num))
-		return -1;
-	return status;
+	return update_obj(new, obj);
 } /* store_obj */
 
 static int
@@ -423,14 +719,14 @@ static int
 store_metric_add_store(metric_t *metric, const sdb_metric_store_t *s,
 		sdb_time_t last_update)
 {
-	char *type = strdup(s->type);
+	/* there's only a small number of different types but IDs are usually
+	 * unique for each metric */
+	const char *type = string_intern(s->type);
 	char *id = strdup(s->id);
 
 	metric_store_t *new;
 
 	if ((! type) || (! id)) {
-		if (type)
-			free(type);
 		if (id)
 			free(id);
 		return -1;
@@ -439,7 +735,6 @@ store_metric_add_store(metric_t *metric, const sdb_metric_store_t *s,
 	new = realloc(metric->stores,
 			(metric->stores_num + 1) * sizeof(*metric->stores));
 	if (! new) {
-		free(type);
 		free(id);
 		return -1;
 	}
@@ -486,7 +781,38 @@ store_metric_stores(metric_t *metric, sdb_store_metric_t *m)
 	return 0;
 } /* store_metric_stores */
 
-/* The store's host_lock has to be acquired before calling this function. */
+/*
+ * Look up a host and acquire its lock for writing. Looking up the host does
+ * not require any locking and the returned host is referenced, so it remains
+ * valid afterwards.
+ */
+static host_t *
+lock_host(sdb_memstore_t *st, const char *hostname)
+{
+	host_t *host;
+
+	while ((host = HOST(sdb_avltree_lookup(st->hosts, hostname)))) {
+		pthread_rwlock_wrlock(&host->lock);
+		if (! host->removed)
+			break;
+
+		/* the host expired while waiting for the lock */
+		pthread_rwlock_unlock(&host->lock);
+		sdb_object_deref(SDB_OBJ(host));
+	}
+	return host;
+} /* lock_host */
+
+static void
+unlock_host(host_t *host)
+{
+	if (! host)
+		return;
+	pthread_rwlock_unlock(&host->lock);
+	sdb_object_deref(SDB_OBJ(host));
+} /* unlock_host */
+
+/* The host's lock has to be acquired before calling this function. */
 static sdb_avltree_t *
 get_host_children(host_t *host, int type)
 {
@@ -505,6 +831,19 @@ get_host_children(host_t *host, int type)
 		return host->services;
 } /* get_host_children */
 
+/* The host's lock has to be acquired before calling this function. */
+static sdb_memstore_time_list_t *
+get_host_time_list(host_t *host, int type)
+{
+	if (! host)
+		return NULL;
+	if (type == SDB_SERVICE)
+		return &host->services_by_time;
+	if (type == SDB_METRIC)
+		return &host->metrics_by_time;
+	return NULL;
+} /* get_host_time_list */
+
 static sdb_avltree_t *
 get_obj_attrs(sdb_memstore_obj_t *obj)
 {
@@ -517,36 +856,182 @@ get_obj_attrs(sdb_memstore_obj_t *obj)
 	return NULL;
 } /* get_obj_attrs */
 
+/* Remove an object's attributes (and those of its children) from the
+ * attribute indexes. The host's lock has to be acquired before calling this
+ * function. */
+static void
+unindex_obj(sdb_memstore_t *st, sdb_memstore_obj_t *obj)
+{
+	sdb_avltree_t *trees[3] = { NULL, NULL, NULL };
+	size_t i;
+
+	if (obj->type == SDB_ATTRIBUTE) {
+		sdb_memstore_index_update(st->index, obj, &ATTR(obj)->value, NULL);
+		return;
+	}
+
+	trees[0] = get_obj_attrs(obj);
+	if (obj->type == SDB_HOST) {
+		trees[1] = HOST(obj)->services;
+		trees[2] = HOST(obj)->metrics;
+	}
+
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(trees); ++i) {
+		sdb_avltree_iter_t *iter;
+
+		if (! trees[i])
+			continue;
+		iter = sdb_avltree_get_iter(trees[i]);
+		while (sdb_avltree_iter_has_next(iter))
+			unindex_obj(st, STORE_OBJ(sdb_avltree_iter_get_next(iter)));
+		sdb_avltree_iter_destroy(iter);
+	}
+} /* unindex_obj */
+
+/*
+ * expiry
+ */
+
+/* Account for 'n' removed services or metrics. */
+static void
+count_sub(sdb_memstore_t *st, int type, size_t n)
+{
+	if (type == SDB_SERVICE)
+		__atomic_sub_fetch(&st->services_num, n, __ATOMIC_RELAXED);
+	else if (type == SDB_METRIC)
+		__atomic_sub_fetch(&st->metrics_num, n, __ATOMIC_RELAXED);
+} /* count_sub */
+
+/* the number of objects to check while holding a host's lock */
+#define EXPIRE_SLICE 256
+
+typedef struct {
+	sdb_memstore_t *store;
+	const sdb_memstore_expiry_t *expiry;
+	sdb_time_t now;
+
+	/* the locked host and the number of objects checked since locking it */
+	host_t *host;
+	int checked;
+
+	int removed;
+} expire_t;
+
+static bool
+expired(const sdb_memstore_obj_t *obj, const sdb_memstore_ttl_t *ttl,
+		sdb_time_t now)
+{
+	sdb_time_t limit = (sdb_time_t)(ttl->factor * (double)obj->interval);
+
+	if (limit < ttl->min_age)
+		limit = ttl->min_age;
+	if (! limit)
+		return 0;
+	return (obj->last_update < now) && (now - obj->last_update > limit);
+} /* expired */
+
+/* Let writers waiting for the host make progress after each slice. */
+static void
+expire_slice(expire_t *e)
+{
+	if (++e->checked < EXPIRE_SLICE)
+		return;
+
+	pthread_rwlock_unlock(&e->host->lock);
+	sched_yield();
+	pthread_rwlock_wrlock(&e->host->lock);
+	e->checked = 0;
+} /* expire_slice */
+
+/* Remove expired objects (and expired attributes of the remaining objects if
+ * 'attr_ttl' is set) from a locked host's tree of children. */
+static void
+expire_children(expire_t *e, sdb_avltree_t *tree,
+		const sdb_memstore_ttl_t *ttl, const sdb_memstore_ttl_t *attr_ttl)
+{
+	sdb_avltree_iter_t *iter;
+
+	/* the iterator's snapshot keeps removed objects valid */
+	iter = sdb_avltree_get_iter(tree);
+	while (sdb_avltree_iter_has_next(iter)) {
+		sdb_memstore_obj_t *obj = STORE_OBJ(sdb_avltree_iter_get_next(iter));
+
+		expire_slice(e);
+		if (expired(obj, ttl, e->now)) {
+			if (! sdb_avltree_remove(tree, SDB_OBJ(obj)->name)) {
+				sdb_memstore_time_list_t *by_time;
+
+				by_time = get_host_time_list(e->host, obj->type);
+				if (by_time)
+					time_list_remove(by_time, obj);
+				unindex_obj(e->store, obj);
+				count_sub(e->store, obj->type, 1);
+				++e->removed;
+			}
+		}
+		else if (attr_ttl)
+			expire_children(e, get_obj_attrs(obj), attr_ttl, NULL);
+	}
+	sdb_avltree_iter_destroy(iter);
+} /* expire_children */
+
+/* Remove an expired host and all of its children. */
+static void
+expire_host(sdb_memstore_t *st, expire_t *e)
+{
+	host_t *host = e->host;
+
+	/* lock in the same order as store_host() */
+	pthread_mutex_lock(&st->host_lock);
+	pthread_rwlock_wrlock(&host->lock);
+	/* the host might have been updated in the meantime */
+	if ((! host->removed)
+			&& expired(STORE_OBJ(host), &e->expiry->host, e->now)) {
+		host->removed = 1;
+		if (! sdb_avltree_remove(st->hosts, SDB_OBJ(host)->name)) {
+			time_list_remove(&st->hosts_by_time, STORE_OBJ(host));
+			unindex_obj(st, STORE_OBJ(host));
+			count_sub(st, SDB_SERVICE, sdb_avltree_size(host->services));
+			count_sub(st, SDB_METRIC, sdb_avltree_size(host->metrics));
+			++e->removed;
+		}
+	}
+	pthread_rwlock_unlock(&host->lock);
+	pthread_mutex_unlock(&st->host_lock);
+} /* expire_host */
+
 /*
  * store writer API
  */
 
+/* Returns the name of the host an attribute belongs to. */
+static const char *
+attr_hostname(sdb_store_attribute_t *attr)
+{
+	if (attr->parent_type == SDB_HOST)
+		return attr->parent;
+	return attr->hostname;
+} /* attr_hostname */
+
+/*
+ * The following functions store an object below the specified host, which
+ * has to be locked by the caller. 'host' may be NULL if the host could not
+ * be found, in which case an error will be reported.
+ */
+
 static int
-store_attribute(sdb_store_attribute_t *attr, sdb_object_t *user_data)
+host_store_attribute(sdb_memstore_t *st, host_t *host,
+		sdb_store_attribute_t *attr)
 {
-	sdb_memstore_t *st = SDB_MEMSTORE(user_data);
 	store_obj_t obj = STORE_OBJ_INIT;
 	sdb_memstore_obj_t *new = NULL;
-	const char *hostname;
-	host_t *host;
 
 	sdb_avltree_t *children = NULL;
 	int status = 0;
 
-	if ((! attr) || (! attr->parent) || (! attr->key))
-		return -1;
-
-	hostname = attr->hostname;
-	if (attr->parent_type == SDB_HOST)
-		hostname = attr->parent;
-	if (! hostname)
-		return -1;
-
-	pthread_rwlock_wrlock(&st->host_lock);
-	host = HOST(sdb_avltree_lookup(st->hosts, hostname));
 	if (! host) {
 		sdb_log(SDB_LOG_ERR, "memstore: Failed to store attribute '%s' - "
-				"host '%s' not found", attr->key, hostname);
+				"host '%s' not found", attr->key, attr_hostname(attr));
 		status = -1;
 	}
 
@@ -590,58 +1075,37 @@ store_attribute(sdb_store_attribute_t *attr, sdb_object_t *user_data)
 
 	if (! status) {
 		assert(new);
-		/* update the value if it changed */
-		if (sdb_data_cmp(&ATTR(new)->value, &attr->value))
-			if (sdb_data_copy(&ATTR(new)->value, &attr->value))
+		/* update the value (and any index referring to it) if it changed;
+		 * the value of a new attribute is NULL */
+		if (sdb_data_cmp(&ATTR(new)->value, &attr->value)) {
+			if (sdb_memstore_index_update(st->index, new,
+						&ATTR(new)->value, &attr->value))
 				status = -1;
+			else if (sdb_data_copy(&ATTR(new)->value, &attr->value)) {
+				/* the value remains unchanged */
+				sdb_memstore_index_update(st->index, new,
+						&attr->value, &ATTR(new)->value);
+				status = -1;
+			}
+		}
 	}
 
 	if (obj.parent != STORE_OBJ(host))
 		sdb_object_deref(SDB_OBJ(obj.parent));
-	sdb_object_deref(SDB_OBJ(host));
-	pthread_rwlock_unlock(&st->host_lock);
-
-	return status;
-} /* store_attribute */
-
-static int
-store_host(sdb_store_host_t *host, sdb_object_t *user_data)
-{
-	sdb_memstore_t *st = SDB_MEMSTORE(user_data);
-	store_obj_t obj = { NULL, st->hosts, SDB_HOST, NULL, 0, 0, NULL, 0 };
-	int status = 0;
-
-	if ((! host) || (! host->name))
-		return -1;
-
-	obj.name = host->name;
-	obj.last_update = host->last_update;
-	obj.interval = host->interval;
-	obj.backends = host->backends;
-	obj.backends_num = host->backends_num;
-	pthread_rwlock_wrlock(&st->host_lock);
-	status = store_obj(&obj, NULL);
-	pthread_rwlock_unlock(&st->host_lock);
-
 	return status;
-} /* store_host */
+} /* host_store_attribute */
 
 static int
-store_service(sdb_store_service_t *service, sdb_object_t *user_data)
+host_store_service(sdb_memstore_t *st, host_t *host,
+		sdb_store_service_t *service)
 {
-	sdb_memstore_t *st = SDB_MEMSTORE(user_data);
 	store_obj_t obj = STORE_OBJ_INIT;
-	host_t *host;
-
 	int status = 0;
 
-	if ((! service) || (! service->hostname) || (! service->name))
-		return -1;
-
-	pthread_rwlock_wrlock(&st->host_lock);
-	host = HOST(sdb_avltree_lookup(st->hosts, service->hostname));
 	obj.parent = STORE_OBJ(host);
 	obj.parent_tree = get_host_children(host, SDB_SERVICE);
+	obj.by_time = get_host_time_list(host, SDB_SERVICE);
+	obj.counter = &st->services_num;
 	obj.type = SDB_SERVICE;
 	if (! obj.parent_tree) {
 		sdb_log(SDB_LOG_ERR, "memstore: Failed to store service '%s' - "
@@ -656,34 +1120,21 @@ store_service(sdb_store_service_t *service, sdb_object_t *user_data)
 	obj.backends_num = service->backends_num;
 	if (! status)
 		status = store_obj(&obj, NULL);
-
-	sdb_object_deref(SDB_OBJ(host));
-	pthread_rwlock_unlock(&st->host_lock);
 	return status;
-} /* store_service */
+} /* host_store_service */
 
 static int
-store_metric(sdb_store_metric_t *metric, sdb_object_t *user_data)
+host_store_metric(sdb_memstore_t *st, host_t *host,
+		sdb_store_metric_t *metric)
 {
-	sdb_memstore_t *st = SDB_MEMSTORE(user_data);
 	store_obj_t obj = STORE_OBJ_INIT;
 	sdb_memstore_obj_t *new = NULL;
-	host_t *host;
-
 	int status = 0;
-	size_t i;
-
-	if ((! metric) || (! metric->hostname) || (! metric->name))
-		return -1;
-
-	for (i = 0; i < metric->stores_num; ++i)
-		if ((metric->stores[i].type == NULL) || (metric->stores[i].id == NULL))
-			return -1;
 
-	pthread_rwlock_wrlock(&st->host_lock);
-	host = HOST(sdb_avltree_lookup(st->hosts, metric->hostname));
 	obj.parent = STORE_OBJ(host);
 	obj.parent_tree = get_host_children(host, SDB_METRIC);
+	obj.by_time = get_host_time_list(host, SDB_METRIC);
+	obj.counter = &st->metrics_num;
 	obj.type = SDB_METRIC;
 	if (! obj.parent_tree) {
 		sdb_log(SDB_LOG_ERR, "memstore: Failed to store metric '%s' - "
@@ -698,31 +1149,227 @@ store_metric(sdb_store_metric_t *metric, sdb_object_t *user_data)
 	obj.backends_num = metric->backends_num;
 	if (! status)
 		status = store_obj(&obj, &new);
-	sdb_object_deref(SDB_OBJ(host));
 
-	if (status) {
-		pthread_rwlock_unlock(&st->host_lock);
-		return status;
+	if (! status) {
+		assert(new);
+		if (store_metric_stores(METRIC(new), metric))
+			status = -1;
 	}
-
-	assert(new);
-	if (store_metric_stores(METRIC(new), metric))
-		status = -1;
-	pthread_rwlock_unlock(&st->host_lock);
 	return status;
-} /* store_metric */
+} /* host_store_metric */
 
-sdb_store_writer_t sdb_memstore_writer = {
-	store_host, store_service, store_metric, store_attribute,
-};
+static bool
+attribute_valid(sdb_store_attribute_t *attr)
+{
+	return attr && attr->parent && attr->key && attr_hostname(attr);
+} /* attribute_valid */
 
-/*
- * store query API
- */
+static bool
+service_valid(sdb_store_service_t *service)
+{
+	return service && service->hostname && service->name;
+} /* service_valid */
 
-static sdb_object_t *
-prepare_query(sdb_ast_node_t *ast,
-		sdb_strbuf_t __attribute__((unused)) *errbuf,
+static bool
+metric_valid(sdb_store_metric_t *metric)
+{
+	size_t i;
+
+	if ((! metric) || (! metric->hostname) || (! metric->name))
+		return 0;
+
+	for (i = 0; i < metric->stores_num; ++i)
+		if ((metric->stores[i].type == NULL) || (metric->stores[i].id == NULL))
+			return 0;
+	return 1;
+} /* metric_valid */
+
+/*
+ * store writer API
+ */
+
+static int
+store_attribute(sdb_store_attribute_t *attr, sdb_object_t *user_data)
+{
+	sdb_memstore_t *st = SDB_MEMSTORE(user_data);
+	host_t *host;
+	int status;
+
+	if (! attribute_valid(attr))
+		return -1;
+
+	host = lock_host(st, attr_hostname(attr));
+	status = host_store_attribute(st, host, attr);
+	unlock_host(host);
+	return status;
+} /* store_attribute */
+
+static int
+store_host(sdb_store_host_t *host, sdb_object_t *user_data)
+{
+	sdb_memstore_t *st = SDB_MEMSTORE(user_data);
+	store_obj_t obj = { NULL, st->hosts, SDB_HOST, NULL, 0, 0, NULL, 0,
+		&st->hosts_by_time, NULL };
+	host_t *old;
+	int status = 0;
+
+	if ((! host) || (! host->name))
+		return -1;
+
+	obj.name = host->name;
+	obj.last_update = host->last_update;
+	obj.interval = host->interval;
+	obj.backends = host->backends;
+	obj.backends_num = host->backends_num;
+
+	/* updating an existing host only requires the host's own lock */
+	old = lock_host(st, host->name);
+	if (old) {
+		status = update_obj(STORE_OBJ(old), &obj);
+		unlock_host(old);
+		return status;
+	}
+
+	pthread_mutex_lock(&st->host_lock);
+	/* the host might have been added in the meantime */
+	old = HOST(sdb_avltree_lookup(st->hosts, host->name));
+	if (old) {
+		pthread_rwlock_wrlock(&old->lock);
+		status = update_obj(STORE_OBJ(old), &obj);
+		unlock_host(old);
+	}
+	else
+		status = store_obj(&obj, NULL);
+	pthread_mutex_unlock(&st->host_lock);
+
+	return status;
+} /* store_host */
+
+static int
+store_service(sdb_store_service_t *service, sdb_object_t *user_data)
+{
+	sdb_memstore_t *st = SDB_MEMSTORE(user_data);
+	host_t *host;
+	int status;
+
+	if (! service_valid(service))
+		return -1;
+
+	host = lock_host(st, service->hostname);
+	status = host_store_service(st, host, service);
+	unlock_host(host);
+	return status;
+} /* store_service */
+
+static int
+store_metric(sdb_store_metric_t *metric, sdb_object_t *user_data)
+{
+	sdb_memstore_t *st = SDB_MEMSTORE(user_data);
+	host_t *host;
+	int status;
+
+	if (! metric_valid(metric))
+		return -1;
+
+	host = lock_host(st, metric->hostname);
+	status = host_store_metric(st, host, metric);
+	unlock_host(host);
+	return status;
+} /* store_metric */
+
+/*
+ * Store all entries of a batch, in order. The lock of the most recently used
+ * host is kept for as long as subsequent entries refer to the same host,
+ * such that a batch of objects grouped by host only acquires each host's
+ * lock once.
+ */
+static int
+store_batch(sdb_store_batch_entry_t *entries, size_t entries_num,
+		sdb_object_t *user_data)
+{
+	sdb_memstore_t *st = SDB_MEMSTORE(user_data);
+	host_t *host = NULL;
+	const char *hostname = NULL;
+
+	int status = 0;
+	size_t i;
+
+	if ((! entries) && entries_num)
+		return -1;
+
+	for (i = 0; i < entries_num; ++i) {
+		sdb_store_batch_entry_t *e = entries + i;
+		const char *name = NULL;
+		int s;
+
+		if (e->type == SDB_HOST) {
+			store_obj_t obj = { NULL, st->hosts, SDB_HOST, NULL, 0, 0, NULL, 0,
+				&st->hosts_by_time, NULL };
+
+			if ((! host) || (! e->obj.host.name)
+					|| strcasecmp(hostname, e->obj.host.name)) {
+				/* store_host() handles locking and creating hosts itself */
+				unlock_host(host);
+				host = NULL;
+				hostname = NULL;
+				s = store_host(&e->obj.host, user_data);
+			}
+			else {
+				obj.name = e->obj.host.name;
+				obj.last_update = e->obj.host.last_update;
+				obj.interval = e->obj.host.interval;
+				obj.backends = e->obj.host.backends;
+				obj.backends_num = e->obj.host.backends_num;
+				s = update_obj(STORE_OBJ(host), &obj);
+			}
+		}
+		else {
+			if ((e->type == SDB_SERVICE) && service_valid(&e->obj.service))
+				name = e->obj.service.hostname;
+			else if ((e->type == SDB_METRIC) && metric_valid(&e->obj.metric))
+				name = e->obj.metric.hostname;
+			else if ((e->type == SDB_ATTRIBUTE)
+					&& attribute_valid(&e->obj.attribute))
+				name = attr_hostname(&e->obj.attribute);
+
+			if (! name)
+				s = -1;
+			else {
+				if ((! hostname) || strcasecmp(hostname, name)) {
+					unlock_host(host);
+					host = lock_host(st, name);
+					hostname = name;
+				}
+
+				if (e->type == SDB_SERVICE)
+					s = host_store_service(st, host, &e->obj.service);
+				else if (e->type == SDB_METRIC)
+					s = host_store_metric(st, host, &e->obj.metric);
+				else
+					s = host_store_attribute(st, host, &e->obj.attribute);
+			}
+		}
+
+		if (((s > 0) && (status >= 0)) || (s < 0))
+			status = s;
+	}
+
+	unlock_host(host);
+	return status;
+} /* store_batch */
+
+sdb_store_writer_t sdb_memstore_writer = {
+	store_host, store_service, store_metric, store_attribute, store_batch,
+	NULL, NULL,
+};
+
+/*
+ * store query API
+ */
+
+static sdb_object_t *
+prepare_query(sdb_ast_node_t *ast,
+		sdb_strbuf_t __attribute__((unused)) *errbuf,
 		sdb_object_t __attribute__((unused)) *user_data)
 {
 	return SDB_OBJ(sdb_memstore_query_prepare(ast));
@@ -737,14 +1384,133 @@ execute_query(sdb_object_t *q,
 			QUERY(q), w, wd, errbuf);
 } /* execute_query */
 
+static int
+explain_query(sdb_object_t *q, sdb_strbuf_t *buf,
+		sdb_strbuf_t __attribute__((unused)) *errbuf,
+		sdb_object_t __attribute__((unused)) *user_data)
+{
+	return sdb_memstore_query_explain(QUERY(q), buf);
+} /* explain_query */
+
 sdb_store_reader_t sdb_memstore_reader = {
-	prepare_query, execute_query,
+	prepare_query, execute_query, explain_query,
 };
 
 /*
  * public API
  */
 
+int
+sdb_memstore_expire(sdb_memstore_t *store, const sdb_memstore_expiry_t *expiry,
+		sdb_time_t now)
+{
+	expire_t e = { store, expiry, now, NULL, 0, 0 };
+	sdb_avltree_iter_t *host_iter;
+
+	if ((! store) || (! expiry))
+		return -1;
+
+	host_iter = sdb_avltree_get_iter(store->hosts);
+	if (! host_iter)
+		return -1;
+
+	while (sdb_avltree_iter_has_next(host_iter)) {
+		e.host = HOST(sdb_avltree_iter_get_next(host_iter));
+		assert(e.host);
+
+		if (expired(STORE_OBJ(e.host), &expiry->host, now)) {
+			expire_host(store, &e);
+			continue;
+		}
+
+		pthread_rwlock_wrlock(&e.host->lock);
+		e.checked = 0;
+		if (! e.host->removed) {
+			expire_children(&e, e.host->attributes, &expiry->attribute, NULL);
+			expire_children(&e, e.host->services,
+					&expiry->service, &expiry->attribute);
+			expire_children(&e, e.host->metrics,
+					&expiry->metric, &expiry->attribute);
+		}
+		pthread_rwlock_unlock(&e.host->lock);
+	}
+
+	sdb_avltree_iter_destroy(host_iter);
+	return e.removed;
+} /* sdb_memstore_expire */
+
+int
+sdb_memstore_index_attribute(sdb_memstore_t *store, const char *key)
+{
+	sdb_avltree_iter_t *host_iter;
+	int status;
+
+	if ((! store) || (! key))
+		return -1;
+
+	/* from now on, all updates of the key's attributes are indexed */
+	if ((status = sdb_memstore_index_add_key(store->index, key)))
+		return status;
+
+	/* index all existing attributes; adding attributes to the index is
+	 * idempotent, so racing with writers is fine */
+	host_iter = sdb_avltree_get_iter(store->hosts);
+	if (! host_iter)
+		return -1;
+
+	while (sdb_avltree_iter_has_next(host_iter)) {
+		host_t *host = HOST(sdb_avltree_iter_get_next(host_iter));
+		sdb_avltree_t *trees[] = {
+			host->services, host->metrics,
+		};
+		sdb_memstore_obj_t *attr;
+		size_t i;
+
+		pthread_rwlock_rdlock(&host->lock);
+		if (host->removed) {
+			pthread_rwlock_unlock(&host->lock);
+			continue;
+		}
+
+		attr = STORE_OBJ(sdb_avltree_lookup(host->attributes, key));
+		if (attr && sdb_memstore_index_update(store->index, attr,
+					NULL, &ATTR(attr)->value))
+			status = -1;
+		sdb_object_deref(SDB_OBJ(attr));
+
+		for (i = 0; i < SDB_STATIC_ARRAY_LEN(trees); ++i) {
+			sdb_avltree_iter_t *iter = sdb_avltree_get_iter(trees[i]);
+
+			while (sdb_avltree_iter_has_next(iter)) {
+				sdb_memstore_obj_t *obj;
+				obj = STORE_OBJ(sdb_avltree_iter_get_next(iter));
+
+				attr = sdb_memstore_get_child(obj, SDB_ATTRIBUTE, key);
+				if (attr && sdb_memstore_index_update(store->index, attr,
+							NULL, &ATTR(attr)->value))
+					status = -1;
+				sdb_object_deref(SDB_OBJ(attr));
+			}
+			sdb_avltree_iter_destroy(iter);
+		}
+		pthread_rwlock_unlock(&host->lock);
+	}
+
+	sdb_avltree_iter_destroy(host_iter);
+	return status;
+} /* sdb_memstore_index_attribute */
+
+size_t
+sdb_memstore_backend_names(const char **names)
+{
+	size_t num = __atomic_load_n(&backend_names_num, __ATOMIC_ACQUIRE);
+	size_t i;
+
+	for (i = 0; i < num; ++i)
+		names[i] = backend_names[i];
+	return num;
+} /* sdb_memstore_backend_names */
+
 sdb_memstore_t *
 sdb_memstore_create(void)
 {
@@ -780,13 +1546,13 @@ sdb_memstore_metric(sdb_memstore_t *store, const char *hostname, const char *nam
 		hostname, name, /* stores */ NULL, 0,
 		last_update, interval, NULL, 0,
 	};
+	sdb_metric_store_t s = SDB_METRIC_STORE_INIT;
+
 	if (metric_store) {
-		metric.stores = &(const sdb_metric_store_t){
-			metric_store->type,
-			metric_store->id,
-			NULL,
-			metric_store->last_update,
-		};
+		s.type = metric_store->type;
+		s.id = metric_store->id;
+		s.last_update = metric_store->last_update;
+		metric.stores = &s;
 		metric.stores_num = 1;
 	}
 	return store_metric(&metric, SDB_OBJ(store));
@@ -897,12 +1663,16 @@ sdb_memstore_get_field(sdb_memstore_obj_t *obj, int field, sdb_data_t *res)
 			tmp.data.datetime = obj->interval;
 			break;
 		case SDB_FIELD_BACKEND:
-			if (! res)
-				return 0;
-			tmp.type = SDB_TYPE_ARRAY | SDB_TYPE_STRING;
-			tmp.data.array.length = obj->backends_num;
-			tmp.data.array.values = obj->backends;
-			return sdb_data_copy(res, &tmp);
+			{
+				const char *backends[BACKENDS_MAX];
+
+				if (! res)
+					return 0;
+				tmp.type = SDB_TYPE_ARRAY | SDB_TYPE_STRING;
+				tmp.data.array.length = get_backends(obj, backends);
+				tmp.data.array.values = tmp.data.array.length ? backends : NULL;
+				return sdb_data_copy(res, &tmp);
+			}
 		case SDB_FIELD_VALUE:
 			if (obj->type != SDB_ATTRIBUTE)
 				return -1;
@@ -937,7 +1707,7 @@ sdb_memstore_get_attr(sdb_memstore_obj_t *obj, const char *name, sdb_data_t *res
 	attr = STORE_OBJ(sdb_avltree_lookup(get_obj_attrs(obj), name));
 	if (! attr)
 		return -1;
-	if (filter && (! sdb_memstore_matcher_matches(filter, attr, NULL))) {
+	if (! sdb_memstore_visible(filter, attr)) {
 		sdb_object_deref(SDB_OBJ(attr));
 		return -1;
 	}
@@ -949,12 +1719,88 @@ sdb_memstore_get_attr(sdb_memstore_obj_t *obj, const char *name, sdb_data_t *res
 	return 0;
 } /* sdb_memstore_get_attr */
 
+/* the longest name prefix implied by the matcher or the filter; only
+ * objects whose names start with it have to be scanned */
+static size_t
+scan_prefix(sdb_memstore_matcher_t *m, sdb_memstore_matcher_t *filter,
+		int type, int target, char *buf, size_t size)
+{
+	char tmp[size];
+	size_t len, n;
+
+	len = sdb_memstore_matcher_prefix(m, type, target, buf, size);
+	/* the filter is applied to the target objects themselves */
+	n = sdb_memstore_matcher_prefix(filter, target, target, tmp, size);
+	if (n > len) {
+		memcpy(buf, tmp, n + 1);
+		len = n;
+	}
+	return len;
+} /* scan_prefix */
+
+/* check whether there is a next object and whether its name starts with the
+ * prefix; once it does not, none of the following objects does either */
+static bool
+scan_has_next(sdb_avltree_iter_t *iter, const char *prefix, size_t len)
+{
+	sdb_object_t *next = sdb_avltree_iter_peek_next(iter);
+
+	if (! next)
+		return 0;
+	return (! len) || (! strncasecmp(next->name, prefix, len));
+} /* scan_has_next */
+
+/* Position the iterator at the first object whose name starts with the
+ * prefix and which does not precede the specified name. */
+static void
+scan_seek(sdb_avltree_iter_t *iter, const char *prefix, size_t prefix_len,
+		const char *name)
+{
+	if (name && ((! prefix_len) || (strcasecmp(name, prefix) > 0)))
+		sdb_avltree_iter_seek(iter, name);
+	else if (prefix_len)
+		sdb_avltree_iter_seek(iter, prefix);
+} /* scan_seek */
+
+/* Skip the next object if it has the specified name. */
+static void
+scan_skip(sdb_avltree_iter_t *iter, const char *name)
+{
+	sdb_object_t *next = sdb_avltree_iter_peek_next(iter);
+	if (next && (! strcasecmp(next->name, name)))
+		sdb_avltree_iter_get_next(iter);
+} /* scan_skip */
+
 int
 sdb_memstore_scan(sdb_memstore_t *store, int type,
 		sdb_memstore_matcher_t *m, sdb_memstore_matcher_t *filter,
 		sdb_memstore_lookup_cb cb, void *user_data)
 {
+	return sdb_memstore_scan_after(store, type, NULL, NULL,
+			m, filter, cb, user_data);
+} /* sdb_memstore_scan */
+
+int
+sdb_memstore_scan_after(sdb_memstore_t *store, int type,
+		const char *hostname, const char *name,
+		sdb_memstore_matcher_t *m, sdb_memstore_matcher_t *filter,
+		sdb_memstore_lookup_cb cb, void *user_data)
+{
+	return sdb_memstore_scan_yield(store, type, hostname, name,
+			m, filter, cb, NULL, user_data);
+} /* sdb_memstore_scan_after */
+
+int
+sdb_memstore_scan_yield(sdb_memstore_t *store, int type,
+		const char *hostname, const char *name,
+		sdb_memstore_matcher_t *m, sdb_memstore_matcher_t *filter,
+		sdb_memstore_lookup_cb cb, sdb_memstore_yield_cb yield,
+		void *user_data)
+{
+	sdb_memstore_visibility_t scope;
 	sdb_avltree_iter_t *host_iter = NULL;
+	char host_prefix[64], prefix[64];
+	size_t host_prefix_len, prefix_len = 0;
 	int status = 0;
 
 	if ((! store) || (! cb))
@@ -965,45 +1811,78 @@ sdb_memstore_scan(sdb_memstore_t *store, int type,
 		return -1;
 	}
 
-	pthread_rwlock_rdlock(&store->host_lock);
+	/* the iterator provides a consistent snapshot of all hosts without
+	 * blocking any writers */
 	host_iter = sdb_avltree_get_iter(store->hosts);
 	if (! host_iter)
 		status = -1;
 
-	/* has_next returns false if the iterator is NULL */
-	while (sdb_avltree_iter_has_next(host_iter)) {
+	/* names are sorted, so scans may skip to the first possible match and
+	 * stop after the last one; likewise, they may skip to the object
+	 * following the specified one */
+	host_prefix_len = scan_prefix(m, filter, type, SDB_HOST,
+			host_prefix, sizeof(host_prefix));
+	scan_seek(host_iter, host_prefix, host_prefix_len, hostname);
+	if (hostname && ((type == SDB_HOST) || (! name)))
+		scan_skip(host_iter, hostname);
+	if (type != SDB_HOST)
+		prefix_len = scan_prefix(m, filter, type, type,
+				prefix, sizeof(prefix));
+
+	/* decide about the visibility of each object only once, no matter how
+	 * often the matcher, the filter, or the callback refer to it */
+	sdb_memstore_visibility_begin(&scope);
+
+	/* peek_next returns NULL if the iterator is NULL */
+	while (scan_has_next(host_iter, host_prefix, host_prefix_len)) {
 		sdb_memstore_obj_t *host;
 		sdb_avltree_iter_t *iter = NULL;
 
 		host = STORE_OBJ(sdb_avltree_iter_get_next(host_iter));
 		assert(host);
 
-		if (! sdb_memstore_matcher_matches(filter, host, NULL))
+		/* writers only ever block the host they are updating */
+		pthread_rwlock_rdlock(&HOST(host)->lock);
+		if (! sdb_memstore_visible(filter, host)) {
+			pthread_rwlock_unlock(&HOST(host)->lock);
+			sdb_memstore_visibility_reset(&scope);
 			continue;
+		}
 
 		if (type == SDB_SERVICE)
 			iter = sdb_avltree_get_iter(HOST(host)->services);
 		else if (type == SDB_METRIC)
 			iter = sdb_avltree_get_iter(HOST(host)->metrics);
 
+		if (iter && hostname && name
+				&& (! strcasecmp(SDB_OBJ(host)->name, hostname))) {
+			scan_seek(iter, prefix, prefix_len, name);
+			scan_skip(iter, name);
+		}
+		else if (iter)
+			scan_seek(iter, prefix, prefix_len, NULL);
+
 		if (iter) {
-			while (sdb_avltree_iter_has_next(iter)) {
+			while (scan_has_next(iter, prefix, prefix_len)) {
 				sdb_memstore_obj_t *obj;
 				obj = STORE_OBJ(sdb_avltree_iter_get_next(iter));
 				assert(obj);
 
 				if (sdb_memstore_matcher_matches(m, obj, filter)) {
-					if (cb(obj, filter, user_data)) {
+					status = cb(obj, filter, user_data);
+					if (status < 0) {
 						sdb_log(SDB_LOG_ERR, "memstore: Callback returned "
 								"an error while scanning");
 						status = -1;
-						break;
 					}
+					if (status)
+						break;
 				}
 			}
 		}
 		else if (sdb_memstore_matcher_matches(m, host, filter)) {
-			if (cb(host, filter, user_data)) {
+			status = cb(host, filter, user_data);
+			if (status < 0) {
 				sdb_log(SDB_LOG_ERR, "memstore: Callback returned "
 						"an error while scanning");
 				status = -1;
@@ -1011,21 +1890,465 @@ sdb_memstore_scan(sdb_memstore_t *store, int type,
 		}
 
 		sdb_avltree_iter_destroy(iter);
+		pthread_rwlock_unlock(&HOST(host)->lock);
+		sdb_memstore_visibility_reset(&scope);
+		if ((! status) && yield)
+			status = yield(user_data);
 		if (status)
 			break;
 	}
 
+	sdb_memstore_visibility_end(&scope);
 	sdb_avltree_iter_destroy(host_iter);
-	pthread_rwlock_unlock(&store->host_lock);
+	/* the callback stops the scan successfully by returning a positive value */
+	return status < 0 ? status : 0;
+} /* sdb_memstore_scan_yield */
+
+/* Pass on a matching object to the callback. Returns a positive value if the
+ * callback asked to stop the scan. */
+static int
+scan_emit(sdb_memstore_obj_t *obj,
+		sdb_memstore_matcher_t *m, sdb_memstore_matcher_t *filter,
+		sdb_memstore_lookup_cb cb, void *user_data)
+{
+	int status;
+
+	if (! sdb_memstore_matcher_matches(m, obj, filter))
+		return 0;
+	status = cb(obj, filter, user_data);
+	if (status < 0) {
+		sdb_log(SDB_LOG_ERR, "memstore: Callback returned "
+				"an error while scanning");
+		return -1;
+	}
 	return status;
-} /* sdb_memstore_scan */
+} /* scan_emit */
+
+/* Walking a tree is cheaper than seeking from its root once the objects to
+ * look up are closer to each other than the depth of the tree. */
+#define SCAN_DENSE(refs_num, size) ((refs_num) * 16 >= (size))
+
+/* Indexes only pay off if they select at most half of all objects. Small
+ * stores use an index regardless. */
+#define SCAN_INDEX_MAX(total) ((total) < 256 ? (total) : (total) / 2)
+
+/* Count the objects of the specified type; counts are read without
+ * locking. */
+static size_t
+count_objs(sdb_memstore_t *store, int type)
+{
+	if (type == SDB_SERVICE)
+		return __atomic_load_n(&store->services_num, __ATOMIC_RELAXED);
+	if (type == SDB_METRIC)
+		return __atomic_load_n(&store->metrics_num, __ATOMIC_RELAXED);
+	return sdb_avltree_size(store->hosts);
+} /* count_objs */
+
+/*
+ * Advance the iterator to the object with the specified name and return it
+ * (without taking a reference). Names have to be looked up in order. Dense
+ * lookups walk the tree while sparse lookups seek to each name.
+ */
+static sdb_object_t *
+scan_find(sdb_avltree_iter_t *iter, const char *name, bool dense)
+{
+	sdb_object_t *next;
+
+	if (! dense)
+		sdb_avltree_iter_seek(iter, name);
+	while ((next = sdb_avltree_iter_peek_next(iter))) {
+		int diff = strcasecmp(next->name, name);
+
+		if (diff > 0)
+			break;
+		sdb_avltree_iter_get_next(iter);
+		if (! diff)
+			return next;
+	}
+	return NULL;
+} /* scan_find */
+
+/* Scan all children of the specified type of a locked host. */
+static int
+scan_host_children(sdb_memstore_obj_t *host, int type,
+		sdb_memstore_matcher_t *m, sdb_memstore_matcher_t *filter,
+		sdb_memstore_lookup_cb cb, void *user_data)
+{
+	sdb_avltree_iter_t *iter;
+	char prefix[64];
+	size_t prefix_len;
+	int status = 0;
+
+	iter = sdb_avltree_get_iter(get_host_children(HOST(host), type));
+	prefix_len = scan_prefix(m, filter, type, type, prefix, sizeof(prefix));
+	if (prefix_len)
+		sdb_avltree_iter_seek(iter, prefix);
+	while ((! status) && scan_has_next(iter, prefix, prefix_len))
+		status = scan_emit(STORE_OBJ(sdb_avltree_iter_get_next(iter)),
+				m, filter, cb, user_data);
+	sdb_avltree_iter_destroy(iter);
+	return status;
+} /* scan_host_children */
+
+/* Scan the objects of a locked host referenced by an index. References to
+ * the host itself refer to all of its children of the requested type. */
+static int
+scan_index_host(sdb_memstore_obj_t *host, int type,
+		const sdb_memstore_index_ref_t *refs, size_t refs_num,
+		sdb_memstore_matcher_t *m, sdb_memstore_matcher_t *filter,
+		sdb_memstore_lookup_cb cb, void *user_data)
+{
+	sdb_avltree_t *children;
+	sdb_avltree_iter_t *iter;
+	int status = 0;
+	bool dense;
+	size_t i;
+
+	if (type == SDB_HOST)
+		return scan_emit(host, m, filter, cb, user_data);
+	if (! refs[0].name)
+		return scan_host_children(host, type, m, filter, cb, user_data);
+
+	children = get_host_children(HOST(host), type);
+	iter = sdb_avltree_get_iter(children);
+	dense = SCAN_DENSE(refs_num, sdb_avltree_size(children));
+	for (i = 0; (! status) && (i < refs_num); ++i) {
+		sdb_object_t *obj = scan_find(iter, refs[i].name, dense);
+		if (obj)
+			status = scan_emit(STORE_OBJ(obj), m, filter, cb, user_data);
+	}
+	sdb_avltree_iter_destroy(iter);
+	return status;
+} /* scan_index_host */
+
+int
+sdb_memstore_scan_index(sdb_memstore_t *store, int type,
+		const sdb_memstore_index_pred_t *pred,
+		sdb_memstore_matcher_t *m, sdb_memstore_matcher_t *filter,
+		sdb_memstore_lookup_cb cb, sdb_memstore_yield_cb yield,
+		void *user_data)
+{
+	sdb_memstore_visibility_t scope;
+	sdb_avltree_iter_t *host_iter;
+	sdb_memstore_index_ref_t *refs = NULL;
+	size_t refs_num = 0, i, j;
+	bool dense;
+	int status;
+
+	if ((! store) || (! pred) || (! cb))
+		return -1;
+
+	if ((type != SDB_HOST) && (type != SDB_SERVICE) && (type != SDB_METRIC)) {
+		sdb_log(SDB_LOG_ERR, "memstore: Cannot scan objects of type %d", type);
+		return -1;
+	}
+
+	/* predicates on the attributes of hosts select all of their children */
+	if ((! pred->type) || ((pred->type != type) && (pred->type != SDB_HOST)))
+		return 1;
+
+	status = sdb_memstore_index_lookup(store->index, pred->type,
+			pred->key, pred->value, pred->in,
+			SCAN_INDEX_MAX(count_objs(store, pred->type)), &refs, &refs_num);
+	if (status)
+		return status;
+
+	/* like a full scan, this operates on a snapshot of all hosts */
+	host_iter = sdb_avltree_get_iter(store->hosts);
+	if (! host_iter)
+		status = -1;
+	dense = SCAN_DENSE(refs_num, sdb_avltree_size(store->hosts));
+
+	sdb_memstore_visibility_begin(&scope);
+
+	/* references are sorted by host, so each host is locked only once */
+	for (i = 0; (! status) && (i < refs_num); i = j) {
+		sdb_memstore_obj_t *host;
+
+		for (j = i + 1; j < refs_num; ++j)
+			if (strcasecmp(refs[i].host, refs[j].host))
+				break;
+
+		host = STORE_OBJ(scan_find(host_iter, refs[i].host, dense));
+		if (! host)
+			continue;
+
+		pthread_rwlock_rdlock(&HOST(host)->lock);
+		if (sdb_memstore_visible(filter, host))
+			status = scan_index_host(host, type, refs + i, j - i,
+					m, filter, cb, user_data);
+		pthread_rwlock_unlock(&HOST(host)->lock);
+		sdb_memstore_visibility_reset(&scope);
+		if ((! status) && yield)
+			status = yield(user_data);
+	}
+
+	sdb_memstore_visibility_end(&scope);
+	sdb_avltree_iter_destroy(host_iter);
+	free(refs);
+	return status < 0 ? status : 0;
+} /* sdb_memstore_scan_index */
+
+/* a range of last updates */
+typedef struct {
+	sdb_time_t min, max;
+} time_range_t;
+
+/* a growing list of objects found while scanning */
+typedef struct {
+	sdb_memstore_obj_t **objs;
+	size_t objs_num;
+	size_t objs_size;
+} obj_list_t;
+#define OBJ_LIST_INIT { NULL, 0, 0 }
+
+/*
+ * Determine the ranges of last updates of all objects satisfying the
+ * predicate at the specified time. The age of objects updated in the future
+ * wraps around, so those are always considered as well. Returns the number
+ * of ranges.
+ */
+static size_t
+time_ranges(const sdb_memstore_time_pred_t *pred, sdb_time_t now,
+		time_range_t *ranges)
+{
+	time_range_t r = { pred->last_update_min, pred->last_update_max };
+	size_t n = 0;
+
+	if ((! pred->age_min) && (pred->age_max == UINT64_MAX)) {
+		ranges[0] = r;
+		return r.min <= r.max;
+	}
+
+	/* age = now - last_update */
+	if ((pred->age_min <= now) && (pred->age_min <= pred->age_max)) {
+		ranges[n].min = pred->age_max < now ? now - pred->age_max : 0;
+		ranges[n].max = now - pred->age_min;
+		if (ranges[n].min < r.min)
+			ranges[n].min = r.min;
+		if (ranges[n].max > r.max)
+			ranges[n].max = r.max;
+		if (ranges[n].min <= ranges[n].max)
+			++n;
+	}
+	if ((now < UINT64_MAX) && (now < r.max)) {
+		ranges[n].min = now + 1 > r.min ? now + 1 : r.min;
+		ranges[n].max = r.max;
+		++n;
+	}
+	return n;
+} /* time_ranges */
+
+static int
+obj_list_add(obj_list_t *list, sdb_memstore_obj_t *obj)
+{
+	if (list->objs_num >= list->objs_size) {
+		size_t size = list->objs_size ? 2 * list->objs_size : 64;
+		sdb_memstore_obj_t **tmp;
+
+		tmp = realloc(list->objs, size * sizeof(*list->objs));
+		if (! tmp)
+			return -1;
+		list->objs = tmp;
+		list->objs_size = size;
+	}
+	list->objs[list->objs_num++] = obj;
+	return 0;
+} /* obj_list_add */
+
+static int
+obj_name_cmp(const void *o1, const void *o2)
+{
+	return strcasecmp(SDB_OBJ(*(sdb_memstore_obj_t * const *)o1)->name,
+			SDB_OBJ(*(sdb_memstore_obj_t * const *)o2)->name);
+} /* obj_name_cmp */
+
+/*
+ * Collect all objects of a list whose last update is in one of the ranges,
+ * walking the list from the closer end of each range. Returns a positive
+ * value if there are more than 'max' such objects.
+ */
+static int
+time_list_collect(const sdb_memstore_time_list_t *list,
+		const time_range_t *ranges, size_t ranges_num, size_t max,
+		obj_list_t *res)
+{
+	size_t i;
+
+	res->objs_num = 0;
+	for (i = 0; i < ranges_num; ++i) {
+		sdb_memstore_obj_t *obj;
+
+		if (! ranges[i].min) {
+			for (obj = list->oldest; obj; obj = obj->newer) {
+				if (obj->last_update > ranges[i].max)
+					break;
+				if (res->objs_num >= max)
+					return 1;
+				if (obj_list_add(res, obj))
+					return -1;
+			}
+			continue;
+		}
+
+		for (obj = list->newest; obj; obj = obj->older) {
+			if (obj->last_update < ranges[i].min)
+				break;
+			if (obj->last_update > ranges[i].max)
+				continue;
+			if (res->objs_num >= max)
+				return 1;
+			if (obj_list_add(res, obj))
+				return -1;
+		}
+	}
+	return 0;
+} /* time_list_collect */
+
+/* Scan the children of a locked host updated within the specified ranges;
+ * scan all of them if there are too many. */
+static int
+scan_time_children(sdb_memstore_obj_t *host, int type,
+		const time_range_t *ranges, size_t ranges_num, obj_list_t *objs,
+		sdb_memstore_matcher_t *m, sdb_memstore_matcher_t *filter,
+		sdb_memstore_lookup_cb cb, void *user_data)
+{
+	size_t max = SCAN_INDEX_MAX(sdb_avltree_size(
+				get_host_children(HOST(host), type)));
+	int status;
+	size_t i;
+
+	status = time_list_collect(get_host_time_list(HOST(host), type),
+			ranges, ranges_num, max, objs);
+	if (status > 0)
+		return scan_host_children(host, type, m, filter, cb, user_data);
+	if (status < 0)
+		return status;
+
+	/* report objects in the same order as a full scan */
+	if (objs->objs_num)
+		qsort(objs->objs, objs->objs_num, sizeof(*objs->objs), obj_name_cmp);
+	for (i = 0; (! status) && (i < objs->objs_num); ++i)
+		status = scan_emit(objs->objs[i], m, filter, cb, user_data);
+	return status;
+} /* scan_time_children */
+
+int
+sdb_memstore_scan_time(sdb_memstore_t *store, int type,
+		const sdb_memstore_time_pred_t *pred,
+		sdb_memstore_matcher_t *m, sdb_memstore_matcher_t *filter,
+		sdb_memstore_lookup_cb cb, sdb_memstore_yield_cb yield,
+		void *user_data)
+{
+	sdb_memstore_visibility_t scope;
+	obj_list_t hosts = OBJ_LIST_INIT, objs = OBJ_LIST_INIT;
+	sdb_avltree_iter_t *host_iter = NULL;
+	char host_prefix[64];
+	size_t host_prefix_len = 0;
+	time_range_t ranges[2];
+	size_t ranges_num, i;
+	int status = 0;
+
+	if ((! store) || (! pred) || (! cb))
+		return -1;
+
+	if ((type != SDB_HOST) && (type != SDB_SERVICE) && (type != SDB_METRIC)) {
+		sdb_log(SDB_LOG_ERR, "memstore: Cannot scan objects of type %d", type);
+		return -1;
+	}
+
+	/* predicates on the last update of hosts select all of their children */
+	if ((! pred->type) || ((pred->type != type) && (pred->type != SDB_HOST)))
+		return 1;
+
+	ranges_num = time_ranges(pred, sdb_gettime(), ranges);
+	if (! ranges_num)
+		return 0; /* nothing can match */
+
+	if (pred->type == SDB_HOST) {
+		/* collect the hosts first; the hosts' locks may not be acquired
+		 * while holding the list's lock */
+		pthread_mutex_lock(&store->time_lock);
+		status = time_list_collect(&store->hosts_by_time, ranges, ranges_num,
+				SCAN_INDEX_MAX(sdb_avltree_size(store->hosts)), &hosts);
+		for (i = 0; i < hosts.objs_num; ++i)
+			sdb_object_ref(SDB_OBJ(hosts.objs[i]));
+		pthread_mutex_unlock(&store->time_lock);
+
+		if (status) {
+			/* too many hosts; a positive value tells the caller to fall
+			 * back to a full scan */
+			for (i = 0; i < hosts.objs_num; ++i)
+				sdb_object_deref(SDB_OBJ(hosts.objs[i]));
+			free(hosts.objs);
+			return status;
+		}
+		if (hosts.objs_num)
+			qsort(hosts.objs, hosts.objs_num, sizeof(*hosts.objs),
+					obj_name_cmp);
+	}
+	else {
+		host_iter = sdb_avltree_get_iter(store->hosts);
+		if (! host_iter)
+			status = -1;
+		host_prefix_len = scan_prefix(m, filter, type, SDB_HOST,
+				host_prefix, sizeof(host_prefix));
+		if (host_prefix_len)
+			sdb_avltree_iter_seek(host_iter, host_prefix);
+	}
+
+	sdb_memstore_visibility_begin(&scope);
+
+	for (i = 0; ! status; ++i) {
+		sdb_memstore_obj_t *host;
+
+		if (host_iter) {
+			if (! scan_has_next(host_iter, host_prefix, host_prefix_len))
+				break;
+			host = STORE_OBJ(sdb_avltree_iter_get_next(host_iter));
+		}
+		else if (i < hosts.objs_num)
+			host = hosts.objs[i];
+		else
+			break;
+
+		pthread_rwlock_rdlock(&HOST(host)->lock);
+		if (HOST(host)->removed || (! sdb_memstore_visible(filter, host)))
+			; /* nothing to do */
+		else if (type == SDB_HOST)
+			status = scan_emit(host, m, filter, cb, user_data);
+		else if (pred->type == SDB_HOST)
+			status = scan_host_children(host, type,
+					m, filter, cb, user_data);
+		else
+			status = scan_time_children(host, type, ranges, ranges_num,
+					&objs, m, filter, cb, user_data);
+		pthread_rwlock_unlock(&HOST(host)->lock);
+		sdb_memstore_visibility_reset(&scope);
+		if ((! status) && yield)
+			status = yield(user_data);
+	}
+
+	sdb_memstore_visibility_end(&scope);
+	sdb_avltree_iter_destroy(host_iter);
+	for (i = 0; i < hosts.objs_num; ++i)
+		sdb_object_deref(SDB_OBJ(hosts.objs[i]));
+	free(hosts.objs);
+	free(objs.objs);
+	return status < 0 ? status : 0;
+} /* sdb_memstore_scan_time */
 
 int
 sdb_memstore_emit(sdb_memstore_obj_t *obj, sdb_store_writer_t *w, sdb_object_t *wd)
 {
+	const char *backends[BACKENDS_MAX];
+	size_t backends_num;
+
 	if ((! obj) || (! w))
 		return -1;
 
+	backends_num = get_backends(obj, backends);
+
 	switch (obj->type) {
 	case SDB_HOST:
 		{
@@ -1033,8 +2356,7 @@ sdb_memstore_emit(sdb_memstore_obj_t *obj, sdb_store_writer_t *w, sdb_object_t *
 				obj->_name,
 				obj->last_update,
 				obj->interval,
-				(const char * const *)obj->backends,
-				obj->backends_num,
+				backends, backends_num,
 			};
 			if (! w->store_host)
 				return -1;
@@ -1047,8 +2369,7 @@ sdb_memstore_emit(sdb_memstore_obj_t *obj, sdb_store_writer_t *w, sdb_object_t *
 				obj->_name,
 				obj->last_update,
 				obj->interval,
-				(const char * const *)obj->backends,
-				obj->backends_num,
+				backends, backends_num,
 			};
 			if (! w->store_service)
 				return -1;
@@ -1064,14 +2385,14 @@ sdb_memstore_emit(sdb_memstore_obj_t *obj, sdb_store_writer_t *w, sdb_object_t *
 				METRIC(obj)->stores_num,
 				obj->last_update,
 				obj->interval,
-				(const char * const *)obj->backends,
-				obj->backends_num,
+				backends, backends_num,
 			};
 			size_t i;
 
 			for (i = 0; i < METRIC(obj)->stores_num; ++i) {
 				metric_stores[i].type = METRIC(obj)->stores[i].type;
 				metric_stores[i].id = METRIC(obj)->stores[i].id;
+				metric_stores[i].info = NULL;
 				metric_stores[i].last_update = METRIC(obj)->stores[i].last_update;
 			}
 
@@ -1089,8 +2410,7 @@ sdb_memstore_emit(sdb_memstore_obj_t *obj, sdb_store_writer_t *w, sdb_object_t *
 				ATTR(obj)->value,
 				obj->last_update,
 				obj->interval,
-				(const char * const *)obj->backends,
-				obj->backends_num,
+				backends, backends_num,
 			};
 			if (obj->parent && (obj->parent->type != SDB_HOST)
 					&& obj->parent->parent)
@@ -1139,7 +2459,7 @@ sdb_memstore_emit_full(sdb_memstore_obj_t *obj, sdb_memstore_matcher_t *filter,
 			sdb_memstore_obj_t *child;
 			child = STORE_OBJ(sdb_avltree_iter_get_next(iter));
 
-			if (filter && (! sdb_memstore_matcher_matches(filter, child, NULL)))
+			if (! sdb_memstore_visible(filter, child))
 				continue;
 
 			if (sdb_memstore_emit_full(child, filter, w, wd)) {
@@ -1152,5 +2472,33 @@ sdb_memstore_emit_full(sdb_memstore_obj_t *obj, sdb_memstore_matcher_t *filter,
 	return 0;
 } /* sdb_memstore_emit_full */
 
+int
+sdb_memstore_emit_select(sdb_memstore_obj_t *obj,
+		sdb_memstore_matcher_t *filter,
+		const char * const *attributes, size_t attributes_num,
+		sdb_store_writer_t *w, sdb_object_t *wd)
+{
+	size_t i;
+
+	if (sdb_memstore_emit(obj, w, wd))
+		return -1;
+	if (obj->type == SDB_ATTRIBUTE)
+		return 0;
+
+	/* look up each attribute rather than iterating all of them */
+	for (i = 0; i < attributes_num; ++i) {
+		sdb_memstore_obj_t *attr;
+		int status = 0;
+
+		attr = sdb_memstore_get_child(obj, SDB_ATTRIBUTE, attributes[i]);
+		if (attr && sdb_memstore_visible(filter, attr))
+			status = sdb_memstore_emit(attr, w, wd);
+		sdb_object_deref(SDB_OBJ(attr));
+		if (status)
+			return -1;
+	}
+	return 0;
+} /* sdb_memstore_emit_select */
+
 /* vim: set tw=78 sw=4 ts=4 noexpandtab : */
 
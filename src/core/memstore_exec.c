@@ -35,19 +35,54 @@
 #include <errno.h>
 
 #include <arpa/inet.h>
+#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 /*
  * private helper functions
  */
 
+/* an object collected for ordering the result */
+typedef struct {
+	sdb_memstore_obj_t *host; /* the locked host while scanning */
+	sdb_memstore_obj_t *obj;
+	sdb_data_t key;
+	size_t seq; /* keeps the order of the store among equal keys */
+} sorted_t;
+
 typedef struct {
 	sdb_memstore_obj_t *current_host;
 
 	sdb_store_writer_t *w;
 	sdb_object_t *wd;
+
+	/* emit the full object, including its children */
+	bool full;
+	/* emit selected attributes only (SELECT clause), if set */
+	sdb_memstore_query_t *select;
+
+	/* bounds of the result */
+	const char *after_host;
+	const char *after_name;
+	int64_t offset;
+	int64_t limit; /* negative if unlimited */
+	int64_t seen;
+
+	/* objects collected for ordering the result; this is a max-heap (that
+	 * is, the object which would be emitted last is on top) bounded to
+	 * 'max' entries, or an unordered array if the result is unbounded */
+	sdb_memstore_expr_t *order_by;
+	bool descending;
+	sorted_t *sorted;
+	size_t sorted_num;
+	size_t sorted_size;
+	size_t max;
 } iter_t;
+#define ITER_INIT(w, wd, full) \
+	{ NULL, (w), (wd), (full), NULL, NULL, NULL, 0, -1, 0, \
+		NULL, 0, NULL, 0, 0, SIZE_MAX }
 
 static int
 maybe_emit_host(iter_t *iter, sdb_memstore_obj_t *obj)
@@ -61,23 +96,525 @@ maybe_emit_host(iter_t *iter, sdb_memstore_obj_t *obj)
 } /* maybe_emit_host */
 
 static int
-list_tojson(sdb_memstore_obj_t *obj,
-		sdb_memstore_matcher_t __attribute__((unused)) *filter,
-		void *user_data)
+emit(iter_t *iter, sdb_memstore_obj_t *obj, sdb_memstore_matcher_t *filter)
 {
-	iter_t *iter = user_data;
 	maybe_emit_host(iter, obj);
+	if (iter->select)
+		return sdb_memstore_emit_select(obj, filter, iter->select->select_attrs,
+				iter->select->select_attrs_num, iter->w, iter->wd);
+	if (iter->full)
+		return sdb_memstore_emit_full(obj, filter, iter->w, iter->wd);
 	return sdb_memstore_emit(obj, iter->w, iter->wd);
-} /* list_tojson */
+} /* emit */
+
+/* Let the writer pass on the result emitted so far while the scan does not
+ * hold any locks. */
+static int
+iter_yield(void *user_data)
+{
+	iter_t *iter = user_data;
 
+	if (! iter->w->flush)
+		return 0;
+	return iter->w->flush(iter->wd);
+} /* iter_yield */
+
+/* Returns true if the object follows the continuation key, if any, in the
+ * order of the store (that is, by host and object name). */
+static bool
+is_after(iter_t *iter, sdb_memstore_obj_t *obj)
+{
+	sdb_memstore_obj_t *host = obj->type == SDB_HOST ? obj : obj->parent;
+	int cmp;
+
+	if (! iter->after_host)
+		return 1;
+	cmp = strcasecmp(SDB_OBJ(host)->name, iter->after_host);
+	if (cmp || (obj->type == SDB_HOST))
+		return cmp > 0;
+	if (! iter->after_name)
+		return 0;
+	return strcasecmp(SDB_OBJ(obj)->name, iter->after_name) > 0;
+} /* is_after */
+
+/* Emit objects in the order of the store, stopping the scan once the limit
+ * has been reached. */
 static int
-lookup_tojson(sdb_memstore_obj_t *obj, sdb_memstore_matcher_t *filter,
+emit_tojson(sdb_memstore_obj_t *obj, sdb_memstore_matcher_t *filter,
 		void *user_data)
 {
 	iter_t *iter = user_data;
-	maybe_emit_host(iter, obj);
-	return sdb_memstore_emit_full(obj, filter, iter->w, iter->wd);
-} /* lookup_tojson */
+
+	if (! iter->limit)
+		return 1;
+	/* full scans seek to the key but other scans do not */
+	if (! is_after(iter, obj))
+		return 0;
+	if (++iter->seen <= iter->offset)
+		return 0;
+	if (emit(iter, obj, filter))
+		return -1;
+	if ((iter->limit > 0) && (iter->seen - iter->offset >= iter->limit))
+		return 1;
+	return 0;
+} /* emit_tojson */
+
+static int
+sorted_cmp(const iter_t *iter, const sorted_t *s1, const sorted_t *s2)
+{
+	int status = sdb_data_cmp(&s1->key, &s2->key);
+	if (iter->descending)
+		status = -status;
+	if (! status)
+		status = s1->seq < s2->seq ? -1 : s1->seq > s2->seq;
+	return status;
+} /* sorted_cmp */
+
+static void
+sorted_clear(sorted_t *s)
+{
+	sdb_object_deref(SDB_OBJ(s->obj));
+	sdb_object_deref(SDB_OBJ(s->host));
+	sdb_data_free_datum(&s->key);
+} /* sorted_clear */
+
+static void
+heap_sift_up(iter_t *iter, size_t i)
+{
+	while (i > 0) {
+		size_t parent = (i - 1) / 2;
+		sorted_t tmp;
+
+		if (sorted_cmp(iter, iter->sorted + parent, iter->sorted + i) >= 0)
+			break;
+		tmp = iter->sorted[parent];
+		iter->sorted[parent] = iter->sorted[i];
+		iter->sorted[i] = tmp;
+		i = parent;
+	}
+} /* heap_sift_up */
+
+static void
+heap_sift_down(iter_t *iter, size_t i, size_t n)
+{
+	while (2 * i + 1 < n) {
+		size_t child = 2 * i + 1;
+		sorted_t tmp;
+
+		if ((child + 1 < n) && (sorted_cmp(iter, iter->sorted + child,
+						iter->sorted + child + 1) < 0))
+			++child;
+		if (sorted_cmp(iter, iter->sorted + i, iter->sorted + child) >= 0)
+			break;
+		tmp = iter->sorted[child];
+		iter->sorted[child] = iter->sorted[i];
+		iter->sorted[i] = tmp;
+		i = child;
+	}
+} /* heap_sift_down */
+
+/* Collect objects to be ordered, keeping only the first 'max' of them. */
+static int
+sort_collect(sdb_memstore_obj_t *obj, sdb_memstore_matcher_t *filter,
+		void *user_data)
+{
+	iter_t *iter = user_data;
+	sorted_t s = { NULL, obj, SDB_DATA_INIT, 0 };
+
+	if (! iter->max)
+		return 1;
+
+	if (sdb_memstore_expr_eval(iter->order_by, obj, &s.key, filter))
+		return -1;
+	s.seq = (size_t)iter->seen++;
+
+	if (iter->sorted_num >= iter->max) {
+		/* replace the top of the heap if the object is to be emitted
+		 * before it */
+		if (sorted_cmp(iter, &s, iter->sorted) >= 0) {
+			sdb_data_free_datum(&s.key);
+			return 0;
+		}
+		sorted_clear(iter->sorted);
+		iter->sorted_num--;
+		iter->sorted[0] = iter->sorted[iter->sorted_num];
+		heap_sift_down(iter, 0, iter->sorted_num);
+	}
+	else if (iter->sorted_num >= iter->sorted_size) {
+		size_t size = iter->sorted_size ? 2 * iter->sorted_size : 64;
+		sorted_t *tmp;
+
+		if ((iter->max < SIZE_MAX) && (size > iter->max))
+			size = iter->max;
+		tmp = realloc(iter->sorted, size * sizeof(*tmp));
+		if (! tmp) {
+			sdb_data_free_datum(&s.key);
+			return -1;
+		}
+		iter->sorted = tmp;
+		iter->sorted_size = size;
+	}
+
+	/* the host is locked while scanning and objects keep no references to
+	 * their parents */
+	s.host = obj->type == SDB_HOST ? obj : obj->parent;
+	sdb_object_ref(SDB_OBJ(s.host));
+	sdb_object_ref(SDB_OBJ(s.obj));
+	iter->sorted[iter->sorted_num++] = s;
+	if (iter->max < SIZE_MAX)
+		heap_sift_up(iter, iter->sorted_num - 1);
+	return 0;
+} /* sort_collect */
+
+/* Sort the collected objects and emit them, skipping the first 'offset'. */
+static int
+sort_emit(iter_t *iter, sdb_memstore_matcher_t *filter)
+{
+	size_t i, n;
+	int status = 0;
+
+	if (iter->max == SIZE_MAX)
+		for (i = iter->sorted_num / 2; i > 0; --i)
+			heap_sift_down(iter, i - 1, iter->sorted_num);
+
+	/* heap sort */
+	for (n = iter->sorted_num; n > 1; --n) {
+		sorted_t tmp = iter->sorted[0];
+		iter->sorted[0] = iter->sorted[n - 1];
+		iter->sorted[n - 1] = tmp;
+		heap_sift_down(iter, 0, n - 1);
+	}
+
+	for (i = 0; i < iter->sorted_num; ++i) {
+		sorted_t *s = iter->sorted + i;
+
+		if ((! status) && ((int64_t)i >= iter->offset)) {
+			pthread_rwlock_rdlock(&HOST(s->host)->lock);
+			status = emit(iter, s->obj, filter);
+			pthread_rwlock_unlock(&HOST(s->host)->lock);
+			if (! status)
+				status = iter_yield(iter);
+		}
+		sorted_clear(s);
+	}
+
+	free(iter->sorted);
+	iter->sorted = NULL;
+	iter->sorted_num = iter->sorted_size = 0;
+	return status;
+} /* sort_emit */
+
+/* Prepare the iterator for the ordering and bounds of the query. */
+static sdb_memstore_lookup_cb
+iter_prepare(iter_t *iter, sdb_memstore_query_t *q, int type)
+{
+	sdb_ast_node_t *ast = q->ast;
+
+	if (ast->type == SDB_AST_TYPE_LIST) {
+		iter->descending = SDB_AST_LIST(ast)->descending;
+		iter->after_host = SDB_AST_LIST(ast)->after_host;
+		iter->after_name = SDB_AST_LIST(ast)->after_name;
+		iter->limit = SDB_AST_LIST(ast)->limit;
+		iter->offset = SDB_AST_LIST(ast)->offset;
+	}
+	else {
+		iter->descending = SDB_AST_LOOKUP(ast)->descending;
+		iter->after_host = SDB_AST_LOOKUP(ast)->after_host;
+		iter->after_name = SDB_AST_LOOKUP(ast)->after_name;
+		iter->limit = SDB_AST_LOOKUP(ast)->limit;
+		iter->offset = SDB_AST_LOOKUP(ast)->offset;
+	}
+
+	if (q->select)
+		iter->select = q;
+
+	/* hosts are scanned in the order of their names already */
+	if ((! q->order_by) || ((type == SDB_HOST) && (! iter->descending)
+				&& (q->order_by->type == FIELD_VALUE)
+				&& (q->order_by->data.data.integer == SDB_FIELD_NAME)))
+		return emit_tojson;
+
+	iter->order_by = q->order_by;
+	if (! iter->limit)
+		iter->max = 0;
+	else if ((iter->limit > 0)
+			&& ((uint64_t)iter->limit + (uint64_t)iter->offset < SIZE_MAX))
+		iter->max = (size_t)(iter->limit + iter->offset);
+	return sort_collect;
+} /* iter_prepare */
+
+/* Finish the result after scanning the store. */
+static int
+iter_finish(iter_t *iter, sdb_memstore_matcher_t *filter, int status)
+{
+	size_t i;
+
+	if (! iter->order_by)
+		return status;
+	if (! status)
+		return sort_emit(iter, filter);
+
+	for (i = 0; i < iter->sorted_num; ++i)
+		sorted_clear(iter->sorted + i);
+	free(iter->sorted);
+	iter->sorted = NULL;
+	iter->sorted_num = iter->sorted_size = 0;
+	return status;
+} /* iter_finish */
+
+/* the number of objects having the same value of the grouping expression */
+typedef struct group {
+	struct group *next;
+	uint32_t hash;
+	sdb_data_t value;
+	int64_t count;
+} group_t;
+
+typedef struct {
+	sdb_memstore_expr_t *group_by;
+	int64_t total;
+
+	/* hash table of all groups, sized to a power of two */
+	group_t **buckets;
+	size_t size;
+	size_t groups_num;
+} count_t;
+#define COUNT_INIT(group_by) { (group_by), 0, NULL, 0, 0 }
+
+static uint32_t
+fnv1a(uint32_t h, const void *data, size_t len)
+{
+	const unsigned char *c = data;
+	size_t i;
+
+	for (i = 0; i < len; ++i) {
+		h ^= (uint32_t)c[i];
+		h *= 16777619U;
+	}
+	return h;
+} /* fnv1a */
+
+/* Hash a value consistently with sdb_data_cmp, that is, strings are
+ * compared case-insensitively. */
+static uint32_t
+group_hash(const sdb_data_t *v)
+{
+	uint32_t h = fnv1a(2166136261U, &v->type, sizeof(v->type));
+	double d;
+
+	switch (v->type) {
+	case SDB_TYPE_NULL:
+		return h;
+	case SDB_TYPE_BOOLEAN:
+		return fnv1a(h, &v->data.boolean, sizeof(v->data.boolean));
+	case SDB_TYPE_INTEGER:
+		return fnv1a(h, &v->data.integer, sizeof(v->data.integer));
+	case SDB_TYPE_DECIMAL:
+		/* 0.0 and -0.0 are equal */
+		d = v->data.decimal == 0. ? 0. : v->data.decimal;
+		return fnv1a(h, &d, sizeof(d));
+	case SDB_TYPE_DATETIME:
+		return fnv1a(h, &v->data.datetime, sizeof(v->data.datetime));
+	case SDB_TYPE_STRING:
+		{
+			const char *c;
+			for (c = v->data.string; *c; ++c) {
+				unsigned char l = (unsigned char)tolower((unsigned char)*c);
+				h = fnv1a(h, &l, 1);
+			}
+			return h;
+		}
+	}
+
+	{
+		char buf[sdb_data_strlen(v) + 1];
+		if (sdb_data_format(v, buf, sizeof(buf), SDB_UNQUOTED))
+			h = fnv1a(h, buf, strlen(buf));
+	}
+	return h;
+} /* group_hash */
+
+static int
+count_grow(count_t *count)
+{
+	size_t size = count->size ? 2 * count->size : 64;
+	group_t **buckets;
+	size_t i;
+
+	buckets = calloc(size, sizeof(*buckets));
+	if (! buckets)
+		return -1;
+
+	for (i = 0; i < count->size; ++i) {
+		group_t *g = count->buckets[i];
+		while (g) {
+			group_t *next = g->next;
+			g->next = buckets[g->hash & (size - 1)];
+			buckets[g->hash & (size - 1)] = g;
+			g = next;
+		}
+	}
+
+	free(count->buckets);
+	count->buckets = buckets;
+	count->size = size;
+	return 0;
+} /* count_grow */
+
+/* Count a single value, adding a new group if necessary. */
+static int
+count_value(count_t *count, const sdb_data_t *value)
+{
+	sdb_data_t null = SDB_DATA_INIT;
+	uint32_t hash;
+	group_t *g;
+
+	if (sdb_data_isnull(value))
+		value = &null;
+	hash = group_hash(value);
+
+	if (count->size) {
+		for (g = count->buckets[hash & (count->size - 1)]; g; g = g->next) {
+			/* sdb_data_cmp does not consider NULL values equal */
+			if ((g->hash == hash) && ((value->type == SDB_TYPE_NULL)
+						? g->value.type == SDB_TYPE_NULL
+						: ! sdb_data_cmp(&g->value, value))) {
+				++g->count;
+				return 0;
+			}
+		}
+	}
+
+	if ((count->groups_num >= count->size) && count_grow(count))
+		return -1;
+
+	g = calloc(1, sizeof(*g));
+	if (! g)
+		return -1;
+	if (sdb_data_copy(&g->value, value)) {
+		free(g);
+		return -1;
+	}
+	g->hash = hash;
+	g->count = 1;
+	g->next = count->buckets[hash & (count->size - 1)];
+	count->buckets[hash & (count->size - 1)] = g;
+	++count->groups_num;
+	return 0;
+} /* count_value */
+
+/* Count matching objects, grouped by the value of the grouping expression,
+ * if any. Arrays are grouped by each of their elements. */
+static int
+count_obj(sdb_memstore_obj_t *obj, sdb_memstore_matcher_t *filter,
+		void *user_data)
+{
+	count_t *count = user_data;
+	sdb_data_t value = SDB_DATA_INIT;
+	int status = 0;
+
+	++count->total;
+	if (! count->group_by)
+		return 0;
+
+	if (sdb_memstore_expr_eval(count->group_by, obj, &value, filter))
+		return -1;
+
+	if ((value.type & SDB_TYPE_ARRAY) && (! sdb_data_isnull(&value))) {
+		size_t i;
+		for (i = 0; (! status) && (i < value.data.array.length); ++i) {
+			sdb_data_t elem = SDB_DATA_INIT;
+			if (sdb_data_array_get(&value, i, &elem))
+				status = -1;
+			else
+				status = count_value(count, &elem);
+		}
+	}
+	else
+		status = count_value(count, &value);
+
+	sdb_data_free_datum(&value);
+	return status;
+} /* count_obj */
+
+static int
+group_cmp(const void *a, const void *b)
+{
+	const group_t *g1 = *(const group_t * const *)a;
+	const group_t *g2 = *(const group_t * const *)b;
+	return sdb_data_cmp(&g1->value, &g2->value);
+} /* group_cmp */
+
+/* Emit all groups in the order of their values and free them. */
+static int
+count_finish(count_t *count, sdb_store_writer_t *w, sdb_object_t *wd,
+		int status)
+{
+	group_t **groups = NULL;
+	size_t i, n = 0;
+
+	if ((! status) && (! count->group_by))
+		status = w->store_count(NULL, count->total, wd);
+
+	if (count->groups_num) {
+		groups = malloc(count->groups_num * sizeof(*groups));
+		if (! groups)
+			status = -1;
+	}
+	for (i = 0; i < count->size; ++i) {
+		group_t *g = count->buckets[i];
+		while (g) {
+			group_t *next = g->next;
+			if (groups)
+				groups[n++] = g;
+			else {
+				sdb_data_free_datum(&g->value);
+				free(g);
+			}
+			g = next;
+		}
+	}
+	free(count->buckets);
+	count->buckets = NULL;
+	count->size = count->groups_num = 0;
+
+	if (groups)
+		qsort(groups, n, sizeof(*groups), group_cmp);
+	for (i = 0; i < n; ++i) {
+		if (! status)
+			status = w->store_count(&groups[i]->value, groups[i]->count, wd);
+		if ((! status) && w->flush)
+			status = w->flush(wd);
+		sdb_data_free_datum(&groups[i]->value);
+		free(groups[i]);
+	}
+	free(groups);
+	return status;
+} /* count_finish */
+
+/* Scan all objects matching the query, using the first index serving any of
+ * the matcher's predicates or the range of updates, if possible. */
+static int
+scan_query(sdb_memstore_t *store, int type, sdb_memstore_query_t *q,
+		const char *after_host, const char *after_name,
+		sdb_memstore_lookup_cb cb, sdb_memstore_yield_cb yield,
+		void *user_data)
+{
+	int status = 1;
+	size_t i;
+
+	for (i = 0; (status > 0) && (i < q->index_num); ++i)
+		status = sdb_memstore_scan_index(store, type, q->index + i,
+				q->matcher, q->filter, cb, yield, user_data);
+	if (status > 0)
+		status = sdb_memstore_scan_time(store, type, &q->time,
+				q->matcher, q->filter, cb, yield, user_data);
+	if (status > 0)
+		status = sdb_memstore_scan_yield(store, type,
+				after_host, after_name, q->matcher, q->filter,
+				cb, yield, user_data);
+	return status;
+} /* scan_query */
 
 /*
  * query implementations
@@ -96,11 +633,15 @@ exec_fetch(sdb_memstore_t *store,
 		hostname = name;
 
 	host = sdb_memstore_get_host(store, hostname);
+	if (host)
+		pthread_rwlock_rdlock(&HOST(host)->lock);
 	if ((! host)
-			|| (filter && (! sdb_memstore_matcher_matches(filter, host, NULL)))) {
+			|| (! sdb_memstore_visible(filter, host))) {
 		sdb_strbuf_sprintf(errbuf, "Failed to fetch %s %s: "
 				"host %s not found", SDB_STORE_TYPE_TO_NAME(type),
 				name, hostname);
+		if (host)
+			pthread_rwlock_unlock(&HOST(host)->lock);
 		sdb_object_deref(SDB_OBJ(host));
 		return -1;
 	}
@@ -108,8 +649,7 @@ exec_fetch(sdb_memstore_t *store,
 	if (type != SDB_HOST) {
 		if (parent) {
 			p = sdb_memstore_get_child(obj, parent_type, parent);
-			if ((! p) || (filter
-						&& (! sdb_memstore_matcher_matches(filter, p, NULL)))) {
+			if ((! p) || (! sdb_memstore_visible(filter, p))) {
 				sdb_strbuf_sprintf(errbuf, "Failed to fetch %s %s.%s.%s: "
 						"%s not found", SDB_STORE_TYPE_TO_NAME(type),
 						hostname, parent, name, parent);
@@ -119,8 +659,7 @@ exec_fetch(sdb_memstore_t *store,
 		}
 		if (! status) {
 			obj = sdb_memstore_get_child(obj, type, name);
-			if ((! obj) || (filter
-						&& (! sdb_memstore_matcher_matches(filter, obj, NULL)))) {
+			if ((! obj) || (! sdb_memstore_visible(filter, obj))) {
 				sdb_strbuf_sprintf(errbuf, "Failed to fetch %s %s.%s: "
 						"%s not found", SDB_STORE_TYPE_TO_NAME(type),
 						hostname, name, name);
@@ -149,6 +688,7 @@ exec_fetch(sdb_memstore_t *store,
 		}
 	}
 
+	pthread_rwlock_unlock(&HOST(host)->lock);
 	if (host != obj)
 		sdb_object_deref(SDB_OBJ(host));
 	if (p != obj)
@@ -163,11 +703,16 @@ exec_fetch(sdb_memstore_t *store,
 static int
 exec_list(sdb_memstore_t *store,
 		sdb_store_writer_t *w, sdb_object_t *wd, sdb_strbuf_t *errbuf,
-		int type, sdb_memstore_matcher_t *filter)
+		int type, sdb_memstore_query_t *q)
 {
-	iter_t iter = { NULL, w, wd };
+	iter_t iter = ITER_INIT(w, wd, 0);
+	sdb_memstore_lookup_cb cb = iter_prepare(&iter, q, type);
+	int status;
 
-	if (sdb_memstore_scan(store, type, /* m = */ NULL, filter, list_tojson, &iter)) {
+	status = sdb_memstore_scan_yield(store, type,
+			iter.after_host, iter.after_name, /* m = */ NULL, q->filter,
+			cb, iter_yield, &iter);
+	if (iter_finish(&iter, q->filter, status)) {
 		sdb_log(SDB_LOG_ERR, "memstore: Failed to serialize "
 				"store to JSON");
 		sdb_strbuf_sprintf(errbuf, "Out of memory");
@@ -180,11 +725,15 @@ exec_list(sdb_memstore_t *store,
 static int
 exec_lookup(sdb_memstore_t *store,
 		sdb_store_writer_t *w, sdb_object_t *wd, sdb_strbuf_t *errbuf,
-		int type, sdb_memstore_matcher_t *m, sdb_memstore_matcher_t *filter)
+		int type, sdb_memstore_query_t *q)
 {
-	iter_t iter = { NULL, w, wd };
+	iter_t iter = ITER_INIT(w, wd, 1);
+	sdb_memstore_lookup_cb cb = iter_prepare(&iter, q, type);
+	int status;
 
-	if (sdb_memstore_scan(store, type, m, filter, lookup_tojson, &iter)) {
+	status = scan_query(store, type, q, iter.after_host, iter.after_name,
+			cb, iter_yield, &iter);
+	if (iter_finish(&iter, q->filter, status)) {
 		sdb_log(SDB_LOG_ERR, "memstore: Failed to lookup %ss",
 				SDB_STORE_TYPE_TO_NAME(type));
 		sdb_strbuf_sprintf(errbuf, "Failed to lookup %ss",
@@ -195,6 +744,32 @@ exec_lookup(sdb_memstore_t *store,
 	return SDB_CONNECTION_DATA;
 } /* exec_lookup */
 
+static int
+exec_count(sdb_memstore_t *store,
+		sdb_store_writer_t *w, sdb_object_t *wd, sdb_strbuf_t *errbuf,
+		int type, sdb_memstore_query_t *q)
+{
+	count_t count = COUNT_INIT(q->group_by);
+	int status;
+
+	if (! w->store_count) {
+		sdb_strbuf_sprintf(errbuf, "Cannot count %ss: "
+				"not supported by the writer", SDB_STORE_TYPE_TO_NAME(type));
+		return -1;
+	}
+
+	status = scan_query(store, type, q, NULL, NULL, count_obj, NULL, &count);
+	if (count_finish(&count, w, wd, status)) {
+		sdb_log(SDB_LOG_ERR, "memstore: Failed to count %ss",
+				SDB_STORE_TYPE_TO_NAME(type));
+		sdb_strbuf_sprintf(errbuf, "Failed to count %ss",
+				SDB_STORE_TYPE_TO_NAME(type));
+		return -1;
+	}
+
+	return SDB_CONNECTION_DATA;
+} /* exec_count */
+
 /*
  * public API
  */
@@ -222,11 +797,15 @@ sdb_memstore_query_execute(sdb_memstore_t *store, sdb_memstore_query_t *q,
 
 	case SDB_AST_TYPE_LIST:
 		return exec_list(store, w, wd, errbuf, SDB_AST_LIST(ast)->obj_type,
-				q->filter);
+				q);
 
 	case SDB_AST_TYPE_LOOKUP:
 		return exec_lookup(store, w, wd, errbuf, SDB_AST_LOOKUP(ast)->obj_type,
-				q->matcher, q->filter);
+				q);
+
+	case SDB_AST_TYPE_COUNT:
+		return exec_count(store, w, wd, errbuf, SDB_AST_COUNT(ast)->obj_type,
+				q);
 
 	default:
 		sdb_log(SDB_LOG_ERR, "memstore: Invalid query of type %s",
@@ -220,7 +220,7 @@ sdb_memstore_expr_eval(sdb_memstore_expr_t *expr, sdb_memstore_obj_t *obj,
 	if ((! expr) || (! res))
 		return -1;
 
-	if (filter && obj && (! sdb_memstore_matcher_matches(filter, obj, NULL)))
+	if (! sdb_memstore_visible(filter, obj))
 		obj = NULL; /* this object does not exist */
 
 	if (! expr->type)
@@ -317,11 +317,10 @@ sdb_memstore_expr_iter(sdb_memstore_expr_t *expr, sdb_memstore_obj_t *obj,
 		if (! obj)
 			return NULL;
 		if (expr->data.data.integer == SDB_FIELD_BACKEND) {
-			/* while scanning the store, we hold a read lock, so it's safe to
-			 * access the data without copying */
-			array.type = SDB_TYPE_ARRAY | SDB_TYPE_STRING;
-			array.data.array.length = obj->backends_num;
-			array.data.array.values = obj->backends;
+			/* backends are stored as a bitmap */
+			if (sdb_memstore_get_field(obj, SDB_FIELD_BACKEND, &array))
+				return NULL;
+			free_array = 1;
 		}
 	}
 	else if (! expr->type) {
@@ -398,7 +397,7 @@ sdb_memstore_expr_iter_has_next(sdb_memstore_expr_iter_t *iter)
 		if (iter->filter) {
 			sdb_memstore_obj_t *child;
 			while ((child = STORE_OBJ(sdb_avltree_iter_peek_next(iter->tree)))) {
-				if (sdb_memstore_matcher_matches(iter->filter, child, NULL))
+				if (sdb_memstore_visible(iter->filter, child))
 					break;
 				(void)sdb_avltree_iter_get_next(iter->tree);
 			}
@@ -427,8 +426,7 @@ sdb_memstore_expr_iter_get_next(sdb_memstore_expr_iter_t *iter)
 			child = STORE_OBJ(sdb_avltree_iter_get_next(iter->tree));
 			if (! child)
 				break;
-			if (iter->filter
-					&& (! sdb_memstore_matcher_matches(iter->filter, child, NULL)))
+			if (! sdb_memstore_visible(iter->filter, child))
 				continue;
 
 			if (sdb_memstore_expr_eval(iter->expr, child, &ret, iter->filter))
@@ -439,7 +437,7 @@ sdb_memstore_expr_iter_get_next(sdb_memstore_expr_iter_t *iter)
 		/* Skip over any filtered objects */
 		if (iter->filter) {
 			while ((child = STORE_OBJ(sdb_avltree_iter_peek_next(iter->tree)))) {
-				if (sdb_memstore_matcher_matches(iter->filter, child, NULL))
+				if (sdb_memstore_visible(iter->filter, child))
 					break;
 				(void)sdb_avltree_iter_get_next(iter->tree);
 			}
@@ -0,0 +1,810 @@
+/*
+ * SysDB - src/core/memstore_index.c
+ * Copyright (C) 2016 Sebastian 'tokkee' Harl <sh@tokkee.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This module implements secondary indexes mapping attribute values to the
+ * objects (hosts, services, and metrics) having an attribute with that value.
+ * Only explicitly configured attribute keys are indexed. Indexes identify
+ * objects by name: scans look up the referenced objects and evaluate the
+ * full matcher against them, so an index only has to provide a superset of
+ * the matching objects.
+ *
+ * Values are indexed by their case-folded string representation, which is
+ * equal for all values considered equal by the comparison matchers. Array
+ * values are additionally indexed by each of their elements to support IN
+ * predicates.
+ */
+
+#if HAVE_CONFIG_H
+#	include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include "sysdb.h"
+#include "core/memstore-private.h"
+#include "utils/error.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <pthread.h>
+
+/*
+ * private data types
+ */
+
+/* an object referenced by the entries of an index key; all entries of the
+ * key share a single reference to each object, so that its names are only
+ * copied once */
+typedef struct ref {
+	struct ref *next;
+	uint32_t hash;
+
+	/* the number of entries referencing the object */
+	size_t users;
+	/* the names are stored right after the struct */
+	sdb_memstore_index_ref_t ref;
+} ref_t;
+
+/* all objects of one type having an attribute with the same value */
+typedef struct entry {
+	struct entry *next;
+	uint32_t hash;
+
+	int type;
+	char *value;
+
+	/* a hash set (linear probing) of references, at most half full */
+	ref_t **refs;
+	size_t refs_num;
+	size_t refs_size;
+} entry_t;
+
+typedef struct index_key {
+	struct index_key *next;
+	char *name;
+
+	/* protects all entries and references of the key */
+	pthread_rwlock_t lock;
+
+	entry_t **buckets;
+	size_t size;
+	size_t entries_num;
+
+	/* all referenced objects, hashed by host and object name */
+	ref_t **refs;
+	size_t refs_size;
+	size_t refs_num;
+} index_key_t;
+
+struct sdb_memstore_index {
+	/* serializes adding keys; the list of keys is append-only, so it may be
+	 * searched without locking */
+	pthread_mutex_t lock;
+	index_key_t *keys;
+};
+
+/* the index keys of a value */
+typedef struct {
+	char **values;
+	size_t values_num;
+} value_keys_t;
+#define VALUE_KEYS_INIT { NULL, 0 }
+
+/*
+ * private helper functions
+ */
+
+/* FNV-1a hash of the type and the (already folded) value */
+static uint32_t
+entry_hash(int type, const char *value)
+{
+	uint32_t h = 2166136261U;
+
+	h ^= (uint32_t)type;
+	h *= 16777619U;
+	for ( ; *value; ++value) {
+		h ^= (uint32_t)(unsigned char)*value;
+		h *= 16777619U;
+	}
+	return h;
+} /* entry_hash */
+
+/* FNV-1a hash of the case-folded host and object name */
+static uint32_t
+ref_hash(const sdb_memstore_index_ref_t *ref)
+{
+	uint32_t h = 2166136261U;
+	const char *c;
+
+	for (c = ref->host; *c; ++c) {
+		h ^= (uint32_t)tolower((unsigned char)*c);
+		h *= 16777619U;
+	}
+	if (! ref->name)
+		return h;
+
+	h ^= (uint32_t)'/';
+	h *= 16777619U;
+	for (c = ref->name; *c; ++c) {
+		h ^= (uint32_t)tolower((unsigned char)*c);
+		h *= 16777619U;
+	}
+	return h;
+} /* ref_hash */
+
+static int
+ref_cmp(const sdb_memstore_index_ref_t *r1, const sdb_memstore_index_ref_t *r2)
+{
+	int diff = strcasecmp(r1->host, r2->host);
+
+	if (diff)
+		return diff;
+	if ((! r1->name) || (! r2->name))
+		return !!r1->name - !!r2->name;
+	return strcasecmp(r1->name, r2->name);
+} /* ref_cmp */
+
+static int
+ref_qsort_cmp(const void *a, const void *b)
+{
+	return ref_cmp(a, b);
+} /* ref_qsort_cmp */
+
+/* Find the slot of 'r' in the reference set of 'e' or the empty slot where
+ * it belongs. */
+static size_t
+entry_slot(const entry_t *e, const ref_t *r)
+{
+	size_t mask = e->refs_size - 1, i;
+
+	for (i = r->hash & mask; e->refs[i] && (e->refs[i] != r);
+			i = (i + 1) & mask)
+		/* keep probing */;
+	return i;
+} /* entry_slot */
+
+static int
+entry_grow(entry_t *e)
+{
+	ref_t **old = e->refs;
+	size_t old_size = e->refs_size, i;
+	size_t size = old_size ? 2 * old_size : 4;
+	ref_t **refs;
+
+	refs = calloc(size, sizeof(*refs));
+	if (! refs)
+		return -1;
+
+	e->refs = refs;
+	e->refs_size = size;
+	for (i = 0; i < old_size; ++i)
+		if (old[i])
+			e->refs[entry_slot(e, old[i])] = old[i];
+	free(old);
+	return 0;
+} /* entry_grow */
+
+/* Remove the reference in slot 'i' and move up any references following it
+ * which may no longer be found otherwise. */
+static void
+entry_remove(entry_t *e, size_t i)
+{
+	size_t mask = e->refs_size - 1, j;
+
+	e->refs[i] = NULL;
+	--e->refs_num;
+	for (j = (i + 1) & mask; e->refs[j]; j = (j + 1) & mask) {
+		size_t home = e->refs[j]->hash & mask;
+
+		/* the reference may move unless its home slot lies in (i, j] */
+		if (((j - home) & mask) < ((j - i) & mask))
+			continue;
+		e->refs[i] = e->refs[j];
+		e->refs[j] = NULL;
+		i = j;
+	}
+} /* entry_remove */
+
+static void
+entry_destroy(entry_t *e)
+{
+	free(e->refs);
+	free(e->value);
+	free(e);
+} /* entry_destroy */
+
+static index_key_t *
+key_find(sdb_memstore_index_t *idx, const char *name)
+{
+	index_key_t *k;
+
+	for (k = __atomic_load_n(&idx->keys, __ATOMIC_ACQUIRE); k; k = k->next)
+		if (! strcasecmp(k->name, name))
+			return k;
+	return NULL;
+} /* key_find */
+
+static void
+key_destroy(index_key_t *k)
+{
+	size_t i;
+
+	for (i = 0; i < k->size; ++i) {
+		while (k->buckets[i]) {
+			entry_t *e = k->buckets[i];
+			k->buckets[i] = e->next;
+			entry_destroy(e);
+		}
+	}
+	for (i = 0; i < k->refs_size; ++i) {
+		while (k->refs[i]) {
+			ref_t *r = k->refs[i];
+			k->refs[i] = r->next;
+			free(r);
+		}
+	}
+	pthread_rwlock_destroy(&k->lock);
+	free(k->buckets);
+	free(k->refs);
+	free(k->name);
+	free(k);
+} /* key_destroy */
+
+static entry_t *
+entry_find(index_key_t *k, int type, const char *value, uint32_t hash,
+		entry_t ***prev)
+{
+	entry_t **e;
+
+	for (e = k->buckets + (hash & (k->size - 1)); *e; e = &(*e)->next) {
+		if (((*e)->hash == hash) && ((*e)->type == type)
+				&& (! strcmp((*e)->value, value)))
+			break;
+	}
+	if (prev)
+		*prev = e;
+	return *e;
+} /* entry_find */
+
+static int
+key_grow(index_key_t *k)
+{
+	entry_t **buckets;
+	size_t size = 2 * k->size, i;
+
+	buckets = calloc(size, sizeof(*buckets));
+	if (! buckets)
+		return -1;
+
+	for (i = 0; i < k->size; ++i) {
+		while (k->buckets[i]) {
+			entry_t *e = k->buckets[i];
+			k->buckets[i] = e->next;
+			e->next = buckets[e->hash & (size - 1)];
+			buckets[e->hash & (size - 1)] = e;
+		}
+	}
+	free(k->buckets);
+	k->buckets = buckets;
+	k->size = size;
+	return 0;
+} /* key_grow */
+
+static ref_t *
+ref_find(index_key_t *k, const sdb_memstore_index_ref_t *ref, uint32_t hash,
+		ref_t ***prev)
+{
+	ref_t **r;
+
+	for (r = k->refs + (hash & (k->refs_size - 1)); *r; r = &(*r)->next)
+		if (((*r)->hash == hash) && (! ref_cmp(&(*r)->ref, ref)))
+			break;
+	if (prev)
+		*prev = r;
+	return *r;
+} /* ref_find */
+
+static int
+refs_grow(index_key_t *k)
+{
+	ref_t **refs;
+	size_t size = 2 * k->refs_size, i;
+
+	refs = calloc(size, sizeof(*refs));
+	if (! refs)
+		return -1;
+
+	for (i = 0; i < k->refs_size; ++i) {
+		while (k->refs[i]) {
+			ref_t *r = k->refs[i];
+			k->refs[i] = r->next;
+			r->next = refs[r->hash & (size - 1)];
+			refs[r->hash & (size - 1)] = r;
+		}
+	}
+	free(k->refs);
+	k->refs = refs;
+	k->refs_size = size;
+	return 0;
+} /* refs_grow */
+
+/* Look up the shared reference to an object, adding it if necessary. */
+static ref_t *
+ref_get(index_key_t *k, const sdb_memstore_index_ref_t *ref)
+{
+	uint32_t hash = ref_hash(ref);
+	size_t host_len, name_len;
+	ref_t **prev, *r;
+
+	if ((r = ref_find(k, ref, hash, &prev)))
+		return r;
+	if ((k->refs_num >= k->refs_size) && (! refs_grow(k)))
+		ref_find(k, ref, hash, &prev);
+
+	host_len = strlen(ref->host) + 1;
+	name_len = ref->name ? strlen(ref->name) + 1 : 0;
+	r = malloc(sizeof(*r) + host_len + name_len);
+	if (! r)
+		return NULL;
+
+	r->next = NULL;
+	r->hash = hash;
+	r->users = 0;
+	r->ref.host = memcpy(r + 1, ref->host, host_len);
+	r->ref.name = NULL;
+	if (ref->name)
+		r->ref.name = memcpy(r->ref.host + host_len, ref->name, name_len);
+	*prev = r;
+	++k->refs_num;
+	return r;
+} /* ref_get */
+
+/* Drop a shared reference once no entry uses it any longer. */
+static void
+ref_put(index_key_t *k, ref_t *r)
+{
+	ref_t **prev;
+
+	if (r->users)
+		return;
+	ref_find(k, &r->ref, r->hash, &prev);
+	*prev = r->next;
+	--k->refs_num;
+	free(r);
+} /* ref_put */
+
+static int
+key_add_ref(index_key_t *k, int type, const char *value,
+		const sdb_memstore_index_ref_t *ref)
+{
+	uint32_t hash = entry_hash(type, value);
+	entry_t **prev, *e;
+	ref_t *r;
+
+	e = entry_find(k, type, value, hash, &prev);
+	if (! e) {
+		if ((k->entries_num >= k->size) && (! key_grow(k)))
+			entry_find(k, type, value, hash, &prev);
+
+		e = calloc(1, sizeof(*e));
+		if (! e)
+			return -1;
+		e->hash = hash;
+		e->type = type;
+		if (! (e->value = strdup(value))) {
+			free(e);
+			return -1;
+		}
+		*prev = e;
+		++k->entries_num;
+	}
+
+	r = ref_get(k, ref);
+	if (r && e->refs_size && e->refs[entry_slot(e, r)])
+		return 0;
+
+	if ((! r) || ((2 * (e->refs_num + 1) > e->refs_size) && entry_grow(e))) {
+		if (r)
+			ref_put(k, r);
+		if (! e->refs_num) {
+			*prev = e->next;
+			entry_destroy(e);
+			--k->entries_num;
+		}
+		return -1;
+	}
+
+	e->refs[entry_slot(e, r)] = r;
+	++e->refs_num;
+	++r->users;
+	return 0;
+} /* key_add_ref */
+
+static void
+key_remove_ref(index_key_t *k, int type, const char *value,
+		const sdb_memstore_index_ref_t *ref)
+{
+	entry_t **prev, *e;
+	ref_t *r;
+	size_t i;
+
+	e = entry_find(k, type, value, entry_hash(type, value), &prev);
+	if ((! e) || (! (r = ref_find(k, ref, ref_hash(ref), NULL))))
+		return;
+	i = entry_slot(e, r);
+	if (! e->refs[i])
+		return;
+
+	entry_remove(e, i);
+	--r->users;
+	ref_put(k, r);
+
+	if (! e->refs_num) {
+		*prev = e->next;
+		entry_destroy(e);
+		--k->entries_num;
+	}
+} /* key_remove_ref */
+
+/* Store the folded string representation of 'v' in 'buf'. */
+static char *
+fold(const sdb_data_t *v, char *buf, size_t len)
+{
+	char *c;
+
+	if (! sdb_data_format(v, buf, len, SDB_UNQUOTED))
+		return NULL;
+	for (c = buf; *c; ++c)
+		*c = (char)tolower((unsigned char)*c);
+	return buf;
+} /* fold */
+
+static int
+value_keys_add(value_keys_t *keys, const sdb_data_t *v)
+{
+	char buf[sdb_data_strlen(v) + 1];
+	char **values;
+
+	if (! fold(v, buf, sizeof(buf)))
+		return -1;
+
+	values = realloc(keys->values, (keys->values_num + 1) * sizeof(*values));
+	if (! values)
+		return -1;
+	keys->values = values;
+	if (! (keys->values[keys->values_num] = strdup(buf)))
+		return -1;
+	++keys->values_num;
+	return 0;
+} /* value_keys_add */
+
+static void
+value_keys_free(value_keys_t *keys)
+{
+	size_t i;
+
+	for (i = 0; i < keys->values_num; ++i)
+		free(keys->values[i]);
+	free(keys->values);
+	keys->values = NULL;
+	keys->values_num = 0;
+} /* value_keys_free */
+
+/* Determine the index keys of a value: its own representation and, for
+ * arrays, that of each element. */
+static int
+value_keys(value_keys_t *keys, const sdb_data_t *v)
+{
+	size_t i;
+
+	if ((! v) || sdb_data_isnull(v))
+		return 0;
+
+	if (value_keys_add(keys, v))
+		return -1;
+	if (! (v->type & SDB_TYPE_ARRAY))
+		return 0;
+	for (i = 0; i < v->data.array.length; ++i) {
+		sdb_data_t elem = SDB_DATA_INIT;
+
+		if (sdb_data_array_get(v, i, &elem) || value_keys_add(keys, &elem))
+			return -1;
+	}
+	return 0;
+} /* value_keys */
+
+/* Determine the object owning an attribute. */
+static int
+attr_ref(sdb_memstore_obj_t *attr, sdb_memstore_index_ref_t *ref)
+{
+	sdb_memstore_obj_t *obj = attr->parent;
+
+	if (! obj)
+		return -1;
+	if (obj->type == SDB_HOST) {
+		ref->host = SDB_OBJ(obj)->name;
+		ref->name = NULL;
+	}
+	else if (obj->parent) {
+		ref->host = SDB_OBJ(obj->parent)->name;
+		ref->name = SDB_OBJ(obj)->name;
+	}
+	else
+		return -1;
+	return obj->type;
+} /* attr_ref */
+
+/*
+ * private API
+ */
+
+sdb_memstore_index_t *
+sdb_memstore_index_create(void)
+{
+	sdb_memstore_index_t *idx;
+
+	idx = calloc(1, sizeof(*idx));
+	if (! idx)
+		return NULL;
+	if (pthread_mutex_init(&idx->lock, /* attr = */ NULL)) {
+		free(idx);
+		return NULL;
+	}
+	return idx;
+} /* sdb_memstore_index_create */
+
+void
+sdb_memstore_index_destroy(sdb_memstore_index_t *idx)
+{
+	if (! idx)
+		return;
+
+	while (idx->keys) {
+		index_key_t *k = idx->keys;
+		idx->keys = k->next;
+		key_destroy(k);
+	}
+	pthread_mutex_destroy(&idx->lock);
+	free(idx);
+} /* sdb_memstore_index_destroy */
+
+int
+sdb_memstore_index_add_key(sdb_memstore_index_t *idx, const char *key)
+{
+	index_key_t *k;
+
+	if ((! idx) || (! key))
+		return -1;
+
+	pthread_mutex_lock(&idx->lock);
+	if (key_find(idx, key)) {
+		pthread_mutex_unlock(&idx->lock);
+		return 1;
+	}
+
+	k = calloc(1, sizeof(*k));
+	if (k) {
+		k->size = k->refs_size = 64;
+		k->buckets = calloc(k->size, sizeof(*k->buckets));
+		k->refs = calloc(k->refs_size, sizeof(*k->refs));
+		k->name = strdup(key);
+	}
+	if ((! k) || (! k->buckets) || (! k->refs) || (! k->name)
+			|| pthread_rwlock_init(&k->lock, /* attr = */ NULL)) {
+		if (k) {
+			free(k->buckets);
+			free(k->refs);
+			free(k->name);
+		}
+		free(k);
+		pthread_mutex_unlock(&idx->lock);
+		return -1;
+	}
+
+	k->next = idx->keys;
+	__atomic_store_n(&idx->keys, k, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&idx->lock);
+	return 0;
+} /* sdb_memstore_index_add_key */
+
+bool
+sdb_memstore_index_has_key(sdb_memstore_index_t *idx, const char *key)
+{
+	if ((! idx) || (! key))
+		return 0;
+	return key_find(idx, key) != NULL;
+} /* sdb_memstore_index_has_key */
+
+int
+sdb_memstore_index_update(sdb_memstore_index_t *idx, sdb_memstore_obj_t *attr,
+		const sdb_data_t *old_value, const sdb_data_t *new_value)
+{
+	value_keys_t old_keys = VALUE_KEYS_INIT, new_keys = VALUE_KEYS_INIT;
+	sdb_memstore_index_ref_t ref;
+	index_key_t *k;
+	int type, status = 0;
+	size_t i;
+
+	if ((! idx) || (! attr) || (attr->type != SDB_ATTRIBUTE))
+		return -1;
+
+	/* most attributes are not indexed; don't bother locking for those */
+	if (! (k = key_find(idx, SDB_OBJ(attr)->name)))
+		return 0;
+	if ((type = attr_ref(attr, &ref)) < 0)
+		return -1;
+
+	if (value_keys(&old_keys, old_value) || value_keys(&new_keys, new_value))
+		status = -1;
+
+	/* writers of different keys don't get into each other's way */
+	pthread_rwlock_wrlock(&k->lock);
+	for (i = 0; i < old_keys.values_num; ++i)
+		key_remove_ref(k, type, old_keys.values[i], &ref);
+	for (i = 0; i < new_keys.values_num; ++i)
+		if (key_add_ref(k, type, new_keys.values[i], &ref))
+			status = -1;
+	pthread_rwlock_unlock(&k->lock);
+
+	if (status)
+		sdb_log(SDB_LOG_ERR, "memstore: Failed to update index of "
+				"attribute '%s'", SDB_OBJ(attr)->name);
+	value_keys_free(&old_keys);
+	value_keys_free(&new_keys);
+	return status;
+} /* sdb_memstore_index_update */
+
+/* Copy a reference into the string buffer at '*buf'. */
+static void
+ref_pack(sdb_memstore_index_ref_t *dst, const sdb_memstore_index_ref_t *src,
+		char **buf)
+{
+	size_t len = strlen(src->host) + 1;
+
+	dst->host = memcpy(*buf, src->host, len);
+	*buf += len;
+	dst->name = NULL;
+	if (src->name) {
+		len = strlen(src->name) + 1;
+		dst->name = memcpy(*buf, src->name, len);
+		*buf += len;
+	}
+} /* ref_pack */
+
+int
+sdb_memstore_index_lookup(sdb_memstore_index_t *idx, int type,
+		const char *key, const sdb_data_t *value, bool in, size_t max,
+		sdb_memstore_index_ref_t **refs, size_t *refs_num)
+{
+	value_keys_t keys = VALUE_KEYS_INIT;
+	size_t entries_num = 0;
+
+	sdb_memstore_index_ref_t *res = NULL;
+	size_t res_num = 0, size = 0;
+	index_key_t *k;
+	char *buf;
+	size_t i, j;
+
+	if ((! idx) || (! key) || (! value) || (! refs) || (! refs_num))
+		return -1;
+
+	if (in) {
+		sdb_data_t empty = { value->type, { .array = { 0, NULL } } };
+
+		if (! (value->type & SDB_TYPE_ARRAY))
+			return -1;
+		for (i = 0; i < value->data.array.length; ++i) {
+			sdb_data_t elem = SDB_DATA_INIT;
+			if (sdb_data_array_get(value, i, &elem)
+					|| value_keys_add(&keys, &elem)) {
+				value_keys_free(&keys);
+				return -1;
+			}
+		}
+		/* an empty array is a subset of any array */
+		if (value_keys_add(&keys, &empty)) {
+			value_keys_free(&keys);
+			return -1;
+		}
+	}
+	else if (value_keys_add(&keys, value)) {
+		value_keys_free(&keys);
+		return -1;
+	}
+
+	k = key_find(idx, key);
+	if (! k) {
+		value_keys_free(&keys);
+		return 1;
+	}
+
+	pthread_rwlock_rdlock(&k->lock);
+	/* all references and their names are copied into a single block */
+	for (i = 0; i < keys.values_num; ++i) {
+		entry_t *e = entry_find(k, type, keys.values[i],
+				entry_hash(type, keys.values[i]), NULL);
+
+		if (! e)
+			continue;
+		for (j = 0; j < e->refs_size; ++j) {
+			const ref_t *r = e->refs[j];
+
+			if (! r)
+				continue;
+			size += strlen(r->ref.host) + 1;
+			if (r->ref.name)
+				size += strlen(r->ref.name) + 1;
+		}
+		res_num += e->refs_num;
+		++entries_num;
+	}
+	if (res_num > max) {
+		pthread_rwlock_unlock(&k->lock);
+		value_keys_free(&keys);
+		return 1;
+	}
+
+	if (res_num && (! (res = malloc(res_num * sizeof(*res) + size)))) {
+		pthread_rwlock_unlock(&k->lock);
+		value_keys_free(&keys);
+		return -1;
+	}
+
+	buf = res ? (char *)(res + res_num) : NULL;
+	res_num = 0;
+	for (i = 0; res && (i < keys.values_num); ++i) {
+		entry_t *e = entry_find(k, type, keys.values[i],
+				entry_hash(type, keys.values[i]), NULL);
+
+		if (! e)
+			continue;
+		for (j = 0; j < e->refs_size; ++j)
+			if (e->refs[j])
+				ref_pack(res + res_num++, &e->refs[j]->ref, &buf);
+	}
+	pthread_rwlock_unlock(&k->lock);
+	value_keys_free(&keys);
+
+	if (res_num > 1)
+		qsort(res, res_num, sizeof(*res), ref_qsort_cmp);
+	/* objects may be found through multiple values */
+	if (entries_num > 1) {
+		for (i = j = 1; i < res_num; ++i)
+			if (ref_cmp(res + j - 1, res + i))
+				res[j++] = res[i];
+		res_num = j;
+	}
+
+	*refs = res;
+	*refs_num = res_num;
+	return 0;
+} /* sdb_memstore_index_lookup */
+
+/* vim: set tw=78 sw=4 ts=4 noexpandtab : */
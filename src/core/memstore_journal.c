@@ -0,0 +1,899 @@
+/*
+ * SysDB - src/core/memstore_journal.c
+ * Copyright (C) 2016 Sebastian 'tokkee' Harl <sh@tokkee.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This module implements an append-only journal of store updates which
+ * allows to recover all updates received since the last snapshot.
+ *
+ * Each record describes a single update. The object itself is encoded using
+ * the SysDB wire protocol (see utils/proto.h); additional meta-data, which
+ * the wire protocol does not transfer, precedes it. All integers are stored
+ * in network byte order:
+ *
+ *   header: "SDBJRNL\0" <version:u32>
+ *   record: <len:u32 (of the remaining record)> <interval:i64>
+ *           <backends_num:u32> <backend>*
+ *           <stores_num:u32> (<type> <id> <last_update:i64>)*
+ *           <object (as encoded by sdb_proto_marshal_<type>)>
+ *
+ * Strings are terminated by a null byte. Writers append records to an
+ * in-memory buffer which is written and synced to disk by whichever thread
+ * flushes it next, such that concurrent writers share a single fsync.
+ *
+ * The journal is a redo log rather than a write-ahead log: updates are
+ * journaled after they have been applied to the store. Compaction depends on
+ * this; it rotates the journal and then dumps the store, so every record in
+ * the rotated journal has to be part of that snapshot. An update is only
+ * acknowledged to its sender once it has been journaled, but queries may see
+ * it earlier, and a crash in between loses it like any unacknowledged
+ * update.
+ */
+
+#if HAVE_CONFIG_H
+#	include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include "core/memstore-private.h"
+#include "utils/error.h"
+#include "utils/proto.h"
+#include "utils/strbuf.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define JOURNAL_MAGIC "SDBJRNL"
+#define JOURNAL_VERSION 1
+
+/* wake up the sync thread early once this many bytes are pending */
+#define PENDING_MAX (1024 * 1024)
+
+/* number of updates replayed at once */
+#define REPLAY_BATCH_SIZE 1024
+
+struct sdb_memstore_journal {
+	sdb_object_t super;
+
+	char *filename;
+	int fd;
+	sdb_time_t sync_interval;
+
+	pthread_mutex_t lock;
+	/* signaled whenever a flush completed */
+	pthread_cond_t flushed;
+	/* wakes up the sync thread */
+	pthread_cond_t wakeup;
+
+	/* records which have not been written yet and those being written */
+	sdb_strbuf_t *pending;
+	sdb_strbuf_t *writing;
+
+	/* sequence numbers of the most recently appended and synced groups */
+	uint64_t appended;
+	uint64_t synced;
+	bool flushing;
+	/* set after a failed write; reset by rotating the journal */
+	bool broken;
+
+	pthread_t thread;
+	bool running;
+};
+#define JOURNAL(obj) ((sdb_memstore_journal_t *)(obj))
+
+/*
+ * private helper functions
+ */
+
+/* Copy a string including its terminating null byte to 'p' and return the
+ * position following it. */
+static char *
+put_string(char *p, const char *s)
+{
+	size_t len;
+
+	if (! s)
+		s = "";
+	len = strlen(s) + 1;
+	memcpy(p, s, len);
+	return p + len;
+} /* put_string */
+
+static ssize_t
+marshal_obj(char *buf, size_t buf_len, const sdb_store_batch_entry_t *e)
+{
+	if (e->type == SDB_HOST) {
+		sdb_proto_host_t h = { e->obj.host.last_update, e->obj.host.name };
+		return sdb_proto_marshal_host(buf, buf_len, &h);
+	}
+	else if (e->type == SDB_SERVICE) {
+		sdb_proto_service_t s = {
+			e->obj.service.last_update, e->obj.service.hostname,
+			e->obj.service.name,
+		};
+		return sdb_proto_marshal_service(buf, buf_len, &s);
+	}
+	else if (e->type == SDB_METRIC) {
+		/* all stores are part of the record's meta-data */
+		sdb_proto_metric_t m = {
+			e->obj.metric.last_update, e->obj.metric.hostname,
+			e->obj.metric.name, NULL, NULL, 0,
+		};
+		return sdb_proto_marshal_metric(buf, buf_len, &m);
+	}
+	else if (e->type == SDB_ATTRIBUTE) {
+		sdb_proto_attribute_t a = {
+			e->obj.attribute.last_update, e->obj.attribute.parent_type,
+			e->obj.attribute.hostname, e->obj.attribute.parent,
+			e->obj.attribute.key, e->obj.attribute.value,
+		};
+		return sdb_proto_marshal_attribute(buf, buf_len, &a);
+	}
+	return -1;
+} /* marshal_obj */
+
+/* Append a record for the specified update to 'buf'. */
+static int
+encode_entry(sdb_strbuf_t *buf, const sdb_store_batch_entry_t *e)
+{
+	const char * const *backends = NULL;
+	const sdb_metric_store_t *stores = NULL;
+	size_t backends_num = 0, stores_num = 0;
+	sdb_time_t interval = 0;
+	ssize_t obj_len;
+	size_t len, i;
+	char *p;
+
+	if (e->type == SDB_HOST) {
+		interval = e->obj.host.interval;
+		backends = e->obj.host.backends;
+		backends_num = e->obj.host.backends_num;
+	}
+	else if (e->type == SDB_SERVICE) {
+		interval = e->obj.service.interval;
+		backends = e->obj.service.backends;
+		backends_num = e->obj.service.backends_num;
+	}
+	else if (e->type == SDB_METRIC) {
+		interval = e->obj.metric.interval;
+		backends = e->obj.metric.backends;
+		backends_num = e->obj.metric.backends_num;
+		stores = e->obj.metric.stores;
+		stores_num = e->obj.metric.stores_num;
+	}
+	else if (e->type == SDB_ATTRIBUTE) {
+		interval = e->obj.attribute.interval;
+		backends = e->obj.attribute.backends;
+		backends_num = e->obj.attribute.backends_num;
+	}
+
+	obj_len = marshal_obj(NULL, 0, e);
+	if (obj_len < 0)
+		return -1;
+
+	len = sizeof(int64_t) + 2 * sizeof(uint32_t) + (size_t)obj_len;
+	for (i = 0; i < backends_num; ++i)
+		len += strlen(backends[i]) + 1;
+	for (i = 0; i < stores_num; ++i)
+		len += strlen(stores[i].type) + strlen(stores[i].id) + 2
+			+ sizeof(int64_t);
+
+	/* the whole record is marshaled in place */
+	if (! (p = sdb_strbuf_reserve(buf, sizeof(uint32_t) + len)))
+		return -1;
+	p += sdb_proto_marshal_int32(p, sizeof(uint32_t), (uint32_t)len);
+	p += sdb_proto_marshal_int64(p, sizeof(int64_t), (uint64_t)interval);
+	p += sdb_proto_marshal_int32(p, sizeof(uint32_t), (uint32_t)backends_num);
+	for (i = 0; i < backends_num; ++i)
+		p = put_string(p, backends[i]);
+	p += sdb_proto_marshal_int32(p, sizeof(uint32_t), (uint32_t)stores_num);
+	for (i = 0; i < stores_num; ++i) {
+		p = put_string(p, stores[i].type);
+		p = put_string(p, stores[i].id);
+		p += sdb_proto_marshal_int64(p, sizeof(int64_t),
+				(uint64_t)stores[i].last_update);
+	}
+	marshal_obj(p, (size_t)obj_len, e);
+	sdb_strbuf_commit(buf, sizeof(uint32_t) + len);
+	return 0;
+} /* encode_entry */
+
+static int
+write_all(int fd, const char *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = write(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += n;
+		len -= (size_t)n;
+	}
+	return 0;
+} /* write_all */
+
+/*
+ * Write and sync all pending records. The caller has to hold the journal's
+ * lock and make sure that no other flush is in progress. The lock is
+ * released while writing to disk, allowing other writers to continue
+ * collecting records for the next flush.
+ */
+static int
+flush_locked(sdb_memstore_journal_t *j)
+{
+	sdb_strbuf_t *buf = j->pending;
+	uint64_t seq = j->appended;
+	int status = 0;
+
+	if (! sdb_strbuf_len(buf)) {
+		j->synced = seq;
+		return 0;
+	}
+
+	j->pending = j->writing;
+	j->writing = buf;
+	j->flushing = 1;
+	pthread_mutex_unlock(&j->lock);
+
+	if (write_all(j->fd, sdb_strbuf_string(buf), sdb_strbuf_len(buf))
+			|| fdatasync(j->fd)) {
+		char errbuf[1024];
+		sdb_log(SDB_LOG_ERR, "memstore: Failed to write journal %s: %s",
+				j->filename, sdb_strerror(errno, errbuf, sizeof(errbuf)));
+		status = -1;
+	}
+	sdb_strbuf_clear(buf);
+
+	pthread_mutex_lock(&j->lock);
+	j->flushing = 0;
+	if (status)
+		j->broken = 1;
+	else
+		j->synced = seq;
+	pthread_cond_broadcast(&j->flushed);
+	return status;
+} /* flush_locked */
+
+/* Wait until all records up to 'seq' have been synced, flushing them unless
+ * another thread is doing so already. The caller has to hold the lock. */
+static int
+sync_locked(sdb_memstore_journal_t *j, uint64_t seq)
+{
+	while ((j->synced < seq) && (! j->broken)) {
+		if (j->flushing)
+			pthread_cond_wait(&j->flushed, &j->lock);
+		else
+			flush_locked(j);
+	}
+	return j->broken ? -1 : 0;
+} /* sync_locked */
+
+static void *
+sync_thread(void *arg)
+{
+	sdb_memstore_journal_t *j = arg;
+
+	pthread_mutex_lock(&j->lock);
+	while (j->running) {
+		struct timespec ts;
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += (time_t)SDB_TIME_TO_SECS(j->sync_interval);
+		ts.tv_nsec += (long)(j->sync_interval % SECS_TO_SDB_TIME(1));
+		if (ts.tv_nsec >= 1000000000L) {
+			++ts.tv_sec;
+			ts.tv_nsec -= 1000000000L;
+		}
+		pthread_cond_timedwait(&j->wakeup, &j->lock, &ts);
+
+		if ((! j->flushing) && (! j->broken))
+			flush_locked(j);
+	}
+	pthread_mutex_unlock(&j->lock);
+	return NULL;
+} /* sync_thread */
+
+/* Create and open a new, empty journal file. */
+static int
+open_file(const char *filename)
+{
+	char header[sizeof(JOURNAL_MAGIC) + sizeof(uint32_t)];
+	char errbuf[1024];
+	int fd;
+
+	fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0600);
+	if (fd < 0) {
+		sdb_log(SDB_LOG_ERR, "memstore: Failed to open journal %s: %s",
+				filename, sdb_strerror(errno, errbuf, sizeof(errbuf)));
+		return -1;
+	}
+
+	memcpy(header, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+	sdb_proto_marshal_int32(header + sizeof(JOURNAL_MAGIC),
+			sizeof(uint32_t), JOURNAL_VERSION);
+	if (write_all(fd, header, sizeof(header)) || fdatasync(fd)) {
+		sdb_log(SDB_LOG_ERR, "memstore: Failed to write journal %s: %s",
+				filename, sdb_strerror(errno, errbuf, sizeof(errbuf)));
+		close(fd);
+		return -1;
+	}
+	return fd;
+} /* open_file */
+
+static int
+journal_init(sdb_object_t *obj, va_list ap)
+{
+	sdb_memstore_journal_t *j = JOURNAL(obj);
+	const char *filename = va_arg(ap, const char *);
+
+	j->fd = -1;
+	j->sync_interval = va_arg(ap, sdb_time_t);
+	pthread_mutex_init(&j->lock, /* attr = */ NULL);
+	pthread_cond_init(&j->flushed, /* attr = */ NULL);
+	pthread_cond_init(&j->wakeup, /* attr = */ NULL);
+
+	j->filename = strdup(filename);
+	j->pending = sdb_strbuf_create(PENDING_MAX);
+	j->writing = sdb_strbuf_create(PENDING_MAX);
+	if ((! j->filename) || (! j->pending) || (! j->writing))
+		return -1;
+
+	if ((j->fd = open_file(filename)) < 0)
+		return -1;
+
+	if (j->sync_interval) {
+		int err;
+
+		j->running = 1;
+		if ((err = pthread_create(&j->thread, /* attr = */ NULL,
+						sync_thread, j))) {
+			char errbuf[1024];
+			sdb_log(SDB_LOG_ERR, "memstore: Failed to start journal "
+					"sync thread: %s",
+					sdb_strerror(err, errbuf, sizeof(errbuf)));
+			j->running = 0;
+			return -1;
+		}
+	}
+	return 0;
+} /* journal_init */
+
+static void
+journal_destroy(sdb_object_t *obj)
+{
+	sdb_memstore_journal_t *j = JOURNAL(obj);
+
+	pthread_mutex_lock(&j->lock);
+	if (j->running) {
+		j->running = 0;
+		pthread_cond_signal(&j->wakeup);
+		pthread_mutex_unlock(&j->lock);
+		pthread_join(j->thread, NULL);
+		pthread_mutex_lock(&j->lock);
+	}
+	if (j->fd >= 0) {
+		sync_locked(j, j->appended);
+		close(j->fd);
+	}
+	pthread_mutex_unlock(&j->lock);
+
+	pthread_cond_destroy(&j->wakeup);
+	pthread_cond_destroy(&j->flushed);
+	pthread_mutex_destroy(&j->lock);
+
+	sdb_strbuf_destroy(j->pending);
+	sdb_strbuf_destroy(j->writing);
+	if (j->filename)
+		free(j->filename);
+} /* journal_destroy */
+
+static sdb_type_t journal_type = {
+	/* size = */ sizeof(sdb_memstore_journal_t),
+	/* init = */ journal_init,
+	/* destroy = */ journal_destroy,
+};
+
+/*
+ * store writer API
+ */
+
+static int
+journal_batch(sdb_store_batch_entry_t *entries, size_t entries_num,
+		sdb_object_t *user_data)
+{
+	sdb_memstore_journal_t *j = JOURNAL(user_data);
+	uint64_t seq;
+	int status = 0;
+	size_t i;
+
+	if ((! j) || ((! entries) && entries_num))
+		return -1;
+
+	pthread_mutex_lock(&j->lock);
+	if (j->broken) {
+		pthread_mutex_unlock(&j->lock);
+		return -1;
+	}
+
+	for (i = 0; i < entries_num; ++i) {
+		if (encode_entry(j->pending, entries + i)) {
+			sdb_log(SDB_LOG_ERR, "memstore: Failed to journal %s update",
+					SDB_STORE_TYPE_TO_NAME(entries[i].type));
+			status = -1;
+		}
+	}
+	seq = ++j->appended;
+
+	if (! j->sync_interval) {
+		if (sync_locked(j, seq))
+			status = -1;
+	}
+	else if (sdb_strbuf_len(j->pending) >= PENDING_MAX)
+		pthread_cond_signal(&j->wakeup);
+
+	pthread_mutex_unlock(&j->lock);
+	return status;
+} /* journal_batch */
+
+static int
+journal_host(sdb_store_host_t *host, sdb_object_t *user_data)
+{
+	sdb_store_batch_entry_t e = { SDB_HOST, { .host = *host } };
+	return journal_batch(&e, 1, user_data);
+} /* journal_host */
+
+static int
+journal_service(sdb_store_service_t *service, sdb_object_t *user_data)
+{
+	sdb_store_batch_entry_t e = { SDB_SERVICE, { .service = *service } };
+	return journal_batch(&e, 1, user_data);
+} /* journal_service */
+
+static int
+journal_metric(sdb_store_metric_t *metric, sdb_object_t *user_data)
+{
+	sdb_store_batch_entry_t e = { SDB_METRIC, { .metric = *metric } };
+	return journal_batch(&e, 1, user_data);
+} /* journal_metric */
+
+static int
+journal_attribute(sdb_store_attribute_t *attr, sdb_object_t *user_data)
+{
+	sdb_store_batch_entry_t e = { SDB_ATTRIBUTE, { .attribute = *attr } };
+	return journal_batch(&e, 1, user_data);
+} /* journal_attribute */
+
+sdb_store_writer_t sdb_memstore_journal_writer = {
+	journal_host, journal_service, journal_metric, journal_attribute,
+	journal_batch, NULL, NULL,
+};
+
+/*
+ * replaying journals
+ */
+
+typedef struct {
+	/* the current batch of updates */
+	sdb_store_batch_entry_t entries[REPLAY_BATCH_SIZE];
+	size_t entries_num;
+
+	/* the backends and metric stores of the current batch, in order */
+	const char **backends;
+	size_t backends_num;
+	size_t backends_size;
+	sdb_metric_store_t *stores;
+	size_t stores_num;
+	size_t stores_size;
+} replay_t;
+
+static int
+replay_flush(sdb_memstore_t *store, replay_t *r)
+{
+	const char **backends = r->backends;
+	sdb_metric_store_t *stores = r->stores;
+	int status;
+	size_t i;
+
+	if (! r->entries_num)
+		return 0;
+
+	/* the lists of backends and stores may have moved while growing */
+	for (i = 0; i < r->entries_num; ++i) {
+		sdb_store_batch_entry_t *e = r->entries + i;
+
+		if (e->type == SDB_HOST) {
+			e->obj.host.backends = backends;
+			backends += e->obj.host.backends_num;
+		}
+		else if (e->type == SDB_SERVICE) {
+			e->obj.service.backends = backends;
+			backends += e->obj.service.backends_num;
+		}
+		else if (e->type == SDB_METRIC) {
+			e->obj.metric.backends = backends;
+			backends += e->obj.metric.backends_num;
+			e->obj.metric.stores = stores;
+			stores += e->obj.metric.stores_num;
+		}
+		else if (e->type == SDB_ATTRIBUTE) {
+			e->obj.attribute.backends = backends;
+			backends += e->obj.attribute.backends_num;
+		}
+	}
+
+	status = sdb_memstore_writer.store_batch(r->entries, r->entries_num,
+			SDB_OBJ(store));
+
+	for (i = 0; i < r->entries_num; ++i)
+		if (r->entries[i].type == SDB_ATTRIBUTE)
+			sdb_data_free_datum(&r->entries[i].obj.attribute.value);
+	r->entries_num = 0;
+	r->backends_num = 0;
+	r->stores_num = 0;
+	return status;
+} /* replay_flush */
+
+static ssize_t
+get_string(const char *buf, size_t len, const char **s)
+{
+	const char *end = memchr(buf, '\0', len);
+	if (! end)
+		return -1;
+	*s = buf;
+	return (end - buf) + 1;
+} /* get_string */
+
+/* Decode a single record into the next entry of the current batch. */
+static int
+replay_decode(replay_t *r, const char *buf, size_t len)
+{
+	sdb_store_batch_entry_t *e = r->entries + r->entries_num;
+	uint64_t interval;
+	uint32_t backends_num, stores_num, type, i;
+	ssize_t n;
+
+	if ((sdb_proto_unmarshal_int64(buf, len, &interval) < 0))
+		return -1;
+	buf += sizeof(int64_t); len -= sizeof(int64_t);
+
+	/* each string uses at least one byte */
+	if ((sdb_proto_unmarshal_int32(buf, len, &backends_num) < 0)
+			|| (backends_num > len))
+		return -1;
+	buf += sizeof(uint32_t); len -= sizeof(uint32_t);
+	if (r->backends_num + backends_num > r->backends_size) {
+		size_t size = r->backends_size ? 2 * r->backends_size : 1024;
+		void *tmp;
+		while (size < r->backends_num + backends_num)
+			size *= 2;
+		if (! (tmp = realloc(r->backends, size * sizeof(*r->backends))))
+			return -1;
+		r->backends = tmp;
+		r->backends_size = size;
+	}
+	for (i = 0; i < backends_num; ++i) {
+		if ((n = get_string(buf, len, r->backends + r->backends_num + i)) < 0)
+			return -1;
+		buf += n; len -= (size_t)n;
+	}
+
+	/* each store uses at least ten bytes */
+	if ((sdb_proto_unmarshal_int32(buf, len, &stores_num) < 0)
+			|| (stores_num > len / 10))
+		return -1;
+	buf += sizeof(uint32_t); len -= sizeof(uint32_t);
+	if (r->stores_num + stores_num > r->stores_size) {
+		size_t size = r->stores_size ? 2 * r->stores_size : 256;
+		void *tmp;
+		while (size < r->stores_num + stores_num)
+			size *= 2;
+		if (! (tmp = realloc(r->stores, size * sizeof(*r->stores))))
+			return -1;
+		r->stores = tmp;
+		r->stores_size = size;
+	}
+	for (i = 0; i < stores_num; ++i) {
+		sdb_metric_store_t *s = r->stores + r->stores_num + i;
+		uint64_t last_update;
+
+		if ((n = get_string(buf, len, &s->type)) < 0)
+			return -1;
+		buf += n; len -= (size_t)n;
+		if ((n = get_string(buf, len, &s->id)) < 0)
+			return -1;
+		buf += n; len -= (size_t)n;
+		if (sdb_proto_unmarshal_int64(buf, len, &last_update) < 0)
+			return -1;
+		buf += sizeof(int64_t); len -= sizeof(int64_t);
+		s->info = NULL;
+		s->last_update = (sdb_time_t)last_update;
+	}
+
+	if (sdb_proto_unmarshal_int32(buf, len, &type) < 0)
+		return -1;
+
+	memset(e, 0, sizeof(*e));
+	if (type == SDB_HOST) {
+		sdb_proto_host_t h = SDB_PROTO_HOST_INIT;
+		if (sdb_proto_unmarshal_host(buf, len, &h) < 0)
+			return -1;
+		e->obj.host.name = h.name;
+		e->obj.host.last_update = h.last_update;
+		e->obj.host.interval = (sdb_time_t)interval;
+		e->obj.host.backends_num = backends_num;
+	}
+	else if (type == SDB_SERVICE) {
+		sdb_proto_service_t s = SDB_PROTO_SERVICE_INIT;
+		if (sdb_proto_unmarshal_service(buf, len, &s) < 0)
+			return -1;
+		e->obj.service.hostname = s.hostname;
+		e->obj.service.name = s.name;
+		e->obj.service.last_update = s.last_update;
+		e->obj.service.interval = (sdb_time_t)interval;
+		e->obj.service.backends_num = backends_num;
+	}
+	else if (type == SDB_METRIC) {
+		sdb_proto_metric_t m = SDB_PROTO_METRIC_INIT;
+		if (sdb_proto_unmarshal_metric(buf, len, &m) < 0)
+			return -1;
+		e->obj.metric.hostname = m.hostname;
+		e->obj.metric.name = m.name;
+		e->obj.metric.last_update = m.last_update;
+		e->obj.metric.interval = (sdb_time_t)interval;
+		e->obj.metric.backends_num = backends_num;
+		e->obj.metric.stores_num = stores_num;
+		r->stores_num += stores_num;
+	}
+	else if (type & SDB_ATTRIBUTE) {
+		sdb_proto_attribute_t a = SDB_PROTO_ATTRIBUTE_INIT;
+		if (sdb_proto_unmarshal_attribute(buf, len, &a) < 0)
+			return -1;
+		e->obj.attribute.hostname = a.hostname;
+		e->obj.attribute.parent_type = a.parent_type;
+		e->obj.attribute.parent = a.parent;
+		e->obj.attribute.key = a.key;
+		e->obj.attribute.value = a.value;
+		e->obj.attribute.last_update = a.last_update;
+		e->obj.attribute.interval = (sdb_time_t)interval;
+		e->obj.attribute.backends_num = backends_num;
+		type = SDB_ATTRIBUTE;
+	}
+	else
+		return -1;
+
+	e->type = (int)type;
+	r->backends_num += backends_num;
+	++r->entries_num;
+	return 0;
+} /* replay_decode */
+
+/*
+ * public API
+ */
+
+sdb_memstore_journal_t *
+sdb_memstore_journal_open(const char *filename, sdb_time_t sync_interval)
+{
+	if (! filename)
+		return NULL;
+	return JOURNAL(sdb_object_create("memstore-journal", journal_type,
+				filename, sync_interval));
+} /* sdb_memstore_journal_open */
+
+int
+sdb_memstore_journal_sync(sdb_memstore_journal_t *journal)
+{
+	int status;
+
+	if (! journal)
+		return -1;
+
+	pthread_mutex_lock(&journal->lock);
+	status = sync_locked(journal, journal->appended);
+	pthread_mutex_unlock(&journal->lock);
+	return status;
+} /* sdb_memstore_journal_sync */
+
+int
+sdb_memstore_journal_compact(sdb_memstore_journal_t *journal,
+		sdb_memstore_t *store, const char *snapshot)
+{
+	char oldname[strlen(journal ? journal->filename : "") + 5];
+	char errbuf[1024];
+	int status = 0;
+
+	if ((! journal) || (! store) || (! snapshot))
+		return -1;
+
+	snprintf(oldname, sizeof(oldname), "%s.old", journal->filename);
+
+	pthread_mutex_lock(&journal->lock);
+	while (journal->flushing)
+		pthread_cond_wait(&journal->flushed, &journal->lock);
+	if (! journal->broken)
+		flush_locked(journal);
+
+	/* If an old journal is left over from a failed compaction, keep it and
+	 * the current journal; both are covered by the new snapshot. Else, all
+	 * updates journaled so far have been applied to the store already and
+	 * will be part of the snapshot. */
+	if (access(oldname, F_OK)) {
+		int fd;
+
+		if (rename(journal->filename, oldname)) {
+			sdb_log(SDB_LOG_ERR, "memstore: Failed to rotate journal %s: %s",
+					journal->filename,
+					sdb_strerror(errno, errbuf, sizeof(errbuf)));
+			status = -1;
+		}
+		else if ((fd = open_file(journal->filename)) < 0) {
+			/* keep journaling to the old file */
+			rename(oldname, journal->filename);
+			status = -1;
+		}
+		else {
+			close(journal->fd);
+			journal->fd = fd;
+			journal->broken = 0;
+		}
+	}
+	pthread_mutex_unlock(&journal->lock);
+
+	if (status)
+		return status;
+
+	status = sdb_memstore_dump(store, snapshot);
+	if (! status)
+		unlink(oldname);
+	return status;
+} /* sdb_memstore_journal_compact */
+
+int
+sdb_memstore_journal_replay(sdb_memstore_t *store, const char *filename)
+{
+	replay_t *r;
+	struct stat st;
+	const char *data;
+	void *map;
+	char errbuf[1024];
+	size_t len;
+	int fd, status = 0;
+
+	if ((! store) || (! filename))
+		return -1;
+
+	if ((fd = open(filename, O_RDONLY)) < 0) {
+		sdb_log(SDB_LOG_ERR, "memstore: Failed to open journal %s: %s",
+				filename, sdb_strerror(errno, errbuf, sizeof(errbuf)));
+		return -1;
+	}
+	if (fstat(fd, &st)) {
+		sdb_log(SDB_LOG_ERR, "memstore: Failed to stat journal %s: %s",
+				filename, sdb_strerror(errno, errbuf, sizeof(errbuf)));
+		close(fd);
+		return -1;
+	}
+
+	/* a journal that has just been created may not have a header yet */
+	if ((size_t)st.st_size < sizeof(JOURNAL_MAGIC) + sizeof(uint32_t)) {
+		close(fd);
+		return 0;
+	}
+
+	map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		sdb_log(SDB_LOG_ERR, "memstore: Failed to map journal %s: %s",
+				filename, sdb_strerror(errno, errbuf, sizeof(errbuf)));
+		return -1;
+	}
+	madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+	data = map;
+	len = (size_t)st.st_size;
+	if (memcmp(data, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC))) {
+		sdb_log(SDB_LOG_ERR, "memstore: Invalid journal %s (bad magic)",
+				filename);
+		munmap(map, (size_t)st.st_size);
+		return -1;
+	}
+	data += sizeof(JOURNAL_MAGIC);
+	len -= sizeof(JOURNAL_MAGIC);
+	{
+		uint32_t version = 0;
+		sdb_proto_unmarshal_int32(data, len, &version);
+		if (version != JOURNAL_VERSION) {
+			sdb_log(SDB_LOG_ERR, "memstore: Unsupported journal version %u "
+					"in %s", version, filename);
+			munmap(map, (size_t)st.st_size);
+			return -1;
+		}
+		data += sizeof(uint32_t);
+		len -= sizeof(uint32_t);
+	}
+
+	if (! (r = calloc(1, sizeof(*r)))) {
+		munmap(map, (size_t)st.st_size);
+		return -1;
+	}
+
+	while (len > 0) {
+		uint32_t rec_len;
+		int s;
+
+		if ((sdb_proto_unmarshal_int32(data, len, &rec_len) < 0)
+				|| (rec_len > len - sizeof(uint32_t))) {
+			/* the last record may not have been written completely */
+			sdb_log(SDB_LOG_WARNING, "memstore: Ignoring truncated record "
+					"at the end of journal %s", filename);
+			break;
+		}
+		data += sizeof(uint32_t);
+		len -= sizeof(uint32_t);
+
+		if (replay_decode(r, data, rec_len)) {
+			sdb_log(SDB_LOG_ERR, "memstore: Invalid record in journal %s "
+					"at offset %zu", filename,
+					(size_t)st.st_size - len - sizeof(uint32_t));
+			status = -1;
+			break;
+		}
+		data += rec_len;
+		len -= rec_len;
+
+		if (r->entries_num >= REPLAY_BATCH_SIZE) {
+			s = replay_flush(store, r);
+			if (((s > 0) && (status >= 0)) || (s < 0))
+				status = s;
+		}
+	}
+
+	{
+		int s = replay_flush(store, r);
+		if (((s > 0) && (status >= 0)) || (s < 0))
+			status = s;
+	}
+
+	free(r->backends);
+	free(r->stores);
+	free(r);
+	munmap(map, (size_t)st.st_size);
+	return status;
+} /* sdb_memstore_journal_replay */
+
+/* vim: set tw=78 sw=4 ts=4 noexpandtab : */
+
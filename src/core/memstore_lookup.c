@@ -50,6 +50,36 @@
 
 #include <limits.h>
 
+/*
+ * private variables
+ */
+
+/* the active visibility scope of each thread; see sdb_memstore_visible */
+static pthread_once_t scope_once = PTHREAD_ONCE_INIT;
+static pthread_key_t  scope_key;
+
+/*
+ * private helper functions
+ */
+
+static void
+scope_init(void)
+{
+	pthread_key_create(&scope_key, /* destructor */ NULL);
+} /* scope_init */
+
+static sdb_memstore_visibility_t *
+scope_get(void)
+{
+	pthread_once(&scope_once, scope_init);
+	return pthread_getspecific(scope_key);
+} /* scope_get */
+
+/* match an object which is known to be visible through the filter */
+static int
+match(sdb_memstore_matcher_t *m, sdb_memstore_obj_t *obj,
+		sdb_memstore_matcher_t *filter);
+
 static int
 expr_eval2(sdb_memstore_expr_t *e1, sdb_data_t *v1,
 		sdb_memstore_expr_t *e2, sdb_data_t *v2,
@@ -83,6 +113,19 @@ expr_free_datum2(sdb_memstore_expr_t *e1, sdb_data_t *v1,
 		sdb_data_free_datum(v2);
 } /* expr_free_datum2 */
 
+/* check whether an expression is independent of any object */
+static bool
+expr_is_const(sdb_memstore_expr_t *e)
+{
+	if (! e)
+		return 1;
+	if (! e->type)
+		return 1;
+	if (e->type < 0)
+		return 0;
+	return expr_is_const(e->left) && expr_is_const(e->right);
+} /* expr_is_const */
+
 /*
  * matcher implementations
  */
@@ -119,10 +162,20 @@ match_cmp_value(int op, sdb_data_t *v1, sdb_data_t *v2, bool strcmp_fallback)
 	return 0;
 } /* match_cmp_value */
 
+/* match the string representation of a non-string value */
 static int
-match_regex_value(int op, sdb_data_t *v, sdb_data_t *re)
+regexec_formatted(const regex_t *re, const sdb_data_t *v)
 {
 	char value[sdb_data_strlen(v) + 1];
+
+	if (! sdb_data_format(v, value, sizeof(value), SDB_UNQUOTED))
+		return 0;
+	return ! regexec(re, value, 0, NULL, 0);
+} /* regexec_formatted */
+
+static int
+match_regex_value(int op, sdb_data_t *v, sdb_data_t *re)
+{
 	int status = 0;
 
 	assert((op == MATCHER_REGEX)
@@ -143,10 +196,11 @@ match_regex_value(int op, sdb_data_t *v, sdb_data_t *re)
 	else if (re->type != SDB_TYPE_REGEX)
 		return 0;
 
-	if (! sdb_data_format(v, value, sizeof(value), SDB_UNQUOTED))
-		status = 0;
-	else if (! regexec(&re->data.re.regex, value, 0, NULL, 0))
-		status = 1;
+	/* strings are matched in place */
+	if (v->type == SDB_TYPE_STRING)
+		status = ! regexec(&re->data.re.regex, v->data.string, 0, NULL, 0);
+	else
+		status = regexec_formatted(&re->data.re.regex, v);
 
 	if (op == MATCHER_NREGEX)
 		return !status;
@@ -162,7 +216,7 @@ match_logical(sdb_memstore_matcher_t *m, sdb_memstore_obj_t *obj,
 	assert((m->type == MATCHER_AND) || (m->type == MATCHER_OR));
 	assert(OP_M(m)->left && OP_M(m)->right);
 
-	status = sdb_memstore_matcher_matches(OP_M(m)->left, obj, filter);
+	status = match(OP_M(m)->left, obj, filter);
 
 	/* lazy evaluation */
 	if ((! status) && (m->type == MATCHER_AND))
@@ -170,7 +224,7 @@ match_logical(sdb_memstore_matcher_t *m, sdb_memstore_obj_t *obj,
 	else if (status && (m->type == MATCHER_OR))
 		return status;
 
-	return sdb_memstore_matcher_matches(OP_M(m)->right, obj, filter);
+	return match(OP_M(m)->right, obj, filter);
 } /* match_logical */
 
 static int
@@ -180,7 +234,7 @@ match_uop(sdb_memstore_matcher_t *m, sdb_memstore_obj_t *obj,
 	assert(m->type == MATCHER_NOT);
 	assert(UOP_M(m)->op);
 
-	return !sdb_memstore_matcher_matches(UOP_M(m)->op, obj, filter);
+	return !match(UOP_M(m)->op, obj, filter);
 } /* match_uop */
 
 /* iterate: ANY/ALL <iter> <cmp> <value> */
@@ -208,7 +262,7 @@ match_iter(sdb_memstore_matcher_t *m, sdb_memstore_obj_t *obj,
 		bool matches;
 
 		CMP_M(ITER_M(m)->m)->left = &expr;
-		matches = sdb_memstore_matcher_matches(ITER_M(m)->m, obj, filter);
+		matches = match(ITER_M(m)->m, obj, filter);
 		CMP_M(ITER_M(m)->m)->left = NULL;
 		sdb_data_free_datum(&v);
 
@@ -359,8 +413,74 @@ matchers[] = {
 	match_regex,
 
 	NULL, /* QUERY */
+	sdb_memstore_prog_matches,
 };
 
+static int
+match(sdb_memstore_matcher_t *m, sdb_memstore_obj_t *obj,
+		sdb_memstore_matcher_t *filter)
+{
+	/* "NULL" always matches */
+	if ((! m) || (! obj))
+		return 1;
+
+	if ((m->type < 0) || ((size_t)m->type >= SDB_STATIC_ARRAY_LEN(matchers)))
+		return 0;
+
+	if (! matchers[m->type])
+		return 0;
+	return matchers[m->type](m, obj, filter);
+} /* match */
+
+/*
+ * name prefixes
+ */
+
+/* check whether 'e' refers to the name of an object of type 'target' when
+ * evaluated against an object of type 'type' */
+static bool
+refers_to_name(sdb_memstore_expr_t *e, int type, int target)
+{
+	if (e && (e->type == TYPED_EXPR)) {
+		int t = (int)e->data.data.integer;
+
+		if (t != target)
+			return 0;
+		/* self-reference or { service, metric } -> host */
+		if ((t != type) && ((t != SDB_HOST)
+					|| ((type != SDB_SERVICE) && (type != SDB_METRIC))))
+			return 0;
+		e = e->left;
+	}
+	else if (type != target)
+		return 0;
+
+	return e && (e->type == FIELD_VALUE)
+		&& (e->data.data.integer == SDB_FIELD_NAME);
+} /* refers_to_name */
+
+/* the literal prefix of an anchored regular expression */
+static size_t
+regex_prefix(const char *raw, char *buf, size_t size)
+{
+	size_t len = 0;
+
+	/* alternatives are not necessarily anchored */
+	if ((raw[0] != '^') || strchr(raw, '|'))
+		return 0;
+
+	for (++raw; *raw && (len + 1 < size); ++raw) {
+		if (strchr(".[]()*+?{}\\^$", *raw))
+			break;
+		buf[len++] = *raw;
+	}
+	/* quantifiers apply to the preceding character */
+	if (len && *raw && strchr("*?{", *raw))
+		--len;
+	buf[len] = '\0';
+	return len;
+} /* regex_prefix */
+
 /*
  * private matcher types
  */
@@ -604,20 +724,43 @@ sdb_memstore_in_matcher(sdb_memstore_expr_t *left, sdb_memstore_expr_t *right)
 sdb_memstore_matcher_t *
 sdb_memstore_regex_matcher(sdb_memstore_expr_t *left, sdb_memstore_expr_t *right)
 {
+	sdb_memstore_expr_t *folded = NULL;
+	sdb_memstore_matcher_t *m;
+
+	if ((right->type > 0) && expr_is_const(right)) {
+		/* compile the regex once rather than for every object */
+		sdb_data_t v = SDB_DATA_INIT;
+
+		if (sdb_memstore_expr_eval(right, NULL, &v, NULL))
+			return NULL;
+		folded = sdb_memstore_expr_constvalue(&v);
+		sdb_data_free_datum(&v);
+		if (! folded)
+			return NULL;
+		right = folded;
+	}
+
 	if (! right->type) {
 		if ((right->data.type != SDB_TYPE_STRING)
-				&& (right->data.type != SDB_TYPE_REGEX))
+				&& (right->data.type != SDB_TYPE_REGEX)) {
+			sdb_object_deref(SDB_OBJ(folded));
 			return NULL;
+		}
 
 		if (right->data.type == SDB_TYPE_STRING) {
 			char *raw = right->data.data.string;
-			if (sdb_data_parse(raw, SDB_TYPE_REGEX, &right->data))
+			if (sdb_data_parse(raw, SDB_TYPE_REGEX, &right->data)) {
+				sdb_object_deref(SDB_OBJ(folded));
 				return NULL;
+			}
 			free(raw);
 		}
 	}
-	return M(sdb_object_create("regex-matcher", cmp_type,
+	m = M(sdb_object_create("regex-matcher", cmp_type,
 				MATCHER_REGEX, left, right));
+	/* the matcher takes a reference */
+	sdb_object_deref(SDB_OBJ(folded));
+	return m;
 } /* sdb_memstore_regex_matcher */
 
 sdb_memstore_matcher_t *
@@ -675,20 +818,104 @@ int
 sdb_memstore_matcher_matches(sdb_memstore_matcher_t *m, sdb_memstore_obj_t *obj,
 		sdb_memstore_matcher_t *filter)
 {
-	if (filter && (! sdb_memstore_matcher_matches(filter, obj, NULL)))
+	if (! sdb_memstore_visible(filter, obj))
 		return 0;
+	return match(m, obj, filter);
+} /* sdb_memstore_matcher_matches */
 
-	/* "NULL" always matches */
-	if ((! m) || (! obj))
-		return 1;
+size_t
+sdb_memstore_matcher_prefix(sdb_memstore_matcher_t *m, int type, int target,
+		char *buf, size_t size)
+{
+	sdb_memstore_expr_t *right;
 
-	if ((m->type < 0) || ((size_t)m->type >= SDB_STATIC_ARRAY_LEN(matchers)))
+	if ((! m) || (! buf) || (! size))
 		return 0;
 
-	if (! matchers[m->type])
+	if (m->type == MATCHER_PROG)
+		return sdb_memstore_matcher_prefix(sdb_memstore_prog_source(m),
+				type, target, buf, size);
+
+	if (m->type == MATCHER_AND) {
+		char tmp[size];
+		size_t l, r;
+
+		/* both prefixes apply; the longer one is more selective */
+		l = sdb_memstore_matcher_prefix(OP_M(m)->left, type, target, buf, size);
+		r = sdb_memstore_matcher_prefix(OP_M(m)->right, type, target, tmp, size);
+		if (r <= l)
+			return l;
+		memcpy(buf, tmp, r + 1);
+		return r;
+	}
+
+	if ((m->type != MATCHER_REGEX) && (m->type != MATCHER_EQ))
 		return 0;
-	return matchers[m->type](m, obj, filter);
-} /* sdb_memstore_matcher_matches */
+	if (! refers_to_name(CMP_M(m)->left, type, target))
+		return 0;
+
+	right = CMP_M(m)->right;
+	if (right->type)
+		return 0;
+	if ((m->type == MATCHER_REGEX) && (right->data.type == SDB_TYPE_REGEX))
+		return regex_prefix(right->data.data.re.raw, buf, size);
+	if ((m->type == MATCHER_EQ) && (right->data.type == SDB_TYPE_STRING)
+			&& right->data.data.string) {
+		strncpy(buf, right->data.data.string, size - 1);
+		buf[size - 1] = '\0';
+		return strlen(buf);
+	}
+	return 0;
+} /* sdb_memstore_matcher_prefix */
+
+void
+sdb_memstore_visibility_begin(sdb_memstore_visibility_t *scope)
+{
+	memset(scope->objs, 0, sizeof(scope->objs));
+	scope->prev = scope_get();
+	pthread_setspecific(scope_key, scope);
+} /* sdb_memstore_visibility_begin */
+
+void
+sdb_memstore_visibility_reset(sdb_memstore_visibility_t *scope)
+{
+	memset(scope->objs, 0, sizeof(scope->objs));
+} /* sdb_memstore_visibility_reset */
+
+void
+sdb_memstore_visibility_end(sdb_memstore_visibility_t *scope)
+{
+	assert(scope_get() == scope);
+	pthread_setspecific(scope_key, scope->prev);
+} /* sdb_memstore_visibility_end */
+
+bool
+sdb_memstore_visible(sdb_memstore_matcher_t *filter, sdb_memstore_obj_t *obj)
+{
+	sdb_memstore_visibility_t *scope;
+	size_t i;
+	bool visible;
+
+	if ((! filter) || (! obj))
+		return 1;
+
+	scope = scope_get();
+	if (! scope)
+		return match(filter, obj, NULL) != 0;
+
+	/* one slot per object type */
+	i = obj->type == SDB_ATTRIBUTE ? 0 : (size_t)obj->type;
+	if (i >= SDB_STATIC_ARRAY_LEN(scope->objs))
+		return match(filter, obj, NULL) != 0;
+	if ((scope->objs[i].obj == obj) && (scope->objs[i].filter == filter))
+		return scope->objs[i].visible;
+
+	visible = match(filter, obj, NULL) != 0;
+	scope->objs[i].filter = filter;
+	scope->objs[i].obj = obj;
+	scope->objs[i].visible = visible;
+	return visible;
+} /* sdb_memstore_visible */
 
 /* vim: set tw=78 sw=4 ts=4 noexpandtab : */
 
@@ -0,0 +1,958 @@
+/*
+ * SysDB - src/core/memstore_prog.c
+ * Copyright (C) 2016 Sebastian 'tokkee' Harl <sh@tokkee.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This module compiles matchers and expressions into flat programs for a
+ * small stack machine. Programs evaluate objects using borrowed values (the
+ * caller holds the lock of the object's host) rather than copying each field
+ * and attribute value, such that matching an object usually does not
+ * allocate any memory. The semantics are the same as those of the matcher
+ * implementations in memstore_lookup.c and memstore_expr.c.
+ */
+
+#if HAVE_CONFIG_H
+#	include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include "sysdb.h"
+#include "core/memstore-private.h"
+#include "core/object.h"
+#include "utils/error.h"
+
+#include <assert.h>
+
+#include <sys/types.h>
+#include <regex.h>
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * private data types
+ */
+
+enum {
+	/* values */
+	OP_CONST,       /* push 'value' */
+	OP_FIELD,       /* push field 'arg' of the current object */
+	OP_ATTR,        /* push the value of attribute 'value' (a string) */
+	OP_ARITH,       /* pop two values, push the result of operator 'arg' */
+	OP_TYPED_BEGIN, /* switch to the object of type 'arg' */
+	OP_TYPED_END,   /* switch back to the previous object */
+
+	/* matchers; these set the result register */
+	OP_CMP,         /* pop two values, compare using matcher 'arg' */
+	OP_IN,          /* pop value and array */
+	OP_REGEX,       /* pop value and regex, match using matcher 'arg' */
+	OP_UNARY,       /* pop a value, check using matcher 'arg' */
+	OP_ITER,        /* pop a value, compare it to all elements of 'iter' */
+	OP_NOT,         /* invert the result */
+	OP_JMP_FALSE,   /* jump to 'arg' if the result is false */
+	OP_JMP_TRUE,    /* jump to 'arg' if the result is true */
+};
+
+typedef struct iter iter_t;
+
+typedef struct {
+	int op;
+	int arg;
+	/* compare string values in case of a type mismatch */
+	bool strcmp_fallback;
+	const sdb_data_t *value;
+	iter_t *iter;
+} instr_t;
+
+typedef struct {
+	instr_t *code;
+	size_t len;
+
+	/* maximum number of values on the stack and of nested typed
+	 * expressions */
+	size_t stack_size;
+	size_t ctx_size;
+} prog_t;
+
+/* ANY/ALL: The iterator expression may refer to the object itself or to its
+ * parent host (using any number of typed expressions) before referring to
+ * the actual values, so its structure is resolved at runtime like
+ * sdb_memstore_expr_iter does. There's one program for each level of
+ * nesting. */
+struct iter {
+	bool all;
+	int op;
+	bool strcmp_fallback;
+
+	sdb_memstore_expr_t *expr;
+	prog_t *levels;
+	size_t levels_num;
+};
+
+typedef struct {
+	sdb_memstore_matcher_t super;
+
+	/* keeps the (borrowed) constants of the program alive */
+	sdb_memstore_matcher_t *orig;
+	prog_t prog;
+} prog_matcher_t;
+#define PROG_M(m) ((prog_matcher_t *)(m))
+
+/* a value on the stack of the machine; 'v' points to a borrowed value or to
+ * 'tmp', which is used for values computed at runtime */
+typedef struct {
+	const sdb_data_t *v;
+	sdb_data_t tmp;
+	/* 'tmp' has to be freed */
+	bool owned;
+	/* the value could not be evaluated */
+	bool err;
+} value_t;
+
+/* the object that's being evaluated inside of a typed expression */
+typedef struct {
+	sdb_memstore_obj_t *obj;
+	/* the typed expression does not apply to the object */
+	bool invalid;
+} ctx_t;
+
+typedef struct {
+	sdb_memstore_matcher_t *filter;
+
+	value_t *stack;
+	size_t sp;
+	ctx_t *ctx;
+	size_t ctx_sp;
+	sdb_memstore_obj_t *obj;
+
+	int res;
+} vm_t;
+
+/*
+ * compiler
+ */
+
+typedef struct {
+	prog_t prog;
+	size_t size;
+	size_t depth;
+	size_t ctx_depth;
+	bool failed;
+} compiler_t;
+
+static void
+prog_free(prog_t *p);
+
+static int
+compile_value_prog(sdb_memstore_expr_t *e, prog_t *p);
+
+static size_t
+emit(compiler_t *c, int op, int arg, const sdb_data_t *value)
+{
+	instr_t *i;
+
+	if (c->failed)
+		return 0;
+
+	if (c->prog.len >= c->size) {
+		size_t size = c->size ? 2 * c->size : 16;
+		instr_t *code = realloc(c->prog.code, size * sizeof(*code));
+		if (! code) {
+			c->failed = 1;
+			return 0;
+		}
+		c->prog.code = code;
+		c->size = size;
+	}
+
+	i = c->prog.code + c->prog.len;
+	i->op = op;
+	i->arg = arg;
+	i->strcmp_fallback = 0;
+	i->value = value;
+	i->iter = NULL;
+	return c->prog.len++;
+} /* emit */
+
+/* Keep track of the stack size required at runtime. */
+static void
+push(compiler_t *c, size_t n)
+{
+	c->depth += n;
+	if (c->depth > c->prog.stack_size)
+		c->prog.stack_size = c->depth;
+} /* push */
+
+static void
+compile_expr(compiler_t *c, sdb_memstore_expr_t *e)
+{
+	if (! e) {
+		c->failed = 1;
+		return;
+	}
+
+	if (! e->type) {
+		emit(c, OP_CONST, 0, &e->data);
+		push(c, 1);
+	}
+	else if (e->type == FIELD_VALUE) {
+		emit(c, OP_FIELD, (int)e->data.data.integer, NULL);
+		push(c, 1);
+	}
+	else if (e->type == ATTR_VALUE) {
+		emit(c, OP_ATTR, 0, &e->data);
+		push(c, 1);
+	}
+	else if (e->type == TYPED_EXPR) {
+		emit(c, OP_TYPED_BEGIN, (int)e->data.data.integer, NULL);
+		if (++c->ctx_depth > c->prog.ctx_size)
+			c->prog.ctx_size = c->ctx_depth;
+		compile_expr(c, e->left);
+		emit(c, OP_TYPED_END, 0, NULL);
+		--c->ctx_depth;
+	}
+	else if (e->type > 0) {
+		compile_expr(c, e->left);
+		compile_expr(c, e->right);
+		emit(c, OP_ARITH, e->type, NULL);
+		--c->depth;
+	}
+	else
+		c->failed = 1;
+} /* compile_expr */
+
+static iter_t *
+compile_iter(sdb_memstore_matcher_t *m)
+{
+	sdb_memstore_matcher_t *cmp = ITER_M(m)->m;
+	sdb_memstore_expr_t *e;
+	iter_t *iter;
+	size_t i;
+
+	iter = calloc(1, sizeof(*iter));
+	if (! iter)
+		return NULL;
+
+	iter->all = m->type == MATCHER_ALL;
+	iter->op = cmp->type;
+	/* the left operand is a constant value, see match_iter */
+	iter->strcmp_fallback = CMP_M(cmp)->right->data_type < 0;
+	iter->expr = ITER_M(m)->iter;
+	sdb_object_ref(SDB_OBJ(iter->expr));
+
+	for (e = iter->expr; e && (e->type == TYPED_EXPR); e = e->left)
+		++iter->levels_num;
+	++iter->levels_num;
+
+	iter->levels = calloc(iter->levels_num, sizeof(*iter->levels));
+	if (! iter->levels) {
+		sdb_object_deref(SDB_OBJ(iter->expr));
+		free(iter);
+		return NULL;
+	}
+	for (e = iter->expr, i = 0; i < iter->levels_num; e = e->left, ++i) {
+		/* constants and fields are handled by the iterator itself */
+		if ((! e->type) || (e->type == FIELD_VALUE))
+			continue;
+		/* a typed expression which is not resolved at runtime refers to
+		 * child objects of that type, see iterate() */
+		if (! compile_value_prog(e->type == TYPED_EXPR ? e->left : e,
+					iter->levels + i)) {
+			for (i = 0; i < iter->levels_num; ++i)
+				prog_free(iter->levels + i);
+			free(iter->levels);
+			sdb_object_deref(SDB_OBJ(iter->expr));
+			free(iter);
+			return NULL;
+		}
+	}
+	return iter;
+} /* compile_iter */
+
+static void
+compile_matcher(compiler_t *c, sdb_memstore_matcher_t *m)
+{
+	size_t jmp;
+
+	if (! m) {
+		c->failed = 1;
+		return;
+	}
+
+	switch (m->type) {
+		case MATCHER_OR:
+		case MATCHER_AND:
+			compile_matcher(c, OP_M(m)->left);
+			jmp = emit(c, m->type == MATCHER_AND ? OP_JMP_FALSE : OP_JMP_TRUE,
+					0, NULL);
+			compile_matcher(c, OP_M(m)->right);
+			if (! c->failed)
+				c->prog.code[jmp].arg = (int)c->prog.len;
+			break;
+
+		case MATCHER_NOT:
+			compile_matcher(c, UOP_M(m)->op);
+			emit(c, OP_NOT, 0, NULL);
+			break;
+
+		case MATCHER_ANY:
+		case MATCHER_ALL:
+			{
+				size_t i;
+				compile_expr(c, CMP_M(ITER_M(m)->m)->right);
+				i = emit(c, OP_ITER, 0, NULL);
+				if (c->failed)
+					break;
+				if (! (c->prog.code[i].iter = compile_iter(m)))
+					c->failed = 1;
+				--c->depth;
+			}
+			break;
+
+		case MATCHER_IN:
+			compile_expr(c, CMP_M(m)->left);
+			compile_expr(c, CMP_M(m)->right);
+			emit(c, OP_IN, 0, NULL);
+			c->depth -= 2;
+			break;
+
+		case MATCHER_ISNULL:
+		case MATCHER_ISTRUE:
+		case MATCHER_ISFALSE:
+			compile_expr(c, UNARY_M(m)->expr);
+			emit(c, OP_UNARY, m->type, NULL);
+			--c->depth;
+			break;
+
+		case MATCHER_LT:
+		case MATCHER_LE:
+		case MATCHER_EQ:
+		case MATCHER_NE:
+		case MATCHER_GE:
+		case MATCHER_GT:
+			{
+				size_t i;
+				compile_expr(c, CMP_M(m)->left);
+				compile_expr(c, CMP_M(m)->right);
+				i = emit(c, OP_CMP, m->type, NULL);
+				if (! c->failed)
+					c->prog.code[i].strcmp_fallback
+						= (CMP_M(m)->left->data_type < 0)
+							|| (CMP_M(m)->right->data_type < 0);
+				c->depth -= 2;
+			}
+			break;
+
+		case MATCHER_REGEX:
+		case MATCHER_NREGEX:
+			compile_expr(c, CMP_M(m)->left);
+			compile_expr(c, CMP_M(m)->right);
+			emit(c, OP_REGEX, m->type, NULL);
+			c->depth -= 2;
+			break;
+
+		default:
+			sdb_log(SDB_LOG_ERR, "memstore: Cannot compile matcher of "
+					"type %s", MATCHER_SYM(m->type));
+			c->failed = 1;
+	}
+} /* compile_matcher */
+
+static void
+prog_free(prog_t *p)
+{
+	size_t i;
+
+	for (i = 0; i < p->len; ++i) {
+		iter_t *iter = p->code[i].iter;
+		size_t j;
+
+		if (! iter)
+			continue;
+		for (j = 0; j < iter->levels_num; ++j)
+			prog_free(iter->levels + j);
+		free(iter->levels);
+		sdb_object_deref(SDB_OBJ(iter->expr));
+		free(iter);
+	}
+	free(p->code);
+	p->code = NULL;
+	p->len = 0;
+} /* prog_free */
+
+/* Compile an expression into a program which leaves its value on the
+ * stack. */
+static int
+compile_value_prog(sdb_memstore_expr_t *e, prog_t *p)
+{
+	compiler_t c;
+
+	memset(&c, 0, sizeof(c));
+	compile_expr(&c, e);
+	if (c.failed) {
+		prog_free(&c.prog);
+		return 0;
+	}
+	*p = c.prog;
+	return 1;
+} /* compile_value_prog */
+
+/*
+ * virtual machine
+ */
+
+static void
+value_free(value_t *v)
+{
+	if (v->owned)
+		sdb_data_free_datum(&v->tmp);
+	v->owned = 0;
+} /* value_free */
+
+static void
+value_move(value_t *dst, value_t *src)
+{
+	*dst = *src;
+	if (src->v == &src->tmp)
+		dst->v = &dst->tmp;
+} /* value_move */
+
+static void
+load_field(vm_t *vm, int field, value_t *v)
+{
+	sdb_memstore_obj_t *obj = vm->obj;
+
+	v->tmp.type = SDB_TYPE_NULL;
+	v->v = &v->tmp;
+	if (! obj) {
+		v->err = 1;
+		return;
+	}
+
+	switch (field) {
+		case SDB_FIELD_NAME:
+			/* the name of an object never changes */
+			v->tmp.type = SDB_TYPE_STRING;
+			v->tmp.data.string = SDB_OBJ(obj)->name;
+			break;
+		case SDB_FIELD_VALUE:
+			if (obj->type != SDB_ATTRIBUTE)
+				v->err = 1;
+			else
+				v->v = &ATTR(obj)->value;
+			break;
+		case SDB_FIELD_BACKEND:
+			if (sdb_memstore_get_field(obj, field, &v->tmp))
+				v->err = 1;
+			else
+				v->owned = 1;
+			break;
+		default:
+			if (sdb_memstore_get_field(obj, field, &v->tmp))
+				v->err = 1;
+	}
+} /* load_field */
+
+static void
+load_attr(vm_t *vm, const char *name, value_t *v)
+{
+	sdb_memstore_obj_t *obj = vm->obj;
+	sdb_memstore_obj_t *attr;
+
+	v->v = &v->tmp;
+	if (! obj) {
+		v->err = 1;
+		return;
+	}
+
+	/* attribute does not exist => NULL */
+	v->tmp.type = SDB_TYPE_STRING;
+	v->tmp.data.string = NULL;
+
+	attr = STORE_OBJ(sdb_avltree_lookup(
+				obj->type == SDB_HOST ? HOST(obj)->attributes
+				: obj->type == SDB_SERVICE ? SVC(obj)->attributes
+				: obj->type == SDB_METRIC ? METRIC(obj)->attributes
+				: NULL, name));
+	if (! attr)
+		return;
+	/* the attribute remains valid while the host is locked */
+	if (sdb_memstore_visible(vm->filter, attr))
+		v->v = &ATTR(attr)->value;
+	sdb_object_deref(SDB_OBJ(attr));
+} /* load_attr */
+
+static void
+typed_begin(vm_t *vm, int type)
+{
+	ctx_t *ctx = vm->ctx + vm->ctx_sp++;
+	sdb_memstore_obj_t *obj = vm->obj;
+
+	ctx->obj = obj;
+	ctx->invalid = 0;
+
+	if (! obj)
+		ctx->invalid = 1;
+	else if (type != obj->type) {
+		/* we support self-references and { service, metric } -> host */
+		if ((type != SDB_HOST)
+				|| ((obj->type != SDB_SERVICE) && (obj->type != SDB_METRIC)))
+			ctx->invalid = 1;
+		else
+			obj = obj->parent;
+	}
+
+	if (ctx->invalid)
+		obj = NULL;
+	else if (! sdb_memstore_visible(vm->filter, obj))
+		obj = NULL; /* this object does not exist */
+	vm->obj = obj;
+} /* typed_begin */
+
+static void
+typed_end(vm_t *vm)
+{
+	ctx_t *ctx = vm->ctx + --vm->ctx_sp;
+	value_t *v = vm->stack + vm->sp - 1;
+
+	if (ctx->invalid) {
+		value_free(v);
+		v->err = 1;
+	}
+	vm->obj = ctx->obj;
+} /* typed_end */
+
+static void
+arith(vm_t *vm, int op)
+{
+	value_t *v1 = vm->stack + vm->sp - 2;
+	value_t *v2 = vm->stack + vm->sp - 1;
+	sdb_data_t res = SDB_DATA_INIT;
+	bool err;
+
+	err = v1->err || v2->err || sdb_data_expr_eval(op, v1->v, v2->v, &res);
+
+	value_free(v1);
+	value_free(v2);
+	--vm->sp;
+
+	v1->tmp = res;
+	v1->v = &v1->tmp;
+	v1->owned = ! err;
+	v1->err = err;
+} /* arith */
+
+/* see match_cmp_value */
+static int
+cmp_values(int op, const sdb_data_t *v1, const sdb_data_t *v2,
+		bool strcmp_fallback)
+{
+	int status;
+
+	if (sdb_data_isnull(v1) || (sdb_data_isnull(v2)))
+		return 0;
+	else if (v1->type == v2->type)
+		status = sdb_data_cmp(v1, v2);
+	else if (! strcmp_fallback)
+		return 0;
+	else
+		status = sdb_data_strcmp(v1, v2);
+
+	if (status == INT_MAX)
+		return 0;
+	switch (op) {
+		case MATCHER_LT: return status < 0;
+		case MATCHER_LE: return status <= 0;
+		case MATCHER_EQ: return status == 0;
+		case MATCHER_NE: return status != 0;
+		case MATCHER_GE: return status >= 0;
+		case MATCHER_GT: return status > 0;
+	}
+	return 0;
+} /* cmp_values */
+
+/* see match_regex_value */
+static int
+regex_values(int op, const sdb_data_t *v, const sdb_data_t *re)
+{
+	sdb_data_t tmp = SDB_DATA_INIT;
+	const regex_t *regex;
+	int status = 0;
+
+	if (sdb_data_isnull(v) || sdb_data_isnull(re))
+		return 0;
+
+	if (re->type == SDB_TYPE_STRING) {
+		if (sdb_data_parse(re->data.string, SDB_TYPE_REGEX, &tmp))
+			return 0;
+		regex = &tmp.data.re.regex;
+	}
+	else if (re->type == SDB_TYPE_REGEX)
+		regex = &re->data.re.regex;
+	else
+		return 0;
+
+	if (v->type == SDB_TYPE_STRING)
+		status = ! regexec(regex, v->data.string, 0, NULL, 0);
+	else {
+		char value[sdb_data_strlen(v) + 1];
+		if (sdb_data_format(v, value, sizeof(value), SDB_UNQUOTED))
+			status = ! regexec(regex, value, 0, NULL, 0);
+	}
+
+	sdb_data_free_datum(&tmp);
+	if (op == MATCHER_NREGEX)
+		return !status;
+	return status;
+} /* regex_values */
+
+static int
+iter_cmp(iter_t *iter, const sdb_data_t *v, const value_t *right)
+{
+	if (right->err)
+		return 0;
+	if ((iter->op == MATCHER_REGEX) || (iter->op == MATCHER_NREGEX))
+		return regex_values(iter->op, v, right->v);
+	return cmp_values(iter->op, v, right->v, iter->strcmp_fallback);
+} /* iter_cmp */
+
+static void
+run(const prog_t *p, vm_t *vm);
+
+/* Evaluate a value program for the specified object. */
+static void
+run_value(const prog_t *p, sdb_memstore_obj_t *obj,
+		sdb_memstore_matcher_t *filter, value_t *res)
+{
+	value_t stack[p->stack_size + 1];
+	ctx_t ctx[p->ctx_size + 1];
+	vm_t vm = { filter, stack, 0, ctx, 0, obj, 0 };
+
+	run(p, &vm);
+	assert(vm.sp == 1);
+	value_move(res, stack);
+} /* run_value */
+
+/* Update the ANY/ALL status with the result of comparing the next element;
+ * returns false once the status is final. */
+static bool
+iter_update(iter_t *iter, int *status, int matches)
+{
+	if (matches && (! iter->all)) {
+		*status = 1;
+		return 0;
+	}
+	else if ((! matches) && iter->all) {
+		*status = 0;
+		return 0;
+	}
+	return 1;
+} /* iter_update */
+
+/* see match_iter and sdb_memstore_expr_iter */
+static int
+iterate(vm_t *vm, iter_t *iter, const value_t *right)
+{
+	const sdb_data_t null = SDB_DATA_INIT;
+	sdb_memstore_obj_t *obj = vm->obj;
+	sdb_memstore_expr_t *e = iter->expr;
+	const prog_t *p;
+	size_t level = 0;
+	int status = iter->all;
+
+	while (obj && (e->type == TYPED_EXPR)) {
+		int type = (int)e->data.data.integer;
+
+		if (obj->type == type) {
+			/* self reference */
+		}
+		else if ((type == SDB_HOST)
+				&& ((obj->type == SDB_SERVICE) || (obj->type == SDB_METRIC))) {
+			/* reference to parent host */
+			obj = obj->parent;
+		}
+		else
+			break;
+		e = e->left;
+		++level;
+	}
+	p = iter->levels + level;
+
+	if (! obj) {
+		/* invalid iterator */
+	}
+	else if (e->type == TYPED_EXPR) {
+		int type = (int)e->data.data.integer;
+		sdb_avltree_t *tree = NULL;
+		sdb_avltree_iter_t *children;
+
+		if ((obj->type == SDB_HOST) && (type == SDB_SERVICE))
+			tree = HOST(obj)->services;
+		else if ((obj->type == SDB_HOST) && (type == SDB_METRIC))
+			tree = HOST(obj)->metrics;
+		else if ((obj->type == SDB_HOST) && (type == SDB_ATTRIBUTE))
+			tree = HOST(obj)->attributes;
+		else if ((obj->type == SDB_SERVICE) && (type == SDB_ATTRIBUTE))
+			tree = SVC(obj)->attributes;
+		else if ((obj->type == SDB_METRIC) && (type == SDB_ATTRIBUTE))
+			tree = METRIC(obj)->attributes;
+
+		if ((children = sdb_avltree_get_iter(tree))) {
+			while (sdb_avltree_iter_has_next(children)) {
+				sdb_memstore_obj_t *child;
+				value_t v;
+				bool cont;
+
+				child = STORE_OBJ(sdb_avltree_iter_get_next(children));
+				if (! sdb_memstore_visible(vm->filter, child))
+					continue;
+
+				/* elements that cannot be evaluated are NULL */
+				run_value(p, child, vm->filter, &v);
+				cont = iter_update(iter, &status,
+						iter_cmp(iter, v.err ? &null : v.v, right));
+				value_free(&v);
+				if (! cont)
+					break;
+			}
+			sdb_avltree_iter_destroy(children);
+			return status;
+		}
+	}
+	else if (e->type == FIELD_VALUE) {
+		if (e->data.data.integer == SDB_FIELD_BACKEND) {
+			const char *names[BACKENDS_MAX];
+			size_t names_num = sdb_memstore_backend_names(names);
+			size_t i;
+
+			/* backends are stored as a bitmap */
+			for (i = 0; i < names_num; ++i) {
+				sdb_data_t v = { SDB_TYPE_STRING, { .string = NULL } };
+
+				if (! (obj->backends & ((uint64_t)1 << i)))
+					continue;
+				/* the comparison does not modify the value */
+				memcpy(&v.data.string, names + i, sizeof(v.data.string));
+				if (! iter_update(iter, &status, iter_cmp(iter, &v, right)))
+					break;
+			}
+			return status;
+		}
+	}
+	else {
+		value_t array = { &e->data, SDB_DATA_INIT, 0, 0 };
+		size_t i;
+
+		if (e->type)
+			run_value(p, obj, vm->filter, &array);
+
+		if ((! array.err) && (array.v->type & SDB_TYPE_ARRAY)) {
+			for (i = 0; i < array.v->data.array.length; ++i) {
+				sdb_data_t v = SDB_DATA_INIT;
+
+				sdb_data_array_get(array.v, i, &v);
+				if (! iter_update(iter, &status, iter_cmp(iter, &v, right)))
+					break;
+			}
+			value_free(&array);
+			return status;
+		}
+		value_free(&array);
+	}
+
+	sdb_log(SDB_LOG_WARNING, "memstore: Invalid iterator");
+	return 0;
+} /* iterate */
+
+static void
+run(const prog_t *p, vm_t *vm)
+{
+	size_t pc = 0;
+
+	while (pc < p->len) {
+		const instr_t *i = p->code + pc++;
+		value_t *v = vm->stack + vm->sp;
+
+		switch (i->op) {
+			case OP_CONST:
+				v->v = i->value;
+				v->owned = v->err = 0;
+				++vm->sp;
+				break;
+			case OP_FIELD:
+				v->owned = v->err = 0;
+				load_field(vm, i->arg, v);
+				++vm->sp;
+				break;
+			case OP_ATTR:
+				v->owned = v->err = 0;
+				load_attr(vm, i->value->data.string, v);
+				++vm->sp;
+				break;
+			case OP_ARITH:
+				arith(vm, i->arg);
+				break;
+			case OP_TYPED_BEGIN:
+				typed_begin(vm, i->arg);
+				break;
+			case OP_TYPED_END:
+				typed_end(vm);
+				break;
+
+			case OP_CMP:
+			case OP_IN:
+			case OP_REGEX:
+				v -= 2;
+				if (v[0].err || v[1].err)
+					vm->res = 0;
+				else if (i->op == OP_CMP)
+					vm->res = cmp_values(i->arg, v[0].v, v[1].v,
+							i->strcmp_fallback);
+				else if (i->op == OP_IN)
+					vm->res = sdb_data_inarray(v[0].v, v[1].v);
+				else
+					vm->res = regex_values(i->arg, v[0].v, v[1].v);
+				value_free(v);
+				value_free(v + 1);
+				vm->sp -= 2;
+				break;
+			case OP_UNARY:
+				--v;
+				/* see match_unary: errors are treated as a match */
+				if (v->err)
+					vm->res = 1;
+				else if (i->arg == MATCHER_ISNULL)
+					vm->res = sdb_data_isnull(v->v);
+				else
+					vm->res = (v->v->type == SDB_TYPE_BOOLEAN)
+						&& (v->v->data.boolean == (i->arg == MATCHER_ISTRUE));
+				value_free(v);
+				--vm->sp;
+				break;
+			case OP_ITER:
+				--v;
+				vm->res = iterate(vm, i->iter, v);
+				value_free(v);
+				--vm->sp;
+				break;
+			case OP_NOT:
+				vm->res = ! vm->res;
+				break;
+			case OP_JMP_FALSE:
+				if (! vm->res)
+					pc = (size_t)i->arg;
+				break;
+			case OP_JMP_TRUE:
+				if (vm->res)
+					pc = (size_t)i->arg;
+				break;
+		}
+	}
+} /* run */
+
+/*
+ * matcher type
+ */
+
+static int
+prog_matcher_init(sdb_object_t *obj, va_list ap)
+{
+	sdb_memstore_matcher_t *m = va_arg(ap, sdb_memstore_matcher_t *);
+	compiler_t c;
+
+	M(obj)->type = MATCHER_PROG;
+
+	memset(&c, 0, sizeof(c));
+	compile_matcher(&c, m);
+	if (c.failed) {
+		prog_free(&c.prog);
+		return -1;
+	}
+	assert(c.depth == 0);
+
+	PROG_M(obj)->prog = c.prog;
+	PROG_M(obj)->orig = m;
+	sdb_object_ref(SDB_OBJ(m));
+	return 0;
+} /* prog_matcher_init */
+
+static void
+prog_matcher_destroy(sdb_object_t *obj)
+{
+	prog_free(&PROG_M(obj)->prog);
+	sdb_object_deref(SDB_OBJ(PROG_M(obj)->orig));
+} /* prog_matcher_destroy */
+
+static sdb_type_t prog_type = {
+	/* size = */ sizeof(prog_matcher_t),
+	/* init = */ prog_matcher_init,
+	/* destroy = */ prog_matcher_destroy,
+};
+
+/*
+ * private API
+ */
+
+int
+sdb_memstore_prog_matches(sdb_memstore_matcher_t *m, sdb_memstore_obj_t *obj,
+		sdb_memstore_matcher_t *filter)
+{
+	const prog_t *p = &PROG_M(m)->prog;
+	value_t stack[p->stack_size + 1];
+	ctx_t ctx[p->ctx_size + 1];
+	vm_t vm = { filter, stack, 0, ctx, 0, obj, 0 };
+
+	assert(m->type == MATCHER_PROG);
+	run(p, &vm);
+	assert(vm.sp == 0);
+	return vm.res;
+} /* sdb_memstore_prog_matches */
+
+sdb_memstore_matcher_t *
+sdb_memstore_prog_source(sdb_memstore_matcher_t *m)
+{
+	assert(m->type == MATCHER_PROG);
+	return PROG_M(m)->orig;
+} /* sdb_memstore_prog_source */
+
+/*
+ * public API
+ */
+
+sdb_memstore_matcher_t *
+sdb_memstore_matcher_compile(sdb_memstore_matcher_t *m)
+{
+	if (! m)
+		return NULL;
+	if (m->type == MATCHER_PROG) {
+		sdb_object_ref(SDB_OBJ(m));
+		return m;
+	}
+	return M(sdb_object_create("prog-matcher", prog_type, m));
+} /* sdb_memstore_matcher_compile */
+
+/* vim: set tw=78 sw=4 ts=4 noexpandtab : */
@@ -31,6 +31,9 @@
 #include "utils/error.h"
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 
 static sdb_memstore_matcher_t *
 node_to_matcher(sdb_ast_node_t *n);
@@ -270,6 +273,659 @@ node_to_matcher(sdb_ast_node_t *n)
 	return NULL;
 } /* node_to_matcher */
 
+/*
+ * optimizer
+ */
+
+/* An optimized matcher along with the estimated cost of evaluating it for a
+ * single object and the estimated probability that it matches. */
+typedef struct {
+	sdb_memstore_matcher_t *m;
+	double cost;
+	double p;
+	int value; /* the result of constant matchers; -1 else */
+} plan_t;
+
+static plan_t
+optimize(sdb_memstore_matcher_t *m);
+
+static double
+expr_cost(sdb_memstore_expr_t *e)
+{
+	if ((! e) || (! e->type))
+		return 0.0;
+	if (e->type == FIELD_VALUE)
+		return 1.0;
+	if (e->type == ATTR_VALUE)
+		return 4.0; /* lookup in the tree of attributes */
+	if (e->type == TYPED_EXPR)
+		return 2.0 + expr_cost(e->left);
+	return 1.0 + expr_cost(e->left) + expr_cost(e->right);
+} /* expr_cost */
+
+static bool
+matcher_is_const(sdb_memstore_matcher_t *m)
+{
+	switch (m->type) {
+	case MATCHER_NOT:
+		return matcher_is_const(UOP_M(m)->op);
+	case MATCHER_IN:
+	case MATCHER_LT:
+	case MATCHER_LE:
+	case MATCHER_EQ:
+	case MATCHER_NE:
+	case MATCHER_GE:
+	case MATCHER_GT:
+	case MATCHER_REGEX:
+	case MATCHER_NREGEX:
+		return (! CMP_M(m)->left->type) && (! CMP_M(m)->right->type);
+	case MATCHER_ISNULL:
+	case MATCHER_ISTRUE:
+	case MATCHER_ISFALSE:
+		return ! UNARY_M(m)->expr->type;
+	}
+	return 0;
+} /* matcher_is_const */
+
+/* Estimate the cost and selectivity of a comparison (or another matcher not
+ * composed of other matchers) and evaluate it if it is constant. */
+static plan_t
+optimize_leaf(sdb_memstore_matcher_t *m)
+{
+	plan_t plan = { m, 1.0, 0.5, -1 };
+
+	switch (m->type) {
+	case MATCHER_ANY:
+	case MATCHER_ALL:
+		/* the right hand side is compared to each element */
+		plan.cost = 8.0 + expr_cost(ITER_M(m)->iter)
+			+ 4.0 * (1.0 + expr_cost(CMP_M(ITER_M(m)->m)->right));
+		plan.p = m->type == MATCHER_ANY ? 0.25 : 0.5;
+		break;
+	case MATCHER_IN:
+		plan.cost = 2.0 + expr_cost(CMP_M(m)->left)
+			+ expr_cost(CMP_M(m)->right);
+		plan.p = 0.2;
+		break;
+	case MATCHER_LT:
+	case MATCHER_LE:
+	case MATCHER_EQ:
+	case MATCHER_NE:
+	case MATCHER_GE:
+	case MATCHER_GT:
+		plan.cost = 1.0 + expr_cost(CMP_M(m)->left)
+			+ expr_cost(CMP_M(m)->right);
+		plan.p = m->type == MATCHER_EQ ? 0.1
+			: m->type == MATCHER_NE ? 0.9 : 0.33;
+		break;
+	case MATCHER_REGEX:
+	case MATCHER_NREGEX:
+		plan.cost = 10.0 + expr_cost(CMP_M(m)->left)
+			+ expr_cost(CMP_M(m)->right);
+		plan.p = m->type == MATCHER_REGEX ? 0.25 : 0.75;
+		break;
+	case MATCHER_ISNULL:
+	case MATCHER_ISTRUE:
+	case MATCHER_ISFALSE:
+		plan.cost = 1.0 + expr_cost(UNARY_M(m)->expr);
+		plan.p = m->type == MATCHER_ISNULL ? 0.1 : 0.5;
+		break;
+	}
+
+	if (matcher_is_const(m)) {
+		/* constant matchers do not access the object */
+		sdb_memstore_obj_t obj;
+
+		memset(&obj, 0, sizeof(obj));
+		plan.value = sdb_memstore_matcher_matches(m, &obj, NULL) != 0;
+		plan.p = plan.value;
+	}
+	sdb_object_ref(SDB_OBJ(m));
+	return plan;
+} /* optimize_leaf */
+
+static plan_t
+optimize_not(sdb_memstore_matcher_t *m)
+{
+	plan_t plan;
+
+	/* NOT NOT x => x */
+	if (UOP_M(m)->op->type == MATCHER_NOT)
+		return optimize(UOP_M(UOP_M(m)->op)->op);
+
+	plan = optimize(UOP_M(m)->op);
+	if (! plan.m)
+		return plan;
+	m = sdb_memstore_inv_matcher(plan.m);
+	sdb_object_deref(SDB_OBJ(plan.m));
+	plan.m = m;
+	plan.p = 1.0 - plan.p;
+	if (plan.value >= 0)
+		plan.value = ! plan.value;
+	return plan;
+} /* optimize_not */
+
+static size_t
+chain_len(sdb_memstore_matcher_t *m, int type)
+{
+	if (m->type != type)
+		return 1;
+	return chain_len(OP_M(m)->left, type) + chain_len(OP_M(m)->right, type);
+} /* chain_len */
+
+/* Optimize all operands of a chain of ANDs or ORs. */
+static int
+chain_optimize(sdb_memstore_matcher_t *m, int type, plan_t *plans, size_t *n)
+{
+	if (m->type == type) {
+		if (chain_optimize(OP_M(m)->left, type, plans, n))
+			return -1;
+		return chain_optimize(OP_M(m)->right, type, plans, n);
+	}
+
+	plans[*n] = optimize(m);
+	if (! plans[*n].m)
+		return -1;
+	++(*n);
+	return 0;
+} /* chain_optimize */
+
+/* The rank by which operands are ordered: operands which are cheap or likely
+ * to decide about the result on their own are evaluated first. */
+static double
+chain_rank(const plan_t *plan, int type)
+{
+	double p = type == MATCHER_AND ? 1.0 - plan->p : plan->p;
+	return plan->cost / (p > 0.01 ? p : 0.01);
+} /* chain_rank */
+
+/*
+ * Optimize a chain of ANDs or ORs: the operands are flattened, constant
+ * operands are folded, and the remaining ones are reordered such that the
+ * expected cost of short-circuit evaluation is minimized. 'plans' provides
+ * space for the plans of all operands.
+ */
+static plan_t
+chain_plan(sdb_memstore_matcher_t *m, plan_t *plans)
+{
+	int type = m->type;
+	/* the value deciding about the chain's result on its own */
+	int decisive = type == MATCHER_OR;
+	plan_t plan = { NULL, 0.0, 1.0, -1 };
+	size_t n = 0, i, j;
+
+	if (chain_optimize(m, type, plans, &n)) {
+		for (i = 0; i < n; ++i)
+			sdb_object_deref(SDB_OBJ(plans[i].m));
+		return plan;
+	}
+
+	/* fold constant operands */
+	for (i = 0, j = 0; i < n; ++i) {
+		if (plans[i].value == decisive) {
+			plan = plans[i];
+			for (j = 0; j < n; ++j)
+				if (j != i)
+					sdb_object_deref(SDB_OBJ(plans[j].m));
+			return plan;
+		}
+		if ((plans[i].value >= 0) && ((j > 0) || (i + 1 < n))) {
+			/* keep it only if all operands are constant */
+			sdb_object_deref(SDB_OBJ(plans[i].m));
+			continue;
+		}
+		plans[j++] = plans[i];
+	}
+	n = j;
+
+	/* stable insertion sort by rank */
+	for (i = 1; i < n; ++i) {
+		plan_t tmp = plans[i];
+		double rank = chain_rank(&tmp, type);
+
+		for (j = i; (j > 0) && (chain_rank(plans + j - 1, type) > rank); --j)
+			plans[j] = plans[j - 1];
+		plans[j] = tmp;
+	}
+
+	plan = plans[0];
+	for (i = 1; i < n; ++i) {
+		/* the next operand is evaluated only if the previous ones did not
+		 * decide about the result yet */
+		double p_cont = type == MATCHER_AND ? plan.p : 1.0 - plan.p;
+		sdb_memstore_matcher_t *tmp;
+
+		if (type == MATCHER_AND)
+			tmp = sdb_memstore_con_matcher(plan.m, plans[i].m);
+		else
+			tmp = sdb_memstore_dis_matcher(plan.m, plans[i].m);
+		sdb_object_deref(SDB_OBJ(plan.m));
+		sdb_object_deref(SDB_OBJ(plans[i].m));
+		plan.m = tmp;
+		if (! tmp) {
+			for (j = i + 1; j < n; ++j)
+				sdb_object_deref(SDB_OBJ(plans[j].m));
+			return plan;
+		}
+
+		plan.cost += p_cont * plans[i].cost;
+		if (type == MATCHER_AND)
+			plan.p *= plans[i].p;
+		else
+			plan.p = 1.0 - (1.0 - plan.p) * (1.0 - plans[i].p);
+		plan.value = -1;
+	}
+	return plan;
+} /* chain_plan */
+
+static plan_t
+optimize_chain(sdb_memstore_matcher_t *m)
+{
+	plan_t *plans, plan = { NULL, 0.0, 1.0, -1 };
+
+	plans = malloc(chain_len(m, m->type) * sizeof(*plans));
+	if (! plans)
+		return plan;
+	plan = chain_plan(m, plans);
+	free(plans);
+	return plan;
+} /* optimize_chain */
+
+/* Returns an optimized matcher equivalent to 'm'. */
+static plan_t
+optimize(sdb_memstore_matcher_t *m)
+{
+	if ((m->type == MATCHER_AND) || (m->type == MATCHER_OR))
+		return optimize_chain(m);
+	if (m->type == MATCHER_NOT)
+		return optimize_not(m);
+	return optimize_leaf(m);
+} /* optimize */
+
+/* Build a matcher, optimize it, and compile it for repeated evaluation. */
+static sdb_memstore_matcher_t *
+prepare_matcher(sdb_ast_node_t *n)
+{
+	sdb_memstore_matcher_t *m, *prog;
+	plan_t plan;
+
+	m = node_to_matcher(n);
+	if (! m)
+		return NULL;
+	plan = optimize(m);
+	sdb_object_deref(SDB_OBJ(m));
+	if (! plan.m)
+		return NULL;
+	prog = sdb_memstore_matcher_compile(plan.m);
+	sdb_object_deref(SDB_OBJ(plan.m));
+	return prog;
+} /* prepare_matcher */
+
+/*
+ * index predicates
+ */
+
+/* Determine the type of the object owning the attribute referenced by 'n'
+ * when evaluated against objects of type 'type'. */
+static int
+index_attr(sdb_ast_node_t *n, int type, const char **key)
+{
+	if (n->type == SDB_AST_TYPE_TYPED) {
+		type = SDB_AST_TYPED(n)->type;
+		n = SDB_AST_TYPED(n)->expr;
+	}
+	if ((n->type != SDB_AST_TYPE_VALUE)
+			|| (SDB_AST_VALUE(n)->type != SDB_ATTRIBUTE))
+		return -1;
+	*key = SDB_AST_VALUE(n)->name;
+	return type;
+} /* index_attr */
+
+/* Values which are equal to some other value if and only if their folded
+ * string representations are equal; this excludes decimal values which are
+ * compared numerically. */
+static bool
+index_value(const sdb_data_t *v, bool in)
+{
+	int type = v->type;
+
+	if (in) {
+		if (! (type & SDB_TYPE_ARRAY))
+			return 0;
+		type &= 0xff;
+	}
+	else if (type & SDB_TYPE_ARRAY)
+		return 0;
+	return (type == SDB_TYPE_BOOLEAN) || (type == SDB_TYPE_INTEGER)
+		|| (type == SDB_TYPE_STRING) || (type == SDB_TYPE_DATETIME);
+} /* index_value */
+
+/* Collect the predicates of the form 'attribute[key] = <const>' or
+ * 'attribute[key] IN <const array>' which have to be satisfied by all objects
+ * matching the matcher 'n'. */
+static void
+index_preds(sdb_memstore_query_t *q, sdb_ast_node_t *n, int type)
+{
+	sdb_memstore_index_pred_t pred = SDB_MEMSTORE_INDEX_PRED_INIT;
+	sdb_ast_node_t *attr, *value;
+
+	if ((n->type != SDB_AST_TYPE_OPERATOR)
+			|| (q->index_num >= SDB_STATIC_ARRAY_LEN(q->index)))
+		return;
+
+	if (SDB_AST_OP(n)->kind == SDB_AST_AND) {
+		index_preds(q, SDB_AST_OP(n)->left, type);
+		index_preds(q, SDB_AST_OP(n)->right, type);
+		return;
+	}
+	if ((SDB_AST_OP(n)->kind != SDB_AST_EQ)
+			&& (SDB_AST_OP(n)->kind != SDB_AST_IN))
+		return;
+
+	attr = SDB_AST_OP(n)->left;
+	value = SDB_AST_OP(n)->right;
+	if ((SDB_AST_OP(n)->kind == SDB_AST_EQ)
+			&& (attr->type == SDB_AST_TYPE_CONST)) {
+		/* equality is symmetric */
+		attr = SDB_AST_OP(n)->right;
+		value = SDB_AST_OP(n)->left;
+	}
+
+	pred.in = SDB_AST_OP(n)->kind == SDB_AST_IN;
+	if ((value->type != SDB_AST_TYPE_CONST)
+			|| (! index_value(&SDB_AST_CONST(value)->value, pred.in)))
+		return;
+	if ((pred.type = index_attr(attr, type, &pred.key)) < 0)
+		return;
+	pred.value = &SDB_AST_CONST(value)->value;
+	q->index[q->index_num++] = pred;
+} /* index_preds */
+
+/* Intersect the range [*min, *max] with the range of values satisfying
+ * '<value> op t'. */
+static void
+time_bound(int op, sdb_time_t t, sdb_time_t *min, sdb_time_t *max)
+{
+	sdb_time_t lo = 0, hi = UINT64_MAX;
+
+	/* strict bounds of 0 and UINT64_MAX leave an empty range */
+	if (op == SDB_AST_LT) {
+		lo = t ? 0 : 1;
+		hi = t ? t - 1 : 0;
+	}
+	else if (op == SDB_AST_LE)
+		hi = t;
+	else if (op == SDB_AST_EQ)
+		lo = hi = t;
+	else if (op == SDB_AST_GE)
+		lo = t;
+	else if (op == SDB_AST_GT) {
+		lo = t < UINT64_MAX ? t + 1 : 1;
+		hi = t < UINT64_MAX ? UINT64_MAX : 0;
+	}
+
+	if (lo > *min)
+		*min = lo;
+	if (hi < *max)
+		*max = hi;
+} /* time_bound */
+
+/* Collect the range predicates on the last update or the age of objects of
+ * one type which have to be satisfied by all objects matching the matcher
+ * 'n'. */
+static void
+time_preds(sdb_memstore_query_t *q, sdb_ast_node_t *n, int type)
+{
+	sdb_ast_node_t *field, *value;
+	int op;
+
+	if (n->type != SDB_AST_TYPE_OPERATOR)
+		return;
+
+	op = SDB_AST_OP(n)->kind;
+	if (op == SDB_AST_AND) {
+		time_preds(q, SDB_AST_OP(n)->left, type);
+		time_preds(q, SDB_AST_OP(n)->right, type);
+		return;
+	}
+	if ((op != SDB_AST_LT) && (op != SDB_AST_LE) && (op != SDB_AST_EQ)
+			&& (op != SDB_AST_GE) && (op != SDB_AST_GT))
+		return;
+
+	field = SDB_AST_OP(n)->left;
+	value = SDB_AST_OP(n)->right;
+	if (field->type == SDB_AST_TYPE_CONST) {
+		/* e.g., '<const> < <field>' is the same as '<field> > <const>' */
+		field = SDB_AST_OP(n)->right;
+		value = SDB_AST_OP(n)->left;
+		if ((op == SDB_AST_LT) || (op == SDB_AST_GT))
+			op = op == SDB_AST_LT ? SDB_AST_GT : SDB_AST_LT;
+		else if ((op == SDB_AST_LE) || (op == SDB_AST_GE))
+			op = op == SDB_AST_LE ? SDB_AST_GE : SDB_AST_LE;
+	}
+
+	if (field->type == SDB_AST_TYPE_TYPED) {
+		type = SDB_AST_TYPED(field)->type;
+		field = SDB_AST_TYPED(field)->expr;
+	}
+	/* other types of values are compared as strings */
+	if ((value->type != SDB_AST_TYPE_CONST)
+			|| (SDB_AST_CONST(value)->value.type != SDB_TYPE_DATETIME)
+			|| (field->type != SDB_AST_TYPE_VALUE))
+		return;
+	if ((SDB_AST_VALUE(field)->type != SDB_FIELD_LAST_UPDATE)
+			&& (SDB_AST_VALUE(field)->type != SDB_FIELD_AGE))
+		return;
+
+	/* only one type of objects may be looked up by time */
+	if (q->time.type && (q->time.type != type))
+		return;
+	q->time.type = type;
+	if (SDB_AST_VALUE(field)->type == SDB_FIELD_LAST_UPDATE)
+		time_bound(op, SDB_AST_CONST(value)->value.data.datetime,
+				&q->time.last_update_min, &q->time.last_update_max);
+	else
+		time_bound(op, SDB_AST_CONST(value)->value.data.datetime,
+				&q->time.age_min, &q->time.age_max);
+} /* time_preds */
+
+/*
+ * query plans
+ */
+
+static void
+explain_value(sdb_strbuf_t *buf, const sdb_data_t *v)
+{
+	char str[sdb_data_strlen(v) + 1];
+
+	sdb_data_format(v, str, sizeof(str), SDB_SINGLE_QUOTED);
+	sdb_strbuf_append(buf, "%s", str);
+} /* explain_value */
+
+static void
+explain_expr(sdb_strbuf_t *buf, sdb_memstore_expr_t *e)
+{
+	if (! e->type)
+		explain_value(buf, &e->data);
+	else if (e->type == FIELD_VALUE)
+		sdb_strbuf_append(buf, "%s",
+				SDB_FIELD_TO_NAME((int)e->data.data.integer));
+	else if (e->type == ATTR_VALUE)
+		sdb_strbuf_append(buf, "attribute['%s']", e->data.data.string);
+	else if (e->type == TYPED_EXPR) {
+		sdb_strbuf_append(buf, "%s.",
+				SDB_STORE_TYPE_TO_NAME((int)e->data.data.integer));
+		explain_expr(buf, e->left);
+	}
+	else {
+		sdb_strbuf_append(buf, "(");
+		explain_expr(buf, e->left);
+		sdb_strbuf_append(buf, " %s ", SDB_DATA_OP_TO_STRING(e->type));
+		explain_expr(buf, e->right);
+		sdb_strbuf_append(buf, ")");
+	}
+} /* explain_expr */
+
+static void
+explain_matcher(sdb_strbuf_t *buf, sdb_memstore_matcher_t *m, int parent)
+{
+	if (m->type == MATCHER_PROG)
+		m = sdb_memstore_prog_source(m);
+	if (parent < 0)
+		parent = m->type; /* no parentheses at the top level */
+
+	switch (m->type) {
+	case MATCHER_OR:
+	case MATCHER_AND:
+		/* chains of the same operator are printed without parentheses */
+		if (parent != m->type)
+			sdb_strbuf_append(buf, "(");
+		explain_matcher(buf, OP_M(m)->left, m->type);
+		sdb_strbuf_append(buf, " %s ", MATCHER_SYM(m->type));
+		explain_matcher(buf, OP_M(m)->right, m->type);
+		if (parent != m->type)
+			sdb_strbuf_append(buf, ")");
+		break;
+	case MATCHER_NOT:
+		sdb_strbuf_append(buf, "NOT ");
+		explain_matcher(buf, UOP_M(m)->op, m->type);
+		break;
+	case MATCHER_ANY:
+	case MATCHER_ALL:
+		sdb_strbuf_append(buf, "%s ", MATCHER_SYM(m->type));
+		explain_expr(buf, ITER_M(m)->iter);
+		sdb_strbuf_append(buf, " %s ", MATCHER_SYM(ITER_M(m)->m->type));
+		explain_expr(buf, CMP_M(ITER_M(m)->m)->right);
+		break;
+	case MATCHER_ISNULL:
+	case MATCHER_ISTRUE:
+	case MATCHER_ISFALSE:
+		explain_expr(buf, UNARY_M(m)->expr);
+		sdb_strbuf_append(buf, " %s", MATCHER_SYM(m->type));
+		break;
+	case MATCHER_IN:
+	case MATCHER_LT:
+	case MATCHER_LE:
+	case MATCHER_EQ:
+	case MATCHER_NE:
+	case MATCHER_GE:
+	case MATCHER_GT:
+	case MATCHER_REGEX:
+	case MATCHER_NREGEX:
+		explain_expr(buf, CMP_M(m)->left);
+		sdb_strbuf_append(buf, " %s ", MATCHER_SYM(m->type));
+		explain_expr(buf, CMP_M(m)->right);
+		break;
+	default:
+		sdb_strbuf_append(buf, "%s", MATCHER_SYM(m->type));
+	}
+} /* explain_matcher */
+
+static void
+explain_time(sdb_strbuf_t *buf, int type, const char *field, bool interval,
+		sdb_time_t min, sdb_time_t max)
+{
+	char str[64];
+
+	if (min) {
+		if (interval)
+			sdb_strfinterval(str, sizeof(str), min);
+		else
+			sdb_strftime(str, sizeof(str), min);
+		sdb_strbuf_append(buf, "\n  time: %s.%s >= %s",
+				SDB_STORE_TYPE_TO_NAME(type), field, str);
+	}
+	if (max < UINT64_MAX) {
+		if (interval)
+			sdb_strfinterval(str, sizeof(str), max);
+		else
+			sdb_strftime(str, sizeof(str), max);
+		sdb_strbuf_append(buf, "\n  time: %s.%s <= %s",
+				SDB_STORE_TYPE_TO_NAME(type), field, str);
+	}
+} /* explain_time */
+
+/* Describe the predicates which may be used to avoid a full scan. */
+static void
+explain_scan(sdb_strbuf_t *buf, sdb_memstore_query_t *q, int type)
+{
+	char prefix[64];
+	size_t i;
+
+	for (i = 0; i < q->index_num; ++i) {
+		const sdb_memstore_index_pred_t *pred = q->index + i;
+
+		sdb_strbuf_append(buf, "\n  index: %s.attribute['%s'] %s ",
+				SDB_STORE_TYPE_TO_NAME(pred->type), pred->key,
+				pred->in ? "IN" : "=");
+		explain_value(buf, pred->value);
+	}
+
+	if (q->time.type) {
+		explain_time(buf, q->time.type, "last_update", 0,
+				q->time.last_update_min, q->time.last_update_max);
+		explain_time(buf, q->time.type, "age", 1,
+				q->time.age_min, q->time.age_max);
+	}
+
+	if ((type != SDB_HOST) && sdb_memstore_matcher_prefix(q->matcher,
+				type, SDB_HOST, prefix, sizeof(prefix)))
+		sdb_strbuf_append(buf, "\n  host prefix: '%s'", prefix);
+	if (sdb_memstore_matcher_prefix(q->matcher, type, type,
+				prefix, sizeof(prefix)))
+		sdb_strbuf_append(buf, "\n  %s prefix: '%s'",
+				SDB_STORE_TYPE_TO_NAME(type), prefix);
+} /* explain_scan */
+
+/* Collect the (distinct) names of the selected attributes. */
+static int
+select_attrs(sdb_memstore_query_t *q, sdb_ast_node_t **select, size_t num)
+{
+	size_t i, j;
+
+	q->select = 1;
+	for (i = 0; i < num; ++i) {
+		const char **attrs;
+
+		if (SDB_AST_VALUE(select[i])->type != SDB_ATTRIBUTE)
+			continue;
+		for (j = 0; j < q->select_attrs_num; ++j)
+			if (! strcasecmp(q->select_attrs[j],
+						SDB_AST_VALUE(select[i])->name))
+				break;
+		if (j < q->select_attrs_num)
+			continue;
+
+		attrs = realloc(q->select_attrs,
+				(q->select_attrs_num + 1) * sizeof(*attrs));
+		if (! attrs)
+			return -1;
+		q->select_attrs = attrs;
+		q->select_attrs[q->select_attrs_num++] = SDB_AST_VALUE(select[i])->name;
+	}
+	return 0;
+} /* select_attrs */
+
+static void
+explain_select(sdb_strbuf_t *buf, sdb_ast_node_t **select, size_t num)
+{
+	size_t i;
+
+	if (! select)
+		return;
+
+	sdb_strbuf_append(buf, "\n  select: ");
+	for (i = 0; i < num; ++i) {
+		sdb_ast_value_t *v = SDB_AST_VALUE(select[i]);
+		if (i)
+			sdb_strbuf_append(buf, ", ");
+		if (v->type == SDB_ATTRIBUTE)
+			sdb_strbuf_append(buf, "attribute['%s']", v->name);
+		else
+			sdb_strbuf_append(buf, "%s", SDB_FIELD_TO_NAME(v->type));
+	}
+} /* explain_select */
+
 /*
  * query type
  */
@@ -278,10 +934,15 @@ static int
 query_init(sdb_object_t *obj, va_list ap)
 {
 	sdb_ast_node_t *ast = va_arg(ap, sdb_ast_node_t *);
-	sdb_ast_node_t *matcher = NULL, *filter = NULL;
+	sdb_ast_node_t *matcher = NULL, *filter = NULL, *order_by = NULL;
+	sdb_ast_node_t *group_by = NULL;
+	sdb_ast_node_t **select = NULL;
+	size_t select_num = 0;
+	int obj_type = 0;
 
 	QUERY(obj)->ast = ast;
 	sdb_object_ref(SDB_OBJ(ast));
+	QUERY(obj)->time = (sdb_memstore_time_pred_t)SDB_MEMSTORE_TIME_PRED_INIT;
 
 	switch (ast->type) {
 	case SDB_AST_TYPE_FETCH:
@@ -289,10 +950,23 @@ query_init(sdb_object_t *obj, va_list ap)
 		break;
 	case SDB_AST_TYPE_LIST:
 		filter = SDB_AST_LIST(ast)->filter;
+		order_by = SDB_AST_LIST(ast)->order_by;
+		select = SDB_AST_LIST(ast)->select;
+		select_num = SDB_AST_LIST(ast)->select_num;
 		break;
 	case SDB_AST_TYPE_LOOKUP:
+		obj_type = SDB_AST_LOOKUP(ast)->obj_type;
 		matcher = SDB_AST_LOOKUP(ast)->matcher;
 		filter = SDB_AST_LOOKUP(ast)->filter;
+		order_by = SDB_AST_LOOKUP(ast)->order_by;
+		select = SDB_AST_LOOKUP(ast)->select;
+		select_num = SDB_AST_LOOKUP(ast)->select_num;
+		break;
+	case SDB_AST_TYPE_COUNT:
+		obj_type = SDB_AST_COUNT(ast)->obj_type;
+		matcher = SDB_AST_COUNT(ast)->matcher;
+		filter = SDB_AST_COUNT(ast)->filter;
+		group_by = SDB_AST_COUNT(ast)->group_by;
 		break;
 	case SDB_AST_TYPE_STORE:
 	case SDB_AST_TYPE_TIMESERIES:
@@ -306,15 +980,30 @@ query_init(sdb_object_t *obj, va_list ap)
 	}
 
 	if (matcher) {
-		QUERY(obj)->matcher = node_to_matcher(matcher);
+		QUERY(obj)->matcher = prepare_matcher(matcher);
 		if (! QUERY(obj)->matcher)
 			return -1;
+		/* the predicates refer to the AST, which is kept by the query */
+		index_preds(QUERY(obj), matcher, obj_type);
+		time_preds(QUERY(obj), matcher, obj_type);
 	}
 	if (filter) {
-		QUERY(obj)->filter = node_to_matcher(filter);
+		QUERY(obj)->filter = prepare_matcher(filter);
 		if (! QUERY(obj)->filter)
 			return -1;
 	}
+	if (order_by) {
+		QUERY(obj)->order_by = node_to_expr(order_by);
+		if (! QUERY(obj)->order_by)
+			return -1;
+	}
+	if (group_by) {
+		QUERY(obj)->group_by = node_to_expr(group_by);
+		if (! QUERY(obj)->group_by)
+			return -1;
+	}
+	if (select && select_attrs(QUERY(obj), select, select_num))
+		return -1;
 
 	return 0;
 } /* query_init */
@@ -325,6 +1014,10 @@ query_destroy(sdb_object_t *obj)
 	sdb_object_deref(SDB_OBJ(QUERY(obj)->ast));
 	sdb_object_deref(SDB_OBJ(QUERY(obj)->matcher));
 	sdb_object_deref(SDB_OBJ(QUERY(obj)->filter));
+	sdb_object_deref(SDB_OBJ(QUERY(obj)->order_by));
+	sdb_object_deref(SDB_OBJ(QUERY(obj)->group_by));
+	if (QUERY(obj)->select_attrs)
+		free(QUERY(obj)->select_attrs);
 } /* query_destroy */
 
 static sdb_type_t query_type = {
@@ -351,4 +1044,80 @@ sdb_memstore_query_prepare_matcher(sdb_ast_node_t *ast)
 	return node_to_matcher(ast);
 } /* sdb_memstore_query_prepare_matcher */
 
+int
+sdb_memstore_query_explain(sdb_memstore_query_t *q, sdb_strbuf_t *buf)
+{
+	int type = 0;
+	bool descending = 0;
+	const char *after_host = NULL, *after_name = NULL;
+	int64_t limit = -1, offset = 0;
+	sdb_ast_node_t **select = NULL;
+	size_t select_num = 0;
+
+	if ((! q) || (! q->ast) || (! buf))
+		return -1;
+
+	if (q->ast->type == SDB_AST_TYPE_FETCH)
+		type = SDB_AST_FETCH(q->ast)->obj_type;
+	else if (q->ast->type == SDB_AST_TYPE_LIST) {
+		type = SDB_AST_LIST(q->ast)->obj_type;
+		descending = SDB_AST_LIST(q->ast)->descending;
+		after_host = SDB_AST_LIST(q->ast)->after_host;
+		after_name = SDB_AST_LIST(q->ast)->after_name;
+		limit = SDB_AST_LIST(q->ast)->limit;
+		offset = SDB_AST_LIST(q->ast)->offset;
+		select = SDB_AST_LIST(q->ast)->select;
+		select_num = SDB_AST_LIST(q->ast)->select_num;
+	}
+	else if (q->ast->type == SDB_AST_TYPE_LOOKUP) {
+		type = SDB_AST_LOOKUP(q->ast)->obj_type;
+		descending = SDB_AST_LOOKUP(q->ast)->descending;
+		after_host = SDB_AST_LOOKUP(q->ast)->after_host;
+		after_name = SDB_AST_LOOKUP(q->ast)->after_name;
+		limit = SDB_AST_LOOKUP(q->ast)->limit;
+		offset = SDB_AST_LOOKUP(q->ast)->offset;
+		select = SDB_AST_LOOKUP(q->ast)->select;
+		select_num = SDB_AST_LOOKUP(q->ast)->select_num;
+	}
+	else if (q->ast->type == SDB_AST_TYPE_COUNT)
+		type = SDB_AST_COUNT(q->ast)->obj_type;
+
+	sdb_strbuf_append(buf, "%s", SDB_AST_TYPE_TO_STRING(q->ast));
+	if (type)
+		sdb_strbuf_append(buf, " %ss", SDB_STORE_TYPE_TO_NAME(type));
+
+	if (q->matcher) {
+		sdb_strbuf_append(buf, "\n  matching: ");
+		explain_matcher(buf, q->matcher, -1);
+	}
+	if (q->filter) {
+		sdb_strbuf_append(buf, "\n  filter: ");
+		explain_matcher(buf, q->filter, -1);
+	}
+	if ((q->ast->type == SDB_AST_TYPE_LOOKUP)
+			|| (q->ast->type == SDB_AST_TYPE_COUNT))
+		explain_scan(buf, q, type);
+	explain_select(buf, select, select_num);
+	if (q->group_by) {
+		sdb_strbuf_append(buf, "\n  group by: ");
+		explain_expr(buf, q->group_by);
+	}
+	if (q->order_by) {
+		sdb_strbuf_append(buf, "\n  order by: ");
+		explain_expr(buf, q->order_by);
+		if (descending)
+			sdb_strbuf_append(buf, " DESC");
+	}
+	if (after_host) {
+		sdb_strbuf_append(buf, "\n  after: '%s'", after_host);
+		if (after_name)
+			sdb_strbuf_append(buf, ".'%s'", after_name);
+	}
+	if (limit >= 0)
+		sdb_strbuf_append(buf, "\n  limit: %"PRId64, limit);
+	if (offset > 0)
+		sdb_strbuf_append(buf, "\n  offset: %"PRId64, offset);
+	return 0;
+} /* sdb_memstore_query_explain */
+
 /* vim: set tw=78 sw=4 ts=4 noexpandtab : */
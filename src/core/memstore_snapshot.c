@@ -0,0 +1,720 @@
+/*
+ * SysDB - src/core/memstore_snapshot.c
+ * Copyright (C) 2016 Sebastian 'tokkee' Harl <sh@tokkee.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This module implements binary snapshots of the in-memory store.
+ *
+ * A snapshot consists of a header listing the known backends followed by one
+ * record per object. All integers are stored in network byte order using the
+ * encoding of the SysDB wire protocol. Each host record is followed by the
+ * records of all of its children; the parent of a child object is implied by
+ * the most recent host, service, or metric record:
+ *
+ *   header:    "SDBSNAP\0" <version:u32> <backends_num:u32> <backend>*
+ *   record:    <type:u32> <name> <last_update:i64> <interval:i64>
+ *              <backends:u64 (bitmap indexing the header's backends)>
+ *   metric:    <record> <stores_num:u32> (<type> <id> <last_update:i64>)*
+ *   attribute: <record> <value (as encoded by sdb_proto_marshal_data)>
+ *   trailer:   <0:u32>
+ *
+ * Strings are terminated by a null byte. The type of attribute records
+ * includes the type of their parent object (e.g., SDB_ATTRIBUTE|SDB_HOST).
+ */
+
+#if HAVE_CONFIG_H
+#	include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include "core/memstore-private.h"
+#include "utils/error.h"
+#include "utils/proto.h"
+#include "utils/strbuf.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SNAPSHOT_MAGIC "SDBSNAP"
+#define SNAPSHOT_VERSION 1
+
+/* flush the output buffer once it grows beyond this size */
+#define FLUSH_SIZE (64 * 1024)
+
+/*
+ * private helper functions
+ */
+
+static int
+put_int32(sdb_strbuf_t *buf, uint32_t v)
+{
+	char tmp[sizeof(v)];
+	sdb_proto_marshal_int32(tmp, sizeof(tmp), v);
+	return sdb_strbuf_memappend(buf, tmp, sizeof(tmp)) < 0 ? -1 : 0;
+} /* put_int32 */
+
+static int
+put_int64(sdb_strbuf_t *buf, uint64_t v)
+{
+	char tmp[sizeof(v)];
+	sdb_proto_marshal_int64(tmp, sizeof(tmp), v);
+	return sdb_strbuf_memappend(buf, tmp, sizeof(tmp)) < 0 ? -1 : 0;
+} /* put_int64 */
+
+static int
+put_string(sdb_strbuf_t *buf, const char *s)
+{
+	if (! s)
+		s = "";
+	return sdb_strbuf_memappend(buf, s, strlen(s) + 1) < 0 ? -1 : 0;
+} /* put_string */
+
+static int
+put_data(sdb_strbuf_t *buf, const sdb_data_t *datum)
+{
+	ssize_t len = sdb_proto_marshal_data(NULL, 0, datum);
+	char *p;
+
+	if (len < 0)
+		return -1;
+	if (! (p = sdb_strbuf_reserve(buf, (size_t)len)))
+		return -1;
+	if (sdb_proto_marshal_data(p, (size_t)len, datum) != len)
+		return -1;
+	sdb_strbuf_commit(buf, (size_t)len);
+	return 0;
+} /* put_data */
+
+/* the bitmap of the first 'n' backends */
+static uint64_t
+backends_mask(size_t n)
+{
+	return n < BACKENDS_MAX ? ((uint64_t)1 << n) - 1 : ~(uint64_t)0;
+} /* backends_mask */
+
+typedef struct {
+	FILE *fh;
+	sdb_strbuf_t *buf;
+	/* mask of the backends listed in the header */
+	uint64_t backends_mask;
+} dump_t;
+
+static int
+dump_obj(dump_t *d, sdb_memstore_obj_t *obj);
+
+static int
+dump_children(dump_t *d, sdb_avltree_t *tree)
+{
+	sdb_avltree_iter_t *iter;
+	int status = 0;
+
+	if (! tree)
+		return 0;
+	if (! (iter = sdb_avltree_get_iter(tree)))
+		return -1;
+	while (sdb_avltree_iter_has_next(iter)) {
+		if (dump_obj(d, STORE_OBJ(sdb_avltree_iter_get_next(iter)))) {
+			status = -1;
+			break;
+		}
+	}
+	sdb_avltree_iter_destroy(iter);
+	return status;
+} /* dump_children */
+
+static int
+dump_obj(dump_t *d, sdb_memstore_obj_t *obj)
+{
+	int type = obj->type;
+
+	if (type == SDB_ATTRIBUTE)
+		type |= obj->parent->type;
+
+	if (put_int32(d->buf, (uint32_t)type)
+			|| put_string(d->buf, SDB_OBJ(obj)->name)
+			|| put_int64(d->buf, (uint64_t)obj->last_update)
+			|| put_int64(d->buf, (uint64_t)obj->interval)
+			|| put_int64(d->buf, obj->backends & d->backends_mask))
+		return -1;
+
+	if (obj->type == SDB_ATTRIBUTE)
+		return put_data(d->buf, &ATTR(obj)->value);
+
+	if (obj->type == SDB_METRIC) {
+		size_t i;
+
+		if (put_int32(d->buf, (uint32_t)METRIC(obj)->stores_num))
+			return -1;
+		for (i = 0; i < METRIC(obj)->stores_num; ++i) {
+			metric_store_t *s = METRIC(obj)->stores + i;
+			if (put_string(d->buf, s->type) || put_string(d->buf, s->id)
+					|| put_int64(d->buf, (uint64_t)s->last_update))
+				return -1;
+		}
+		return dump_children(d, METRIC(obj)->attributes);
+	}
+	if (obj->type == SDB_SERVICE)
+		return dump_children(d, SVC(obj)->attributes);
+
+	if (obj->type == SDB_HOST) {
+		if (dump_children(d, HOST(obj)->attributes)
+				|| dump_children(d, HOST(obj)->metrics)
+				|| dump_children(d, HOST(obj)->services))
+			return -1;
+	}
+	return 0;
+} /* dump_obj */
+
+static int
+flush_buf(dump_t *d)
+{
+	size_t len = sdb_strbuf_len(d->buf);
+
+	if (len && (fwrite(sdb_strbuf_string(d->buf), 1, len, d->fh) != len))
+		return -1;
+	sdb_strbuf_clear(d->buf);
+	return 0;
+} /* flush_buf */
+
+/* sdb_memstore_scan() calls this while holding the host's lock */
+static int
+dump_host(sdb_memstore_obj_t *host,
+		sdb_memstore_matcher_t __attribute__((unused)) *filter,
+		void *user_data)
+{
+	dump_t *d = user_data;
+
+	if (dump_obj(d, host))
+		return -1;
+	if ((sdb_strbuf_len(d->buf) >= FLUSH_SIZE) && flush_buf(d))
+		return -1;
+	return 0;
+} /* dump_host */
+
+/*
+ * restoring snapshots
+ */
+
+typedef struct {
+	const char *data;
+	size_t len;
+
+	/* the backends listed in the header */
+	const char *backends[BACKENDS_MAX];
+	size_t backends_num;
+
+	/* lists of backend names for each distinct bitmap seen so far */
+	struct {
+		uint64_t bits;
+		const char **names;
+		size_t num;
+	} *backend_lists;
+	size_t backend_lists_num;
+
+	/* the current host's batch */
+	sdb_store_batch_entry_t *entries;
+	size_t entries_num;
+	size_t entries_size;
+
+	/* the metric stores of the current host's batch, in order */
+	sdb_metric_store_t *stores;
+	size_t stores_num;
+	size_t stores_size;
+} restore_t;
+
+static ssize_t
+get_int32(restore_t *r, uint32_t *v)
+{
+	ssize_t n = sdb_proto_unmarshal_int32(r->data, r->len, v);
+	if (n > 0) {
+		r->data += n;
+		r->len -= (size_t)n;
+	}
+	return n;
+} /* get_int32 */
+
+static ssize_t
+get_int64(restore_t *r, uint64_t *v)
+{
+	ssize_t n = sdb_proto_unmarshal_int64(r->data, r->len, v);
+	if (n > 0) {
+		r->data += n;
+		r->len -= (size_t)n;
+	}
+	return n;
+} /* get_int64 */
+
+/* strings are used in place; they remain valid while the file is mapped */
+static ssize_t
+get_string(restore_t *r, const char **s)
+{
+	const char *end = memchr(r->data, '\0', r->len);
+	size_t n;
+
+	if (! end)
+		return -1;
+	n = (size_t)(end - r->data) + 1;
+	*s = r->data;
+	r->data += n;
+	r->len -= n;
+	return (ssize_t)n;
+} /* get_string */
+
+static ssize_t
+get_data(restore_t *r, sdb_data_t *datum)
+{
+	ssize_t n = sdb_proto_unmarshal_data(r->data, r->len, datum);
+	if (n > 0) {
+		r->data += n;
+		r->len -= (size_t)n;
+	}
+	return n;
+} /* get_data */
+
+static int
+lookup_backends(restore_t *r, uint64_t bits,
+		const char * const **names, size_t *num)
+{
+	const char **list;
+	void *tmp;
+	size_t i, j;
+
+	*names = NULL;
+	*num = 0;
+	if (! bits)
+		return 0;
+
+	/* there are few distinct sets of backends, so simply search them all */
+	for (i = 0; i < r->backend_lists_num; ++i) {
+		if (r->backend_lists[i].bits == bits) {
+			*names = r->backend_lists[i].names;
+			*num = r->backend_lists[i].num;
+			return 0;
+		}
+	}
+
+	if (bits & ~backends_mask(r->backends_num))
+		return -1;
+
+	i = r->backend_lists_num;
+	tmp = realloc(r->backend_lists, (i + 1) * sizeof(*r->backend_lists));
+	if (! tmp)
+		return -1;
+	r->backend_lists = tmp;
+
+	list = malloc(r->backends_num * sizeof(*list));
+	if (! list)
+		return -1;
+	r->backend_lists[i].bits = bits;
+	r->backend_lists[i].names = list;
+	r->backend_lists[i].num = 0;
+	for (j = 0; j < r->backends_num; ++j)
+		if (bits & ((uint64_t)1 << j))
+			list[r->backend_lists[i].num++] = r->backends[j];
+	++r->backend_lists_num;
+
+	*names = list;
+	*num = r->backend_lists[i].num;
+	return 0;
+} /* lookup_backends */
+
+static void
+clear_entries(restore_t *r)
+{
+	size_t i;
+
+	for (i = 0; i < r->entries_num; ++i) {
+		sdb_store_batch_entry_t *e = r->entries + i;
+		if (e->type == SDB_ATTRIBUTE)
+			sdb_data_free_datum(&e->obj.attribute.value);
+	}
+	r->entries_num = 0;
+	r->stores_num = 0;
+} /* clear_entries */
+
+static int
+store_entries(sdb_memstore_t *store, restore_t *r)
+{
+	sdb_metric_store_t *stores = r->stores;
+	int status;
+	size_t i;
+
+	if (! r->entries_num)
+		return 0;
+
+	/* the list of stores may have moved while it was growing */
+	for (i = 0; i < r->entries_num; ++i) {
+		sdb_store_metric_t *m = &r->entries[i].obj.metric;
+		if ((r->entries[i].type != SDB_METRIC) || (! m->stores_num))
+			continue;
+		m->stores = stores;
+		stores += m->stores_num;
+	}
+
+	status = sdb_memstore_writer.store_batch(r->entries, r->entries_num,
+			SDB_OBJ(store));
+	clear_entries(r);
+	return status;
+} /* store_entries */
+
+static int
+restore_metric_stores(restore_t *r, sdb_store_metric_t *metric)
+{
+	sdb_metric_store_t *stores;
+	uint32_t num, i;
+
+	if (get_int32(r, &num) < 0)
+		return -1;
+	if (! num)
+		return 0;
+	/* each store uses at least ten bytes */
+	if (num > r->len / 10)
+		return -1;
+
+	if (r->stores_num + num > r->stores_size) {
+		size_t size = r->stores_size ? 2 * r->stores_size : 64;
+		while (size < r->stores_num + num)
+			size *= 2;
+		stores = realloc(r->stores, size * sizeof(*stores));
+		if (! stores)
+			return -1;
+		r->stores = stores;
+		r->stores_size = size;
+	}
+	stores = r->stores + r->stores_num;
+
+	for (i = 0; i < num; ++i) {
+		uint64_t last_update;
+		if ((get_string(r, &stores[i].type) < 0)
+				|| (get_string(r, &stores[i].id) < 0)
+				|| (get_int64(r, &last_update) < 0))
+			return -1;
+		stores[i].info = NULL;
+		stores[i].last_update = (sdb_time_t)last_update;
+	}
+
+	/* store_entries() sets up the pointer to the stores */
+	r->stores_num += num;
+	metric->stores_num = num;
+	return 0;
+} /* restore_metric_stores */
+
+static int
+restore_objects(sdb_memstore_t *store, restore_t *r)
+{
+	const char *hostname = NULL, *service = NULL, *metric = NULL;
+	int status = 0, s;
+
+	while (42) {
+		sdb_store_batch_entry_t *e;
+		const char *name;
+		uint64_t last_update, interval, backends;
+		const char * const *backend_names;
+		size_t backends_num;
+		uint32_t type;
+
+		if (get_int32(r, &type) < 0)
+			return -1;
+		if (! type)
+			break;
+
+		if ((get_string(r, &name) < 0)
+				|| (get_int64(r, &last_update) < 0)
+				|| (get_int64(r, &interval) < 0)
+				|| (get_int64(r, &backends) < 0)
+				|| lookup_backends(r, backends, &backend_names, &backends_num))
+			return -1;
+
+		if (type == SDB_HOST) {
+			s = store_entries(store, r);
+			if (((s > 0) && (status >= 0)) || (s < 0))
+				status = s;
+			hostname = name;
+			service = metric = NULL;
+		}
+		else if (! hostname)
+			return -1;
+
+		if (r->entries_num >= r->entries_size) {
+			size_t size = r->entries_size ? 2 * r->entries_size : 64;
+			e = realloc(r->entries, size * sizeof(*e));
+			if (! e)
+				return -1;
+			r->entries = e;
+			r->entries_size = size;
+		}
+		e = r->entries + r->entries_num;
+		memset(e, 0, sizeof(*e));
+
+		switch (type) {
+		case SDB_HOST:
+			e->obj.host.name = name;
+			e->obj.host.last_update = (sdb_time_t)last_update;
+			e->obj.host.interval = (sdb_time_t)interval;
+			e->obj.host.backends = backend_names;
+			e->obj.host.backends_num = backends_num;
+			break;
+		case SDB_SERVICE:
+			e->obj.service.hostname = hostname;
+			e->obj.service.name = name;
+			e->obj.service.last_update = (sdb_time_t)last_update;
+			e->obj.service.interval = (sdb_time_t)interval;
+			e->obj.service.backends = backend_names;
+			e->obj.service.backends_num = backends_num;
+			service = name;
+			metric = NULL;
+			break;
+		case SDB_METRIC:
+			e->obj.metric.hostname = hostname;
+			e->obj.metric.name = name;
+			e->obj.metric.last_update = (sdb_time_t)last_update;
+			e->obj.metric.interval = (sdb_time_t)interval;
+			e->obj.metric.backends = backend_names;
+			e->obj.metric.backends_num = backends_num;
+			metric = name;
+			service = NULL;
+			break;
+		case SDB_ATTRIBUTE | SDB_HOST:
+		case SDB_ATTRIBUTE | SDB_SERVICE:
+		case SDB_ATTRIBUTE | SDB_METRIC:
+			e->obj.attribute.hostname = hostname;
+			e->obj.attribute.parent_type = (int)(type & ~SDB_ATTRIBUTE);
+			if (type == (SDB_ATTRIBUTE | SDB_HOST))
+				e->obj.attribute.parent = hostname;
+			else if (type == (SDB_ATTRIBUTE | SDB_SERVICE))
+				e->obj.attribute.parent = service;
+			else
+				e->obj.attribute.parent = metric;
+			if (! e->obj.attribute.parent)
+				return -1;
+			e->obj.attribute.key = name;
+			e->obj.attribute.last_update = (sdb_time_t)last_update;
+			e->obj.attribute.interval = (sdb_time_t)interval;
+			e->obj.attribute.backends = backend_names;
+			e->obj.attribute.backends_num = backends_num;
+			break;
+		default:
+			sdb_log(SDB_LOG_ERR, "memstore: Unexpected object type %u "
+					"in snapshot", type);
+			return -1;
+		}
+
+		e->type = type & SDB_ATTRIBUTE ? SDB_ATTRIBUTE : (int)type;
+		++r->entries_num;
+
+		/* the entry has to be complete before it may be freed on error */
+		if (type == SDB_METRIC) {
+			if (restore_metric_stores(r, &e->obj.metric))
+				return -1;
+		}
+		else if (type & SDB_ATTRIBUTE) {
+			if (get_data(r, &e->obj.attribute.value) < 0) {
+				e->obj.attribute.value.type = SDB_TYPE_NULL;
+				return -1;
+			}
+		}
+	}
+
+	s = store_entries(store, r);
+	if (((s > 0) && (status >= 0)) || (s < 0))
+		status = s;
+	return status;
+} /* restore_objects */
+
+static int
+restore_header(restore_t *r)
+{
+	uint32_t version, num, i;
+
+	if ((r->len < sizeof(SNAPSHOT_MAGIC))
+			|| memcmp(r->data, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC))) {
+		sdb_log(SDB_LOG_ERR, "memstore: Invalid snapshot (bad magic)");
+		return -1;
+	}
+	r->data += sizeof(SNAPSHOT_MAGIC);
+	r->len -= sizeof(SNAPSHOT_MAGIC);
+
+	if ((get_int32(r, &version) < 0) || (get_int32(r, &num) < 0))
+		return -1;
+	if (version != SNAPSHOT_VERSION) {
+		sdb_log(SDB_LOG_ERR, "memstore: Unsupported snapshot version %u",
+				version);
+		return -1;
+	}
+	if (num > BACKENDS_MAX) {
+		sdb_log(SDB_LOG_ERR, "memstore: Invalid snapshot (%u backends; "
+				"at most %d are supported)", num, BACKENDS_MAX);
+		return -1;
+	}
+
+	for (i = 0; i < num; ++i)
+		if (get_string(r, r->backends + i) < 0)
+			return -1;
+	r->backends_num = num;
+	return 0;
+} /* restore_header */
+
+/*
+ * public API
+ */
+
+int
+sdb_memstore_dump(sdb_memstore_t *store, const char *filename)
+{
+	const char *backends[BACKENDS_MAX];
+	size_t backends_num, i;
+	char tmpname[strlen(filename ? filename : "") + 5];
+	char errbuf[1024];
+	dump_t d = { NULL, NULL, 0 };
+	int status = 0;
+
+	if ((! store) || (! filename))
+		return -1;
+
+	/* backends registered while dumping are not part of the header and,
+	 * thus, are masked from any object's bitmap */
+	backends_num = sdb_memstore_backend_names(backends);
+	d.backends_mask = backends_mask(backends_num);
+
+	snprintf(tmpname, sizeof(tmpname), "%s.tmp", filename);
+	if (! (d.fh = fopen(tmpname, "w"))) {
+		sdb_log(SDB_LOG_ERR, "memstore: Failed to open snapshot file %s: %s",
+				tmpname, sdb_strerror(errno, errbuf, sizeof(errbuf)));
+		return -1;
+	}
+	if (! (d.buf = sdb_strbuf_create(2 * FLUSH_SIZE))) {
+		fclose(d.fh);
+		unlink(tmpname);
+		return -1;
+	}
+
+	if ((sdb_strbuf_memappend(d.buf, SNAPSHOT_MAGIC,
+					sizeof(SNAPSHOT_MAGIC)) < 0)
+			|| put_int32(d.buf, SNAPSHOT_VERSION)
+			|| put_int32(d.buf, (uint32_t)backends_num))
+		status = -1;
+	for (i = 0; (! status) && (i < backends_num); ++i)
+		status = put_string(d.buf, backends[i]);
+
+	if (! status)
+		status = sdb_memstore_scan(store, SDB_HOST, /* m = */ NULL,
+				/* filter = */ NULL, dump_host, &d);
+	if ((! status) && (put_int32(d.buf, 0) || flush_buf(&d)))
+		status = -1;
+	if ((! status) && (fflush(d.fh) || fsync(fileno(d.fh))))
+		status = -1;
+	if (status)
+		sdb_log(SDB_LOG_ERR, "memstore: Failed to write snapshot file %s: %s",
+				tmpname, sdb_strerror(errno, errbuf, sizeof(errbuf)));
+
+	if (fclose(d.fh) && (! status)) {
+		sdb_log(SDB_LOG_ERR, "memstore: Failed to close snapshot file %s: %s",
+				tmpname, sdb_strerror(errno, errbuf, sizeof(errbuf)));
+		status = -1;
+	}
+	sdb_strbuf_destroy(d.buf);
+
+	if ((! status) && rename(tmpname, filename)) {
+		sdb_log(SDB_LOG_ERR, "memstore: Failed to rename snapshot file "
+				"%s to %s: %s", tmpname, filename,
+				sdb_strerror(errno, errbuf, sizeof(errbuf)));
+		status = -1;
+	}
+	if (status)
+		unlink(tmpname);
+	return status;
+} /* sdb_memstore_dump */
+
+int
+sdb_memstore_restore(sdb_memstore_t *store, const char *filename)
+{
+	restore_t r;
+	struct stat st;
+	void *map;
+	char errbuf[1024];
+	int fd, status;
+	size_t i;
+
+	if ((! store) || (! filename))
+		return -1;
+
+	if ((fd = open(filename, O_RDONLY)) < 0) {
+		sdb_log(SDB_LOG_ERR, "memstore: Failed to open snapshot file %s: %s",
+				filename, sdb_strerror(errno, errbuf, sizeof(errbuf)));
+		return -1;
+	}
+	if (fstat(fd, &st)) {
+		sdb_log(SDB_LOG_ERR, "memstore: Failed to stat snapshot file %s: %s",
+				filename, sdb_strerror(errno, errbuf, sizeof(errbuf)));
+		close(fd);
+		return -1;
+	}
+	if (! st.st_size) {
+		sdb_log(SDB_LOG_ERR, "memstore: Empty snapshot file %s", filename);
+		close(fd);
+		return -1;
+	}
+
+	map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		sdb_log(SDB_LOG_ERR, "memstore: Failed to map snapshot file %s: %s",
+				filename, sdb_strerror(errno, errbuf, sizeof(errbuf)));
+		return -1;
+	}
+	/* the file is read front to back exactly once */
+	madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+	memset(&r, 0, sizeof(r));
+	r.data = map;
+	r.len = (size_t)st.st_size;
+
+	status = restore_header(&r);
+	if (! status)
+		status = restore_objects(store, &r);
+	if (status < 0)
+		sdb_log(SDB_LOG_ERR, "memstore: Failed to restore snapshot file %s "
+				"(corrupt or truncated at offset %zu)", filename,
+				(size_t)st.st_size - r.len);
+
+	clear_entries(&r);
+	free(r.entries);
+	free(r.stores);
+	for (i = 0; i < r.backend_lists_num; ++i)
+		free(r.backend_lists[i].names);
+	free(r.backend_lists);
+	munmap(map, (size_t)st.st_size);
+	return status;
+} /* sdb_memstore_restore */
+
+/* vim: set tw=78 sw=4 ts=4 noexpandtab : */
+
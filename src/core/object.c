@@ -30,6 +30,7 @@
 #endif /* HAVE_CONFIG_H */
 
 #include "core/object.h"
+#include "utils/slab.h"
 
 #include <assert.h>
 
@@ -74,6 +75,23 @@ static sdb_type_t sdb_object_wrapper_type = {
 	sdb_object_wrapper_destroy
 };
 
+/*
+ * private helper functions
+ */
+
+/* Objects are allocated along with their name, which is stored right after
+ * the type-specific data. Objects without a name store an empty string. The
+ * inline name may be modified later on, so the size of the allocation is
+ * recorded in a header preceding the object. */
+#define INLINE_NAME(obj) ((char *)(obj) + (obj)->type.size)
+
+typedef union {
+	size_t size;
+	/* keeps the object aligned */
+	char align[SDB_SLAB_ALIGN];
+} header_t;
+#define HEADER(obj) ((header_t *)(obj) - 1)
+
 /*
  * public API
  */
@@ -82,24 +100,24 @@ sdb_object_t *
 sdb_object_vcreate(const char *name, sdb_type_t type, va_list ap)
 {
 	sdb_object_t *obj;
+	size_t len = name ? strlen(name) : 0;
+	size_t size = sizeof(header_t) + type.size + len + 1;
+	header_t *h;
 
 	if (type.size < sizeof(sdb_object_t))
 		return NULL;
 
-	obj = malloc(type.size);
-	if (! obj)
+	h = sdb_slab_alloc(size);
+	if (! h)
 		return NULL;
+	h->size = size;
+	obj = (sdb_object_t *)(h + 1);
 	memset(obj, 0, type.size);
 	obj->type = type;
 
-	if (name) {
-		obj->name = strdup(name);
-		if (! obj->name) {
-			obj->ref_cnt = 1;
-			sdb_object_deref(obj);
-			return NULL;
-		}
-	}
+	memcpy(INLINE_NAME(obj), name ? name : "", len + 1);
+	if (name)
+		obj->name = INLINE_NAME(obj);
 
 	if (type.init) {
 		if (type.init(obj, ap)) {
@@ -143,22 +161,25 @@ sdb_object_create_wrapper(const char *name,
 void
 sdb_object_deref(sdb_object_t *obj)
 {
+	int ref_cnt;
+
 	if (! obj)
 		return;
 
-	--obj->ref_cnt;
-	if (obj->ref_cnt > 0)
+	/* objects may be shared between threads */
+	ref_cnt = __atomic_sub_fetch(&obj->ref_cnt, 1, __ATOMIC_ACQ_REL);
+	if (ref_cnt > 0)
 		return;
 
 	/* we'd access free'd memory in case ref_cnt < 0 */
-	assert(! obj->ref_cnt);
+	assert(! ref_cnt);
 
 	if (obj->type.destroy)
 		obj->type.destroy(obj);
 
-	if (obj->name)
+	if (obj->name && (obj->name != INLINE_NAME(obj)))
 		free(obj->name);
-	free(obj);
+	sdb_slab_free(HEADER(obj), HEADER(obj)->size);
 } /* sdb_object_deref */
 
 void
@@ -167,7 +188,7 @@ sdb_object_ref(sdb_object_t *obj)
 	if (! obj)
 		return;
 	assert(obj->ref_cnt > 0);
-	++obj->ref_cnt;
+	__atomic_add_fetch(&obj->ref_cnt, 1, __ATOMIC_RELAXED);
 } /* sdb_object_ref */
 
 int
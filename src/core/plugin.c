@@ -122,6 +122,33 @@ typedef struct {
 } ts_fetcher_t;
 #define TS_FETCHER(obj) ((ts_fetcher_t *)(obj))
 
+/* a queued object of a batch update; all strings are owned by the entry */
+typedef struct {
+	int type;
+	int parent_type; /* attributes only */
+	char *hostname;
+	char *name;
+	char *key;       /* attributes only */
+	sdb_data_t value;
+
+	bool has_store;  /* metrics only */
+	char *store_type;
+	char *store_id;
+	sdb_time_t store_last_update;
+
+	sdb_time_t last_update;
+	char *backend;
+} batch_entry_t;
+
+struct sdb_plugin_batch {
+	sdb_object_t super;
+
+	batch_entry_t *entries;
+	size_t entries_num;
+	size_t entries_size;
+};
+#define BATCH(obj) ((sdb_plugin_batch_t *)(obj))
+
 /*
  * private variables
  */
@@ -336,9 +363,29 @@ query_store_attribute(sdb_store_attribute_t *attr, sdb_object_t *user_data)
 	return qw->w->store_attribute(attr, qw->ud);
 } /* query_store_attribute */
 
+static int
+query_store_count(const sdb_data_t *value, int64_t count,
+		sdb_object_t *user_data)
+{
+	query_writer_t *qw = QUERY_WRITER(user_data);
+	if (! qw->w->store_count)
+		return -1;
+	return qw->w->store_count(value, count, qw->ud);
+} /* query_store_count */
+
+static int
+query_flush(sdb_object_t *user_data)
+{
+	query_writer_t *qw = QUERY_WRITER(user_data);
+	if (! qw->w->flush)
+		return 0;
+	return qw->w->flush(qw->ud);
+} /* query_flush */
+
 static sdb_store_writer_t query_writer = {
 	query_store_host, query_store_service,
-	query_store_metric, query_store_attribute,
+	query_store_metric, query_store_attribute, NULL, query_store_count,
+	query_flush,
 };
 
 /*
@@ -539,6 +586,46 @@ static sdb_type_t writer_type = {
 	plugin_writer_destroy
 };
 
+static void
+batch_entry_clear(batch_entry_t *e)
+{
+	free(e->hostname);
+	free(e->name);
+	free(e->key);
+	sdb_data_free_datum(&e->value);
+	free(e->store_type);
+	free(e->store_id);
+	free(e->backend);
+	memset(e, 0, sizeof(*e));
+} /* batch_entry_clear */
+
+static void
+batch_clear(sdb_plugin_batch_t *batch)
+{
+	size_t i;
+
+	for (i = 0; i < batch->entries_num; ++i)
+		batch_entry_clear(batch->entries + i);
+	batch->entries_num = 0;
+} /* batch_clear */
+
+static void
+batch_destroy(sdb_object_t *obj)
+{
+	assert(obj);
+	batch_clear(BATCH(obj));
+	free(BATCH(obj)->entries);
+	BATCH(obj)->entries = NULL;
+	BATCH(obj)->entries_size = 0;
+} /* batch_destroy */
+
+static sdb_type_t batch_type = {
+	sizeof(sdb_plugin_batch_t),
+
+	NULL,
+	batch_destroy
+};
+
 static int
 plugin_reader_init(sdb_object_t *obj, va_list ap)
 {
@@ -651,6 +738,24 @@ module_init(const char *name, lt_dlhandle lh, sdb_plugin_info_t *info)
 	return 0;
 } /* module_init */
 
+/* Returns the number of backends loaded so far. */
+static size_t
+backends_count(void)
+{
+	sdb_llist_iter_t *iter;
+	size_t n = 0;
+
+	if (! (iter = sdb_llist_get_iter(all_plugins)))
+		return 0;
+	while (sdb_llist_iter_has_next(iter)) {
+		sdb_object_t *obj = sdb_llist_iter_get_next(iter);
+		if (! strncasecmp(obj->name, "backend::", strlen("backend::")))
+			++n;
+	}
+	sdb_llist_iter_destroy(iter);
+	return n;
+} /* backends_count */
+
 static int
 module_load(const char *basedir, const char *name,
 		const sdb_plugin_ctx_t *plugin_ctx)
@@ -799,121 +904,185 @@ plugin_add_impl(sdb_llist_t **list, sdb_type_t T, const char *type,
  * object meta-data
  */
 
-typedef struct {
-	int obj_type;
-	sdb_time_t last_update;
-	sdb_time_t interval;
-} interval_fetcher_t;
-
-static int
-interval_fetcher_host(sdb_store_host_t *host, sdb_object_t *user_data)
+static void
+get_backend(char **backends, size_t *backends_num)
 {
-	interval_fetcher_t *lu = SDB_OBJ_WRAPPER(user_data)->data;
-	lu->obj_type = SDB_HOST;
-	lu->last_update = host->last_update;
-	return 0;
-} /* interval_fetcher_host */
+	const sdb_plugin_info_t *info;
 
-static int
-interval_fetcher_service(sdb_store_service_t *svc, sdb_object_t *user_data)
-{
-	interval_fetcher_t *lu = SDB_OBJ_WRAPPER(user_data)->data;
-	lu->obj_type = SDB_SERVICE;
-	lu->last_update = svc->last_update;
-	return 0;
-} /* interval_fetcher_service */
+	info = sdb_plugin_current();
+	if ((! info) || (! info->plugin_name) || (! *info->plugin_name)) {
+		*backends_num = 0;
+		return;
+	}
 
-static int
-interval_fetcher_metric(sdb_store_metric_t *metric, sdb_object_t *user_data)
-{
-	interval_fetcher_t *lu = SDB_OBJ_WRAPPER(user_data)->data;
-	lu->obj_type = SDB_METRIC;
-	lu->last_update = metric->last_update;
-	return 0;
-} /* interval_fetcher_metric */
+	backends[0] = info->plugin_name;
+	*backends_num = 1;
+} /* get_backend */
 
-static int
-interval_fetcher_attr(sdb_store_attribute_t *attr, sdb_object_t *user_data)
+/*
+ * Append a new entry for an object of the specified type to a batch. All
+ * fields are copied and default values (last_update, backend) are filled in
+ * the same way as when storing a single object.
+ */
+static batch_entry_t *
+batch_add(sdb_plugin_batch_t *batch, int type, const char *hostname,
+		const char *name, sdb_time_t last_update)
 {
-	interval_fetcher_t *lu = SDB_OBJ_WRAPPER(user_data)->data;
-	lu->obj_type = SDB_ATTRIBUTE;
-	lu->last_update = attr->last_update;
-	return 0;
-} /* interval_fetcher_attr */
+	batch_entry_t *e;
+	char *backends[1];
+	size_t backends_num;
 
-static sdb_store_writer_t interval_fetcher = {
-	interval_fetcher_host, interval_fetcher_service,
-	interval_fetcher_metric, interval_fetcher_attr,
-};
+	if (batch->entries_num >= batch->entries_size) {
+		size_t size = batch->entries_size ? 2 * batch->entries_size : 64;
+		batch_entry_t *tmp;
 
-static int
-get_interval(int obj_type, const char *hostname,
-		int parent_type, const char *parent, const char *name,
-		sdb_time_t last_update, sdb_time_t *interval_out)
-{
-	sdb_ast_fetch_t fetch = SDB_AST_FETCH_INIT;
-	char hn[hostname ? strlen(hostname) + 1 : 1];
-	char pn[parent ? strlen(parent) + 1 : 1];
-	char n[strlen(name) + 1];
-	int status;
+		tmp = realloc(batch->entries, size * sizeof(*tmp));
+		if (! tmp) {
+			sdb_log(SDB_LOG_ERR, "Failed to add %s to batch: "
+					"out of memory", SDB_STORE_TYPE_TO_NAME(type));
+			return NULL;
+		}
+		batch->entries = tmp;
+		batch->entries_size = size;
+	}
 
-	interval_fetcher_t lu = { 0, 0, 0 };
-	sdb_object_wrapper_t obj = SDB_OBJECT_WRAPPER_STATIC(&lu);
-	sdb_time_t interval;
+	e = batch->entries + batch->entries_num;
+	memset(e, 0, sizeof(*e));
+	e->type = type;
+	e->value.type = SDB_TYPE_NULL;
+	e->last_update = last_update ? last_update : sdb_gettime();
 
-	assert(name);
+	get_backend(backends, &backends_num);
+	e->hostname = sdb_plugin_cname(strdup(hostname));
+	e->name = strdup(name);
+	if (backends_num)
+		e->backend = strdup(backends[0]);
 
-	if (hostname)
-		strncpy(hn, hostname, sizeof(hn));
-	if (parent)
-		strncpy(pn, parent, sizeof(pn));
-	strncpy(n, name, sizeof(n));
-
-	fetch.obj_type = obj_type;
-	fetch.hostname = hostname ? hn : NULL;
-	fetch.parent_type = parent_type;
-	fetch.parent = parent ? pn : NULL;
-	fetch.name = n;
-
-	status = sdb_plugin_query(SDB_AST_NODE(&fetch),
-			&interval_fetcher, SDB_OBJ(&obj), NULL, NULL);
-	if ((status < 0) || (lu.obj_type != obj_type) || (lu.last_update == 0)) {
-		*interval_out = 0;
-		return 0;
+	if ((! e->hostname) || (! e->name) || (backends_num && (! e->backend))) {
+		sdb_log(SDB_LOG_ERR, "strdup failed");
+		batch_entry_clear(e);
+		return NULL;
 	}
 
-	if (lu.last_update >= last_update) {
-		if (lu.last_update > last_update)
-			sdb_log(SDB_LOG_DEBUG, "Cannot update %s '%s' - "
-					"value too old (%"PRIsdbTIME" < %"PRIsdbTIME")",
-					SDB_STORE_TYPE_TO_NAME(obj_type), name,
-					lu.last_update, last_update);
-		*interval_out = lu.interval;
-		return 1;
-	}
+	++batch->entries_num;
+	return e;
+} /* batch_add */
 
-	interval = last_update - lu.last_update;
-	if (lu.interval && interval)
-		interval = (sdb_time_t)((0.9 * (double)lu.interval)
-				+ (0.1 * (double)interval));
-	*interval_out = interval;
+static int
+batch_add_attribute(sdb_plugin_batch_t *batch, int parent_type,
+		const char *hostname, const char *parent, const char *key,
+		const sdb_data_t *value, sdb_time_t last_update)
+{
+	batch_entry_t *e;
+
+	if ((! batch) || (! hostname) || (! parent) || (! key) || (! value))
+		return -1;
+
+	e = batch_add(batch, SDB_ATTRIBUTE, hostname, parent, last_update);
+	if (! e)
+		return -1;
+
+	e->parent_type = parent_type;
+	e->key = strdup(key);
+	if ((! e->key) || sdb_data_copy(&e->value, value)) {
+		sdb_log(SDB_LOG_ERR, "Failed to add attribute '%s' to batch: "
+				"out of memory", key);
+		batch_entry_clear(e);
+		--batch->entries_num;
+		return -1;
+	}
 	return 0;
-} /* get_interval */
+} /* batch_add_attribute */
 
+/*
+ * Translate a queued entry into the writer representation. The returned
+ * object references the strings owned by the queued entry.
+ */
 static void
-get_backend(char **backends, size_t *backends_num)
+batch_entry_get(batch_entry_t *e, sdb_store_batch_entry_t *entry,
+		sdb_metric_store_t *store)
+{
+	const char * const *backends = (const char * const *)&e->backend;
+	size_t backends_num = e->backend ? 1 : 0;
+
+	memset(entry, 0, sizeof(*entry));
+	entry->type = e->type;
+
+	if (e->type == SDB_HOST) {
+		entry->obj.host.name = e->hostname;
+		entry->obj.host.last_update = e->last_update;
+		entry->obj.host.backends = backends;
+		entry->obj.host.backends_num = backends_num;
+	}
+	else if (e->type == SDB_SERVICE) {
+		entry->obj.service.hostname = e->hostname;
+		entry->obj.service.name = e->name;
+		entry->obj.service.last_update = e->last_update;
+		entry->obj.service.backends = backends;
+		entry->obj.service.backends_num = backends_num;
+	}
+	else if (e->type == SDB_METRIC) {
+		entry->obj.metric.hostname = e->hostname;
+		entry->obj.metric.name = e->name;
+		if (e->has_store) {
+			store->type = e->store_type;
+			store->id = e->store_id;
+			store->info = NULL;
+			store->last_update = e->store_last_update;
+			entry->obj.metric.stores = store;
+			entry->obj.metric.stores_num = 1;
+		}
+		entry->obj.metric.last_update = e->last_update;
+		entry->obj.metric.backends = backends;
+		entry->obj.metric.backends_num = backends_num;
+	}
+	else if (e->type == SDB_ATTRIBUTE) {
+		if (e->parent_type == SDB_HOST)
+			entry->obj.attribute.parent = e->hostname;
+		else {
+			entry->obj.attribute.hostname = e->hostname;
+			entry->obj.attribute.parent = e->name;
+		}
+		entry->obj.attribute.parent_type = e->parent_type;
+		entry->obj.attribute.key = e->key;
+		entry->obj.attribute.value = e->value;
+		entry->obj.attribute.last_update = e->last_update;
+		entry->obj.attribute.backends = backends;
+		entry->obj.attribute.backends_num = backends_num;
+	}
+} /* batch_entry_get */
+
+/* Fall back to storing one object at a time for writers without batches. */
+static int
+writer_store_each(writer_t *writer,
+		sdb_store_batch_entry_t *entries, size_t entries_num)
 {
-	const sdb_plugin_info_t *info;
+	int status = 0;
+	size_t i;
 
-	info = sdb_plugin_current();
-	if ((! info) || (! info->plugin_name) || (! *info->plugin_name)) {
-		*backends_num = 0;
-		return;
-	}
+	for (i = 0; i < entries_num; ++i) {
+		sdb_store_batch_entry_t *e = entries + i;
+		int s;
 
-	backends[0] = info->plugin_name;
-	*backends_num = 1;
-} /* get_backend */
+		if (e->type == SDB_HOST)
+			s = writer->impl.store_host(&e->obj.host, writer->w_user_data);
+		else if (e->type == SDB_SERVICE)
+			s = writer->impl.store_service(&e->obj.service,
+					writer->w_user_data);
+		else if (e->type == SDB_METRIC)
+			s = writer->impl.store_metric(&e->obj.metric,
+					writer->w_user_data);
+		else if (e->type == SDB_ATTRIBUTE)
+			s = writer->impl.store_attribute(&e->obj.attribute,
+					writer->w_user_data);
+		else
+			s = -1;
+
+		if (((s > 0) && (status >= 0)) || (s < 0))
+			status = s;
+	}
+	return status;
+} /* writer_store_each */
 
 /*
  * public API
@@ -959,6 +1128,14 @@ sdb_plugin_load(const char *basedir, const char *name,
 		return 0;
 	}
 
+	/* stores keep track of the backends of each object */
+	if ((! strncasecmp(name, "backend::", strlen("backend::")))
+			&& (backends_count() >= SDB_STORE_BACKENDS_MAX)) {
+		sdb_log(SDB_LOG_ERR, "Failed to load backend '%s': too many "
+				"backends (max: %d)", name, SDB_STORE_BACKENDS_MAX);
+		return -1;
+	}
+
 	return module_load(basedir, name, plugin_ctx);
 } /* sdb_plugin_load */
 
@@ -1662,32 +1839,21 @@ sdb_plugin_describe_timeseries(const char *type, const char *id)
 	return ts_info;
 } /* sdb_plugin_describe_timeseries */
 
-int
-sdb_plugin_query(sdb_ast_node_t *ast,
-		sdb_store_writer_t *w, sdb_object_t *wd,
-		sdb_query_opts_t *opts, sdb_strbuf_t *errbuf)
+/* Look up the reader to execute queries; returns a new reference. */
+static reader_t *
+query_reader(sdb_ast_node_t *ast, sdb_strbuf_t *errbuf)
 {
-	query_writer_t qw = QUERY_WRITER_INIT(w, wd);
-	reader_t *reader;
-	sdb_object_t *q;
-
 	size_t n = sdb_llist_len(reader_list);
-	int status = 0;
-
-	if (! ast)
-		return 0;
-
-	if (opts)
-		qw.opts = *opts;
 
 	if ((ast->type != SDB_AST_TYPE_FETCH)
 			&& (ast->type != SDB_AST_TYPE_LIST)
-			&& (ast->type != SDB_AST_TYPE_LOOKUP)) {
+			&& (ast->type != SDB_AST_TYPE_LOOKUP)
+			&& (ast->type != SDB_AST_TYPE_COUNT)) {
 		sdb_log(SDB_LOG_ERR, "Cannot execute query of type %s",
 				SDB_AST_TYPE_TO_STRING(ast));
 		sdb_strbuf_sprintf(errbuf, "Cannot execute query of type %s",
 				SDB_AST_TYPE_TO_STRING(ast));
-		return -1;
+		return NULL;
 	}
 
 	if (n != 1) {
@@ -1696,11 +1862,30 @@ sdb_plugin_query(sdb_ast_node_t *ast,
 			: "Cannot execute query: no readers registered";
 		sdb_strbuf_sprintf(errbuf, "%s", msg);
 		sdb_log(SDB_LOG_ERR, "%s", msg);
-		return -1;
+		return NULL;
 	}
 
-	reader = READER(sdb_llist_get(reader_list, 0));
-	assert(reader);
+	return READER(sdb_llist_get(reader_list, 0));
+} /* query_reader */
+
+int
+sdb_plugin_query(sdb_ast_node_t *ast,
+		sdb_store_writer_t *w, sdb_object_t *wd,
+		sdb_query_opts_t *opts, sdb_strbuf_t *errbuf)
+{
+	query_writer_t qw = QUERY_WRITER_INIT(w, wd);
+	reader_t *reader;
+	sdb_object_t *q;
+	int status = 0;
+
+	if (! ast)
+		return 0;
+
+	if (opts)
+		qw.opts = *opts;
+
+	if (! (reader = query_reader(ast, errbuf)))
+		return -1;
 
 	q = reader->impl.prepare_query(ast, errbuf, reader->r_user_data);
 	if (q)
@@ -1714,6 +1899,38 @@ sdb_plugin_query(sdb_ast_node_t *ast,
 	return status;
 } /* sdb_plugin_query */
 
+int
+sdb_plugin_explain(sdb_ast_node_t *ast, sdb_strbuf_t *buf,
+		sdb_strbuf_t *errbuf)
+{
+	reader_t *reader;
+	sdb_object_t *q;
+	int status = 0;
+
+	if ((! ast) || (! buf))
+		return -1;
+
+	if (! (reader = query_reader(ast, errbuf)))
+		return -1;
+	if (! reader->impl.explain_query) {
+		sdb_strbuf_sprintf(errbuf, "Cannot explain query: "
+				"not supported by the store");
+		sdb_object_deref(SDB_OBJ(reader));
+		return -1;
+	}
+
+	q = reader->impl.prepare_query(ast, errbuf, reader->r_user_data);
+	if (q)
+		status = reader->impl.explain_query(q, buf, errbuf,
+				reader->r_user_data);
+	else
+		status = -1;
+
+	sdb_object_deref(SDB_OBJ(q));
+	sdb_object_deref(SDB_OBJ(reader));
+	return status;
+} /* sdb_plugin_explain */
+
 int
 sdb_plugin_store_host(const char *name, sdb_time_t last_update)
 {
@@ -1740,11 +1957,6 @@ sdb_plugin_store_host(const char *name, sdb_time_t last_update)
 
 	host.name = cname;
 	host.last_update = last_update ? last_update : sdb_gettime();
-	if (get_interval(SDB_HOST, NULL, -1, NULL, cname,
-				host.last_update, &host.interval)) {
-		free(cname);
-		return 1;
-	}
 	host.backends = (const char * const *)backends;
 	get_backend(backends, &host.backends_num);
 
@@ -1793,11 +2005,6 @@ sdb_plugin_store_service(const char *hostname, const char *name,
 	service.hostname = cname;
 	service.name = name;
 	service.last_update = last_update ? last_update : sdb_gettime();
-	if (get_interval(SDB_SERVICE, cname, -1, NULL, name,
-				service.last_update, &service.interval)) {
-		free(cname);
-		return 1;
-	}
 	service.backends = (const char * const *)backends;
 	get_backend(backends, &service.backends_num);
 
@@ -1864,11 +2071,6 @@ sdb_plugin_store_metric(const char *hostname, const char *name,
 		metric.stores_num = 1;
 	}
 	metric.last_update = last_update ? last_update : sdb_gettime();
-	if (get_interval(SDB_METRIC, cname, -1, NULL, name,
-				metric.last_update, &metric.interval)) {
-		free(cname);
-		return 1;
-	}
 	metric.backends = (const char * const *)backends;
 	get_backend(backends, &metric.backends_num);
 
@@ -1926,11 +2128,6 @@ sdb_plugin_store_attribute(const char *hostname, const char *key,
 	attr.key = key;
 	attr.value = *value;
 	attr.last_update = last_update ? last_update : sdb_gettime();
-	if (get_interval(SDB_ATTRIBUTE, cname, -1, NULL, key,
-				attr.last_update, &attr.interval)) {
-		free(cname);
-		return 1;
-	}
 	attr.backends = (const char * const *)backends;
 	get_backend(backends, &attr.backends_num);
 
@@ -1980,11 +2177,6 @@ sdb_plugin_store_service_attribute(const char *hostname, const char *service,
 	attr.key = key;
 	attr.value = *value;
 	attr.last_update = last_update ? last_update : sdb_gettime();
-	if (get_interval(SDB_ATTRIBUTE, cname, SDB_SERVICE, service, key,
-				attr.last_update, &attr.interval)) {
-		free(cname);
-		return 1;
-	}
 	attr.backends = (const char * const *)backends;
 	get_backend(backends, &attr.backends_num);
 
@@ -2034,11 +2226,6 @@ sdb_plugin_store_metric_attribute(const char *hostname, const char *metric,
 	attr.key = key;
 	attr.value = *value;
 	attr.last_update = last_update ? last_update : sdb_gettime();
-	if (get_interval(SDB_ATTRIBUTE, cname, SDB_METRIC, metric, key,
-				attr.last_update, &attr.interval)) {
-		free(cname);
-		return 1;
-	}
 	attr.backends = (const char * const *)backends;
 	get_backend(backends, &attr.backends_num);
 
@@ -2056,5 +2243,157 @@ sdb_plugin_store_metric_attribute(const char *hostname, const char *metric,
 	return status;
 } /* sdb_plugin_store_metric_attribute */
 
+sdb_plugin_batch_t *
+sdb_plugin_store_batch_begin(void)
+{
+	return BATCH(sdb_object_create("batch", batch_type));
+} /* sdb_plugin_store_batch_begin */
+
+int
+sdb_plugin_store_batch_host(sdb_plugin_batch_t *batch, const char *name,
+		sdb_time_t last_update)
+{
+	if ((! batch) || (! name))
+		return -1;
+	if (! batch_add(batch, SDB_HOST, name, name, last_update))
+		return -1;
+	return 0;
+} /* sdb_plugin_store_batch_host */
+
+int
+sdb_plugin_store_batch_service(sdb_plugin_batch_t *batch,
+		const char *hostname, const char *name, sdb_time_t last_update)
+{
+	batch_entry_t *e;
+	sdb_data_t d;
+
+	if ((! batch) || (! hostname) || (! name))
+		return -1;
+	if (! (e = batch_add(batch, SDB_SERVICE, hostname, name, last_update)))
+		return -1;
+
+	/* record the hostname as an attribute */
+	d.type = SDB_TYPE_STRING;
+	d.data.string = e->hostname;
+	return batch_add_attribute(batch, SDB_SERVICE, e->hostname, name,
+			"hostname", &d, e->last_update);
+} /* sdb_plugin_store_batch_service */
+
+int
+sdb_plugin_store_batch_metric(sdb_plugin_batch_t *batch,
+		const char *hostname, const char *name,
+		sdb_metric_store_t *store, sdb_time_t last_update)
+{
+	batch_entry_t *e;
+	sdb_data_t d;
+
+	if ((! batch) || (! hostname) || (! name))
+		return -1;
+	if (! (e = batch_add(batch, SDB_METRIC, hostname, name, last_update)))
+		return -1;
+
+	if (store && store->type && store->id) {
+		e->has_store = 1;
+		e->store_type = strdup(store->type);
+		e->store_id = strdup(store->id);
+		e->store_last_update = store->last_update < last_update
+			? last_update : store->last_update;
+		if ((! e->store_type) || (! e->store_id)) {
+			sdb_log(SDB_LOG_ERR, "strdup failed");
+			batch_entry_clear(e);
+			--batch->entries_num;
+			return -1;
+		}
+	}
+
+	/* record the hostname as an attribute */
+	d.type = SDB_TYPE_STRING;
+	d.data.string = e->hostname;
+	return batch_add_attribute(batch, SDB_METRIC, e->hostname, name,
+			"hostname", &d, e->last_update);
+} /* sdb_plugin_store_batch_metric */
+
+int
+sdb_plugin_store_batch_attribute(sdb_plugin_batch_t *batch,
+		const char *hostname, const char *key, const sdb_data_t *value,
+		sdb_time_t last_update)
+{
+	return batch_add_attribute(batch, SDB_HOST, hostname, hostname,
+			key, value, last_update);
+} /* sdb_plugin_store_batch_attribute */
+
+int
+sdb_plugin_store_batch_service_attribute(sdb_plugin_batch_t *batch,
+		const char *hostname, const char *service,
+		const char *key, const sdb_data_t *value, sdb_time_t last_update)
+{
+	return batch_add_attribute(batch, SDB_SERVICE, hostname, service,
+			key, value, last_update);
+} /* sdb_plugin_store_batch_service_attribute */
+
+int
+sdb_plugin_store_batch_metric_attribute(sdb_plugin_batch_t *batch,
+		const char *hostname, const char *metric,
+		const char *key, const sdb_data_t *value, sdb_time_t last_update)
+{
+	return batch_add_attribute(batch, SDB_METRIC, hostname, metric,
+			key, value, last_update);
+} /* sdb_plugin_store_batch_metric_attribute */
+
+int
+sdb_plugin_store_batch_commit(sdb_plugin_batch_t *batch)
+{
+	sdb_store_batch_entry_t *entries;
+	sdb_metric_store_t *stores;
+
+	sdb_llist_iter_t *iter;
+	int status = 0;
+	size_t i;
+
+	if (! batch)
+		return -1;
+	if (! batch->entries_num)
+		return 0;
+
+	if (! sdb_llist_len(writer_list)) {
+		sdb_log(SDB_LOG_ERR, "Cannot store batch: no writers registered");
+		batch_clear(batch);
+		return -1;
+	}
+
+	entries = calloc(batch->entries_num, sizeof(*entries));
+	stores = calloc(batch->entries_num, sizeof(*stores));
+	if ((! entries) || (! stores)) {
+		sdb_log(SDB_LOG_ERR, "Failed to store batch: out of memory");
+		free(entries);
+		free(stores);
+		batch_clear(batch);
+		return -1;
+	}
+
+	for (i = 0; i < batch->entries_num; ++i)
+		batch_entry_get(batch->entries + i, entries + i, stores + i);
+
+	iter = sdb_llist_get_iter(writer_list);
+	while (sdb_llist_iter_has_next(iter)) {
+		writer_t *writer = WRITER(sdb_llist_iter_get_next(iter));
+		int s;
+		assert(writer);
+		if (writer->impl.store_batch)
+			s = writer->impl.store_batch(entries, batch->entries_num,
+					writer->w_user_data);
+		else
+			s = writer_store_each(writer, entries, batch->entries_num);
+		if (((s > 0) && (status >= 0)) || (s < 0))
+			status = s;
+	}
+	sdb_llist_iter_destroy(iter);
+
+	free(entries);
+	free(stores);
+	batch_clear(batch);
+	return status;
+} /* sdb_plugin_store_batch_commit */
+
 /* vim: set tw=78 sw=4 ts=4 noexpandtab : */
 
@@ -61,6 +61,14 @@ struct sdb_store_json_formatter {
 
 	int type;
 	int flags;
+
+	/* the fields to include (a bit-mask of SDB_FIELD_MASK values) */
+	int fields;
+
+	/* pass on the output once it reaches 'flush_size' bytes (optional) */
+	sdb_store_json_flush_cb flush;
+	void *flush_data;
+	size_t flush_size;
 };
 #define F(obj) ((sdb_store_json_formatter_t *)(obj))
 
@@ -78,6 +86,10 @@ formatter_init(sdb_object_t *obj, va_list ap)
 		return -1;
 
 	f->flags = va_arg(ap, int);
+	f->fields = -1;
+	f->flush = NULL;
+	f->flush_data = NULL;
+	f->flush_size = 0;
 
 	f->context[0] = 0;
 	f->current = 0;
@@ -203,6 +215,30 @@ handle_new_object(sdb_store_json_formatter_t *f, int type)
 	return 0;
 } /* handle_new_object */
 
+static void
+json_value(sdb_store_json_formatter_t *f, const sdb_data_t *value)
+{
+	char tmp[sdb_data_strlen(value) + 1];
+	char val[2 * sizeof(tmp) + 3];
+
+	if (sdb_data_isnull(value)) {
+		sdb_strbuf_append(f->buf, "null");
+		return;
+	}
+
+	if (! sdb_data_format(value, tmp, sizeof(tmp), SDB_DOUBLE_QUOTED))
+		snprintf(tmp, sizeof(tmp), "<error>");
+
+	if (tmp[0] == '"') {
+		/* a string; escape_string handles quoting */
+		tmp[strlen(tmp) - 1] = '\0';
+		escape_string(tmp + 1, val);
+		sdb_strbuf_append(f->buf, "%s", val);
+	}
+	else
+		sdb_strbuf_append(f->buf, "%s", tmp);
+} /* json_value */
+
 static int
 json_emit(sdb_store_json_formatter_t *f, obj_t *obj)
 {
@@ -216,31 +252,20 @@ json_emit(sdb_store_json_formatter_t *f, obj_t *obj)
 	handle_new_object(f, obj->type);
 
 	escape_string(obj->name, name);
-	sdb_strbuf_append(f->buf, "{\"name\": %s, ", name);
+	sdb_strbuf_append(f->buf, "{\"name\": %s", name);
 	if ((obj->type == SDB_ATTRIBUTE) && (obj->value)) {
-		char tmp[sdb_data_strlen(obj->value) + 1];
-		char val[2 * sizeof(tmp) + 3];
-		if (! sdb_data_format(obj->value, tmp, sizeof(tmp),
-					SDB_DOUBLE_QUOTED))
-			snprintf(tmp, sizeof(tmp), "<error>");
-
-		if (tmp[0] == '"') {
-			/* a string; escape_string handles quoting */
-			tmp[strlen(tmp) - 1] = '\0';
-			escape_string(tmp + 1, val);
-			sdb_strbuf_append(f->buf, "\"value\": %s, ", val);
-		}
-		else
-			sdb_strbuf_append(f->buf, "\"value\": %s, ", tmp);
+		sdb_strbuf_append(f->buf, ", \"value\": ");
+		json_value(f, obj->value);
 	}
-	else if ((obj->type == SDB_METRIC) && (obj->timeseries >= 0)) {
+	else if ((obj->type == SDB_METRIC) && (obj->timeseries >= 0)
+			&& (f->fields & SDB_FIELD_MASK(SDB_FIELD_TIMESERIES))) {
 		if (obj->timeseries)
-			sdb_strbuf_append(f->buf, "\"timeseries\": true, ");
+			sdb_strbuf_append(f->buf, ", \"timeseries\": true");
 		else
-			sdb_strbuf_append(f->buf, "\"timeseries\": false, ");
+			sdb_strbuf_append(f->buf, ", \"timeseries\": false");
 
 		if (obj->data_names_len > 0) {
-			sdb_strbuf_append(f->buf, "\"data_names\": [");
+			sdb_strbuf_append(f->buf, ", \"data_names\": [");
 			for (i = 0; i < obj->data_names_len; i++) {
 				char dn[2 * strlen(obj->data_names[i]) + 3];
 				escape_string(obj->data_names[i], dn);
@@ -248,30 +273,36 @@ json_emit(sdb_store_json_formatter_t *f, obj_t *obj)
 				if (i < obj->data_names_len - 1)
 					sdb_strbuf_append(f->buf, ", ");
 			}
-			sdb_strbuf_append(f->buf, "], ");
+			sdb_strbuf_append(f->buf, "]");
 		}
 	}
 
 	/* TODO: make time and interval formats configurable */
-	if (! sdb_strftime(time_str, sizeof(time_str), obj->last_update))
-		snprintf(time_str, sizeof(time_str), "<error>");
-	time_str[sizeof(time_str) - 1] = '\0';
-
-	if (! sdb_strfinterval(interval_str, sizeof(interval_str),
-				obj->interval))
-		snprintf(interval_str, sizeof(interval_str), "<error>");
-	interval_str[sizeof(interval_str) - 1] = '\0';
-
-	sdb_strbuf_append(f->buf, "\"last_update\": \"%s\", "
-			"\"update_interval\": \"%s\", \"backends\": [",
-			time_str, interval_str);
-
-	for (i = 0; i < obj->backends_num; ++i) {
-		sdb_strbuf_append(f->buf, "\"%s\"", obj->backends[i]);
-		if (i < obj->backends_num - 1)
-			sdb_strbuf_append(f->buf, ",");
+	if (f->fields & SDB_FIELD_MASK(SDB_FIELD_LAST_UPDATE)) {
+		if (! sdb_strftime(time_str, sizeof(time_str), obj->last_update))
+			snprintf(time_str, sizeof(time_str), "<error>");
+		time_str[sizeof(time_str) - 1] = '\0';
+		sdb_strbuf_append(f->buf, ", \"last_update\": \"%s\"", time_str);
+	}
+
+	if (f->fields & SDB_FIELD_MASK(SDB_FIELD_INTERVAL)) {
+		if (! sdb_strfinterval(interval_str, sizeof(interval_str),
+					obj->interval))
+			snprintf(interval_str, sizeof(interval_str), "<error>");
+		interval_str[sizeof(interval_str) - 1] = '\0';
+		sdb_strbuf_append(f->buf, ", \"update_interval\": \"%s\"",
+				interval_str);
+	}
+
+	if (f->fields & SDB_FIELD_MASK(SDB_FIELD_BACKEND)) {
+		sdb_strbuf_append(f->buf, ", \"backends\": [");
+		for (i = 0; i < obj->backends_num; ++i) {
+			sdb_strbuf_append(f->buf, "\"%s\"", obj->backends[i]);
+			if (i < obj->backends_num - 1)
+				sdb_strbuf_append(f->buf, ",");
+		}
+		sdb_strbuf_append(f->buf, "]");
 	}
-	sdb_strbuf_append(f->buf, "]");
 	return 0;
 } /* json_emit */
 
@@ -402,12 +433,53 @@ emit_attribute(sdb_store_attribute_t *attr, sdb_object_t *user_data)
 	}
 } /* emit_attribute */
 
+/* Emit a single (group) count as a plain object; counts never have any
+ * children, so the context only tracks whether anything was emitted yet. */
+static int
+emit_count(const sdb_data_t *value, int64_t count, sdb_object_t *user_data)
+{
+	sdb_store_json_formatter_t *f = F(user_data);
+
+	if (! user_data)
+		return -1;
+
+	if (! f->context[0]) {
+		if (f->flags & SDB_WANT_ARRAY)
+			sdb_strbuf_append(f->buf, "[");
+		f->context[0] = f->type;
+	}
+	else {
+		assert(f->current == 0);
+		sdb_strbuf_append(f->buf, "},");
+	}
+
+	sdb_strbuf_append(f->buf, "{");
+	if (value) {
+		sdb_strbuf_append(f->buf, "\"value\": ");
+		json_value(f, value);
+		sdb_strbuf_append(f->buf, ", ");
+	}
+	sdb_strbuf_append(f->buf, "\"count\": %"PRId64, count);
+	return 0;
+} /* emit_count */
+
+static int
+emit_flush(sdb_object_t *user_data)
+{
+	sdb_store_json_formatter_t *f = F(user_data);
+
+	if ((! f->flush) || (sdb_strbuf_len(f->buf) < f->flush_size))
+		return 0;
+	return f->flush(f->buf, f->flush_data);
+} /* emit_flush */
+
 /*
  * public API
  */
 
 sdb_store_writer_t sdb_store_json_writer = {
-	emit_host, emit_service, emit_metric, emit_attribute,
+	emit_host, emit_service, emit_metric, emit_attribute, NULL, emit_count,
+	emit_flush,
 };
 
 sdb_store_json_formatter_t *
@@ -417,6 +489,27 @@ sdb_store_json_formatter(sdb_strbuf_t *buf, int type, int flags)
 				buf, type, flags));
 } /* sdb_store_json_formatter */
 
+int
+sdb_store_json_select(sdb_store_json_formatter_t *f, int fields)
+{
+	if (! f)
+		return -1;
+	f->fields = fields;
+	return 0;
+} /* sdb_store_json_select */
+
+int
+sdb_store_json_set_flush(sdb_store_json_formatter_t *f, size_t size,
+		sdb_store_json_flush_cb flush, void *user_data)
+{
+	if (! f)
+		return -1;
+	f->flush = flush;
+	f->flush_data = user_data;
+	f->flush_size = size;
+	return 0;
+} /* sdb_store_json_set_flush */
+
 int
 sdb_store_json_finish(sdb_store_json_formatter_t *f)
 {
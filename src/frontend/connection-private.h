@@ -41,6 +41,7 @@
 
 #include <inttypes.h>
 #include <arpa/inet.h>
+#include <sys/uio.h>
 
 #include <stdlib.h>
 
@@ -48,6 +49,9 @@
 extern "C" {
 #endif
 
+/* a message queued for sending */
+typedef struct sdb_conn_msg sdb_conn_msg_t;
+
 struct sdb_conn {
 	sdb_object_t super;
 
@@ -61,11 +65,25 @@ struct sdb_conn {
 	/* connection handling */
 	ssize_t (*read)(sdb_conn_t *, size_t);
 	ssize_t (*write)(sdb_conn_t *, const void *, size_t);
+	/* optional; used to write multiple messages at once */
+	ssize_t (*writev)(sdb_conn_t *, const struct iovec *, int);
 	int (*finish)(sdb_conn_t *);
 	sdb_ssl_session_t *ssl_session;
 
-	/* read buffer */
+	/* read buffer; data is read directly into the buffer in chunks of
+	 * 'read_size' bytes which adapts to the amount of incoming data */
 	sdb_strbuf_t *buf;
+	size_t read_size;
+
+	/* output queue; writing never blocks, messages which could not be sent
+	 * right away are written once the connection becomes writable */
+	sdb_conn_msg_t *out_head;
+	sdb_conn_msg_t *out_tail;
+	size_t out_len; /* number of bytes queued */
+
+	/* the peer finished sending; close the connection after sending all
+	 * queued messages */
+	bool closing;
 
 	/* connection / protocol state information */
 	uint32_t cmd;
@@ -80,6 +98,9 @@ struct sdb_conn {
 	/* user information */
 	char *username; /* NULL if the user has not been authenticated */
 	bool  ready; /* indicates that startup finished successfully */
+
+	/* send the result of data queries in chunks */
+	bool chunked;
 };
 #define CONN(obj) ((sdb_conn_t *)(obj))
 
@@ -43,6 +43,7 @@
 
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <poll.h>
 
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -52,6 +53,7 @@
 
 #include <pthread.h>
 #include <netdb.h>
+#include <unistd.h>
 
 /*
  * private variables
@@ -68,6 +70,24 @@ static bool          conn_ctx_key_initialized = 0;
 #define CONN_FD_PREFIX "conn#"
 #define CONN_FD_PLACEHOLDER "XXXXXXX"
 
+struct sdb_conn_msg {
+	sdb_conn_msg_t *next;
+	size_t len;
+	size_t sent;
+	char data[];
+};
+
+/* maximum number of messages to write at once */
+#define CONN_IOV_MAX 16
+
+/* maximum time (in milliseconds) to wait for a client to accept more data
+ * while draining the output queue */
+#define CONN_DRAIN_TIMEOUT (60 * 1000)
+
+/* bounds of the amount of data to read at once */
+#define CONN_READ_MIN 4096
+#define CONN_READ_MAX (256 * 1024)
+
 static ssize_t
 conn_read(sdb_conn_t *conn, size_t len)
 {
@@ -77,9 +97,51 @@ conn_read(sdb_conn_t *conn, size_t len)
 static ssize_t
 conn_write(sdb_conn_t *conn, const void *buf, size_t len)
 {
-	return sdb_write(conn->fd, len, buf);
+	return write(conn->fd, buf, len);
 } /* conn_write */
 
+static ssize_t
+conn_writev(sdb_conn_t *conn, const struct iovec *iov, int iovcnt)
+{
+	return writev(conn->fd, iov, iovcnt);
+} /* conn_writev */
+
+static void
+conn_clear_output(sdb_conn_t *conn)
+{
+	while (conn->out_head) {
+		sdb_conn_msg_t *msg = conn->out_head;
+		conn->out_head = msg->next;
+		free(msg);
+	}
+	conn->out_tail = NULL;
+	conn->out_len = 0;
+} /* conn_clear_output */
+
+/* Remove 'n' bytes written to the connection from the output queue. */
+static void
+conn_consume_output(sdb_conn_t *conn, size_t n)
+{
+	assert(n <= conn->out_len);
+	conn->out_len -= n;
+
+	while (n > 0) {
+		sdb_conn_msg_t *msg = conn->out_head;
+		size_t len = msg->len - msg->sent;
+
+		if (n < len) {
+			msg->sent += n;
+			break;
+		}
+
+		n -= len;
+		conn->out_head = msg->next;
+		if (! conn->out_head)
+			conn->out_tail = NULL;
+		free(msg);
+	}
+} /* conn_consume_output */
+
 static int
 connection_init(sdb_object_t *obj, va_list ap)
 {
@@ -93,6 +155,7 @@ connection_init(sdb_object_t *obj, va_list ap)
 	sock_fd = va_arg(ap, int);
 
 	conn->buf = sdb_strbuf_create(/* size = */ 128);
+	conn->read_size = CONN_READ_MIN;
 	if (! conn->buf) {
 		sdb_log(SDB_LOG_ERR, "frontend: Failed to allocate a read buffer "
 				"for a new connection");
@@ -124,9 +187,14 @@ connection_init(sdb_object_t *obj, va_list ap)
 	/* defaults */
 	conn->read = conn_read;
 	conn->write = conn_write;
+	conn->writev = conn_writev;
 	conn->finish = NULL;
 	conn->ssl_session = NULL;
 
+	conn->out_head = conn->out_tail = NULL;
+	conn->out_len = 0;
+	conn->closing = 0;
+
 	sock_fl = fcntl(conn->fd, F_GETFL);
 	if (fcntl(conn->fd, F_SETFL, sock_fl | O_NONBLOCK)) {
 		char buf[1024];
@@ -138,6 +206,7 @@ connection_init(sdb_object_t *obj, va_list ap)
 
 	conn->username = NULL;
 	conn->ready = 0;
+	conn->chunked = 0;
 
 	sdb_log(SDB_LOG_DEBUG, "frontend: Accepted connection on fd=%i",
 			conn->fd);
@@ -192,6 +261,7 @@ connection_destroy(sdb_object_t *obj)
 	conn->buf = NULL;
 	sdb_strbuf_destroy(conn->errbuf);
 	conn->errbuf = NULL;
+	conn_clear_output(conn);
 } /* connection_destroy */
 
 static sdb_type_t connection_type = {
@@ -309,6 +379,8 @@ command_handle(sdb_conn_t *conn)
 
 	else if (conn->cmd == SDB_CONNECTION_SERVER_VERSION)
 		status = sdb_connection_server_version(conn);
+	else if (conn->cmd == SDB_CONNECTION_CHUNKED)
+		status = sdb_connection_chunked(conn);
 
 	else {
 		sdb_log(SDB_LOG_WARNING, "frontend: Ignoring invalid command %#x",
@@ -382,8 +454,11 @@ connection_read(sdb_conn_t *conn)
 	while (42) {
 		ssize_t status;
 
+		if (conn->read_size < CONN_READ_MIN)
+			conn->read_size = CONN_READ_MIN;
+
 		errno = 0;
-		status = conn->read(conn, 1024);
+		status = conn->read(conn, conn->read_size);
 		if (status < 0) {
 			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
 				break;
@@ -394,6 +469,15 @@ connection_read(sdb_conn_t *conn)
 		else if (! status) /* EOF */
 			break;
 
+		/* read larger chunks during bulk transfers, only using large
+		 * amounts of memory while they last */
+		if (((size_t)status == conn->read_size)
+				&& (conn->read_size < CONN_READ_MAX))
+			conn->read_size *= 2;
+		else if (((size_t)status < conn->read_size / 4)
+				&& (conn->read_size > CONN_READ_MIN))
+			conn->read_size /= 2;
+
 		if (conn->skip_len) {
 			size_t len = (size_t)status < conn->skip_len
 				? (size_t)status : conn->skip_len;
@@ -473,6 +557,9 @@ sdb_connection_close(sdb_conn_t *conn)
 	if (conn->fd >= 0)
 		close(conn->fd);
 	conn->fd = -1;
+
+	/* nothing can be sent anymore */
+	conn_clear_output(conn);
 } /* sdb_connection_close */
 
 ssize_t
@@ -485,11 +572,17 @@ sdb_connection_handle(sdb_conn_t *conn)
 	while (42) {
 		ssize_t status = connection_read(conn);
 
-		if ((conn->cmd == SDB_CONNECTION_IDLE) && (! conn->cmd_len)
-				&& (sdb_strbuf_len(conn->buf) >= 2 * sizeof(int32_t)))
-			command_init(conn);
-		if ((conn->cmd != SDB_CONNECTION_IDLE)
-				&& (sdb_strbuf_len(conn->buf) >= conn->cmd_len)) {
+		/* clients may send multiple commands without waiting for the
+		 * replies (pipelining); handle all complete commands in order */
+		while (conn->fd >= 0) {
+			if ((conn->cmd == SDB_CONNECTION_IDLE) && (! conn->cmd_len)
+					&& (! conn->skip_len)
+					&& (sdb_strbuf_len(conn->buf) >= 2 * sizeof(int32_t)))
+				command_init(conn);
+			if ((conn->cmd == SDB_CONNECTION_IDLE)
+					|| (sdb_strbuf_len(conn->buf) < conn->cmd_len))
+				break;
+
 			command_handle(conn);
 
 			/* remove the command from the buffer */
@@ -510,33 +603,134 @@ sdb_connection_handle(sdb_conn_t *conn)
 } /* sdb_connection_handle */
 
 ssize_t
-sdb_connection_send(sdb_conn_t *conn, uint32_t code,
+sdb_connection_queue(sdb_conn_t *conn, uint32_t code,
 		uint32_t msg_len, const char *msg)
 {
-	char buf[2 * sizeof(uint32_t) + msg_len];
-	ssize_t status;
+	size_t len = 2 * sizeof(uint32_t) + msg_len;
+	sdb_conn_msg_t *m;
 
 	if ((! conn) || (conn->fd < 0))
 		return -1;
-	if (sdb_proto_marshal(buf, sizeof(buf), code, msg_len, msg) < 0)
+
+	m = malloc(sizeof(*m) + len);
+	if (! m)
+		return -1;
+	if (sdb_proto_marshal(m->data, len, code, msg_len, msg) < 0) {
+		free(m);
 		return -1;
+	}
+	m->next = NULL;
+	m->len = len;
+	m->sent = 0;
+
+	if (conn->out_tail)
+		conn->out_tail->next = m;
+	else
+		conn->out_head = m;
+	conn->out_tail = m;
+	conn->out_len += len;
+	return (ssize_t)len;
+} /* sdb_connection_queue */
 
-	status = conn->write(conn, buf, sizeof(buf));
-	if (status < 0) {
-		char errbuf[1024];
+ssize_t
+sdb_connection_send(sdb_conn_t *conn, uint32_t code,
+		uint32_t msg_len, const char *msg)
+{
+	ssize_t len;
 
-		/* tell other code that there was a problem and, more importantly,
-		 * make sure we don't try to send further logs to the connection */
-		sdb_connection_close(conn);
-		conn->ready = 0;
+	len = sdb_connection_queue(conn, code, msg_len, msg);
+	if (len < 0)
+		return len;
 
+	/* try to send right away; the rest will be sent
+	 * once the connection becomes writable */
+	if (sdb_connection_flush(conn) < 0) {
 		sdb_log(SDB_LOG_ERR, "frontend: Failed to send msg "
-				"(code: %u, len: %u) to client: %s", code, msg_len,
-				sdb_strerror(errno, errbuf, sizeof(errbuf)));
+				"(code: %u, len: %u) to client", code, msg_len);
+		return -1;
 	}
-	return status;
+	return len;
 } /* sdb_connection_send */
 
+ssize_t
+sdb_connection_flush(sdb_conn_t *conn)
+{
+	if ((! conn) || (conn->fd < 0))
+		return -1;
+
+	while (conn->out_head) {
+		sdb_conn_msg_t *m = conn->out_head;
+		ssize_t status;
+
+		errno = 0;
+		if (conn->writev && m->next) {
+			struct iovec iov[CONN_IOV_MAX];
+			int n = 0;
+
+			for ( ; m && (n < CONN_IOV_MAX); m = m->next, ++n) {
+				iov[n].iov_base = m->data + m->sent;
+				iov[n].iov_len = m->len - m->sent;
+			}
+			status = conn->writev(conn, iov, n);
+		}
+		else
+			status = conn->write(conn, m->data + m->sent, m->len - m->sent);
+
+		if (status < 0) {
+			char errbuf[1024];
+
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				break;
+			if (errno == EINTR)
+				continue;
+
+			sdb_log(SDB_LOG_ERR, "frontend: Failed to write to connection "
+					"%s: %s", SDB_OBJ(conn)->name,
+					sdb_strerror(errno, errbuf, sizeof(errbuf)));
+
+			/* tell other code that there was a problem and, more
+			 * importantly, make sure we don't try to send further logs to
+			 * the connection */
+			sdb_connection_close(conn);
+			conn->ready = 0;
+			return -1;
+		}
+		else if (! status)
+			break;
+
+		conn_consume_output(conn, (size_t)status);
+	}
+	return (ssize_t)conn->out_len;
+} /* sdb_connection_flush */
+
+ssize_t
+sdb_connection_drain(sdb_conn_t *conn, size_t max_len)
+{
+	ssize_t len = sdb_connection_flush(conn);
+
+	while ((len > 0) && ((size_t)len > max_len)) {
+		struct pollfd pfd = { conn->fd, POLLOUT, 0 };
+		int status;
+
+		status = poll(&pfd, 1, CONN_DRAIN_TIMEOUT);
+		if ((status < 0) && (errno == EINTR))
+			continue;
+		if (status <= 0) {
+			char errbuf[1024];
+
+			sdb_log(SDB_LOG_ERR, "frontend: Failed to wait for connection "
+					"%s to become writable: %s", SDB_OBJ(conn)->name,
+					status ? sdb_strerror(errno, errbuf, sizeof(errbuf))
+						: "client stopped reading");
+			sdb_connection_close(conn);
+			conn->ready = 0;
+			return -1;
+		}
+		len = sdb_connection_flush(conn);
+	}
+	return len;
+} /* sdb_connection_drain */
+
 int
 sdb_connection_ping(sdb_conn_t *conn)
 {
@@ -548,6 +742,17 @@ sdb_connection_ping(sdb_conn_t *conn)
 	return 0;
 } /* sdb_connection_ping */
 
+int
+sdb_connection_chunked(sdb_conn_t *conn)
+{
+	if ((! conn) || (conn->cmd != SDB_CONNECTION_CHUNKED))
+		return -1;
+
+	conn->chunked = 1;
+	sdb_connection_send(conn, SDB_CONNECTION_OK, 0, NULL);
+	return 0;
+} /* sdb_connection_chunked */
+
 int
 sdb_connection_server_version(sdb_conn_t *conn)
 {
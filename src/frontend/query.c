@@ -43,6 +43,14 @@
 #include <ctype.h>
 #include <string.h>
 
+/* the minimum size of chunks of the result of a data query */
+#define CHUNK_SIZE (64 * 1024)
+
+/* the maximum number of bytes queued for a connection while sending the
+ * result of a data query in chunks; the query waits for the client to
+ * accept more data before queuing any further chunks */
+#define CHUNKS_QUEUED_MAX (4 * CHUNK_SIZE)
+
 /*
  * metric fetcher:
  * Implements the callbacks necessary to read a metric object.
@@ -86,7 +94,7 @@ metric_fetcher_metric(sdb_store_metric_t *metric, sdb_object_t *user_data)
 } /* metric_fetcher_metric */
 
 static sdb_store_writer_t metric_fetcher = {
-	metric_fetcher_host, NULL, metric_fetcher_metric, NULL,
+	metric_fetcher_host, NULL, metric_fetcher_metric, NULL, NULL, NULL, NULL,
 };
 
 /*
@@ -105,10 +113,44 @@ sstrlen(const char *s)
 	return s ? strlen(s) : 0;
 } /* sstrlen */
 
+/* Returns the mask of fields selected by a SELECT clause. */
 static int
-exec_query(sdb_ast_node_t *ast, sdb_strbuf_t *buf, sdb_strbuf_t *errbuf)
+select_fields(sdb_ast_node_t **select, size_t select_num)
 {
+	int fields = 0;
+	size_t i;
+
+	for (i = 0; i < select_num; ++i)
+		if (SDB_AST_VALUE(select[i])->type != SDB_ATTRIBUTE)
+			fields |= SDB_FIELD_MASK(SDB_AST_VALUE(select[i])->type);
+	return fields;
+} /* select_fields */
+
+/* Send the result formatted so far as a chunk. The buffer starts with the
+ * result type which is kept for the next chunk. The store calls this while
+ * not holding any locks, so it may block until the client catches up. */
+static int
+send_chunk(sdb_strbuf_t *buf, void *user_data)
+{
+	sdb_conn_t *conn = user_data;
+	size_t len = sdb_strbuf_len(buf);
+
+	if (sdb_connection_queue(conn, SDB_CONNECTION_DATA_CHUNK,
+				(uint32_t)len, sdb_strbuf_string(buf)) < 0)
+		return -1;
+	sdb_strbuf_skip(buf, sizeof(uint32_t), len - sizeof(uint32_t));
+	if (sdb_connection_drain(conn, CHUNKS_QUEUED_MAX) < 0)
+		return -1;
+	return 0;
+} /* send_chunk */
+
+static int
+exec_query(sdb_conn_t *conn, sdb_ast_node_t *ast, sdb_strbuf_t *buf)
+{
+	sdb_strbuf_t *errbuf = conn->errbuf;
 	sdb_store_json_formatter_t *f;
+	sdb_ast_node_t **select = NULL;
+	size_t select_num = 0;
 	int type = 0, flags = 0;
 	uint32_t res_type = 0;
 	int status;
@@ -121,13 +163,23 @@ exec_query(sdb_ast_node_t *ast, sdb_strbuf_t *buf, sdb_strbuf_t *errbuf)
 	case SDB_AST_TYPE_LIST:
 		type = SDB_AST_LIST(ast)->obj_type;
 		flags = SDB_WANT_ARRAY;
+		select = SDB_AST_LIST(ast)->select;
+		select_num = SDB_AST_LIST(ast)->select_num;
 		res_type = htonl(SDB_CONNECTION_LIST);
 		break;
 	case SDB_AST_TYPE_LOOKUP:
 		type = SDB_AST_LOOKUP(ast)->obj_type;
 		flags = SDB_WANT_ARRAY;
+		select = SDB_AST_LOOKUP(ast)->select;
+		select_num = SDB_AST_LOOKUP(ast)->select_num;
 		res_type = htonl(SDB_CONNECTION_LOOKUP);
 		break;
+	case SDB_AST_TYPE_COUNT:
+		type = SDB_AST_COUNT(ast)->obj_type;
+		if (SDB_AST_COUNT(ast)->group_by)
+			flags = SDB_WANT_ARRAY;
+		res_type = htonl(SDB_CONNECTION_COUNT);
+		break;
 	default:
 		sdb_strbuf_sprintf(errbuf, "invalid command %s (%#x)",
 				SDB_AST_TYPE_TO_STRING(ast), ast->type);
@@ -135,7 +187,11 @@ exec_query(sdb_ast_node_t *ast, sdb_strbuf_t *buf, sdb_strbuf_t *errbuf)
 	}
 
 	f = sdb_store_json_formatter(buf, type, flags);
+	if (select)
+		sdb_store_json_select(f, select_fields(select, select_num));
 	sdb_strbuf_memcpy(buf, &res_type, sizeof(res_type));
+	if (conn->chunked)
+		sdb_store_json_set_flush(f, CHUNK_SIZE, send_chunk, conn);
 	status = sdb_plugin_query(ast, &sdb_store_json_writer, SDB_OBJ(f),
 			&(sdb_query_opts_t){ true }, errbuf);
 	if (status < 0)
@@ -286,6 +342,15 @@ exec_timeseries(sdb_ast_timeseries_t *ts, sdb_strbuf_t *buf, sdb_strbuf_t *errbu
 	return status;
 } /* exec_timeseries */
 
+static int
+exec_explain(sdb_ast_explain_t *explain, sdb_strbuf_t *buf,
+		sdb_strbuf_t *errbuf)
+{
+	if (sdb_plugin_explain(explain->query, buf, errbuf) < 0)
+		return -1;
+	return SDB_CONNECTION_OK;
+} /* exec_explain */
+
 static int
 exec_cmd(sdb_conn_t *conn, sdb_ast_node_t *ast)
 {
@@ -307,8 +372,10 @@ exec_cmd(sdb_conn_t *conn, sdb_ast_node_t *ast)
 		status = exec_store(SDB_AST_STORE(ast), buf, conn->errbuf);
 	else if (ast->type == SDB_AST_TYPE_TIMESERIES)
 		status = exec_timeseries(SDB_AST_TIMESERIES(ast), buf, conn->errbuf);
+	else if (ast->type == SDB_AST_TYPE_EXPLAIN)
+		status = exec_explain(SDB_AST_EXPLAIN(ast), buf, conn->errbuf);
 	else
-		status = exec_query(ast, buf, conn->errbuf);
+		status = exec_query(conn, ast, buf);
 
 	if (status < 0) {
 		char query[conn->cmd_len + 1];
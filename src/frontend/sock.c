@@ -34,7 +34,6 @@
 #include "frontend/connection-private.h"
 #include "frontend/sock.h"
 
-#include "utils/channel.h"
 #include "utils/error.h"
 #include "utils/llist.h"
 #include "utils/os.h"
@@ -52,7 +51,6 @@
 
 #include <sys/time.h>
 #include <sys/types.h>
-#include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/param.h>
 #include <sys/un.h>
@@ -69,8 +67,13 @@
 #include <fcntl.h>
 #include <netdb.h>
 #include <libgen.h>
+#include <poll.h>
 #include <pthread.h>
 
+#ifdef HAVE_SYS_EPOLL_H
+#	include <sys/epoll.h>
+#endif
+
 /*
  * private data types
  */
@@ -96,22 +99,43 @@ typedef struct {
 	void (*close)(listener_t *);
 } fe_listener_impl_t;
 
-struct sdb_fe_socket {
-	listener_t *listeners;
-	size_t listeners_num;
+/* a connection handler thread running its own event loop */
+typedef struct {
+	pthread_t thread;
+
+	/* the handler shuts down when this is set to false */
+	bool running;
 
-	/* list of open, idle connections; active connections will be passed on to
-	 * the connection handler threads which place them back after handling
-	 * pending actions; the trigger pipe is used to notify the main thread
-	 * after adding a connection (back) to the list */
-	sdb_llist_t *open_connections;
+	/* connections accepted by the main thread which have not been picked up
+	 * by the handler yet; the trigger pipe is used to notify the handler
+	 * about new connections and about shutting down */
+	sdb_llist_t *new_connections;
 	int trigger[2];
 #define TRIGGER_READ 0
 #define TRIGGER_WRITE 1
 
-	/* channel used for communication between main
-	 * and connection handler threads */
-	sdb_channel_t *chan;
+	/* open connections owned by the handler, indexed by file descriptor */
+	sdb_conn_t **conns;
+	size_t conns_len;
+
+#ifdef HAVE_SYS_EPOLL_H
+	int epoll_fd;
+#else
+	/* poll() set; the trigger is the first element */
+	struct pollfd *pollfds;
+#endif
+} handler_t;
+
+struct sdb_fe_socket {
+	listener_t *listeners;
+	size_t listeners_num;
+
+	/* connection handler threads; accepted connections are assigned to them
+	 * in a round-robin fashion and remain with their handler until they are
+	 * closed */
+	handler_t *handlers;
+	size_t handlers_num;
+	size_t next_handler;
 };
 
 /*
@@ -121,14 +145,19 @@ struct sdb_fe_socket {
 static ssize_t
 ssl_read(sdb_conn_t *conn, size_t n)
 {
-	char buf[n];
+	char *buf;
 	ssize_t ret;
 
+	/* decrypt directly into the connection's buffer */
+	buf = sdb_strbuf_reserve(conn->buf, n);
+	if (! buf)
+		return -1;
+
 	ret = sdb_ssl_session_read(conn->ssl_session, buf, n);
 	if (ret <= 0)
 		return ret;
 
-	sdb_strbuf_memappend(conn->buf, buf, ret);
+	sdb_strbuf_commit(conn->buf, (size_t)ret);
 	return ret;
 } /* ssl_read */
 
@@ -280,6 +309,7 @@ setup_tcp(sdb_conn_t *conn, void *user_data)
 	conn->finish = finish_tcp;
 	conn->read = ssl_read;
 	conn->write = ssl_write;
+	conn->writev = NULL;
 	return 0;
 } /* setup_tcp */
 
@@ -529,55 +559,323 @@ socket_close(sdb_fe_socket_t *sock)
  * connection handler functions
  */
 
-static void *
-connection_handler(void *data)
+static int
+handler_init(handler_t *h)
 {
-	sdb_fe_socket_t *sock = data;
+	int i;
+
+	h->running = 1;
+	h->trigger[TRIGGER_READ] = h->trigger[TRIGGER_WRITE] = -1;
+	h->conns = NULL;
+	h->conns_len = 0;
+#ifdef HAVE_SYS_EPOLL_H
+	h->epoll_fd = -1;
+#else
+	h->pollfds = calloc(1, sizeof(*h->pollfds));
+	if (! h->pollfds)
+		return -1;
+#endif
 
-	assert(sock);
+	h->new_connections = sdb_llist_create();
+	if (! h->new_connections)
+		return -1;
 
-	while (42) {
-		struct timespec timeout = { 0, 500000000 }; /* .5 seconds */
-		sdb_conn_t *conn;
-		int status;
+	if (pipe(h->trigger)) {
+		char errbuf[1024];
+		sdb_log(SDB_LOG_ERR, "frontend: Failed to create pipe: %s",
+				sdb_strerror(errno, errbuf, sizeof(errbuf)));
+		return -1;
+	}
+	for (i = 0; i < 2; ++i) {
+		int flags = fcntl(h->trigger[i], F_GETFL);
+		if (fcntl(h->trigger[i], F_SETFL, flags | O_NONBLOCK)) {
+			char errbuf[1024];
+			sdb_log(SDB_LOG_ERR, "frontend: Failed to switch pipe to "
+					"non-blocking mode: %s",
+					sdb_strerror(errno, errbuf, sizeof(errbuf)));
+			return -1;
+		}
+	}
 
-		errno = 0;
-		status = sdb_channel_select(sock->chan, /* read */ NULL, &conn,
-				/* write */ NULL, NULL, &timeout);
-		if (status) {
-			char buf[1024];
+#ifdef HAVE_SYS_EPOLL_H
+	h->epoll_fd = epoll_create1(0);
+	if (h->epoll_fd < 0) {
+		char errbuf[1024];
+		sdb_log(SDB_LOG_ERR, "frontend: Failed to create epoll instance: %s",
+				sdb_strerror(errno, errbuf, sizeof(errbuf)));
+		return -1;
+	}
+	{
+		/* level-triggered; it's drained on every wakeup anyway */
+		struct epoll_event ev = { EPOLLIN, { .fd = h->trigger[TRIGGER_READ] } };
+		if (epoll_ctl(h->epoll_fd, EPOLL_CTL_ADD,
+					h->trigger[TRIGGER_READ], &ev)) {
+			char errbuf[1024];
+			sdb_log(SDB_LOG_ERR, "frontend: Failed to monitor pipe: %s",
+					sdb_strerror(errno, errbuf, sizeof(errbuf)));
+			return -1;
+		}
+	}
+#endif
+	return 0;
+} /* handler_init */
 
-			if (errno == ETIMEDOUT)
-				continue;
-			if (errno == EBADF) /* channel shut down */
-				break;
+static void
+handler_destroy(handler_t *h)
+{
+	sdb_object_t *obj;
+	size_t i;
 
-			sdb_log(SDB_LOG_ERR, "frontend: Failed to read from channel: %s",
-					sdb_strerror(errno, buf, sizeof(buf)));
-			continue;
+	for (i = 0; i < h->conns_len; ++i)
+		sdb_object_deref(SDB_OBJ(h->conns[i]));
+	if (h->conns)
+		free(h->conns);
+	h->conns = NULL;
+	h->conns_len = 0;
+
+	while ((obj = sdb_llist_shift(h->new_connections)))
+		sdb_object_deref(obj);
+	sdb_llist_destroy(h->new_connections);
+	h->new_connections = NULL;
+
+	if (h->trigger[TRIGGER_WRITE] >= 0)
+		close(h->trigger[TRIGGER_WRITE]);
+	if (h->trigger[TRIGGER_READ] >= 0)
+		close(h->trigger[TRIGGER_READ]);
+	h->trigger[TRIGGER_READ] = h->trigger[TRIGGER_WRITE] = -1;
+
+#ifdef HAVE_SYS_EPOLL_H
+	if (h->epoll_fd >= 0)
+		close(h->epoll_fd);
+	h->epoll_fd = -1;
+#else
+	if (h->pollfds)
+		free(h->pollfds);
+	h->pollfds = NULL;
+#endif
+} /* handler_destroy */
+
+static void
+handler_trigger(handler_t *h)
+{
+	if (write(h->trigger[TRIGGER_WRITE], "", 1) <= 0) {
+		/* This shouldn't happen and it's not critical as long as the pipe
+		 * is not empty; else, the handler will notice on its next timeout. */
+		sdb_log(SDB_LOG_WARNING, "frontend: Failed to trigger "
+				"connection handler");
+	}
+} /* handler_trigger */
+
+/* Take over a connection accepted by the main thread. */
+static int
+handler_add(handler_t *h, sdb_conn_t *conn)
+{
+	size_t fd = (size_t)conn->fd;
+
+	if (conn->fd < 0)
+		return -1;
+
+	if (fd >= h->conns_len) {
+		size_t len = h->conns_len ? h->conns_len : 64;
+		sdb_conn_t **conns;
+
+		while (len <= fd)
+			len *= 2;
+		conns = realloc(h->conns, len * sizeof(*conns));
+		if (! conns)
+			return -1;
+		memset(conns + h->conns_len, 0,
+				(len - h->conns_len) * sizeof(*conns));
+		h->conns = conns;
+		h->conns_len = len;
+
+#ifndef HAVE_SYS_EPOLL_H
+		{
+			struct pollfd *pollfds = realloc(h->pollfds,
+					(len + 1) * sizeof(*pollfds));
+			if (! pollfds)
+				return -1;
+			h->pollfds = pollfds;
 		}
+#endif
+	}
 
-		status = (int)sdb_connection_handle(conn);
-		if (status <= 0) {
-			/* error or EOF -> close connection */
-			sdb_object_deref(SDB_OBJ(conn));
-			continue;
+#ifdef HAVE_SYS_EPOLL_H
+	{
+		/* edge-triggered: connections are always read (written) until
+		 * there's no more data available (writing would block); data which
+		 * arrived before adding the connection is reported right away */
+		struct epoll_event ev = {
+			EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, { .fd = conn->fd },
+		};
+		if (epoll_ctl(h->epoll_fd, EPOLL_CTL_ADD, conn->fd, &ev)) {
+			char errbuf[1024];
+			sdb_log(SDB_LOG_ERR, "frontend: Failed to monitor "
+					"connection %s: %s", SDB_OBJ(conn)->name,
+					sdb_strerror(errno, errbuf, sizeof(errbuf)));
+			return -1;
 		}
+	}
+#endif
 
-		/* return the connection to the main loop */
-		if (sdb_llist_append(sock->open_connections, SDB_OBJ(conn))) {
-			sdb_log(SDB_LOG_ERR, "frontend: Failed to re-append "
-					"connection %s to list of open connections",
-					SDB_OBJ(conn)->name);
+	h->conns[fd] = conn;
+	return 0;
+} /* handler_add */
+
+/* Close the connection on the specified file-descriptor. */
+static void
+handler_remove(handler_t *h, int fd)
+{
+	sdb_conn_t *conn = h->conns[fd];
+
+#ifdef HAVE_SYS_EPOLL_H
+	/* the file-descriptor is removed from the epoll set automatically when
+	 * closing it, but the connection may be referenced elsewhere */
+	if (conn->fd >= 0)
+		epoll_ctl(h->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+#endif
+	h->conns[fd] = NULL;
+	sdb_object_deref(SDB_OBJ(conn));
+} /* handler_remove */
+
+/* Pick up all connections passed on by the main thread. */
+static void
+handler_accept(handler_t *h)
+{
+	sdb_object_t *obj;
+	char buf[1024];
+
+	while (read(h->trigger[TRIGGER_READ], buf, sizeof(buf)) > 0)
+		/* do nothing */;
+
+	while ((obj = sdb_llist_shift(h->new_connections))) {
+		if (handler_add(h, CONN(obj))) {
+			sdb_log(SDB_LOG_ERR, "frontend: Failed to add connection %s "
+					"to connection handler", obj->name);
+			sdb_object_deref(obj);
 		}
-		if (write(sock->trigger[TRIGGER_WRITE], "", 1) <= 0) {
-			/* This shouldn't happen and it's not critical; in the worst cases
-			 * it slows us down. */
-			sdb_log(SDB_LOG_WARNING, "frontend: Failed to trigger main loop");
+		/* else: the handler owns the list's reference now */
+	}
+} /* handler_accept */
+
+/* Handle events on the specified file-descriptor: 'events' is a
+ * combination of POLLIN, POLLOUT, POLLHUP (the peer finished sending), and
+ * POLLERR. Connections are closed on error and after EOF or a hang-up once
+ * all queued output has been written. */
+static void
+handler_handle(handler_t *h, int fd, int events)
+{
+	sdb_conn_t *conn;
+
+	if (((size_t)fd >= h->conns_len) || (! h->conns[fd]))
+		return;
+	conn = h->conns[fd];
+
+	if ((events & POLLIN) && (! conn->closing)) {
+		if ((sdb_connection_handle(conn) <= 0) || (events & POLLHUP))
+			conn->closing = 1;
+	}
+	if (conn->out_len && ((events & POLLOUT) || conn->closing))
+		sdb_connection_flush(conn);
+
+	if ((events & POLLERR) || (conn->fd < 0)
+			|| (conn->closing && (! conn->out_len)))
+		handler_remove(h, fd);
+} /* handler_handle */
+
+#ifdef HAVE_SYS_EPOLL_H
+/* Wait for and handle events; only ready connections are visited. */
+static int
+handler_poll(handler_t *h, int timeout)
+{
+	struct epoll_event events[64];
+	int n, i;
+
+	n = epoll_wait(h->epoll_fd, events, SDB_STATIC_ARRAY_LEN(events), timeout);
+	if (n < 0)
+		return errno == EINTR ? 0 : -1;
+
+	for (i = 0; i < n; ++i) {
+		int ev = 0;
+
+		if (events[i].data.fd == h->trigger[TRIGGER_READ]) {
+			handler_accept(h);
+			continue;
 		}
 
-		/* pass ownership back to list; or destroy in case of an error */
-		sdb_object_deref(SDB_OBJ(conn));
+		if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+			ev |= POLLIN;
+		if (events[i].events & EPOLLOUT)
+			ev |= POLLOUT;
+		if (events[i].events & EPOLLRDHUP)
+			ev |= POLLHUP;
+		if (events[i].events & (EPOLLHUP | EPOLLERR))
+			ev |= POLLERR;
+		handler_handle(h, events[i].data.fd, ev);
+	}
+	return 0;
+} /* handler_poll */
+#else /* HAVE_SYS_EPOLL_H */
+/* Wait for and handle events using poll(); this is the fallback for
+ * systems without epoll support and visits all connections on each call. */
+static int
+handler_poll(handler_t *h, int timeout)
+{
+	nfds_t nfds = 1;
+	size_t i;
+	int n;
+
+	h->pollfds[0].fd = h->trigger[TRIGGER_READ];
+	h->pollfds[0].events = POLLIN;
+	for (i = 0; i < h->conns_len; ++i) {
+		if (! h->conns[i])
+			continue;
+		h->pollfds[nfds].fd = (int)i;
+		h->pollfds[nfds].events = 0;
+		if (! h->conns[i]->closing)
+			h->pollfds[nfds].events |= POLLIN;
+		if (h->conns[i]->out_len)
+			h->pollfds[nfds].events |= POLLOUT;
+		++nfds;
+	}
+
+	n = poll(h->pollfds, nfds, timeout);
+	if (n < 0)
+		return errno == EINTR ? 0 : -1;
+
+	/* the connections are level-triggered, so report hang-ups on the next
+	 * iteration, after reading all remaining data */
+	for (i = 1; i < nfds; ++i) {
+		int ev = 0;
+
+		if (h->pollfds[i].revents & (POLLIN | POLLHUP | POLLERR))
+			ev |= POLLIN;
+		if (h->pollfds[i].revents & POLLOUT)
+			ev |= POLLOUT;
+		if (ev)
+			handler_handle(h, h->pollfds[i].fd, ev);
+	}
+	if (h->pollfds[0].revents)
+		handler_accept(h);
+	return 0;
+} /* handler_poll */
+#endif /* ! HAVE_SYS_EPOLL_H */
+
+static void *
+connection_handler(void *data)
+{
+	handler_t *h = data;
+
+	assert(h);
+
+	while (h->running) {
+		if (handler_poll(h, /* timeout = */ 500)) {
+			char buf[1024];
+			sdb_log(SDB_LOG_ERR, "frontend: Failed to monitor "
+					"connections: %s",
+					sdb_strerror(errno, buf, sizeof(buf)));
+			break;
+		}
 	}
 	return NULL;
 } /* connection_handler */
@@ -585,6 +883,7 @@ connection_handler(void *data)
 static int
 connection_accept(sdb_fe_socket_t *sock, listener_t *listener)
 {
+	handler_t *h;
 	sdb_object_t *obj;
 	int status;
 
@@ -593,59 +892,21 @@ connection_accept(sdb_fe_socket_t *sock, listener_t *listener)
 	if (! obj)
 		return -1;
 
-	status = sdb_llist_append(sock->open_connections, obj);
+	h = sock->handlers + sock->next_handler;
+	sock->next_handler = (sock->next_handler + 1) % sock->handlers_num;
+
+	status = sdb_llist_append(h->new_connections, obj);
 	if (status)
-		sdb_log(SDB_LOG_ERR, "frontend: Failed to append "
-				"connection %s to list of open connections",
-				obj->name);
+		sdb_log(SDB_LOG_ERR, "frontend: Failed to pass on "
+				"connection %s to connection handler", obj->name);
+	else
+		handler_trigger(h);
 
-	/* hand ownership over to the list; or destroy in case of an error */
+	/* hand ownership over to the handler; or destroy in case of an error */
 	sdb_object_deref(obj);
 	return status;
 } /* connection_accept */
 
-static int
-socket_handle_incoming(sdb_fe_socket_t *sock,
-		fd_set *ready, fd_set *exceptions)
-{
-	sdb_llist_iter_t *iter;
-	size_t i;
-
-	for (i = 0; i < sock->listeners_num; ++i) {
-		listener_t *listener = sock->listeners + i;
-		if (FD_ISSET(listener->sock_fd, ready))
-			if (connection_accept(sock, listener))
-				continue;
-	}
-
-	iter = sdb_llist_get_iter(sock->open_connections);
-	if (! iter) {
-		sdb_log(SDB_LOG_ERR, "frontend: Failed to acquire iterator "
-				"for open connections");
-		return -1;
-	}
-
-	while (sdb_llist_iter_has_next(iter)) {
-		sdb_object_t *obj = sdb_llist_iter_get_next(iter);
-
-		if (FD_ISSET(CONN(obj)->fd, exceptions)) {
-			sdb_log(SDB_LOG_INFO, "Exception on fd %d",
-					CONN(obj)->fd);
-			/* close the connection */
-			sdb_llist_iter_remove_current(iter);
-			sdb_object_deref(obj);
-			continue;
-		}
-
-		if (FD_ISSET(CONN(obj)->fd, ready)) {
-			sdb_llist_iter_remove_current(iter);
-			sdb_channel_write(sock->chan, &obj);
-		}
-	}
-	sdb_llist_iter_destroy(iter);
-	return 0;
-} /* socket_handle_incoming */
-
 /*
  * public API
  */
@@ -653,46 +914,7 @@ socket_handle_incoming(sdb_fe_socket_t *sock,
 sdb_fe_socket_t *
 sdb_fe_sock_create(void)
 {
-	sdb_fe_socket_t *sock;
-	int flags;
-
-	sock = calloc(1, sizeof(*sock));
-	if (! sock)
-		return NULL;
-	sock->trigger[TRIGGER_READ] = sock->trigger[TRIGGER_WRITE] = -1;
-
-	sock->open_connections = sdb_llist_create();
-	if (! sock->open_connections) {
-		sdb_fe_sock_destroy(sock);
-		return NULL;
-	}
-
-	if (pipe(sock->trigger)) {
-		char errbuf[1024];
-		sdb_log(SDB_LOG_ERR, "frontend: Failed to create pipe: %s",
-				sdb_strerror(errno, errbuf, sizeof(errbuf)));
-		sdb_fe_sock_destroy(sock);
-		return NULL;
-	}
-	/* TODO: Can we do a zero-byte write as well to trigger select()?
-	 * Linux does not seem to support the I_SWROPT ioctl on a pipe. */
-	flags = fcntl(sock->trigger[TRIGGER_WRITE], F_GETFL);
-	if (fcntl(sock->trigger[TRIGGER_WRITE], F_SETFL, flags | O_NONBLOCK)) {
-		char errbuf[1024];
-		sdb_log(SDB_LOG_ERR, "frontend: Failed to switch pipe to non-blocking "
-				"mode: %s", sdb_strerror(errno, errbuf, sizeof(errbuf)));
-		sdb_fe_sock_destroy(sock);
-		return NULL;
-	}
-	flags = fcntl(sock->trigger[TRIGGER_READ], F_GETFL);
-	if (fcntl(sock->trigger[TRIGGER_READ], F_SETFL, flags | O_NONBLOCK)) {
-		char errbuf[1024];
-		sdb_log(SDB_LOG_ERR, "frontend: Failed to switch pipe to non-blocking "
-				"mode: %s", sdb_strerror(errno, errbuf, sizeof(errbuf)));
-		sdb_fe_sock_destroy(sock);
-		return NULL;
-	}
-	return sock;
+	return calloc(1, sizeof(sdb_fe_socket_t));
 } /* sdb_fe_sock_create */
 
 void
@@ -702,15 +924,6 @@ sdb_fe_sock_destroy(sdb_fe_socket_t *sock)
 		return;
 
 	socket_clear(sock);
-
-	if (sock->trigger[TRIGGER_WRITE] >= 0)
-		close(sock->trigger[TRIGGER_WRITE]);
-	if (sock->trigger[TRIGGER_READ] >= 0)
-		close(sock->trigger[TRIGGER_READ]);
-	sock->trigger[TRIGGER_READ] = sock->trigger[TRIGGER_WRITE] = -1;
-
-	sdb_llist_destroy(sock->open_connections);
-	sock->open_connections = NULL;
 	free(sock);
 } /* sdb_fe_sock_destroy */
 
@@ -779,37 +992,37 @@ sdb_fe_sock_clear_listeners(sdb_fe_socket_t *sock)
 int
 sdb_fe_sock_listen_and_serve(sdb_fe_socket_t *sock, sdb_fe_loop_t *loop)
 {
-	fd_set sockets;
-	int max_listen_fd = 0;
-	size_t i;
-
-	pthread_t handler_threads[loop->num_threads];
+	struct pollfd *listen_fds;
 	size_t num_threads;
+	size_t i;
 
-	if ((! sock) || (! sock->listeners_num) || sock->chan
+	if ((! sock) || (! sock->listeners_num) || sock->handlers
 			|| (! loop) || (loop->num_threads <= 0))
 		return -1;
 
 	if (! loop->do_loop)
 		return 0;
 
-	FD_ZERO(&sockets);
+	listen_fds = calloc(sock->listeners_num, sizeof(*listen_fds));
+	if (! listen_fds)
+		return -1;
 	for (i = 0; i < sock->listeners_num; ++i) {
 		listener_t *listener = sock->listeners + i;
 
 		if (listener_listen(listener)) {
 			socket_close(sock);
+			free(listen_fds);
 			return -1;
 		}
 
-		FD_SET(listener->sock_fd, &sockets);
-		if (listener->sock_fd > max_listen_fd)
-			max_listen_fd = listener->sock_fd;
+		listen_fds[i].fd = listener->sock_fd;
+		listen_fds[i].events = POLLIN;
 	}
 
-	sock->chan = sdb_channel_create(1024, sizeof(sdb_conn_t *));
-	if (! sock->chan) {
+	sock->handlers = calloc(loop->num_threads, sizeof(*sock->handlers));
+	if (! sock->handlers) {
 		socket_close(sock);
+		free(listen_fds);
 		return -1;
 	}
 
@@ -819,61 +1032,38 @@ sdb_fe_sock_listen_and_serve(sdb_fe_socket_t *sock, sdb_fe_loop_t *loop)
 			sock->listeners_num, sock->listeners_num == 1 ? "" : "s");
 
 	num_threads = loop->num_threads;
-	memset(&handler_threads, 0, sizeof(handler_threads));
 	for (i = 0; i < num_threads; ++i) {
+		handler_t *h = sock->handlers + i;
+
+		if (handler_init(h)) {
+			handler_destroy(h);
+			num_threads = i;
+			break;
+		}
+
 		errno = 0;
-		if (pthread_create(&handler_threads[i], /* attr = */ NULL,
-					connection_handler, /* arg = */ sock)) {
+		if (pthread_create(&h->thread, /* attr = */ NULL,
+					connection_handler, /* arg = */ h)) {
 			char errbuf[1024];
 			sdb_log(SDB_LOG_ERR, "frontend: Failed to create "
 					"connection handler thread: %s",
 					sdb_strerror(errno, errbuf, sizeof(errbuf)));
+			handler_destroy(h);
 			num_threads = i;
 			break;
 		}
 	}
+	sock->handlers_num = num_threads;
+	sock->next_handler = 0;
 
+	/* the main loop only accepts new connections
+	 * and passes them on to the handlers */
 	while (loop->do_loop && num_threads) {
-		struct timeval timeout = { 1, 0 }; /* one second */
-		sdb_llist_iter_t *iter;
-
-		int max_fd = max_listen_fd;
-		fd_set ready;
-		fd_set exceptions;
 		int n;
 
-		FD_ZERO(&ready);
-		FD_ZERO(&exceptions);
-
-		ready = sockets;
-		FD_SET(sock->trigger[TRIGGER_READ], &ready);
-
-		iter = sdb_llist_get_iter(sock->open_connections);
-		if (! iter) {
-			sdb_log(SDB_LOG_ERR, "frontend: Failed to acquire iterator "
-					"for open connections");
-			break;
-		}
-
-		while (sdb_llist_iter_has_next(iter)) {
-			sdb_object_t *obj = sdb_llist_iter_get_next(iter);
-
-			if (CONN(obj)->fd < 0) {
-				sdb_llist_iter_remove_current(iter);
-				sdb_object_deref(obj);
-				continue;
-			}
-
-			FD_SET(CONN(obj)->fd, &ready);
-			FD_SET(CONN(obj)->fd, &exceptions);
-
-			if (CONN(obj)->fd > max_fd)
-				max_fd = CONN(obj)->fd;
-		}
-		sdb_llist_iter_destroy(iter);
-
 		errno = 0;
-		n = select(max_fd + 1, &ready, NULL, &exceptions, &timeout);
+		n = poll(listen_fds, (nfds_t)sock->listeners_num,
+				/* timeout = */ 1000);
 		if (n < 0) {
 			char buf[1024];
 
@@ -887,28 +1077,28 @@ sdb_fe_sock_listen_and_serve(sdb_fe_socket_t *sock, sdb_fe_loop_t *loop)
 		else if (! n)
 			continue;
 
-		if (FD_ISSET(sock->trigger[TRIGGER_READ], &ready)) {
-			char buf[1024];
-			while (read(sock->trigger[TRIGGER_READ], buf, sizeof(buf)) > 0)
-				/* do nothing */;
-		}
-
-		/* handle new and open connections */
-		if (socket_handle_incoming(sock, &ready, &exceptions))
-			break;
+		for (i = 0; i < sock->listeners_num; ++i)
+			if (listen_fds[i].revents & POLLIN)
+				connection_accept(sock, sock->listeners + i);
 	}
 
 	socket_close(sock);
+	free(listen_fds);
 
 	sdb_log(SDB_LOG_INFO, "frontend: Waiting for connection handler threads "
 			"to terminate");
-	if (! sdb_channel_shutdown(sock->chan))
-		for (i = 0; i < num_threads; ++i)
-			pthread_join(handler_threads[i], NULL);
-	/* else: we tried our best; let the operating system clean up */
+	for (i = 0; i < num_threads; ++i) {
+		sock->handlers[i].running = 0;
+		handler_trigger(sock->handlers + i);
+	}
+	for (i = 0; i < num_threads; ++i) {
+		pthread_join(sock->handlers[i].thread, NULL);
+		handler_destroy(sock->handlers + i);
+	}
 
-	sdb_channel_destroy(sock->chan);
-	sock->chan = NULL;
+	free(sock->handlers);
+	sock->handlers = NULL;
+	sock->handlers_num = 0;
 
 	if (! num_threads)
 		return -1;
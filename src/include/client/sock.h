@@ -118,7 +118,8 @@ sdb_client_close(sdb_client_t *client);
  * set to UINT32_MAX. The returned data does not include the status code and
  * message len as received from the remote side but only the data associated
  * with the message. The function handles all asynchronous log messages by
- * logging them at the right log level.
+ * logging them at the right log level. Chunked data replies are assembled
+ * and returned as a single SDB_CONNECTION_DATA message.
  *
  * Returns:
  *  - the number of bytes read
@@ -130,6 +131,26 @@ sdb_client_rpc(sdb_client_t *client,
 		uint32_t cmd, uint32_t msg_len, const char *msg,
 		uint32_t *code, sdb_strbuf_t *buf);
 
+/*
+ * sdb_client_collect:
+ * Wait for the reply to a command sent to the server using sdb_client_send.
+ * The reply is handled as described for sdb_client_rpc which is equivalent
+ * to sdb_client_send followed by sdb_client_collect.
+ *
+ * Clients may send multiple commands without waiting for the replies in
+ * between (pipelining). The server handles commands in order, so each call
+ * collects the reply to the oldest command which has not been collected yet.
+ * That avoids a full round-trip per command when sending many commands,
+ * e.g. when storing objects.
+ *
+ * Returns:
+ *  - the number of bytes read
+ *    (may be zero if the message did not include any data)
+ *  - a negative value on error
+ */
+ssize_t
+sdb_client_collect(sdb_client_t *client, uint32_t *code, sdb_strbuf_t *buf);
+
 /*
  * sdb_client_send:
  * Send the specified command and accompanying data to the server.
@@ -51,6 +51,14 @@ struct sdb_memstore;
 typedef struct sdb_memstore sdb_memstore_t;
 #define SDB_MEMSTORE(obj) ((sdb_memstore_t *)(obj))
 
+/*
+ * sdb_memstore_journal_t represents an append-only journal of store updates.
+ * It inherits from sdb_object_t and may safely be cast to a generic object.
+ */
+struct sdb_memstore_journal;
+typedef struct sdb_memstore_journal sdb_memstore_journal_t;
+#define SDB_MEMSTORE_JOURNAL(obj) ((sdb_memstore_journal_t *)(obj))
+
 /*
  * sdb_memstore_obj_t represents the super-class of any stored object. It
  * inherits from sdb_object_t and may safely be cast to a generic object to
@@ -96,6 +104,16 @@ typedef struct sdb_memstore_matcher sdb_memstore_matcher_t;
  */
 extern sdb_store_writer_t sdb_memstore_writer;
 
+/*
+ * sdb_memstore_journal_writer:
+ * A store writer implementation that appends all updates to a journal. It
+ * expects a journal object as its user-data argument. It has to be
+ * registered after the writer of the store that is being journaled:
+ * sdb_memstore_journal_compact relies on all journaled updates having been
+ * applied to the store before, so the journal is not a write-ahead log.
+ */
+extern sdb_store_writer_t sdb_memstore_journal_writer;
+
 /*
  * sdb_memstore_reader:
  * A store reader implementation that uses an in-memory object store. It
@@ -114,7 +132,13 @@ sdb_memstore_create(void);
  * sdb_memstore_host, sdb_memstore_service, sdb_memstore_metric,
  * sdb_memstore_attribute, sdb_memstore_metric_attr:
  * Store an object in the specified store. The hostname is expected to be
- * canonical.
+ * canonical. If the interval is zero, it is determined as a moving average
+ * of the time between updates of the object.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a positive value if the new entry is not newer than the existing one
+ *  - a negative value on error
  */
 int
 sdb_memstore_host(sdb_memstore_t *store, const char *name,
@@ -249,6 +273,21 @@ int
 sdb_memstore_query_execute(sdb_memstore_t *store, sdb_memstore_query_t *m,
 		sdb_store_writer_t *w, sdb_object_t *wd, sdb_strbuf_t *errbuf);
 
+/*
+ * sdb_memstore_query_explain:
+ * Describe how a previously prepared query will be executed. This includes
+ * the matcher and filter after optimization (that is, in the order in which
+ * their conditions will be evaluated), the predicates which may be used to
+ * avoid scanning all objects, and the order and bounds of the result. The
+ * description is appended to 'buf'.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a negative value else
+ */
+int
+sdb_memstore_query_explain(sdb_memstore_query_t *q, sdb_strbuf_t *buf);
+
 /*
  * sdb_memstore_expr_create:
  * Creates an arithmetic expression implementing the specified operator on the
@@ -449,6 +488,20 @@ sdb_memstore_istrue_matcher(sdb_memstore_expr_t *expr);
 sdb_memstore_matcher_t *
 sdb_memstore_isfalse_matcher(sdb_memstore_expr_t *expr);
 
+/*
+ * sdb_memstore_matcher_compile:
+ * Compile a matcher into a flat program which evaluates objects without
+ * copying their values. The returned matcher may be used in place of the
+ * original one and behaves the same. Compiling an already compiled matcher
+ * returns the matcher itself.
+ *
+ * Returns:
+ *  - a new matcher on success
+ *  - NULL else
+ */
+sdb_memstore_matcher_t *
+sdb_memstore_matcher_compile(sdb_memstore_matcher_t *m);
+
 /*
  * sdb_memstore_matcher_matches:
  * Check whether the specified matcher matches the specified store object. If
@@ -479,7 +532,9 @@ typedef sdb_memstore_matcher_t *(*sdb_memstore_matcher_op_cb)
  * sdb_memstore_lookup_cb:
  * Lookup callback. It is called for each matching object when looking up data
  * in the store passing on the lookup filter and the specified user-data. The
- * lookup aborts early if the callback returns non-zero.
+ * lookup aborts with an error if the callback returns a negative value and
+ * stops successfully (without considering any further objects) if it returns
+ * a positive value.
  */
 typedef int (*sdb_memstore_lookup_cb)(sdb_memstore_obj_t *obj,
 		sdb_memstore_matcher_t *filter, void *user_data);
@@ -501,6 +556,25 @@ sdb_memstore_scan(sdb_memstore_t *store, int type,
 		sdb_memstore_matcher_t *m, sdb_memstore_matcher_t *filter,
 		sdb_memstore_lookup_cb cb, void *user_data);
 
+/*
+ * sdb_memstore_scan_after:
+ * Scan the store like sdb_memstore_scan but skip all objects up to and
+ * including the specified one. Objects are scanned ordered by the name of
+ * their host and their own name, so this allows to continue a scan which
+ * has been stopped before. For services and metrics, 'name' may be NULL
+ * to skip all children of the host 'hostname'. The scan seeks to the
+ * specified object directly; neither of the objects has to exist.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a negative value else
+ */
+int
+sdb_memstore_scan_after(sdb_memstore_t *store, int type,
+		const char *hostname, const char *name,
+		sdb_memstore_matcher_t *m, sdb_memstore_matcher_t *filter,
+		sdb_memstore_lookup_cb cb, void *user_data);
+
 /*
  * sdb_memstore_emit:
  * Send a single object to the specified store writer. Attributes or any child
@@ -528,6 +602,172 @@ int
 sdb_memstore_emit_full(sdb_memstore_obj_t *obj, sdb_memstore_matcher_t *filter,
 		sdb_store_writer_t *w, sdb_object_t *wd);
 
+/*
+ * sdb_memstore_emit_select:
+ * Send a single object and the specified attributes to the specified store
+ * writer. Unlike sdb_memstore_emit_full(), other attributes and any child
+ * objects are not included, so the cost depends on the number of requested
+ * attributes only. The filter, if specified, is applied to each attribute.
+ * Missing attributes are skipped.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a negative value else
+ */
+int
+sdb_memstore_emit_select(sdb_memstore_obj_t *obj,
+		sdb_memstore_matcher_t *filter,
+		const char * const *attributes, size_t attributes_num,
+		sdb_store_writer_t *w, sdb_object_t *wd);
+
+/*
+ * sdb_memstore_ttl_t:
+ * Specifies when objects of some type expire. An object expires once it has
+ * not been updated for 'factor' times its update interval or 'min_age',
+ * whichever is longer. Objects never expire if both values are zero.
+ */
+typedef struct {
+	double factor;
+	sdb_time_t min_age;
+} sdb_memstore_ttl_t;
+
+/*
+ * sdb_memstore_expiry_t:
+ * Expiry settings for each type of object. Attributes use the same settings
+ * regardless of the type of their parent object.
+ */
+typedef struct {
+	sdb_memstore_ttl_t host;
+	sdb_memstore_ttl_t service;
+	sdb_memstore_ttl_t metric;
+	sdb_memstore_ttl_t attribute;
+} sdb_memstore_expiry_t;
+
+/*
+ * sdb_memstore_expire:
+ * Remove all objects from the store which have expired at time 'now'
+ * according to the specified settings. Removing an object removes all of its
+ * attributes and children as well. The store is processed incrementally,
+ * acquiring each host's lock for a small number of objects at a time, such
+ * that writers and queries are never blocked for long.
+ *
+ * Returns:
+ *  - the number of removed objects (not counting the attributes and children
+ *    of removed objects) on success
+ *  - a negative value else
+ */
+int
+sdb_memstore_expire(sdb_memstore_t *store, const sdb_memstore_expiry_t *expiry,
+		sdb_time_t now);
+
+/*
+ * sdb_memstore_index_attribute:
+ * Maintain a secondary index on the values of all attributes with the
+ * specified key. Lookups matching objects by the equality of such an
+ * attribute to a constant value (or by its membership in a constant array)
+ * will only consider the indexed objects rather than scanning the whole
+ * store. Attributes already stored are indexed right away.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a positive value if the key is indexed already
+ *  - a negative value else
+ */
+int
+sdb_memstore_index_attribute(sdb_memstore_t *store, const char *key);
+
+/*
+ * sdb_memstore_dump:
+ * Write a snapshot of all objects in the store to the specified file. The
+ * snapshot is written to a temporary file first which then replaces the
+ * specified file atomically. Writers are only blocked while the host they
+ * are updating is being written.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a negative value else
+ */
+int
+sdb_memstore_dump(sdb_memstore_t *store, const char *filename);
+
+/*
+ * sdb_memstore_restore:
+ * Load all objects from a snapshot written by sdb_memstore_dump into the
+ * store. Objects are merged into the store using the regular update rules,
+ * that is, objects which are already in the store are only updated if the
+ * snapshot is newer.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a positive value if some objects were not newer than the stored ones
+ *  - a negative value else; the store may have been populated partially
+ */
+int
+sdb_memstore_restore(sdb_memstore_t *store, const char *filename);
+
+/*
+ * sdb_memstore_journal_open:
+ * Create a new, empty journal in the specified file, replacing any existing
+ * file. Use sdb_memstore_journal_replay() to load the previous journal first.
+ *
+ * Updates are collected in memory and written to disk in groups, sharing a
+ * single fsync. If 'sync_interval' is zero, writers wait until their updates
+ * have been synced to disk. Else, a background thread writes and syncs all
+ * collected updates using the specified interval and writers never wait for
+ * the disk; in case of a crash, updates from the last interval may be lost.
+ *
+ * Returns:
+ *  - the journal object on success
+ *  - NULL else
+ */
+sdb_memstore_journal_t *
+sdb_memstore_journal_open(const char *filename, sdb_time_t sync_interval);
+
+/*
+ * sdb_memstore_journal_sync:
+ * Write all collected updates to disk and sync them.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a negative value else
+ */
+int
+sdb_memstore_journal_sync(sdb_memstore_journal_t *journal);
+
+/*
+ * sdb_memstore_journal_compact:
+ * Compact the journal by writing a snapshot of the journaled store (see
+ * sdb_memstore_dump) and dropping all journaled updates that are part of the
+ * snapshot. The journal is rotated to '<filename>.old' before writing the
+ * snapshot which is removed once the snapshot has been written successfully.
+ * Thus, after a crash, the snapshot has to be restored first and then the
+ * old journal (if it exists) and the journal have to be replayed, in this
+ * order.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a negative value else
+ */
+int
+sdb_memstore_journal_compact(sdb_memstore_journal_t *journal,
+		sdb_memstore_t *store, const char *snapshot);
+
+/*
+ * sdb_memstore_journal_replay:
+ * Apply all updates recorded in the specified journal file to the store.
+ * Updates are applied in batches using the regular update rules, that is,
+ * updates which are not newer than the stored objects are ignored. A
+ * truncated record at the end of the journal (as left behind by a crash
+ * while writing it) is ignored.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a positive value if some updates were not newer than the stored objects
+ *  - a negative value else; the store may have been updated partially
+ */
+int
+sdb_memstore_journal_replay(sdb_memstore_t *store, const char *filename);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
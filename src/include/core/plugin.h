@@ -473,15 +473,31 @@ sdb_plugin_query(sdb_ast_node_t *ast,
 		sdb_store_writer_t *w, sdb_object_t *wd,
 		sdb_query_opts_t *opts, sdb_strbuf_t *errbuf);
 
+/*
+ * sdb_plugin_explain:
+ * Describe how the store would execute the query specified by 'ast'. The
+ * description will be appended to 'buf' and any errors will be written to
+ * 'errbuf'.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a negative value else
+ */
+int
+sdb_plugin_explain(sdb_ast_node_t *ast, sdb_strbuf_t *buf,
+		sdb_strbuf_t *errbuf);
+
 /*
  * sdb_plugin_store_host, sdb_plugin_store_service, sdb_plugin_store_metric,
  * sdb_plugin_store_attribute, sdb_plugin_store_service_attribute,
  * sdb_plugin_store_metric_attribute:
  * Store an object in the database by sending it to all registered store
- * writer plugins.
+ * writer plugins. The writers take care of rejecting outdated updates and
+ * of determining the object's update interval.
  *
  * Returns:
  *  - 0 on success
+ *  - a positive value if the new entry is older than the stored entry
  *  - a negative value else
  */
 int
@@ -502,6 +518,78 @@ int
 sdb_plugin_store_metric_attribute(const char *hostname, const char *metric,
 		const char *key, const sdb_data_t *value, sdb_time_t last_update);
 
+/*
+ * A batch collects objects to be stored in the database such that they may
+ * be passed to all store writers at once. It inherits from sdb_object_t and
+ * has to be destroyed using sdb_object_deref.
+ */
+struct sdb_plugin_batch;
+typedef struct sdb_plugin_batch sdb_plugin_batch_t;
+
+/*
+ * sdb_plugin_store_batch_begin:
+ * Create a new, empty batch.
+ *
+ * Returns:
+ *  - a batch object on success
+ *  - NULL else
+ */
+sdb_plugin_batch_t *
+sdb_plugin_store_batch_begin(void);
+
+/*
+ * sdb_plugin_store_batch_host, sdb_plugin_store_batch_service,
+ * sdb_plugin_store_batch_metric, sdb_plugin_store_batch_attribute,
+ * sdb_plugin_store_batch_service_attribute,
+ * sdb_plugin_store_batch_metric_attribute:
+ * Add an object to a batch. The arguments match those of the respective
+ * sdb_plugin_store_<type> function and all of them are copied, so the caller
+ * may release them right away. The object will be stored when committing
+ * the batch. For best performance, objects should be grouped by host.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a negative value else
+ */
+int
+sdb_plugin_store_batch_host(sdb_plugin_batch_t *batch, const char *name,
+		sdb_time_t last_update);
+int
+sdb_plugin_store_batch_service(sdb_plugin_batch_t *batch,
+		const char *hostname, const char *name, sdb_time_t last_update);
+int
+sdb_plugin_store_batch_metric(sdb_plugin_batch_t *batch,
+		const char *hostname, const char *name,
+		sdb_metric_store_t *store, sdb_time_t last_update);
+int
+sdb_plugin_store_batch_attribute(sdb_plugin_batch_t *batch,
+		const char *hostname, const char *key, const sdb_data_t *value,
+		sdb_time_t last_update);
+int
+sdb_plugin_store_batch_service_attribute(sdb_plugin_batch_t *batch,
+		const char *hostname, const char *service,
+		const char *key, const sdb_data_t *value, sdb_time_t last_update);
+int
+sdb_plugin_store_batch_metric_attribute(sdb_plugin_batch_t *batch,
+		const char *hostname, const char *metric,
+		const char *key, const sdb_data_t *value, sdb_time_t last_update);
+
+/*
+ * sdb_plugin_store_batch_commit:
+ * Send all objects of a batch to all registered store writer plugins, in the
+ * order in which they were added. Writers supporting batches will receive
+ * all objects at once; all other writers receive one object at a time. The
+ * batch will be empty afterwards and may be reused.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a positive value if any of the new entries is older than the stored
+ *    entry and no error occurred
+ *  - a negative value else
+ */
+int
+sdb_plugin_store_batch_commit(sdb_plugin_batch_t *batch);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -95,6 +95,13 @@ enum {
 		: ((f) == SDB_FIELD_TIMESERIES) ? SDB_TYPE_BOOLEAN \
 		: -1)
 
+/* a bit-mask identifying a field in a set of fields */
+#define SDB_FIELD_MASK(f) (1 << ((f) - SDB_FIELD_NAME))
+
+/* The maximum number of distinct backends stores keep track of. The plugin
+ * loader refuses to load any more backends. */
+#define SDB_STORE_BACKENDS_MAX 64
+
 /*
  * sdb_store_host_t represents the meta-data of a stored host object.
  */
@@ -168,6 +175,21 @@ typedef struct {
 } sdb_store_attribute_t;
 #define SDB_STORE_ATTRIBUTE_INIT { NULL, 0, NULL, NULL, SDB_DATA_INIT, 0, 0, NULL, 0 }
 
+/*
+ * sdb_store_batch_entry_t represents a single object of a batch update. The
+ * type (SDB_HOST, SDB_SERVICE, SDB_METRIC, or SDB_ATTRIBUTE) determines which
+ * member of the union is valid.
+ */
+typedef struct {
+	int type;
+	union {
+		sdb_store_host_t host;
+		sdb_store_service_t service;
+		sdb_store_metric_t metric;
+		sdb_store_attribute_t attribute;
+	} obj;
+} sdb_store_batch_entry_t;
+
 /*
  * A JSON formatter converts stored objects into the JSON format.
  * See http://www.ietf.org/rfc/rfc4627.txt
@@ -181,6 +203,12 @@ typedef struct sdb_store_json_formatter sdb_store_json_formatter_t;
 /*
  * A store writer describes the interface for plugins implementing a store.
  *
+ * Writers are responsible for rejecting stale updates and for keeping track
+ * of each object's update interval: an interval of zero passed to any of the
+ * call-back functions means that the writer shall determine the interval
+ * itself (e.g., as a moving average of the time between updates) as part of
+ * the same update.
+ *
  * Any of the call-back functions shall return:
  *  - 0 on success
  *  - a positive value if the new entry is older than the currently stored
@@ -226,6 +254,43 @@ typedef struct {
 	 * the store.
 	 */
 	int (*store_attribute)(sdb_store_attribute_t *attr, sdb_object_t *user_data);
+
+	/*
+	 * store_batch (optional):
+	 * Add/update all of the specified objects in the store, in order. This
+	 * is semantically equivalent to calling the respective callback for each
+	 * entry but allows the writer to amortize the cost of locking and
+	 * looking up objects across all entries belonging to the same host.
+	 * Objects should be grouped by host for best results.
+	 *
+	 * Returns:
+	 *  - 0 if all objects were stored successfully
+	 *  - a positive value if at least one object was older than the
+	 *    currently stored entry and none failed
+	 *  - a negative value if storing any of the objects failed; all other
+	 *    objects will still be stored
+	 */
+	int (*store_batch)(sdb_store_batch_entry_t *entries, size_t entries_num,
+			sdb_object_t *user_data);
+
+	/*
+	 * store_count (optional):
+	 * Receive the result of a COUNT query: the number of objects having the
+	 * specified value of the grouping expression, or the total number of
+	 * matching objects if the value is NULL (that is, if the query was not
+	 * grouped). Writers not supporting query results may leave this unset.
+	 */
+	int (*store_count)(const sdb_data_t *value, int64_t count,
+			sdb_object_t *user_data);
+
+	/*
+	 * flush (optional):
+	 * Called by readers while executing a query whenever they do not hold
+	 * any locks, e.g., after finishing with a host. Writers receiving query
+	 * results may pass on the results received so far and may block while
+	 * doing so. Returning a negative value aborts the query.
+	 */
+	int (*flush)(sdb_object_t *user_data);
 } sdb_store_writer_t;
 
 /*
@@ -249,6 +314,14 @@ typedef struct {
 	int (*execute_query)(sdb_object_t *q,
 			sdb_store_writer_t *w, sdb_object_t *wd,
 			sdb_strbuf_t *errbuf, sdb_object_t *user_data);
+
+	/*
+	 * explain_query (optional):
+	 * Describe how a previously prepared query would be executed. The
+	 * description will be appended to 'buf' in a human-readable form.
+	 */
+	int (*explain_query)(sdb_object_t *q, sdb_strbuf_t *buf,
+			sdb_strbuf_t *errbuf, sdb_object_t *user_data);
 } sdb_store_reader_t;
 
 /*
@@ -266,6 +339,45 @@ enum {
 sdb_store_json_formatter_t *
 sdb_store_json_formatter(sdb_strbuf_t *buf, int type, int flags);
 
+/*
+ * sdb_store_json_select:
+ * Restrict the JSON output to the specified fields (a bit-mask of
+ * SDB_FIELD_MASK values) of each object. The name of all objects and the
+ * value of attributes are always included. All fields are included by
+ * default.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a negative value else
+ */
+int
+sdb_store_json_select(sdb_store_json_formatter_t *f, int fields);
+
+/*
+ * sdb_store_json_flush_cb:
+ * A callback passing on formatted output. It may consume any data from the
+ * front of the buffer (removing it from the buffer). Returning a non-zero
+ * value aborts formatting.
+ */
+typedef int (*sdb_store_json_flush_cb)(sdb_strbuf_t *buf, void *user_data);
+
+/*
+ * sdb_store_json_set_flush:
+ * Register a callback to be invoked whenever the formatted output has
+ * reached (at least) 'size' bytes when the store reader flushes the writer
+ * (see the 'flush' callback of sdb_store_writer_t). This allows to bound
+ * the amount of output buffered in memory without passing on any output
+ * while the reader holds any locks. The output is not guaranteed to be
+ * split at the boundaries of JSON values.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a negative value else
+ */
+int
+sdb_store_json_set_flush(sdb_store_json_formatter_t *f, size_t size,
+		sdb_store_json_flush_cb flush, void *user_data);
+
 /*
  * sdb_store_json_finish:
  * Finish the JSON output. This function has to be called once after emiting
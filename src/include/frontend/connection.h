@@ -112,18 +112,60 @@ sdb_connection_close(sdb_conn_t *conn);
 ssize_t
 sdb_connection_handle(sdb_conn_t *conn);
 
+/*
+ * sdb_connection_queue:
+ * Append a message to the output queue of an open connection without writing
+ * anything to the connection. Queued messages are sent by
+ * sdb_connection_flush or sdb_connection_drain.
+ *
+ * Returns:
+ *  - the number of bytes queued
+ *  - a negative value on error
+ */
+ssize_t
+sdb_connection_queue(sdb_conn_t *conn, uint32_t code,
+		uint32_t msg_len, const char *msg);
+
 /*
  * sdb_connection_send:
- * Send to an open connection.
+ * Send to an open connection. Messages which cannot be written right away
+ * are queued and sent by sdb_connection_flush.
  *
  * Returns:
- *  - the number of bytes written
+ *  - the number of bytes sent or queued
  *  - a negative value on error
  */
 ssize_t
 sdb_connection_send(sdb_conn_t *conn, uint32_t code,
 		uint32_t msg_len, const char *msg);
 
+/*
+ * sdb_connection_flush:
+ * Write messages queued by sdb_connection_send to an open connection until
+ * writing would block. The connection is closed on error.
+ *
+ * Returns:
+ *  - the number of bytes still queued
+ *  - a negative value on error
+ */
+ssize_t
+sdb_connection_flush(sdb_conn_t *conn);
+
+/*
+ * sdb_connection_drain:
+ * Write queued messages to an open connection, waiting for the connection
+ * to become writable as necessary, until no more than 'max_len' bytes are
+ * queued. This blocks the calling thread, so it must not be used while
+ * holding any locks which other threads may have to acquire. The connection
+ * is closed on error or if the client does not accept any data for a minute.
+ *
+ * Returns:
+ *  - the number of bytes still queued
+ *  - a negative value on error
+ */
+ssize_t
+sdb_connection_drain(sdb_conn_t *conn, size_t max_len);
+
 /*
  * sdb_connection_ping:
  * Send back a backend status indicator to the connected client.
@@ -146,6 +188,17 @@ sdb_connection_ping(sdb_conn_t *conn);
 int
 sdb_connection_server_version(sdb_conn_t *conn);
 
+/*
+ * sdb_connection_chunked:
+ * Enable chunked replies to data queries on the connection.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a negative value else
+ */
+int
+sdb_connection_chunked(sdb_conn_t *conn);
+
 /*
  * session handling
  */
@@ -42,6 +42,10 @@ extern "C" {
  *
  * Any strings in the message body may not include a zero byte.
  *
+ * Clients may send multiple commands without waiting for the server's reply
+ * (pipelining). Commands are handled in the order they were received and
+ * replies are sent in the same order.
+ *
  *                  1               3               4               6
  *  0               6               2               8               4
  * +-------------------------------+-------------------------------+
@@ -123,6 +127,28 @@ typedef enum {
 	 * | ...                           |
 	 */
 	SDB_CONNECTION_DATA = 100,
+
+	/*
+	 * SDB_CONNECTION_DATA_CHUNK:
+	 * Indicates a part of the result of a data query. Chunks are only sent to
+	 * clients which enabled chunked replies (see SDB_CONNECTION_CHUNKED). The
+	 * message body has the same format as SDB_CONNECTION_DATA and includes
+	 * the type of the data. The result is split into any number of chunks
+	 * followed by a final SDB_CONNECTION_DATA message; the full result is the
+	 * concatenation of the results included in all of these messages. Any
+	 * SDB_CONNECTION_ERROR message instead of the final DATA message
+	 * indicates that the query failed and that the partial result shall be
+	 * discarded. Log messages may be sent in between chunks.
+	 *
+	 * 0               32              64
+	 * +---------------+---------------+
+	 * | DATA_CHUNK    | length        |
+	 * +---------------+---------------+
+	 * | result type   | partial       |
+	 * +---------------+ result ...    |
+	 * | ...                           |
+	 */
+	SDB_CONNECTION_DATA_CHUNK,
 } sdb_conn_status_t;
 
 /* accepted commands / state of the connection */
@@ -245,6 +271,13 @@ typedef enum {
 	 */
 	SDB_CONNECTION_TIMESERIES,
 
+	/*
+	 * SDB_CONNECTION_COUNT:
+	 * Execute the 'COUNT' command in the server. This command is not yet
+	 * supported on the wire. Use SDB_CONNECTION_QUERY instead.
+	 */
+	SDB_CONNECTION_COUNT,
+
 	/*
 	 * SDB_CONNECTION_STORE:
 	 * Execute the 'STORE' command in the server. The message body shall
@@ -317,6 +350,26 @@ typedef enum {
 	 * +---------------+---------------+
 	 */
 	SDB_CONNECTION_SERVER_VERSION = 1000,
+
+	/*
+	 * Connection settings.
+	 */
+
+	/*
+	 * SDB_CONNECTION_CHUNKED:
+	 * Enable chunked replies on the current connection. The server may then
+	 * split the result of data queries into SDB_CONNECTION_DATA_CHUNK
+	 * messages sent while executing the query rather than building the
+	 * whole result in memory first. Queries wait for the client to read
+	 * the chunks sent so far if it does not keep up. The server replies
+	 * with SDB_CONNECTION_OK if chunked replies are supported.
+	 *
+	 * 0               32              64
+	 * +---------------+---------------+
+	 * | CHUNKED       | 0             |
+	 * +---------------+---------------+
+	 */
+	SDB_CONNECTION_CHUNKED = 2000,
 } sdb_conn_state_t;
 
 #define SDB_CONN_MSGTYPE_TO_STRING(t) \
@@ -328,7 +381,9 @@ typedef enum {
 		: ((t) == SDB_CONNECTION_LIST) ? "LIST" \
 		: ((t) == SDB_CONNECTION_LOOKUP) ? "LOOKUP" \
 		: ((t) == SDB_CONNECTION_TIMESERIES) ? "TIMESERIES" \
+		: ((t) == SDB_CONNECTION_COUNT) ? "COUNT" \
 		: ((t) == SDB_CONNECTION_STORE) ? "STORE" \
+		: ((t) == SDB_CONNECTION_CHUNKED) ? "CHUNKED" \
 		: "UNKNOWN")
 
 #ifdef __cplusplus
@@ -52,6 +52,8 @@ typedef enum {
 	SDB_AST_TYPE_LOOKUP     = 3,
 	SDB_AST_TYPE_STORE      = 4,
 	SDB_AST_TYPE_TIMESERIES = 5,
+	SDB_AST_TYPE_COUNT      = 6,
+	SDB_AST_TYPE_EXPLAIN    = 7,
 
 	/* generic expressions */
 	SDB_AST_TYPE_OPERATOR   = 100,
@@ -158,6 +160,8 @@ typedef enum {
 		: ((n)->type == SDB_AST_TYPE_LOOKUP) ? "LOOKUP" \
 		: ((n)->type == SDB_AST_TYPE_STORE) ? "STORE" \
 		: ((n)->type == SDB_AST_TYPE_TIMESERIES) ? "TIMESERIES" \
+		: ((n)->type == SDB_AST_TYPE_COUNT) ? "COUNT" \
+		: ((n)->type == SDB_AST_TYPE_EXPLAIN) ? "EXPLAIN" \
 		: ((n)->type == SDB_AST_TYPE_OPERATOR) \
 			? SDB_AST_OP_TO_STRING(SDB_AST_OP(n)->kind) \
 		: ((n)->type == SDB_AST_TYPE_ITERATOR) ? "ITERATOR" \
@@ -276,10 +280,24 @@ typedef struct {
 	sdb_ast_node_t super;
 	int obj_type;
 	sdb_ast_node_t *filter; /* optional */
+
+	/* ordering and bounds of the result; see sdb_ast_lookup_t */
+	sdb_ast_node_t *order_by; /* optional */
+	bool descending;
+	char *after_host; /* optional */
+	char *after_name; /* optional */
+	int64_t limit;
+	int64_t offset;
+
+	/* the fields and attributes to include in the result; see
+	 * sdb_ast_lookup_t */
+	sdb_ast_node_t **select; /* optional */
+	size_t select_num;
 } sdb_ast_list_t;
 #define SDB_AST_LIST(obj) ((sdb_ast_list_t *)(obj))
 #define SDB_AST_LIST_INIT \
-	{ { SDB_OBJECT_INIT, SDB_AST_TYPE_LIST, -1 }, -1, NULL }
+	{ { SDB_OBJECT_INIT, SDB_AST_TYPE_LIST, -1 }, -1, NULL, \
+		NULL, 0, NULL, NULL, -1, 0, NULL, 0 }
 
 /*
  * sdb_ast_lookup_t represents a LOOKUP command.
@@ -289,10 +307,61 @@ typedef struct {
 	int obj_type;
 	sdb_ast_node_t *matcher; /* optional */
 	sdb_ast_node_t *filter; /* optional */
+
+	/* the value (a field or an attribute) by which to order the result;
+	 * objects are returned in the order of the store by default */
+	sdb_ast_node_t *order_by; /* optional */
+	bool descending;
+	/* continue a previous (unordered) query after the object with the
+	 * specified host and object name; only objects following it in the
+	 * order of the store are returned; a missing name refers to all
+	 * children of the host */
+	char *after_host; /* optional */
+	char *after_name; /* optional */
+	/* the maximum number of objects to return (negative if unlimited) after
+	 * skipping the first 'offset' objects */
+	int64_t limit;
+	int64_t offset;
+
+	/* the fields and attributes (value nodes) to include in the result;
+	 * other attributes and any children are omitted if specified, while
+	 * full objects are returned by default */
+	sdb_ast_node_t **select; /* optional */
+	size_t select_num;
 } sdb_ast_lookup_t;
 #define SDB_AST_LOOKUP(obj) ((sdb_ast_lookup_t *)(obj))
 #define SDB_AST_LOOKUP_INIT \
-	{ { SDB_OBJECT_INIT, SDB_AST_TYPE_LOOKUP, -1 }, -1, NULL, NULL }
+	{ { SDB_OBJECT_INIT, SDB_AST_TYPE_LOOKUP, -1 }, -1, NULL, NULL, \
+		NULL, 0, NULL, NULL, -1, 0, NULL, 0 }
+
+/*
+ * sdb_ast_count_t represents a COUNT command.
+ */
+typedef struct {
+	sdb_ast_node_t super;
+	int obj_type;
+	sdb_ast_node_t *matcher; /* optional */
+	sdb_ast_node_t *filter; /* optional */
+
+	/* the value (a field or an attribute) by which to group the matching
+	 * objects; all matching objects are counted as a whole by default */
+	sdb_ast_node_t *group_by; /* optional */
+} sdb_ast_count_t;
+#define SDB_AST_COUNT(obj) ((sdb_ast_count_t *)(obj))
+#define SDB_AST_COUNT_INIT \
+	{ { SDB_OBJECT_INIT, SDB_AST_TYPE_COUNT, -1 }, -1, NULL, NULL, NULL }
+
+/*
+ * sdb_ast_explain_t represents an EXPLAIN command.
+ */
+typedef struct {
+	sdb_ast_node_t super;
+	/* the FETCH, LIST, LOOKUP, or COUNT command to explain */
+	sdb_ast_node_t *query;
+} sdb_ast_explain_t;
+#define SDB_AST_EXPLAIN(obj) ((sdb_ast_explain_t *)(obj))
+#define SDB_AST_EXPLAIN_INIT \
+	{ { SDB_OBJECT_INIT, SDB_AST_TYPE_EXPLAIN, -1 }, NULL }
 
 /*
  * sdb_ast_store_t represents a STORE command.
@@ -399,7 +468,8 @@ sdb_ast_fetch_create(int obj_type, char *hostname,
 /*
  * sdb_ast_list_create:
  * Creates an AST node representing a LIST command. The newly created node
- * takes ownership of the filter node.
+ * takes ownership of the filter node. The result is neither ordered nor
+ * bounded by default.
  */
 sdb_ast_node_t *
 sdb_ast_list_create(int obj_type, sdb_ast_node_t *filter);
@@ -407,12 +477,30 @@ sdb_ast_list_create(int obj_type, sdb_ast_node_t *filter);
 /*
  * sdb_ast_lookup_create:
  * Creates an AST node representing a LOOKUP command. The newly created node
- * takes ownership of the matcher and filter nodes.
+ * takes ownership of the matcher and filter nodes. The result is neither
+ * ordered nor bounded by default.
  */
 sdb_ast_node_t *
 sdb_ast_lookup_create(int obj_type, sdb_ast_node_t *matcher,
 		sdb_ast_node_t *filter);
 
+/*
+ * sdb_ast_count_create:
+ * Creates an AST node representing a COUNT command. The newly created node
+ * takes ownership of the matcher, filter, and group_by nodes.
+ */
+sdb_ast_node_t *
+sdb_ast_count_create(int obj_type, sdb_ast_node_t *matcher,
+		sdb_ast_node_t *filter, sdb_ast_node_t *group_by);
+
+/*
+ * sdb_ast_explain_create:
+ * Creates an AST node representing an EXPLAIN command. The newly created
+ * node takes ownership of the query node.
+ */
+sdb_ast_node_t *
+sdb_ast_explain_create(sdb_ast_node_t *query);
+
 /*
  * sdb_ast_store_create:
  * Creates an AST node representing a STORE command. Thew newly created node
@@ -54,6 +54,16 @@ typedef struct sdb_avltree_iter sdb_avltree_iter_t;
 sdb_avltree_t *
 sdb_avltree_create(void);
 
+/*
+ * sdb_avltree_create_indexed:
+ * Creates an AVL tree which additionally maintains a hash index of the
+ * (case-insensitive) object names, turning lookups into (average) O(1)
+ * operations. Iteration still uses the tree and, thus, remains ordered. The
+ * index is only built once the tree contains more than a few nodes.
+ */
+sdb_avltree_t *
+sdb_avltree_create_indexed(void);
+
 /*
  * sdb_avltree_destroy:
  * Destroy the specified AVL tree and release all included objects (decrement
@@ -83,6 +93,21 @@ sdb_avltree_clear(sdb_avltree_t *tree);
 int
 sdb_avltree_insert(sdb_avltree_t *tree, sdb_object_t *obj);
 
+/*
+ * sdb_avltree_remove:
+ * Remove the node with the specified name from the tree and release the
+ * included object (decrement the ref-count) once no concurrent reader may
+ * access it anymore. This operation may change the structure of the tree by
+ * rebalancing subtrees.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a positive value if no such node exists
+ *  - a negative value else
+ */
+int
+sdb_avltree_remove(sdb_avltree_t *tree, const char *name);
+
 /*
  * sdb_avltree_lookup:
  * Lookup an object from a tree by name.
@@ -113,6 +138,16 @@ sdb_avltree_iter_has_next(sdb_avltree_iter_t *iter);
 sdb_object_t *
 sdb_avltree_iter_get_next(sdb_avltree_iter_t *iter);
 
+/*
+ * sdb_avltree_iter_seek:
+ * Reposition the iterator such that the next element is the smallest element
+ * whose name is not less than the specified name (compared
+ * case-insensitively). The iterator continues to refer to the same snapshot
+ * of the tree.
+ */
+void
+sdb_avltree_iter_seek(sdb_avltree_iter_t *iter, const char *name);
+
 /*
  * sdb_avltree_iter_peek_next:
  * Peek at the next node, if there is one. This is similar to has_next() but
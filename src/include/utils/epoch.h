@@ -0,0 +1,96 @@
+/*
+ * SysDB - src/include/utils/epoch.h
+ * Copyright (C) 2016 Sebastian 'tokkee' Harl <sh@tokkee.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SDB_UTILS_EPOCH_H
+#define SDB_UTILS_EPOCH_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Epoch-based reclamation allows readers to access shared data structures
+ * without any locking while writers replace parts of them concurrently.
+ * Readers announce accessing shared data by entering a critical section.
+ * Writers unlink outdated data and then retire it, deferring its release
+ * until all readers which might still see the data have left their critical
+ * sections. Critical sections are cheap but should be short-lived since
+ * they delay the release of retired data. They may be nested and must not be
+ * left in a different thread than the one which entered them.
+ */
+
+/*
+ * sdb_epoch_enter:
+ * Enter a read-side critical section. Any shared data accessed inside a
+ * critical section remains valid until the (outermost) section has been
+ * left.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a negative value if the calling thread could not be registered as a
+ *    reader; in this case, shared data must not be accessed
+ */
+int
+sdb_epoch_enter(void);
+
+/*
+ * sdb_epoch_exit:
+ * Leave a read-side critical section entered using sdb_epoch_enter.
+ */
+void
+sdb_epoch_exit(void);
+
+/*
+ * sdb_epoch_retire:
+ * Retire the specified data, which has to be unreachable by any new readers
+ * already. The destructor will be called (in any thread) once all readers
+ * which might still access the data have left their critical sections.
+ *
+ * Returns:
+ *  - 0 on success
+ *  - a negative value if the data could not be queued; in this case, it has
+ *    not been released either
+ */
+int
+sdb_epoch_retire(void *data, void (*destructor)(void *));
+
+/*
+ * sdb_epoch_reclaim:
+ * Release as much retired data as possible. This is done automatically when
+ * retiring data and is mainly useful for testing.
+ */
+void
+sdb_epoch_reclaim(void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* ! SDB_UTILS_EPOCH_H */
+
+/* vim: set tw=78 sw=4 ts=4 noexpandtab : */
+
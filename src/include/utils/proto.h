@@ -106,6 +106,20 @@ sdb_proto_marshal(char *buf, size_t buf_len, uint32_t code,
 ssize_t
 sdb_proto_marshal_int32(char *buf, size_t buf_len, uint32_t v);
 
+/*
+ * sdb_proto_marshal_int64:
+ * Encode the 64-bit integer into the wire format and write it to buf.
+ *
+ * Returns:
+ *  - The number of bytes of the encoded value on success. The function does
+ *    not write more than 'buf_len' bytes. If the output was truncated then
+ *    the return value is the number of bytes which would have been written if
+ *    enough space had been available.
+ *  - a negative value else
+ */
+ssize_t
+sdb_proto_marshal_int64(char *buf, size_t buf_len, uint64_t v);
+
 /*
  * sdb_proto_marshal_data:
  * Encode a datum into the wire format and write it to buf.
@@ -170,6 +184,17 @@ sdb_proto_unmarshal_header(const char *buf, size_t buf_len,
 ssize_t
 sdb_proto_unmarshal_int32(const char *buf, size_t buf_len, uint32_t *v);
 
+/*
+ * sdb_proto_unmarshal_int64:
+ * Read and decode a 64-bit integer from the specified string.
+ *
+ * Returns:
+ *  - the number of bytes read on success
+ *  - a negative value else
+ */
+ssize_t
+sdb_proto_unmarshal_int64(const char *buf, size_t buf_len, uint64_t *v);
+
 /*
  * sdb_proto_unmarshal_data:
  * Read and decode a datum from the specified string. The datum's data will be
@@ -0,0 +1,87 @@
+/*
+ * SysDB - src/include/utils/slab.h
+ * Copyright (C) 2016 Sebastian 'tokkee' Harl <sh@tokkee.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef SDB_UTILS_SLAB_H
+#define SDB_UTILS_SLAB_H 1
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The slab allocator manages small chunks of memory in size classes of
+ * SDB_SLAB_ALIGN bytes up to SDB_SLAB_MAX bytes. Chunks are carved from large
+ * pages without any per-chunk overhead. Each thread keeps a cache of free
+ * chunks of each class, so most allocations and releases don't need any
+ * locking. Memory may be released in a different thread than the one which
+ * allocated it. Pages are never returned to the system but reused for later
+ * allocations of the same size class. Larger allocations are passed on to
+ * malloc.
+ */
+
+#define SDB_SLAB_ALIGN 8
+#define SDB_SLAB_MAX 512
+
+/*
+ * sdb_slab_alloc:
+ * Allocate 'size' bytes of memory. The memory is aligned to SDB_SLAB_ALIGN
+ * bytes (or as returned by malloc for larger sizes) and has to be released
+ * using sdb_slab_free, passing the same size.
+ *
+ * Returns:
+ *  - a pointer to the allocated memory on success
+ *  - NULL else
+ */
+void *
+sdb_slab_alloc(size_t size);
+
+/*
+ * sdb_slab_free:
+ * Release memory allocated using sdb_slab_alloc. 'size' has to match the
+ * size specified when allocating the memory.
+ */
+void
+sdb_slab_free(void *ptr, size_t size);
+
+/*
+ * sdb_slab_bytes:
+ * Returns the total amount of memory allocated from the system for all size
+ * classes.
+ */
+size_t
+sdb_slab_bytes(void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* ! SDB_UTILS_SLAB_H */
+
+/* vim: set tw=78 sw=4 ts=4 noexpandtab : */
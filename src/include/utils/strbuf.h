@@ -136,6 +136,23 @@ sdb_strbuf_memappend(sdb_strbuf_t *strbuf, const void *data, size_t n);
 ssize_t
 sdb_strbuf_read(sdb_strbuf_t *strbuf, int fd, size_t n);
 
+/*
+ * sdb_strbuf_reserve, sdb_strbuf_commit:
+ * Append data to the buffer without copying it: sdb_strbuf_reserve makes
+ * sure that at least 'n' bytes may be written to the end of the buffer and
+ * returns a pointer to that memory area. The pointer is valid until the next
+ * modification of the buffer. sdb_strbuf_commit then appends 'n' (no more
+ * than reserved) bytes written to that area to the buffer's content.
+ *
+ * sdb_strbuf_reserve returns:
+ *  - a pointer to the reserved memory area on success
+ *  - NULL else
+ */
+char *
+sdb_strbuf_reserve(sdb_strbuf_t *strbuf, size_t n);
+void
+sdb_strbuf_commit(sdb_strbuf_t *strbuf, size_t n);
+
 /*
  * sdb_strbuf_chomp:
  * Remove all consecutive newline characters from the end of the string buffer
@@ -150,7 +167,8 @@ sdb_strbuf_chomp(sdb_strbuf_t *strbuf);
 
 /*
  * sdb_strbuf_skip:
- * Removes 'n' bytes from the buffer starting at offset 'offset'.
+ * Removes 'n' bytes from the buffer starting at offset 'offset'. Removing
+ * bytes from the start of the buffer does not move the remaining content.
  */
 void
 sdb_strbuf_skip(sdb_strbuf_t *strbuf, size_t offset, size_t n);
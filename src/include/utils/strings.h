@@ -68,6 +68,21 @@ stringv_append_if_missing(char ***s, size_t *s_len, const char *elem);
 void
 stringv_free(char ***s, size_t *s_len);
 
+/*
+ * string_intern:
+ * Look up a shared copy of the specified string, adding it to a global table
+ * of interned strings if it's not known yet. Equal strings map to the same
+ * pointer, so they may be compared by address. Interned strings are never
+ * released, so this should only be used for strings from a limited set of
+ * values (like type names).
+ *
+ * Returns:
+ *  - the interned copy of the string on success
+ *  - NULL else
+ */
+const char *
+string_intern(const char *s);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
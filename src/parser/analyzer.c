@@ -512,6 +512,82 @@ analyze_fetch(sdb_ast_fetch_t *fetch, sdb_strbuf_t *errbuf)
 	return 0;
 } /* analyze_fetch */
 
+static int
+analyze_bounds(const char *cmd, int obj_type, sdb_ast_node_t *order_by,
+		const char *after_host, const char *after_name, int64_t offset,
+		sdb_strbuf_t *errbuf)
+{
+	if (offset < 0) {
+		sdb_strbuf_sprintf(errbuf, "Invalid offset %"PRId64" "
+				"in %s command", offset, cmd);
+		return -1;
+	}
+	if (after_name && (! after_host)) {
+		sdb_strbuf_sprintf(errbuf, "Missing hostname in AFTER clause "
+				"of %s command", cmd);
+		return -1;
+	}
+	if (after_name && (obj_type == SDB_HOST)) {
+		sdb_strbuf_sprintf(errbuf, "Invalid AFTER clause %s.%s "
+				"in %s hosts command", after_host, after_name, cmd);
+		return -1;
+	}
+	if (! order_by)
+		return 0;
+
+	/* continuation keys refer to the order of the store */
+	if (after_host) {
+		sdb_strbuf_sprintf(errbuf, "Cannot use AFTER clause with ORDER BY "
+				"in %s command", cmd);
+		return -1;
+	}
+
+	if ((order_by->type != SDB_AST_TYPE_VALUE)
+			&& (order_by->type != SDB_AST_TYPE_TYPED)) {
+		sdb_strbuf_sprintf(errbuf, "Invalid ORDER BY expression of type %s "
+				"in %s command", SDB_AST_TYPE_TO_STRING(order_by), cmd);
+		return -1;
+	}
+	{
+		context_t ctx = { obj_type, 0 };
+		if (analyze_node(ctx, order_by, errbuf))
+			return -1;
+	}
+	if ((order_by->data_type > 0) && (order_by->data_type & SDB_TYPE_ARRAY)) {
+		sdb_strbuf_sprintf(errbuf, "Cannot order by %s values "
+				"in %s command", SDB_TYPE_TO_STRING(order_by->data_type),
+				cmd);
+		return -1;
+	}
+	return 0;
+} /* analyze_bounds */
+
+static int
+analyze_select(const char *cmd, int obj_type,
+		sdb_ast_node_t **select, size_t select_num, sdb_strbuf_t *errbuf)
+{
+	context_t ctx = { obj_type, 0 };
+	size_t i;
+
+	for (i = 0; i < select_num; ++i) {
+		sdb_ast_node_t *n = select[i];
+
+		/* only the object's own fields and attributes are part of the
+		 * result; age is derived from the last update */
+		if ((n->type != SDB_AST_TYPE_VALUE)
+				|| (SDB_AST_VALUE(n)->type == SDB_FIELD_AGE)) {
+			sdb_strbuf_sprintf(errbuf, "Cannot select %s in %s command",
+					(n->type == SDB_AST_TYPE_VALUE)
+						? SDB_FIELD_TO_NAME(SDB_AST_VALUE(n)->type)
+						: SDB_AST_TYPE_TO_STRING(n), cmd);
+			return -1;
+		}
+		if (analyze_node(ctx, n, errbuf))
+			return -1;
+	}
+	return 0;
+} /* analyze_select */
+
 static int
 analyze_list(sdb_ast_list_t *list, sdb_strbuf_t *errbuf)
 {
@@ -520,6 +596,12 @@ analyze_list(sdb_ast_list_t *list, sdb_strbuf_t *errbuf)
 				"in LIST command", list->obj_type);
 		return -1;
 	}
+	if (analyze_select("LIST", list->obj_type,
+				list->select, list->select_num, errbuf))
+		return -1;
+	if (analyze_bounds("LIST", list->obj_type, list->order_by,
+				list->after_host, list->after_name, list->offset, errbuf))
+		return -1;
 	if (list->filter)
 		return analyze_node(FILTER_CTX, list->filter, errbuf);
 	return 0;
@@ -538,11 +620,65 @@ analyze_lookup(sdb_ast_lookup_t *lookup, sdb_strbuf_t *errbuf)
 		if (analyze_node(ctx, lookup->matcher, errbuf))
 			return -1;
 	}
+	if (analyze_select("LOOKUP", lookup->obj_type,
+				lookup->select, lookup->select_num, errbuf))
+		return -1;
+	if (analyze_bounds("LOOKUP", lookup->obj_type, lookup->order_by,
+				lookup->after_host, lookup->after_name, lookup->offset,
+				errbuf))
+		return -1;
 	if (lookup->filter)
 		return analyze_node(FILTER_CTX, lookup->filter, errbuf);
 	return 0;
 } /* analyze_lookup */
 
+static int
+analyze_count(sdb_ast_count_t *count, sdb_strbuf_t *errbuf)
+{
+	if (! VALID_OBJ_TYPE(count->obj_type)) {
+		sdb_strbuf_sprintf(errbuf, "Invalid object type %#x "
+				"in COUNT command", count->obj_type);
+		return -1;
+	}
+	if (count->matcher) {
+		context_t ctx = { count->obj_type, 0 };
+		if (analyze_node(ctx, count->matcher, errbuf))
+			return -1;
+	}
+	if (count->group_by) {
+		/* arrays are grouped by each of their elements */
+		context_t ctx = { count->obj_type, 0 };
+		if ((count->group_by->type != SDB_AST_TYPE_VALUE)
+				&& (count->group_by->type != SDB_AST_TYPE_TYPED)) {
+			sdb_strbuf_sprintf(errbuf, "Invalid GROUP BY expression "
+					"of type %s in COUNT command",
+					SDB_AST_TYPE_TO_STRING(count->group_by));
+			return -1;
+		}
+		if (analyze_node(ctx, count->group_by, errbuf))
+			return -1;
+	}
+	if (count->filter)
+		return analyze_node(FILTER_CTX, count->filter, errbuf);
+	return 0;
+} /* analyze_count */
+
+static int
+analyze_explain(sdb_ast_explain_t *explain, sdb_strbuf_t *errbuf)
+{
+	sdb_ast_node_t *q = explain->query;
+
+	if ((! q) || ((q->type != SDB_AST_TYPE_FETCH)
+				&& (q->type != SDB_AST_TYPE_LIST)
+				&& (q->type != SDB_AST_TYPE_LOOKUP)
+				&& (q->type != SDB_AST_TYPE_COUNT))) {
+		sdb_strbuf_sprintf(errbuf, "Invalid %s command in EXPLAIN command",
+				q ? SDB_AST_TYPE_TO_STRING(q) : "empty");
+		return -1;
+	}
+	return sdb_parser_analyze(q, errbuf);
+} /* analyze_explain */
+
 static int
 analyze_store(sdb_ast_store_t *st, sdb_strbuf_t *errbuf)
 {
@@ -630,6 +766,10 @@ sdb_parser_analyze(sdb_ast_node_t *node, sdb_strbuf_t *errbuf)
 		return analyze_store(SDB_AST_STORE(node), errbuf);
 	else if (node->type == SDB_AST_TYPE_TIMESERIES)
 		return analyze_timeseries(SDB_AST_TIMESERIES(node), errbuf);
+	else if (node->type == SDB_AST_TYPE_COUNT)
+		return analyze_count(SDB_AST_COUNT(node), errbuf);
+	else if (node->type == SDB_AST_TYPE_EXPLAIN)
+		return analyze_explain(SDB_AST_EXPLAIN(node), errbuf);
 
 	sdb_strbuf_sprintf(errbuf, "Invalid top-level AST node "
 			"of type %#x", node->type);
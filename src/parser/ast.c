@@ -95,12 +95,31 @@ fetch_destroy(sdb_object_t *obj)
 	fetch->filter = NULL;
 } /* fetch_destroy */
 
+static void
+select_destroy(sdb_ast_node_t ***select, size_t *select_num)
+{
+	size_t i;
+	for (i = 0; i < *select_num; ++i)
+		sdb_object_deref(SDB_OBJ((*select)[i]));
+	if (*select)
+		free(*select);
+	*select = NULL;
+	*select_num = 0;
+} /* select_destroy */
+
 static void
 list_destroy(sdb_object_t *obj)
 {
 	sdb_ast_list_t *list = SDB_AST_LIST(obj);
 	sdb_object_deref(SDB_OBJ(list->filter));
-	list->filter = NULL;
+	sdb_object_deref(SDB_OBJ(list->order_by));
+	list->filter = list->order_by = NULL;
+	if (list->after_host)
+		free(list->after_host);
+	if (list->after_name)
+		free(list->after_name);
+	list->after_host = list->after_name = NULL;
+	select_destroy(&list->select, &list->select_num);
 } /* list_destroy */
 
 static void
@@ -109,9 +128,34 @@ lookup_destroy(sdb_object_t *obj)
 	sdb_ast_lookup_t *lookup = SDB_AST_LOOKUP(obj);
 	sdb_object_deref(SDB_OBJ(lookup->matcher));
 	sdb_object_deref(SDB_OBJ(lookup->filter));
-	lookup->matcher = lookup->filter = NULL;
+	sdb_object_deref(SDB_OBJ(lookup->order_by));
+	lookup->matcher = lookup->filter = lookup->order_by = NULL;
+	if (lookup->after_host)
+		free(lookup->after_host);
+	if (lookup->after_name)
+		free(lookup->after_name);
+	lookup->after_host = lookup->after_name = NULL;
+	select_destroy(&lookup->select, &lookup->select_num);
 } /* lookup_destroy */
 
+static void
+count_destroy(sdb_object_t *obj)
+{
+	sdb_ast_count_t *count = SDB_AST_COUNT(obj);
+	sdb_object_deref(SDB_OBJ(count->matcher));
+	sdb_object_deref(SDB_OBJ(count->filter));
+	sdb_object_deref(SDB_OBJ(count->group_by));
+	count->matcher = count->filter = count->group_by = NULL;
+} /* count_destroy */
+
+static void
+explain_destroy(sdb_object_t *obj)
+{
+	sdb_ast_explain_t *explain = SDB_AST_EXPLAIN(obj);
+	sdb_object_deref(SDB_OBJ(explain->query));
+	explain->query = NULL;
+} /* explain_destroy */
+
 static void
 store_destroy(sdb_object_t *obj)
 {
@@ -199,6 +243,18 @@ static sdb_type_t lookup_type = {
 	/* destroy */ lookup_destroy,
 };
 
+static sdb_type_t count_type = {
+	/* size */ sizeof(sdb_ast_count_t),
+	/* init */ NULL,
+	/* destroy */ count_destroy,
+};
+
+static sdb_type_t explain_type = {
+	/* size */ sizeof(sdb_ast_explain_t),
+	/* init */ NULL,
+	/* destroy */ explain_destroy,
+};
+
 static sdb_type_t st_type = {
 	/* size */ sizeof(sdb_ast_store_t),
 	/* init */ NULL,
@@ -331,6 +387,7 @@ sdb_ast_list_create(int obj_type, sdb_ast_node_t *filter)
 
 	list->obj_type = obj_type;
 	list->filter = filter;
+	list->limit = -1;
 	return SDB_AST_NODE(list);
 } /* sdb_ast_list_create */
 
@@ -348,9 +405,42 @@ sdb_ast_lookup_create(int obj_type, sdb_ast_node_t *matcher,
 	lookup->obj_type = obj_type;
 	lookup->matcher = matcher;
 	lookup->filter = filter;
+	lookup->limit = -1;
 	return SDB_AST_NODE(lookup);
 } /* sdb_ast_lookup_create */
 
+sdb_ast_node_t *
+sdb_ast_count_create(int obj_type, sdb_ast_node_t *matcher,
+		sdb_ast_node_t *filter, sdb_ast_node_t *group_by)
+{
+	sdb_ast_count_t *count;
+	count = SDB_AST_COUNT(sdb_object_create("COUNT", count_type));
+	if (! count)
+		return NULL;
+
+	count->super.type = SDB_AST_TYPE_COUNT;
+
+	count->obj_type = obj_type;
+	count->matcher = matcher;
+	count->filter = filter;
+	count->group_by = group_by;
+	return SDB_AST_NODE(count);
+} /* sdb_ast_count_create */
+
+sdb_ast_node_t *
+sdb_ast_explain_create(sdb_ast_node_t *query)
+{
+	sdb_ast_explain_t *explain;
+	explain = SDB_AST_EXPLAIN(sdb_object_create("EXPLAIN", explain_type));
+	if (! explain)
+		return NULL;
+
+	explain->super.type = SDB_AST_TYPE_EXPLAIN;
+
+	explain->query = query;
+	return SDB_AST_NODE(explain);
+} /* sdb_ast_explain_create */
+
 sdb_ast_node_t *
 sdb_ast_store_create(int obj_type, char *hostname,
 		int parent_type, char *parent, char *name, sdb_time_t last_update,
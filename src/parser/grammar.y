@@ -44,6 +44,7 @@
 #include <assert.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 /*
@@ -105,6 +106,10 @@ sdb_parser_yyerrorf(YYLTYPE *lval, sdb_parser_yyscan_t scanner, const char *fmt,
 	sdb_ast_node_t *node;
 
 	struct { char *type; char *id; sdb_time_t last_update; } metric_store;
+	struct { sdb_ast_node_t *expr; bool desc; } order;
+	struct { char *host; char *name; } after;
+	struct { sdb_ast_node_t **nodes; size_t len; } select;
+	int64_t count;
 }
 
 %start statements
@@ -129,7 +134,9 @@ sdb_parser_yyerrorf(YYLTYPE *lval, sdb_parser_yyscan_t scanner, const char *fmt,
 
 %token TRUE FALSE
 
-%token FETCH LIST LOOKUP STORE TIMESERIES
+%token FETCH LIST LOOKUP STORE TIMESERIES COUNT EXPLAIN
+
+%token SELECT ORDER GROUP BY ASC DESC AFTER LIMIT OFFSET
 
 %token <str> IDENTIFIER STRING
 
@@ -160,8 +167,12 @@ sdb_parser_yyerrorf(YYLTYPE *lval, sdb_parser_yyscan_t scanner, const char *fmt,
 	lookup_statement
 	store_statement
 	timeseries_statement
+	count_statement
+	explain_statement
+	query_statement
 	matching_clause
 	filter_clause
+	group_clause
 	condition comparison
 	expression object_expression
 
@@ -179,9 +190,22 @@ sdb_parser_yyerrorf(YYLTYPE *lval, sdb_parser_yyscan_t scanner, const char *fmt,
 
 %type <metric_store> metric_store_clause
 
+%type <select> select_clause select_list
+%type <order> order_clause
+%type <after> after_clause
+%type <count> limit_clause offset_clause
+
 %destructor { free($$); } <str>
 %destructor { sdb_object_deref(SDB_OBJ($$)); } <node>
 %destructor { sdb_data_free_datum(&$$); } <data>
+%destructor { sdb_object_deref(SDB_OBJ($$.expr)); } <order>
+%destructor { free($$.host); free($$.name); } <after>
+%destructor {
+	size_t i;
+	for (i = 0; i < $$.len; ++i)
+		sdb_object_deref(SDB_OBJ($$.nodes[i]));
+	free($$.nodes);
+} <select>
 
 %%
 
@@ -256,22 +280,30 @@ statements:
 	;
 
 statement:
-	fetch_statement
-	|
-	list_statement
-	|
-	lookup_statement
+	query_statement
 	|
 	store_statement
 	|
 	timeseries_statement
 	|
+	explain_statement
+	|
 	/* empty */
 		{
 			$$ = NULL;
 		}
 	;
 
+query_statement:
+	fetch_statement
+	|
+	list_statement
+	|
+	lookup_statement
+	|
+	count_statement
+	;
+
 /*
  * FETCH host <hostname> [FILTER <condition>];
  * FETCH <type> <hostname>.<name> [FILTER <condition>];
@@ -293,28 +325,79 @@ fetch_statement:
 	;
 
 /*
- * LIST <type> [FILTER <condition>];
+ * LIST <type> [FILTER <condition>] [SELECT <expression>, ...]
+ *   [ORDER BY <expression> [ASC|DESC]] [AFTER <host>[.<name>]]
+ *   [LIMIT <n>] [OFFSET <n>];
  *
  * Returns a list of all objects in the store.
  */
 list_statement:
-	LIST object_type_plural filter_clause
+	LIST object_type_plural filter_clause select_clause
+		order_clause after_clause limit_clause offset_clause
 		{
 			$$ = sdb_ast_list_create($2, $3);
 			CK_OOM($$);
+			SDB_AST_LIST($$)->select = $4.nodes;
+			SDB_AST_LIST($$)->select_num = $4.len;
+			SDB_AST_LIST($$)->order_by = $5.expr;
+			SDB_AST_LIST($$)->descending = $5.desc;
+			SDB_AST_LIST($$)->after_host = $6.host;
+			SDB_AST_LIST($$)->after_name = $6.name;
+			SDB_AST_LIST($$)->limit = $7;
+			SDB_AST_LIST($$)->offset = $8;
 		}
 	;
 
 /*
- * LOOKUP <type> [MATCHING <condition>] [FILTER <condition>];
+ * LOOKUP <type> [MATCHING <condition>] [FILTER <condition>]
+ *   [SELECT <expression>, ...]
+ *   [ORDER BY <expression> [ASC|DESC]] [AFTER <host>[.<name>]]
+ *   [LIMIT <n>] [OFFSET <n>];
  *
  * Returns detailed information about objects matching a condition.
  */
 lookup_statement:
-	LOOKUP object_type_plural matching_clause filter_clause
+	LOOKUP object_type_plural matching_clause filter_clause select_clause
+		order_clause after_clause limit_clause offset_clause
 		{
 			$$ = sdb_ast_lookup_create($2, $3, $4);
 			CK_OOM($$);
+			SDB_AST_LOOKUP($$)->select = $5.nodes;
+			SDB_AST_LOOKUP($$)->select_num = $5.len;
+			SDB_AST_LOOKUP($$)->order_by = $6.expr;
+			SDB_AST_LOOKUP($$)->descending = $6.desc;
+			SDB_AST_LOOKUP($$)->after_host = $7.host;
+			SDB_AST_LOOKUP($$)->after_name = $7.name;
+			SDB_AST_LOOKUP($$)->limit = $8;
+			SDB_AST_LOOKUP($$)->offset = $9;
+		}
+	;
+
+/*
+ * COUNT <type> [MATCHING <condition>] [FILTER <condition>]
+ *   [GROUP BY <expression>];
+ *
+ * Returns the number of objects matching a condition, optionally grouped by
+ * the value of a field or an attribute.
+ */
+count_statement:
+	COUNT object_type_plural matching_clause filter_clause group_clause
+		{
+			$$ = sdb_ast_count_create($2, $3, $4, $5);
+			CK_OOM($$);
+		}
+	;
+
+/*
+ * EXPLAIN <query>;
+ *
+ * Describe how a FETCH, LIST, LOOKUP, or COUNT command would be executed.
+ */
+explain_statement:
+	EXPLAIN query_statement
+		{
+			$$ = sdb_ast_explain_create($2);
+			CK_OOM($$);
 		}
 	;
 
@@ -328,6 +411,94 @@ filter_clause:
 	|
 	/* empty */ { $$ = NULL; }
 
+order_clause:
+	ORDER BY object_expression { $$.expr = $3; $$.desc = 0; }
+	|
+	ORDER BY object_expression ASC { $$.expr = $3; $$.desc = 0; }
+	|
+	ORDER BY object_expression DESC { $$.expr = $3; $$.desc = 1; }
+	|
+	/* empty */ { $$.expr = NULL; $$.desc = 0; }
+
+select_clause:
+	SELECT select_list { $$ = $2; }
+	|
+	/* empty */ { $$.nodes = NULL; $$.len = 0; }
+
+select_list:
+	select_list ',' object_expression
+		{
+			sdb_ast_node_t **nodes;
+			size_t i;
+
+			nodes = realloc($1.nodes, ($1.len + 1) * sizeof(*nodes));
+			if (! nodes) {
+				for (i = 0; i < $1.len; ++i)
+					sdb_object_deref(SDB_OBJ($1.nodes[i]));
+				free($1.nodes);
+				sdb_object_deref(SDB_OBJ($3));
+				sdb_parser_yyerror(&yylloc, scanner, YY_("out of memory"));
+				YYABORT;
+			}
+
+			$$.nodes = nodes;
+			$$.nodes[$1.len] = $3;
+			$$.len = $1.len + 1;
+		}
+	|
+	object_expression
+		{
+			$$.nodes = malloc(sizeof(*$$.nodes));
+			if (! $$.nodes) {
+				sdb_object_deref(SDB_OBJ($1));
+				sdb_parser_yyerror(&yylloc, scanner, YY_("out of memory"));
+				YYABORT;
+			}
+			$$.nodes[0] = $1;
+			$$.len = 1;
+		}
+	;
+
+group_clause:
+	GROUP BY object_expression { $$ = $3; }
+	|
+	/* empty */ { $$ = NULL; }
+
+after_clause:
+	AFTER STRING { $$.host = $2; $$.name = NULL; }
+	|
+	AFTER STRING '.' STRING { $$.host = $2; $$.name = $4; }
+	|
+	/* empty */ { $$.host = $$.name = NULL; }
+
+limit_clause:
+	LIMIT INTEGER
+		{
+			if ($2.data.integer < 0) {
+				sdb_parser_yyerrorf(&yylloc, scanner, YY_("syntax error, "
+						"unexpected negative LIMIT %"PRId64),
+						$2.data.integer);
+				YYABORT;
+			}
+			$$ = $2.data.integer;
+		}
+	|
+	/* empty */ { $$ = -1; }
+
+offset_clause:
+	OFFSET INTEGER
+		{
+			if ($2.data.integer < 0) {
+				sdb_parser_yyerrorf(&yylloc, scanner, YY_("syntax error, "
+						"unexpected negative OFFSET %"PRId64),
+						$2.data.integer);
+				YYABORT;
+			}
+			$$ = $2.data.integer;
+		}
+	|
+	/* empty */ { $$ = 0; }
+
 /*
  * STORE <type> <name>|<host>.<name> [LAST UPDATE <datetime>];
  * STORE METRIC <host>.<name> STORE <type> <id> [LAST UPDATE <datetime>];
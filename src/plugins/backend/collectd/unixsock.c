@@ -66,9 +66,12 @@ typedef struct {
 	int metrics_updated;
 	int metrics_failed;
 
+	/* all objects of one LISTVAL sweep are stored at once */
+	sdb_plugin_batch_t *batch;
+
 	user_data_t *ud;
 } state_t;
-#define STATE_INIT { NULL, 0, 0, 0, NULL }
+#define STATE_INIT { NULL, 0, 0, 0, NULL, NULL }
 
 /*
  * private helper functions
@@ -109,7 +112,7 @@ store_host(state_t *state, const char *hostname, sdb_time_t last_update)
 	/* else: first/new host */
 
 	if (state->current_host) {
-		sdb_log(SDB_LOG_DEBUG, "Added/updated %i metric%s (%i failed) for host '%s'.",
+		sdb_log(SDB_LOG_DEBUG, "Queued %i metric%s (%i failed) for host '%s'.",
 				state->metrics_updated, state->metrics_updated == 1 ? "" : "s",
 				state->metrics_failed, state->current_host);
 		state->metrics_updated = state->metrics_failed = 0;
@@ -124,24 +127,22 @@ store_host(state_t *state, const char *hostname, sdb_time_t last_update)
 		return -1;
 	}
 
-	status = sdb_plugin_store_host(hostname, last_update);
-
+	status = sdb_plugin_store_batch_host(state->batch, hostname, last_update);
 	if (status < 0) {
 		sdb_log(SDB_LOG_ERR, "Failed to store/update host '%s'.", hostname);
 		return -1;
 	}
-	else if (status > 0) /* value too old */
-		return 0;
 
-	sdb_log(SDB_LOG_DEBUG, "Added/updated host '%s' "
+	/* the outcome is known only once the batch has been committed */
+	sdb_log(SDB_LOG_DEBUG, "Queued host '%s' for update "
 			"(last update timestamp = %"PRIsdbTIME").",
 			hostname, last_update);
 	return 0;
 } /* store_host */
 
 static int
-add_metrics(const char *hostname, char *plugin, char *type,
-		sdb_time_t last_update, user_data_t *ud)
+add_metrics(sdb_plugin_batch_t *batch, const char *hostname,
+		char *plugin, char *type, sdb_time_t last_update, user_data_t *ud)
 {
 	char  name[strlen(plugin) + strlen(type) + 2];
 	char *plugin_instance, *type_instance;
@@ -159,10 +160,12 @@ add_metrics(const char *hostname, char *plugin, char *type,
 	if (ud->ts_base) {
 		snprintf(metric_id, sizeof(metric_id), "%s/%s/%s.rrd",
 				ud->ts_base, hostname, name);
-		status = sdb_plugin_store_metric(hostname, name, &store, last_update);
+		status = sdb_plugin_store_batch_metric(batch, hostname, name,
+				&store, last_update);
 	}
 	else
-		status = sdb_plugin_store_metric(hostname, name, NULL, last_update);
+		status = sdb_plugin_store_batch_metric(batch, hostname, name,
+				NULL, last_update);
 	if (status < 0) {
 		sdb_log(SDB_LOG_ERR, "Failed to store/update metric '%s/%s'.", hostname, name);
 		return -1;
@@ -174,7 +177,7 @@ add_metrics(const char *hostname, char *plugin, char *type,
 		++plugin_instance;
 
 		data.data.string = plugin_instance;
-		sdb_plugin_store_metric_attribute(hostname, name,
+		sdb_plugin_store_batch_metric_attribute(batch, hostname, name,
 				"plugin_instance", &data, last_update);
 	}
 
@@ -184,14 +187,16 @@ add_metrics(const char *hostname, char *plugin, char *type,
 		++type_instance;
 
 		data.data.string = type_instance;
-		sdb_plugin_store_metric_attribute(hostname, name,
+		sdb_plugin_store_batch_metric_attribute(batch, hostname, name,
 				"type_instance", &data, last_update);
 	}
 
 	data.data.string = plugin;
-	sdb_plugin_store_metric_attribute(hostname, name, "plugin", &data, last_update);
+	sdb_plugin_store_batch_metric_attribute(batch, hostname, name,
+			"plugin", &data, last_update);
 	data.data.string = type;
-	sdb_plugin_store_metric_attribute(hostname, name, "type", &data, last_update);
+	sdb_plugin_store_batch_metric_attribute(batch, hostname, name,
+			"type", &data, last_update);
 	return 0;
 } /* add_metrics */
 
@@ -241,7 +246,7 @@ get_data(sdb_unixsock_client_t __attribute__((unused)) *client,
 	if (store_host(state, hostname, last_update.data.datetime))
 		return -1;
 
-	if (add_metrics(hostname, plugin, type,
+	if (add_metrics(state->batch, hostname, plugin, type,
 				last_update.data.datetime, state->ud))
 		++state->metrics_failed;
 	else
@@ -283,6 +288,7 @@ sdb_collectd_collect(sdb_object_t *user_data)
 
 	char *endptr = NULL;
 	long int count;
+	int status, check;
 
 	state_t state = STATE_INIT;
 	sdb_object_wrapper_t state_obj = SDB_OBJECT_WRAPPER_STATIC(&state);
@@ -327,20 +333,42 @@ sdb_collectd_collect(sdb_object_t *user_data)
 		return -1;
 	}
 
-	if (sdb_unixsock_client_process_lines(ud->client, get_data,
-				SDB_OBJ(&state_obj), count, /* delim */ "/",
-				/* column count = */ 3,
-				SDB_TYPE_STRING, SDB_TYPE_STRING, SDB_TYPE_STRING)) {
-		sdb_log(SDB_LOG_ERR, "Failed to read response from collectd @ %s.",
+	state.batch = sdb_plugin_store_batch_begin();
+	if (! state.batch) {
+		sdb_log(SDB_LOG_ERR, "Failed to allocate batch for collectd @ %s.",
 				sdb_unixsock_client_path(ud->client));
 		return -1;
 	}
 
-	if (state.current_host) {
-		sdb_log(SDB_LOG_DEBUG, "Added/updated %i metric%s (%i failed) for host '%s'.",
+	status = sdb_unixsock_client_process_lines(ud->client, get_data,
+			SDB_OBJ(&state_obj), count, /* delim */ "/",
+			/* column count = */ 3,
+			SDB_TYPE_STRING, SDB_TYPE_STRING, SDB_TYPE_STRING);
+
+	if (state.current_host && (! status))
+		sdb_log(SDB_LOG_DEBUG, "Queued %i metric%s (%i failed) for host '%s'.",
 				state.metrics_updated, state.metrics_updated == 1 ? "" : "s",
 				state.metrics_failed, state.current_host);
-		free(state.current_host);
+	free(state.current_host);
+
+	/* store everything received so far, even if reading failed */
+	check = sdb_plugin_store_batch_commit(state.batch);
+	if (check < 0)
+		sdb_log(SDB_LOG_ERR, "Failed to store some objects received "
+				"from collectd @ %s.", sdb_unixsock_client_path(ud->client));
+	else if (check > 0)
+		sdb_log(SDB_LOG_DEBUG, "Added/updated objects received from "
+				"collectd @ %s; ignored stale updates of some of them.",
+				sdb_unixsock_client_path(ud->client));
+	else
+		sdb_log(SDB_LOG_DEBUG, "Added/updated all objects received from "
+				"collectd @ %s.", sdb_unixsock_client_path(ud->client));
+	sdb_object_deref(SDB_OBJ(state.batch));
+
+	if (status) {
+		sdb_log(SDB_LOG_ERR, "Failed to read response from collectd @ %s.",
+				sdb_unixsock_client_path(ud->client));
+		return -1;
 	}
 	return 0;
 } /* collect */
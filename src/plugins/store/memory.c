@@ -33,14 +33,151 @@
 #include "core/plugin.h"
 #include "core/memstore.h"
 #include "core/store.h"
+#include "core/time.h"
 #include "utils/error.h"
 
+#include "liboconfig/utils.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
 SDB_PLUGIN_MAGIC;
 
+/* store singleton */
+static sdb_memstore_t *mem_store = NULL;
+
+static char *snapshot_file = NULL;
+static sdb_time_t snapshot_interval = 0;
+
+static char *journal_file = NULL;
+static sdb_time_t journal_sync_interval = SECS_TO_SDB_TIME(1);
+static sdb_memstore_journal_t *journal = NULL;
+
+static sdb_memstore_expiry_t expiry;
+static sdb_time_t expire_min_age = SECS_TO_SDB_TIME(3600);
+static sdb_time_t expire_interval = SECS_TO_SDB_TIME(60);
+
+/*
+ * private helper functions
+ */
+
+static void
+mem_replay(const char *filename)
+{
+	sdb_time_t start = sdb_gettime();
+
+	if (access(filename, F_OK))
+		return;
+	if (sdb_memstore_journal_replay(mem_store, filename) < 0)
+		sdb_log(SDB_LOG_ERR, "memory store: Failed to replay journal %s; "
+				"some updates may have been lost", filename);
+	else
+		sdb_log(SDB_LOG_INFO, "memory store: Replayed journal %s in %.3fs",
+				filename, SDB_TIME_TO_DOUBLE(sdb_gettime() - start));
+} /* mem_replay */
+
+static int
+mem_restore(void)
+{
+	sdb_time_t start = sdb_gettime();
+	int status;
+
+	if (access(snapshot_file, F_OK))
+		sdb_log(SDB_LOG_INFO, "memory store: No snapshot found at %s; "
+				"starting with an empty store", snapshot_file);
+	else {
+		status = sdb_memstore_restore(mem_store, snapshot_file);
+		if (status < 0)
+			sdb_log(SDB_LOG_ERR, "memory store: Failed to restore snapshot "
+					"%s; it will be replaced by the next snapshot",
+					snapshot_file);
+		else
+			sdb_log(SDB_LOG_INFO, "memory store: Restored snapshot %s "
+					"in %.3fs", snapshot_file,
+					SDB_TIME_TO_DOUBLE(sdb_gettime() - start));
+	}
+
+	if (journal_file) {
+		char oldname[strlen(journal_file) + 5];
+
+		/* see sdb_memstore_journal_compact() */
+		snprintf(oldname, sizeof(oldname), "%s.old", journal_file);
+		mem_replay(oldname);
+		mem_replay(journal_file);
+
+		/* opening the journal discards its content, so all replayed updates
+		 * have to be part of the snapshot first */
+		if (sdb_memstore_dump(mem_store, snapshot_file)) {
+			sdb_log(SDB_LOG_ERR, "memory store: Failed to write snapshot %s; "
+					"refusing to discard journal %s", snapshot_file,
+					journal_file);
+			return -1;
+		}
+		journal = sdb_memstore_journal_open(journal_file,
+				journal_sync_interval);
+		if (! journal)
+			return -1;
+		unlink(oldname);
+	}
+	return 0;
+} /* mem_restore */
+
+/* Enable the expiry of objects with the configured minimum age; returns
+ * false if no objects expire at all. */
+static bool
+mem_expiry_setup(void)
+{
+	sdb_memstore_ttl_t *ttls[] = {
+		&expiry.host, &expiry.service, &expiry.metric, &expiry.attribute,
+	};
+	bool enabled = 0;
+	size_t i;
+
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(ttls); ++i) {
+		ttls[i]->min_age = 0;
+		if (ttls[i]->factor > 0.0) {
+			ttls[i]->min_age = expire_min_age;
+			enabled = 1;
+		}
+	}
+	return enabled;
+} /* mem_expiry_setup */
+
 /*
  * plugin API
  */
 
+static int
+mem_expire(sdb_object_t *user_data)
+{
+	sdb_time_t start = sdb_gettime();
+	int n;
+
+	n = sdb_memstore_expire(SDB_MEMSTORE(user_data), &expiry, start);
+	if (n < 0) {
+		sdb_log(SDB_LOG_ERR, "memory store: Failed to expire objects");
+		return -1;
+	}
+	if (n)
+		sdb_log(SDB_LOG_INFO, "memory store: Expired %d object%s in %.3fs",
+				n, n == 1 ? "" : "s",
+				SDB_TIME_TO_DOUBLE(sdb_gettime() - start));
+	return 0;
+} /* mem_expire */
+
+static int
+mem_dump(sdb_object_t *user_data)
+{
+	if (journal)
+		return sdb_memstore_journal_compact(journal,
+				SDB_MEMSTORE(user_data), snapshot_file);
+	return sdb_memstore_dump(SDB_MEMSTORE(user_data), snapshot_file);
+} /* mem_dump */
+
 static int
 mem_init(sdb_object_t *user_data)
 {
@@ -60,22 +197,194 @@ mem_init(sdb_object_t *user_data)
 		sdb_object_deref(SDB_OBJ(store));
 		return -1;
 	}
+
+	if (snapshot_file) {
+		if (mem_restore())
+			return -1;
+		/* the journal has to be written after updating the store; see
+		 * sdb_memstore_journal_compact() */
+		if (journal && sdb_plugin_register_writer("journal",
+					&sdb_memstore_journal_writer, SDB_OBJ(journal)))
+			return -1;
+		if (snapshot_interval
+				&& sdb_plugin_register_collector("snapshot", mem_dump,
+					&snapshot_interval, SDB_OBJ(store)))
+			return -1;
+	}
+
+	if (mem_expiry_setup()
+			&& sdb_plugin_register_collector("expire", mem_expire,
+				&expire_interval, SDB_OBJ(store)))
+		return -1;
 	return 0;
 } /* mem_init */
 
 static int
 mem_shutdown(sdb_object_t *user_data)
 {
+	if (snapshot_file && mem_dump(user_data))
+		sdb_log(SDB_LOG_ERR, "memory store: Failed to write snapshot %s "
+				"on shutdown", snapshot_file);
+	sdb_object_deref(SDB_OBJ(journal));
+	journal = NULL;
 	sdb_object_deref(user_data);
+	mem_store = NULL;
 	return 0;
 } /* mem_shutdown */
 
+static int
+mem_config(oconfig_item_t *ci)
+{
+	int i;
+
+	if (! ci) { /* reconfigure */
+		if (snapshot_file)
+			free(snapshot_file);
+		snapshot_file = NULL;
+		snapshot_interval = 0;
+		if (journal_file)
+			free(journal_file);
+		journal_file = NULL;
+		journal_sync_interval = SECS_TO_SDB_TIME(1);
+		memset(&expiry, 0, sizeof(expiry));
+		expire_min_age = SECS_TO_SDB_TIME(3600);
+		expire_interval = SECS_TO_SDB_TIME(60);
+		return 0;
+	}
+
+	for (i = 0; i < ci->children_num; ++i) {
+		oconfig_item_t *child = ci->children + i;
+
+		if (! strcasecmp(child->key, "Snapshot")) {
+			char *filename = NULL;
+
+			if (oconfig_get_string(child, &filename)) {
+				sdb_log(SDB_LOG_ERR, "memory store: Snapshot requires "
+						"a single string argument\n\tUsage: Snapshot PATH");
+				return -1;
+			}
+			if (snapshot_file)
+				free(snapshot_file);
+			if (! (snapshot_file = strdup(filename))) {
+				char errbuf[1024];
+				sdb_log(SDB_LOG_ERR, "memory store: Failed to duplicate "
+						"string: %s", sdb_strerror(errno, errbuf, sizeof(errbuf)));
+				return -1;
+			}
+		}
+		else if (! strcasecmp(child->key, "SnapshotInterval")) {
+			double interval = 0.0;
+
+			if (oconfig_get_number(child, &interval) || (interval < 0.0)) {
+				sdb_log(SDB_LOG_ERR, "memory store: SnapshotInterval "
+						"requires a single, non-negative numeric argument\n"
+						"\tUsage: SnapshotInterval SECONDS");
+				return -1;
+			}
+			snapshot_interval = DOUBLE_TO_SDB_TIME(interval);
+		}
+		else if (! strcasecmp(child->key, "Journal")) {
+			char *filename = NULL;
+
+			if (oconfig_get_string(child, &filename)) {
+				sdb_log(SDB_LOG_ERR, "memory store: Journal requires "
+						"a single string argument\n\tUsage: Journal PATH");
+				return -1;
+			}
+			if (journal_file)
+				free(journal_file);
+			if (! (journal_file = strdup(filename))) {
+				char errbuf[1024];
+				sdb_log(SDB_LOG_ERR, "memory store: Failed to duplicate "
+						"string: %s", sdb_strerror(errno, errbuf, sizeof(errbuf)));
+				return -1;
+			}
+		}
+		else if (! strcasecmp(child->key, "JournalSyncInterval")) {
+			double interval = 0.0;
+
+			if (oconfig_get_number(child, &interval) || (interval < 0.0)) {
+				sdb_log(SDB_LOG_ERR, "memory store: JournalSyncInterval "
+						"requires a single, non-negative numeric argument\n"
+						"\tUsage: JournalSyncInterval SECONDS");
+				return -1;
+			}
+			journal_sync_interval = DOUBLE_TO_SDB_TIME(interval);
+		}
+		else if ((! strcasecmp(child->key, "ExpireHosts"))
+				|| (! strcasecmp(child->key, "ExpireServices"))
+				|| (! strcasecmp(child->key, "ExpireMetrics"))
+				|| (! strcasecmp(child->key, "ExpireAttributes"))) {
+			double factor = 0.0;
+
+			if (oconfig_get_number(child, &factor) || (factor < 0.0)) {
+				sdb_log(SDB_LOG_ERR, "memory store: %s requires a single, "
+						"non-negative numeric argument\n"
+						"\tUsage: %s FACTOR", child->key, child->key);
+				return -1;
+			}
+			if (! strcasecmp(child->key, "ExpireHosts"))
+				expiry.host.factor = factor;
+			else if (! strcasecmp(child->key, "ExpireServices"))
+				expiry.service.factor = factor;
+			else if (! strcasecmp(child->key, "ExpireMetrics"))
+				expiry.metric.factor = factor;
+			else
+				expiry.attribute.factor = factor;
+		}
+		else if (! strcasecmp(child->key, "ExpireMinAge")) {
+			double age = 0.0;
+
+			if (oconfig_get_number(child, &age) || (age < 0.0)) {
+				sdb_log(SDB_LOG_ERR, "memory store: ExpireMinAge requires "
+						"a single, non-negative numeric argument\n"
+						"\tUsage: ExpireMinAge SECONDS");
+				return -1;
+			}
+			expire_min_age = DOUBLE_TO_SDB_TIME(age);
+		}
+		else if (! strcasecmp(child->key, "ExpireInterval")) {
+			double interval = 0.0;
+
+			if (oconfig_get_number(child, &interval) || (interval <= 0.0)) {
+				sdb_log(SDB_LOG_ERR, "memory store: ExpireInterval requires "
+						"a single, positive numeric argument\n"
+						"\tUsage: ExpireInterval SECONDS");
+				return -1;
+			}
+			expire_interval = DOUBLE_TO_SDB_TIME(interval);
+		}
+		else if (! strcasecmp(child->key, "IndexAttribute")) {
+			char *key = NULL;
+
+			if (oconfig_get_string(child, &key)) {
+				sdb_log(SDB_LOG_ERR, "memory store: IndexAttribute requires "
+						"a single string argument\n\tUsage: IndexAttribute KEY");
+				return -1;
+			}
+			/* indexes are kept across reconfiguration */
+			if (sdb_memstore_index_attribute(mem_store, key) < 0) {
+				sdb_log(SDB_LOG_ERR, "memory store: Failed to index "
+						"attribute '%s'", key);
+				return -1;
+			}
+		}
+		else
+			sdb_log(SDB_LOG_WARNING, "memory store: Ignoring unknown config "
+					"option '%s'.", child->key);
+	}
+
+	if (journal_file && (! snapshot_file)) {
+		sdb_log(SDB_LOG_ERR, "memory store: Journal requires a Snapshot "
+				"to compact it into");
+		return -1;
+	}
+	return 0;
+} /* mem_config */
+
 int
 sdb_module_init(sdb_plugin_info_t *info)
 {
-	/* store singleton */
-	static sdb_memstore_t *store;
-
 	sdb_plugin_set_info(info, SDB_PLUGIN_INFO_DESC, "in-memory object store");
 	sdb_plugin_set_info(info, SDB_PLUGIN_INFO_COPYRIGHT,
 			"Copyright (C) 2015 Sebastian 'tokkee' Harl <sh@tokkee.org>");
@@ -83,15 +392,16 @@ sdb_module_init(sdb_plugin_info_t *info)
 	sdb_plugin_set_info(info, SDB_PLUGIN_INFO_VERSION, SDB_VERSION);
 	sdb_plugin_set_info(info, SDB_PLUGIN_INFO_PLUGIN_VERSION, SDB_VERSION);
 
-	if (! store) {
-		if (! (store = sdb_memstore_create())) {
+	if (! mem_store) {
+		if (! (mem_store = sdb_memstore_create())) {
 			sdb_log(SDB_LOG_ERR, "Failed to create store object");
 			return -1;
 		}
 	}
 
-	sdb_plugin_register_init("main", mem_init, SDB_OBJ(store));
-	sdb_plugin_register_shutdown("main", mem_shutdown, SDB_OBJ(store));
+	sdb_plugin_register_config(mem_config);
+	sdb_plugin_register_init("main", mem_init, SDB_OBJ(mem_store));
+	sdb_plugin_register_shutdown("main", mem_shutdown, SDB_OBJ(mem_store));
 	return 0;
 } /* sdb_module_init */
 
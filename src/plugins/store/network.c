@@ -176,7 +176,7 @@ store_attr(sdb_store_attribute_t *attr, sdb_object_t *user_data)
 } /* store_attr */
 
 static sdb_store_writer_t store_impl = {
-	store_host, store_service, store_metric, store_attr,
+	store_host, store_service, store_metric, store_attr, NULL, NULL, NULL,
 };
 
 /*
@@ -192,6 +192,50 @@ data_printer(sdb_input_t *input, sdb_strbuf_t *buf)
 		waitpid(pager, NULL, 0);
 } /* data_printer */
 
+/* Receive the remaining parts of a chunked data reply and append their
+ * results to the buffer. Log messages are printed right away. On error, the
+ * partial result is replaced with the error message. Returns the status of
+ * the final message. */
+static uint32_t
+recv_chunks(sdb_input_t *input, sdb_strbuf_t *buf)
+{
+	sdb_strbuf_t *msg = sdb_strbuf_create(1024);
+	uint32_t rcode = SDB_CONNECTION_DATA_CHUNK;
+
+	if (! msg)
+		return UINT32_MAX;
+
+	while (rcode == SDB_CONNECTION_DATA_CHUNK) {
+		sdb_strbuf_clear(msg);
+		if ((sdb_client_recv(input->client, &rcode, msg) < 0)
+				|| sdb_client_eof(input->client)) {
+			rcode = UINT32_MAX;
+			break;
+		}
+
+		if (rcode == SDB_CONNECTION_LOG) {
+			log_printer(input, msg);
+			rcode = SDB_CONNECTION_DATA_CHUNK;
+		}
+		else if ((rcode == SDB_CONNECTION_DATA_CHUNK)
+				|| (rcode == SDB_CONNECTION_DATA)) {
+			/* each chunk includes the result type */
+			if (sdb_strbuf_len(msg) > sizeof(uint32_t))
+				sdb_strbuf_memappend(buf,
+						sdb_strbuf_string(msg) + sizeof(uint32_t),
+						sdb_strbuf_len(msg) - sizeof(uint32_t));
+		}
+		else {
+			sdb_strbuf_clear(buf);
+			sdb_strbuf_memappend(buf, sdb_strbuf_string(msg),
+					sdb_strbuf_len(msg));
+		}
+	}
+
+	sdb_strbuf_destroy(msg);
+	return rcode;
+} /* recv_chunks */
+
 static struct {
 	int status;
 	void (*printer)(sdb_input_t *, sdb_strbuf_t *);
@@ -230,6 +274,8 @@ sdb_command_print_reply(sdb_input_t *input)
 
 	if (sdb_client_recv(input->client, &rcode, recv_buf) < 0)
 		rcode = UINT32_MAX;
+	else if (rcode == SDB_CONNECTION_DATA_CHUNK)
+		rcode = recv_chunks(input, recv_buf);
 
 	if (sdb_client_eof(input->client)) {
 		sdb_strbuf_destroy(recv_buf);
@@ -335,5 +381,17 @@ sdb_command_print_server_version(sdb_input_t *input)
 	sdb_strbuf_destroy(buf);
 } /* sdb_command_print_server_version */
 
+void
+sdb_command_enable_chunks(sdb_input_t *input)
+{
+	sdb_strbuf_t *buf = sdb_strbuf_create(32);
+	uint32_t code = 0;
+
+	if ((sdb_client_rpc(input->client, SDB_CONNECTION_CHUNKED,
+					0, NULL, &code, buf) < 0) || (code != SDB_CONNECTION_OK))
+		sdb_log(SDB_LOG_DEBUG, "Server does not support chunked replies");
+	sdb_strbuf_destroy(buf);
+} /* sdb_command_enable_chunks */
+
 /* vim: set tw=78 sw=4 ts=4 noexpandtab : */
 
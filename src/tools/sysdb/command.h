@@ -65,6 +65,17 @@ sdb_command_exec(sdb_input_t *input);
 void
 sdb_command_print_server_version(sdb_input_t *input);
 
+/*
+ * sdb_command_enable_chunks:
+ * Ask the server to send the results of queries in chunks. This lets the
+ * server pass on large results without buffering all of them first. Older
+ * servers not supporting chunked replies are silently ignored. The setting
+ * applies to the current connection only and has to be renewed after
+ * reconnecting.
+ */
+void
+sdb_command_enable_chunks(sdb_input_t *input);
+
 #endif /* SYSDB_COMMAND_H */
 
 /* vim: set tw=78 sw=4 ts=4 noexpandtab : */
@@ -330,6 +330,8 @@ sdb_input_reconnect(void)
 	}
 	sdb_log(SDB_LOG_INFO, "Successfully reconnected to SysDBd");
 	sdb_command_print_server_version(sysdb_input);
+	/* connection settings do not survive the reconnect */
+	sdb_command_enable_chunks(sysdb_input);
 	return 0;
 } /* sdb_input_reconnect */
 
@@ -283,6 +283,10 @@ sdb_json_print(FILE *out, sdb_input_t *input, int type, sdb_strbuf_t *buf)
 	case SDB_CONNECTION_TIMESERIES:
 		f.context[0] = SDB_TIMESERIES;
 		break;
+	case SDB_CONNECTION_COUNT:
+		/* plain (group) counts */
+		f.context[0] = 0;
+		break;
 	}
 	f.next_context = f.context[0];
 
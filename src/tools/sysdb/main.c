@@ -322,6 +322,7 @@ main(int argc, char **argv)
 		sdb_input_reset(&input);
 		exit(1);
 	}
+	sdb_command_enable_chunks(&input);
 
 	if (commands) {
 		int status;
@@ -25,16 +25,21 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+
 #if HAVE_CONFIG_H
 #	include "config.h"
 #endif /* HAVE_CONFIG_H */
 
 #include "sysdb.h"
 #include "utils/avltree.h"
+#include "utils/epoch.h"
+#include "utils/slab.h"
 #include "utils/error.h"
 
 #include <assert.h>
 
+#include <ctype.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
@@ -44,13 +49,19 @@
  * private data types
  */
 
+/*
+ * Nodes are never modified once they have been published, allowing readers
+ * to walk the tree without any locking: insertions copy the path from the
+ * root to the new node and then atomically publish the new root (while
+ * still sharing all other nodes). Replaced nodes are released using
+ * epoch-based reclamation once no reader may access them anymore.
+ */
 struct node;
 typedef struct node node_t;
 
 struct node {
 	sdb_object_t *obj;
 
-	node_t *parent;
 	node_t *left;
 	node_t *right;
 
@@ -65,216 +76,513 @@ struct node {
 #define BALANCE(n) \
 	((n) ? (int)NODE_HEIGHT((n)->left) - (int)NODE_HEIGHT((n)->right) : 0)
 
+/* The height of an AVL tree is less than 1.45 * log2(n + 2), so this is
+ * more than enough for any tree fitting into memory. */
+#define MAX_HEIGHT 96
+
+/* a slot of the (optional) hash index; the tree owns the reference */
+typedef struct {
+	uint32_t hash;
+	sdb_object_t *obj;
+} slot_t;
+
+typedef struct {
+	size_t size;
+	slot_t slots[];
+} index_t;
+
+/* don't bother indexing trees smaller than this */
+#define INDEX_MIN_NODES 8
+
+/* Marks the slot of a removed object. Slots are never emptied, so that
+ * concurrent readers keep probing past removed objects. */
+static sdb_object_t tombstone = SDB_OBJECT_STATIC("<removed>");
+#define TOMBSTONE (&tombstone)
+
 struct sdb_avltree {
-	pthread_rwlock_t lock;
+	/* serializes writers; readers don't lock at all */
+	pthread_mutex_t lock;
 
+	/* accessed atomically */
 	node_t *root;
 	size_t size;
+
+	/* Hash index using open addressing and linear probing. The number of
+	 * slots is a power of two and the table is kept at most half full. It's
+	 * built lazily and falls back to a tree search if it's not available.
+	 * Slots are only ever filled, so readers may probe it concurrently. */
+	bool indexed;
+	index_t *index;
+	/* number of slots marking removed objects */
+	size_t tombstones;
 };
 
 struct sdb_avltree_iter {
 	sdb_avltree_t *tree;
-	node_t *node;
+	/* the snapshot of the tree */
+	node_t *root;
+
+	/* path to the next node; stack[depth - 1] is the next node */
+	node_t *stack[MAX_HEIGHT];
+	size_t depth;
 };
 
 /*
  * private helper functions
  */
 
+/* FNV-1a hash of the case-folded name */
+static uint32_t
+name_hash(const char *name)
+{
+	uint32_t h = 2166136261U;
+
+	for ( ; *name; ++name) {
+		h ^= (uint32_t)tolower((unsigned char)*name);
+		h *= 16777619U;
+	}
+	return h;
+} /* name_hash */
+
+static void
+index_add(index_t *idx, sdb_object_t *obj)
+{
+	size_t mask = idx->size - 1;
+	uint32_t h;
+	size_t i;
+
+	if ((! obj) || (! obj->name))
+		return;
+
+	h = name_hash(obj->name);
+	for (i = h & mask; idx->slots[i].obj; i = (i + 1) & mask)
+		/* nothing to do; the table is never full */;
+
+	/* publish the hash before the object */
+	idx->slots[i].hash = h;
+	__atomic_store_n(&idx->slots[i].obj, obj, __ATOMIC_RELEASE);
+} /* index_add */
+
+static sdb_object_t *
+index_lookup(index_t *idx, const char *name)
+{
+	size_t mask = idx->size - 1;
+	uint32_t h = name_hash(name);
+	sdb_object_t *obj;
+	size_t i;
+
+	for (i = h & mask;
+			(obj = __atomic_load_n(&idx->slots[i].obj, __ATOMIC_ACQUIRE));
+			i = (i + 1) & mask)
+		if ((obj != TOMBSTONE) && (idx->slots[i].hash == h)
+				&& (! strcasecmp(obj->name, name)))
+			return obj;
+	return NULL;
+} /* index_lookup */
+
+static void
+index_fill(index_t *idx, node_t *n)
+{
+	if (! n)
+		return;
+	index_fill(idx, n->left);
+	index_add(idx, n->obj);
+	index_fill(idx, n->right);
+} /* index_fill */
+
+/* Replace the index of the tree (which may be NULL). The old index will be
+ * released once it's no longer in use. */
+static void
+index_replace(sdb_avltree_t *tree, index_t *idx)
+{
+	index_t *old = tree->index;
+
+	__atomic_store_n(&tree->index, idx, __ATOMIC_RELEASE);
+	tree->tombstones = 0;
+	if (old && sdb_epoch_retire(old, free))
+		sdb_log(SDB_LOG_ERR, "avltree: Failed to release index; "
+				"leaking memory");
+} /* index_replace */
+
+/* (Re-)build the index with enough slots for the current tree. If that
+ * fails, lookups fall back to searching the tree. */
+static void
+index_rebuild(sdb_avltree_t *tree)
+{
+	size_t size = 2 * INDEX_MIN_NODES;
+	index_t *idx;
+
+	while (size < 2 * tree->size)
+		size *= 2;
+
+	idx = calloc(1, sizeof(*idx) + size * sizeof(idx->slots[0]));
+	if (idx) {
+		idx->size = size;
+		index_fill(idx, tree->root);
+	}
+	index_replace(tree, idx);
+} /* index_rebuild */
+
+/* Update the index after inserting 'obj' into the tree. */
+static void
+index_insert(sdb_avltree_t *tree, sdb_object_t *obj)
+{
+	if ((! tree->indexed) || (tree->size <= INDEX_MIN_NODES))
+		return;
+
+	if ((! tree->index)
+			|| (2 * (tree->size + tree->tombstones) > tree->index->size))
+		index_rebuild(tree);
+	else
+		index_add(tree->index, obj);
+} /* index_insert */
+
+/* Update the index after removing 'obj' from the tree. */
+static void
+index_remove(sdb_avltree_t *tree, sdb_object_t *obj)
+{
+	index_t *idx = tree->index;
+	size_t mask, i;
+	sdb_object_t *o;
+
+	if (! idx)
+		return;
+
+	/* shrink the index once most of it is unused */
+	if ((tree->size <= INDEX_MIN_NODES) || (8 * tree->size < idx->size)) {
+		if (tree->size <= INDEX_MIN_NODES)
+			index_replace(tree, NULL);
+		else
+			index_rebuild(tree);
+		return;
+	}
+
+	mask = idx->size - 1;
+	for (i = name_hash(obj->name) & mask; (o = idx->slots[i].obj);
+			i = (i + 1) & mask) {
+		if (o == obj) {
+			__atomic_store_n(&idx->slots[i].obj, TOMBSTONE, __ATOMIC_RELEASE);
+			++tree->tombstones;
+			return;
+		}
+	}
+} /* index_remove */
+
+static void
+node_free(node_t *n)
+{
+	sdb_slab_free(n, sizeof(*n));
+} /* node_free */
+
+/* Release a NULL-terminated list of replaced nodes. Their objects are
+ * still referenced by the respective copies. */
+static void
+node_retire_path(void *ptr)
+{
+	node_t **nodes = ptr;
+	size_t i;
+
+	for (i = 0; nodes[i]; ++i)
+		node_free(nodes[i]);
+	sdb_slab_free(nodes, (i + 1) * sizeof(*nodes));
+} /* node_retire_path */
+
+/* Destroy a whole (sub-)tree, releasing all included objects. */
 static void
-node_destroy(node_t *n)
+node_destroy_all(void *ptr)
 {
+	node_t *n = ptr;
+
+	if (! n)
+		return;
+
+	node_destroy_all(n->left);
+	node_destroy_all(n->right);
 	sdb_object_deref(n->obj);
-	n->obj = NULL;
-	n->parent = n->left = n->right = NULL;
-	free(n);
-} /* node_destroy */
+	node_free(n);
+} /* node_destroy_all */
 
 static node_t *
 node_create(sdb_object_t *obj)
 {
-	node_t *n = malloc(sizeof(*n));
+	node_t *n = sdb_slab_alloc(sizeof(*n));
 	if (! n)
 		return NULL;
 
 	sdb_object_ref(obj);
 	n->obj = obj;
-	n->parent = n->left = n->right = NULL;
+	n->left = n->right = NULL;
 	n->height = 1;
 	return n;
 } /* node_create */
 
+/* Create a private copy of a node; the copy takes over the object
+ * reference from the original. */
 static node_t *
-node_next(node_t *n)
+node_copy(node_t *n)
 {
-	node_t *next;
-
-	if (! n)
+	node_t *c = sdb_slab_alloc(sizeof(*c));
+	if (! c)
 		return NULL;
+	*c = *n;
+	return c;
+} /* node_copy */
 
-	/* descend into the right tree */
-	if (n->right) {
-		next = n->right;
-		while (next->left)
-			next = next->left;
-		return next;
-	}
+/* Make 'n's right child the new root of the sub-tree, making 'n' its left
+ * child. Only ever called on private (not yet published) nodes. */
+static node_t *
+rotate_left(node_t *n)
+{
+	node_t *n2 = n->right;
 
-	/* visit the parent if we're in its left tree */
-	if (n->parent && (n->parent->left == n))
-		return n->parent;
+	n->right = n2->left;
+	n2->left = n;
 
-	/* find the parent of the sibling sub-tree on the right */
-	next = n->parent;
-	next = NULL;
-	while (n->parent && (n->parent->right == n)) {
-		n = n->parent;
-		next = n;
-	}
-	if (next)
-		next = next->parent;
-	return next;
-} /* node_next */
+	n->height = CALC_HEIGHT(n);
+	n2->height = CALC_HEIGHT(n2);
+	return n2;
+} /* rotate_left */
 
+/* Make 'n's left child the new root of the sub-tree, making 'n' its right
+ * child. Only ever called on private (not yet published) nodes. */
 static node_t *
-node_smallest(sdb_avltree_t *tree)
+rotate_right(node_t *n)
 {
-	node_t *n;
+	node_t *n2 = n->left;
 
-	if (! tree)
-		return NULL;
+	n->left = n2->right;
+	n2->right = n;
 
-	n = tree->root;
-	while (n && n->left)
-		n = n->left;
-	return n;
-} /* node_smallest */
+	n->height = CALC_HEIGHT(n);
+	n2->height = CALC_HEIGHT(n2);
+	return n2;
+} /* rotate_right */
 
-static void
-tree_clear(sdb_avltree_t *tree)
+/* Rebalance the private node 'n' after inserting a node into one of its
+ * sub-trees and return the new root of the sub-tree. Any nodes affected by
+ * rotations are on the path to the new node and, thus, private as well. */
+static node_t *
+rebalance(node_t *n)
 {
-	node_t *n;
+	int bf;
 
-	if ((! tree) || (! tree->root))
-		return;
-
-	/* do a depth-first iteration and delete the leafs */
-	n = tree->root;
-	while (n) {
-		node_t *tmp;
+	n->height = CALC_HEIGHT(n);
+	bf = BALANCE(n);
+	assert((-2 <= bf) && (bf <= 2));
 
-		if (n->left) {
-			n = n->left;
-			continue;
-		}
-		else if (n->right) {
-			n = n->right;
-			continue;
-		}
+	if (bf == 2) {
+		if (BALANCE(n->left) < 0)
+			n->left = rotate_left(n->left);
+		return rotate_right(n);
+	}
+	else if (bf == -2) {
+		if (BALANCE(n->right) > 0)
+			n->right = rotate_right(n->right);
+		return rotate_left(n);
+	}
+	return n;
+} /* rebalance */
 
-		tmp = n->parent;
-		if (tmp) {
-			if (tmp->left == n)
-				tmp->left = NULL;
-			else
-				tmp->right = NULL;
-		}
+/*
+ * Removing a node copies the path from the root to the removed node (and to
+ * its in-order successor). Unlike insertions, rebalancing after a removal
+ * rotates the sibling sub-tree of the path, so nodes of that sub-tree are
+ * copied as well before modifying them. Any replaced node is recorded so it
+ * may be retired once the new tree has been published or released if that
+ * fails.
+ */
+typedef struct {
+	/* at most three nodes per level (path, sibling, and its child) plus the
+	 * removed node and the successor */
+	node_t *replaced[3 * MAX_HEIGHT + 2];
+	node_t *copies[3 * MAX_HEIGHT + 2];
+	size_t replaced_num;
+	size_t copies_num;
+	bool failed;
+} remove_t;
+
+/* Returns a private copy of 'n' or 'n' itself if that failed. */
+static node_t *
+remove_copy(remove_t *r, node_t *n)
+{
+	node_t *c;
 
-		node_destroy(n);
-		n = tmp;
+	if (r->failed)
+		return n;
+	if (! (c = node_copy(n))) {
+		r->failed = 1;
+		return n;
 	}
+	r->replaced[r->replaced_num++] = n;
+	r->copies[r->copies_num++] = c;
+	return c;
+} /* remove_copy */
 
-	tree->root = NULL;
-	tree->size = 0;
-} /* tree_clear */
+/* Rebalance the private node 'n' after removing a node from one of its
+ * sub-trees. */
+static node_t *
+remove_rebalance(remove_t *r, node_t *n)
+{
+	int bf;
 
-/* Switch node 'n' with its right child, making 'n'
- * the new left child of that node. */
-static void
-rotate_left(sdb_avltree_t *tree, node_t *n)
+	if (r->failed)
+		return n;
+
+	n->height = CALC_HEIGHT(n);
+	bf = BALANCE(n);
+
+	if (bf == 2) {
+		n->left = remove_copy(r, n->left);
+		if (BALANCE(n->left) < 0)
+			n->left->right = remove_copy(r, n->left->right);
+		if (r->failed)
+			return n;
+		if (BALANCE(n->left) < 0)
+			n->left = rotate_left(n->left);
+		return rotate_right(n);
+	}
+	else if (bf == -2) {
+		n->right = remove_copy(r, n->right);
+		if (BALANCE(n->right) > 0)
+			n->right->left = remove_copy(r, n->right->left);
+		if (r->failed)
+			return n;
+		if (BALANCE(n->right) > 0)
+			n->right = rotate_right(n->right);
+		return rotate_left(n);
+	}
+	return n;
+} /* remove_rebalance */
+
+/* Remove the smallest node from the (non-empty) sub-tree 'n' and store it
+ * in 'min'. */
+static node_t *
+remove_min(remove_t *r, node_t *n, node_t **min)
 {
-	node_t *n2 = n->right;
-	node_t *c = n2->left;
+	node_t *c;
 
-	n2->parent = n->parent;
-	if (! n2->parent)
-		tree->root = n2;
-	else if (n2->parent->left == n)
-		n2->parent->left = n2;
-	else
-		n2->parent->right = n2;
+	if (! n->left) {
+		*min = n;
+		r->replaced[r->replaced_num++] = n;
+		return n->right;
+	}
 
-	n2->left = n;
-	n->parent = n2;
+	c = remove_copy(r, n);
+	if (r->failed)
+		return n;
+	c->left = remove_min(r, n->left, min);
+	return remove_rebalance(r, c);
+} /* remove_min */
 
-	n->right = c;
-	if (c)
-		c->parent = n;
+/* Remove the node named 'name', which has to exist in the sub-tree 'n', and
+ * store its object in 'obj'. */
+static node_t *
+remove_node(remove_t *r, node_t *n, const char *name, sdb_object_t **obj)
+{
+	int diff = strcasecmp(name, n->obj->name);
+	node_t *c, *min = NULL;
+
+	if (! diff) {
+		*obj = n->obj;
+		if ((! n->left) || (! n->right)) {
+			r->replaced[r->replaced_num++] = n;
+			return n->left ? n->left : n->right;
+		}
 
-	n->height = CALC_HEIGHT(n);
-	n2->height = CALC_HEIGHT(n2);
-} /* rotate_left */
+		/* replace the node with its in-order successor */
+		c = remove_copy(r, n);
+		if (r->failed)
+			return n;
+		c->right = remove_min(r, n->right, &min);
+		if (r->failed)
+			return n;
+		c->obj = min->obj;
+		return remove_rebalance(r, c);
+	}
+
+	c = remove_copy(r, n);
+	if (r->failed)
+		return n;
+	if (diff < 0)
+		c->left = remove_node(r, n->left, name, obj);
+	else
+		c->right = remove_node(r, n->right, name, obj);
+	return remove_rebalance(r, c);
+} /* remove_node */
 
-/* Switch node 'n' with its left child, making 'n'
- * the new right child of that node. */
 static void
-rotate_right(sdb_avltree_t *tree, node_t *n)
+obj_release(void *obj)
 {
-	node_t *n2 = n->left;
-	node_t *c = n2->right;
+	sdb_object_deref(obj);
+} /* obj_release */
 
-	n2->parent = n->parent;
-	if (! n2->parent)
-		tree->root = n2;
-	else if (n2->parent->left == n)
-		n2->parent->left = n2;
-	else
-		n2->parent->right = n2;
+static void
+iter_push_left(sdb_avltree_iter_t *iter, node_t *n)
+{
+	for ( ; n; n = n->left) {
+		assert(iter->depth < MAX_HEIGHT);
+		iter->stack[iter->depth++] = n;
+	}
+} /* iter_push_left */
 
-	n2->right = n;
-	n->parent = n2;
+static bool
+node_valid(node_t *n, const char *min, const char *max, size_t *size)
+{
+	bool status = 1;
+	int bf;
 
-	n->left = c;
-	if (c)
-		c->parent = n;
+	if (! n)
+		return 1;
 
-	n->height = CALC_HEIGHT(n);
-	n2->height = CALC_HEIGHT(n2);
-} /* rotate_right */
+	bf = BALANCE(n);
+	if ((bf < -1) || (1 < bf)) {
+		sdb_log(SDB_LOG_ERR, "avltree: Unbalanced node '%s' (bf=%i)",
+				NODE_NAME(n), bf);
+		status = 0;
+	}
 
-/* Rebalance a tree starting at node 'n' towards the root;
- * also, update the node heights all the way up to the root. */
-static void
-rebalance(sdb_avltree_t *tree, node_t *n)
-{
-	for ( ; n; n = n->parent) {
-		int bf = BALANCE(n);
+	if (CALC_HEIGHT(n) != n->height) {
+		sdb_log(SDB_LOG_ERR, "avltree: Unexpected height for node '%s': "
+				"%zu; expected: %zu", NODE_NAME(n), n->height,
+				CALC_HEIGHT(n));
+		status = 0;
+	}
 
-		if (bf == 0)
-			return;
+	if ((min && (strcasecmp(min, NODE_NAME(n)) >= 0))
+			|| (max && (strcasecmp(NODE_NAME(n), max) >= 0))) {
+		sdb_log(SDB_LOG_ERR, "avltree: Node '%s' out of order; "
+				"expected to be in range ('%s', '%s')", NODE_NAME(n),
+				min ? min : "<nil>", max ? max : "<nil>");
+		status = 0;
+	}
 
-		if ((-1 <= bf) && (bf <= 1)) {
-			n->height = CALC_HEIGHT(n);
-			continue;
-		}
+	++*size;
+	if (! node_valid(n->left, min, NODE_NAME(n), size))
+		status = 0;
+	if (! node_valid(n->right, NODE_NAME(n), max, size))
+		status = 0;
+	return status;
+} /* node_valid */
 
-		assert((-2 <= bf) && (bf <= 2));
+static bool
+index_valid(index_t *idx, node_t *n)
+{
+	bool status = 1;
 
-		if (bf == 2) {
-			if (BALANCE(n->left) == -1)
-				rotate_left(tree, n->left);
-			rotate_right(tree, n);
-		}
-		else {
-			if (BALANCE(n->right) == 1)
-				rotate_right(tree, n->right);
-			rotate_left(tree, n);
-		}
+	if (! n)
+		return 1;
 
-		/* n was moved downwards; get back to the previous level */
-		n = n->parent;
+	if (index_lookup(idx, n->obj->name) != n->obj) {
+		sdb_log(SDB_LOG_ERR, "avltree: Node '%s' missing from index",
+				NODE_NAME(n));
+		status = 0;
 	}
-} /* rebalance */
+	if (! index_valid(idx, n->left))
+		status = 0;
+	if (! index_valid(idx, n->right))
+		status = 0;
+	return status;
+} /* index_valid */
 
 /*
  * public API
@@ -285,115 +593,241 @@ sdb_avltree_create(void)
 {
 	sdb_avltree_t *tree;
 
-	tree = malloc(sizeof(*tree));
+	tree = sdb_slab_alloc(sizeof(*tree));
 	if (! tree)
 		return NULL;
 
-	pthread_rwlock_init(&tree->lock, /* attr = */ NULL);
+	pthread_mutex_init(&tree->lock, /* attr = */ NULL);
 
 	tree->root = NULL;
 	tree->size = 0;
+
+	tree->indexed = 0;
+	tree->index = NULL;
 	return tree;
 } /* sdb_avltree_create */
 
+sdb_avltree_t *
+sdb_avltree_create_indexed(void)
+{
+	sdb_avltree_t *tree = sdb_avltree_create();
+	if (tree)
+		tree->indexed = 1;
+	return tree;
+} /* sdb_avltree_create_indexed */
+
 void
 sdb_avltree_destroy(sdb_avltree_t *tree)
 {
 	if (! tree)
 		return;
 
-	pthread_rwlock_wrlock(&tree->lock);
-	tree_clear(tree);
-	pthread_rwlock_unlock(&tree->lock);
-	pthread_rwlock_destroy(&tree->lock);
-	free(tree);
+	/* there must not be any readers left at this point */
+	node_destroy_all(tree->root);
+	free(tree->index);
+	pthread_mutex_destroy(&tree->lock);
+	sdb_slab_free(tree, sizeof(*tree));
 } /* sdb_avltree_destroy */
 
 void
 sdb_avltree_clear(sdb_avltree_t *tree)
 {
+	node_t *root;
+
 	if (! tree)
 		return;
 
-	pthread_rwlock_wrlock(&tree->lock);
-	tree_clear(tree);
-	pthread_rwlock_unlock(&tree->lock);
+	pthread_mutex_lock(&tree->lock);
+	root = tree->root;
+	__atomic_store_n(&tree->root, NULL, __ATOMIC_RELEASE);
+	__atomic_store_n(&tree->size, 0, __ATOMIC_RELAXED);
+	index_replace(tree, NULL);
+	pthread_mutex_unlock(&tree->lock);
+
+	/* concurrent readers may still access the old nodes */
+	if (root && sdb_epoch_retire(root, node_destroy_all))
+		sdb_log(SDB_LOG_ERR, "avltree: Failed to release nodes; "
+				"leaking memory");
 } /* sdb_avltree_clear */
 
 int
 sdb_avltree_insert(sdb_avltree_t *tree, sdb_object_t *obj)
 {
-	node_t *parent;
-	node_t *n;
+	node_t *path[MAX_HEIGHT];
+	int dirs[MAX_HEIGHT];
+	size_t depth = 0;
 
-	int diff = -1;
+	node_t **retired;
+	node_t *leaf, *n;
+	size_t i;
 
-	if (! tree)
+	if ((! tree) || (! obj) || (! obj->name))
 		return -1;
 
-	n = node_create(obj);
-	if (! n)
-		return -1;
+	pthread_mutex_lock(&tree->lock);
 
-	pthread_rwlock_wrlock(&tree->lock);
+	/* record the path to the new node */
+	for (n = tree->root; n; ) {
+		int diff = strcasecmp(obj->name, n->obj->name);
+		if (! diff) {
+			pthread_mutex_unlock(&tree->lock);
+			return -1;
+		}
 
-	if (! tree->root) {
-		tree->root = n;
-		tree->size = 1;
-		pthread_rwlock_unlock(&tree->lock);
-		return 0;
+		assert(depth < MAX_HEIGHT);
+		path[depth] = n;
+		dirs[depth] = diff;
+		++depth;
+		n = diff < 0 ? n->left : n->right;
 	}
 
-	parent = tree->root;
-	while (42) {
-		assert(parent);
+	/* allocate everything up-front; the last element terminates the list of
+	 * nodes to be retired */
+	retired = sdb_slab_alloc((depth + 1) * sizeof(*retired));
+	n = leaf = node_create(obj);
+	if ((! retired) || (! leaf)) {
+		if (leaf)
+			sdb_object_deref(leaf->obj);
+		node_free(leaf);
+		sdb_slab_free(retired, (depth + 1) * sizeof(*retired));
+		pthread_mutex_unlock(&tree->lock);
+		return -1;
+	}
 
-		diff = strcasecmp(obj->name, parent->obj->name);
-		if (! diff) {
-			node_destroy(n);
-			pthread_rwlock_unlock(&tree->lock);
+	/* copy the path bottom-up, rebalancing private copies as necessary */
+	for (i = depth; i > 0; --i) {
+		node_t *c = node_copy(path[i - 1]);
+		if (! c) {
+			/* nothing has been published yet; undo everything */
+			for ( ; i < depth; ++i)
+				node_free(retired[i]);
+			sdb_object_deref(leaf->obj);
+			node_free(leaf);
+			sdb_slab_free(retired, (depth + 1) * sizeof(*retired));
+			pthread_mutex_unlock(&tree->lock);
 			return -1;
 		}
 
-		if (diff < 0) {
-			if (! parent->left) {
-				parent->left = n;
-				break;
-			}
-			parent = parent->left;
-		}
-		else {
-			if (! parent->right) {
-				parent->right = n;
-				break;
-			}
-			parent = parent->right;
-		}
+		if (dirs[i - 1] < 0)
+			c->left = n;
+		else
+			c->right = n;
+		n = rebalance(c);
+		/* remember the copy for now, in case we have to undo it */
+		retired[i - 1] = c;
 	}
 
-	n->parent = parent;
-	++tree->size;
+	__atomic_store_n(&tree->root, n, __ATOMIC_RELEASE);
+	__atomic_store_n(&tree->size, tree->size + 1, __ATOMIC_RELAXED);
+	index_insert(tree, obj);
+	pthread_mutex_unlock(&tree->lock);
+
+	if (! depth) {
+		sdb_slab_free(retired, sizeof(*retired));
+		return 0;
+	}
 
-	rebalance(tree, parent);
-	pthread_rwlock_unlock(&tree->lock);
+	for (i = 0; i < depth; ++i)
+		retired[i] = path[i];
+	retired[depth] = NULL;
+	if (sdb_epoch_retire(retired, node_retire_path))
+		sdb_log(SDB_LOG_ERR, "avltree: Failed to release nodes; "
+				"leaking memory");
 	return 0;
 } /* sdb_avltree_insert */
 
+int
+sdb_avltree_remove(sdb_avltree_t *tree, const char *name)
+{
+	remove_t *r;
+	sdb_object_t *obj = NULL;
+	node_t **retired;
+	node_t *n;
+	size_t i;
+
+	if ((! tree) || (! name))
+		return -1;
+
+	pthread_mutex_lock(&tree->lock);
+
+	for (n = tree->root; n; ) {
+		int diff = strcasecmp(name, n->obj->name);
+		if (! diff)
+			break;
+		n = diff < 0 ? n->left : n->right;
+	}
+	if (! n) {
+		pthread_mutex_unlock(&tree->lock);
+		return 1;
+	}
+
+	r = calloc(1, sizeof(*r));
+	if (! r) {
+		pthread_mutex_unlock(&tree->lock);
+		return -1;
+	}
+
+	n = remove_node(r, tree->root, name, &obj);
+	retired = r->failed ? NULL
+		: sdb_slab_alloc((r->replaced_num + 1) * sizeof(*retired));
+	if (! retired) {
+		/* nothing has been published yet; undo everything */
+		for (i = 0; i < r->copies_num; ++i)
+			node_free(r->copies[i]);
+		if (! r->failed)
+			sdb_slab_free(retired, (r->replaced_num + 1) * sizeof(*retired));
+		pthread_mutex_unlock(&tree->lock);
+		free(r);
+		return -1;
+	}
+
+	__atomic_store_n(&tree->root, n, __ATOMIC_RELEASE);
+	__atomic_store_n(&tree->size, tree->size - 1, __ATOMIC_RELAXED);
+	index_remove(tree, obj);
+	pthread_mutex_unlock(&tree->lock);
+
+	for (i = 0; i < r->replaced_num; ++i)
+		retired[i] = r->replaced[i];
+	retired[r->replaced_num] = NULL;
+	free(r);
+
+	/* concurrent readers may still access the old nodes and the object */
+	if (sdb_epoch_retire(retired, node_retire_path)
+			|| sdb_epoch_retire(obj, obj_release))
+		sdb_log(SDB_LOG_ERR, "avltree: Failed to release nodes; "
+				"leaking memory");
+	return 0;
+} /* sdb_avltree_remove */
+
 sdb_object_t *
 sdb_avltree_lookup(sdb_avltree_t *tree, const char *name)
 {
+	sdb_object_t *obj = NULL;
+	index_t *idx;
 	node_t *n;
 
 	if (! tree)
 		return NULL;
 
-	n = tree->root;
+	if (sdb_epoch_enter())
+		return NULL;
+
+	idx = __atomic_load_n(&tree->index, __ATOMIC_ACQUIRE);
+	if (idx) {
+		obj = index_lookup(idx, name);
+		sdb_object_ref(obj);
+		sdb_epoch_exit();
+		return obj;
+	}
+
+	n = __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE);
 	while (n) {
 		int diff = strcasecmp(n->obj->name, name);
 
 		if (! diff) {
-			sdb_object_ref(n->obj);
-			return n->obj;
+			obj = n->obj;
+			sdb_object_ref(obj);
+			break;
 		}
 
 		if (diff < 0)
@@ -401,8 +835,9 @@ sdb_avltree_lookup(sdb_avltree_t *tree, const char *name)
 		else
 			n = n->left;
 	}
-	return NULL;
-} /* sdb_avltree_lookup_by_name */
+	sdb_epoch_exit();
+	return obj;
+} /* sdb_avltree_lookup */
 
 sdb_avltree_iter_t *
 sdb_avltree_get_iter(sdb_avltree_t *tree)
@@ -416,23 +851,51 @@ sdb_avltree_get_iter(sdb_avltree_t *tree)
 	if (! iter)
 		return NULL;
 
-	pthread_rwlock_rdlock(&tree->lock);
+	/* the iterator keeps a consistent snapshot of the tree until it's
+	 * destroyed */
+	if (sdb_epoch_enter()) {
+		free(iter);
+		return NULL;
+	}
 
 	iter->tree = tree;
-	iter->node = node_smallest(tree);
-
-	pthread_rwlock_unlock(&tree->lock);
+	iter->root = __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE);
+	iter->depth = 0;
+	iter_push_left(iter, iter->root);
 	return iter;
 } /* sdb_avltree_get_iter */
 
+void
+sdb_avltree_iter_seek(sdb_avltree_iter_t *iter, const char *name)
+{
+	node_t *n;
+
+	if ((! iter) || (! name))
+		return;
+
+	/* the stack holds all nodes whose left subtree has not been visited
+	 * yet; descending to the first node not less than 'name' rebuilds it */
+	iter->depth = 0;
+	for (n = iter->root; n; ) {
+		if (strcasecmp(n->obj->name, name) < 0)
+			n = n->right;
+		else {
+			assert(iter->depth < MAX_HEIGHT);
+			iter->stack[iter->depth++] = n;
+			n = n->left;
+		}
+	}
+} /* sdb_avltree_iter_seek */
+
 void
 sdb_avltree_iter_destroy(sdb_avltree_iter_t *iter)
 {
 	if (! iter)
 		return;
 
+	sdb_epoch_exit();
 	iter->tree = NULL;
-	iter->node = NULL;
+	iter->depth = 0;
 	free(iter);
 } /* sdb_avltree_iter_destroy */
 
@@ -442,7 +905,7 @@ sdb_avltree_iter_has_next(sdb_avltree_iter_t *iter)
 	if (! iter)
 		return 0;
 
-	return iter->node != NULL;
+	return iter->depth > 0;
 } /* sdb_avltree_iter_has_next */
 
 sdb_object_t *
@@ -450,76 +913,49 @@ sdb_avltree_iter_get_next(sdb_avltree_iter_t *iter)
 {
 	node_t *n;
 
-	if (! iter)
+	if ((! iter) || (! iter->depth))
 		return NULL;
 
-	n = iter->node;
-	iter->node = node_next(iter->node);
-	return n ? n->obj : NULL;
+	n = iter->stack[--iter->depth];
+	iter_push_left(iter, n->right);
+	return n->obj;
 } /* sdb_avltree_iter_get_next */
 
 sdb_object_t *
 sdb_avltree_iter_peek_next(sdb_avltree_iter_t *iter)
 {
-	if ((! iter) || (! iter->node))
+	if ((! iter) || (! iter->depth))
 		return NULL;
-	return iter->node->obj;
+	return iter->stack[iter->depth - 1]->obj;
 } /* sdb_avltree_iter_peek_next */
 
 size_t
 sdb_avltree_size(sdb_avltree_t *tree)
 {
-	return tree ? tree->size : 0;
+	return tree ? __atomic_load_n(&tree->size, __ATOMIC_RELAXED) : 0;
 } /* sdb_avltree_size */
 
 bool
 sdb_avltree_valid(sdb_avltree_t *tree)
 {
-	node_t *n;
-
-	bool status = 1;
+	bool status;
 	size_t size = 0;
 
 	if (! tree)
 		return 1;
 
-	for (n = node_smallest(tree); n; n = node_next(n)) {
-		int bf = BALANCE(n);
-
-		if ((bf < -1) || (1 < bf)) {
-			sdb_log(SDB_LOG_ERR, "avltree: Unbalanced node '%s' (bf=%i)",
-					NODE_NAME(n), bf);
-			status = 0;
-		}
-
-		if (NODE_HEIGHT(n) != n->height) {
-			sdb_log(SDB_LOG_ERR, "avltree: Unexpected height for node '%s': "
-					"%zu; expected: %zu", NODE_NAME(n), n->height,
-					NODE_HEIGHT(n));
-			status = 0;
-		}
-
-		if (n->parent && (n->parent->left != n) && (n->parent->right != n)) {
-			sdb_log(SDB_LOG_ERR, "avltree: Invalid child nodes for parent of "
-					"node '%s': {left: %s, right: %s}; expected: %s",
-					NODE_NAME(n), NODE_NAME(n->parent->left),
-					NODE_NAME(n->parent->right), NODE_NAME(n));
-			status = 0;
-		}
-		if ((! n->parent) && (n != tree->root)) {
-			sdb_log(SDB_LOG_ERR, "avltree: Non-root node '%s' does not "
-					"have a parent", NODE_NAME(n));
-			status = 0;
-		}
-
-		++size;
-	}
+	pthread_mutex_lock(&tree->lock);
+	status = node_valid(tree->root, NULL, NULL, &size);
 
 	if (size != tree->size) {
 		sdb_log(SDB_LOG_ERR, "avltree: Invalid size %zu; expected: %zu",
 				tree->size, size);
 		status = 0;
 	}
+
+	if (tree->index && (! index_valid(tree->index, tree->root)))
+		status = 0;
+	pthread_mutex_unlock(&tree->lock);
 	return status;
 } /* sdb_avltree_valid */
 
@@ -0,0 +1,247 @@
+/*
+ * SysDB - src/utils/epoch.c
+ * Copyright (C) 2016 Sebastian 'tokkee' Harl <sh@tokkee.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if HAVE_CONFIG_H
+#	include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include "utils/epoch.h"
+#include "utils/slab.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <pthread.h>
+
+/*
+ * private data types
+ */
+
+/* per-thread reader state */
+typedef struct record {
+	struct record *next;
+
+	/* accessed atomically */
+	unsigned long epoch;
+	int active;
+
+	/* only accessed by the owning thread */
+	unsigned int nesting;
+
+	/* protected by 'lock' */
+	bool in_use;
+} record_t;
+
+typedef struct retired {
+	struct retired *next;
+	void *data;
+	void (*destructor)(void *);
+} retired_t;
+
+/*
+ * private variables
+ */
+
+static pthread_once_t   key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t    record_key;
+
+/* protects the list of records and retired data */
+static pthread_mutex_t  lock = PTHREAD_MUTEX_INITIALIZER;
+static record_t        *records = NULL;
+
+/* Data retired during epoch e is stored in limbo[e % 3]. It may be released
+ * once the global epoch reached e + 2: at that point, all readers have
+ * entered their critical sections after the data had been unlinked. */
+static unsigned long    global_epoch = 0;
+static retired_t       *limbo[3] = { NULL, NULL, NULL };
+
+/*
+ * private helper functions
+ */
+
+static void
+record_release(void *r)
+{
+	pthread_mutex_lock(&lock);
+	__atomic_store_n(&((record_t *)r)->active, 0, __ATOMIC_RELEASE);
+	((record_t *)r)->nesting = 0;
+	((record_t *)r)->in_use = 0;
+	pthread_mutex_unlock(&lock);
+} /* record_release */
+
+static void
+key_init(void)
+{
+	pthread_key_create(&record_key, record_release);
+} /* key_init */
+
+static record_t *
+record_get(void)
+{
+	record_t *r;
+
+	pthread_once(&key_once, key_init);
+	r = pthread_getspecific(record_key);
+	if (r)
+		return r;
+
+	pthread_mutex_lock(&lock);
+	for (r = records; r; r = r->next)
+		if (! r->in_use)
+			break;
+	if (! r) {
+		r = calloc(1, sizeof(*r));
+		if (! r) {
+			pthread_mutex_unlock(&lock);
+			return NULL;
+		}
+		r->next = records;
+		records = r;
+	}
+	r->in_use = 1;
+	pthread_mutex_unlock(&lock);
+
+	pthread_setspecific(record_key, r);
+	return r;
+} /* record_get */
+
+/* Advance the global epoch if all active readers have observed the current
+ * one. Returns the list of data which may be released; lock must be held. */
+static retired_t *
+try_advance(void)
+{
+	unsigned long e = __atomic_load_n(&global_epoch, __ATOMIC_RELAXED);
+	retired_t *done;
+	record_t *r;
+
+	for (r = records; r; r = r->next) {
+		if (! __atomic_load_n(&r->active, __ATOMIC_ACQUIRE))
+			continue;
+		if (__atomic_load_n(&r->epoch, __ATOMIC_ACQUIRE) != e)
+			return NULL;
+	}
+
+	++e;
+	__atomic_store_n(&global_epoch, e, __ATOMIC_RELEASE);
+
+	/* data retired during epoch e - 2 */
+	done = limbo[(e + 1) % 3];
+	limbo[(e + 1) % 3] = NULL;
+	return done;
+} /* try_advance */
+
+static void
+release(retired_t *done)
+{
+	while (done) {
+		retired_t *next = done->next;
+		done->destructor(done->data);
+		sdb_slab_free(done, sizeof(*done));
+		done = next;
+	}
+} /* release */
+
+/*
+ * public API
+ */
+
+int
+sdb_epoch_enter(void)
+{
+	record_t *r = record_get();
+
+	if (! r)
+		return -1;
+	if (r->nesting++)
+		return 0;
+
+	__atomic_store_n(&r->epoch,
+			__atomic_load_n(&global_epoch, __ATOMIC_ACQUIRE),
+			__ATOMIC_RELAXED);
+	__atomic_store_n(&r->active, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	return 0;
+} /* sdb_epoch_enter */
+
+void
+sdb_epoch_exit(void)
+{
+	record_t *r = pthread_getspecific(record_key);
+
+	if ((! r) || (! r->nesting))
+		return;
+	if (--r->nesting)
+		return;
+	__atomic_store_n(&r->active, 0, __ATOMIC_RELEASE);
+} /* sdb_epoch_exit */
+
+int
+sdb_epoch_retire(void *data, void (*destructor)(void *))
+{
+	retired_t *ret, *done;
+
+	if ((! data) || (! destructor))
+		return -1;
+
+	ret = sdb_slab_alloc(sizeof(*ret));
+	if (! ret)
+		return -1;
+	ret->data = data;
+	ret->destructor = destructor;
+
+	/* make sure the data has been unlinked before advancing the epoch */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	pthread_mutex_lock(&lock);
+	ret->next = limbo[global_epoch % 3];
+	limbo[global_epoch % 3] = ret;
+	done = try_advance();
+	pthread_mutex_unlock(&lock);
+
+	/* destructors may retire further data */
+	release(done);
+	return 0;
+} /* sdb_epoch_retire */
+
+void
+sdb_epoch_reclaim(void)
+{
+	int i;
+
+	/* three successful steps release everything retired so far */
+	for (i = 0; i < 3; ++i) {
+		retired_t *done;
+
+		pthread_mutex_lock(&lock);
+		done = try_advance();
+		pthread_mutex_unlock(&lock);
+		release(done);
+	}
+} /* sdb_epoch_reclaim */
+
+/* vim: set tw=78 sw=4 ts=4 noexpandtab : */
+
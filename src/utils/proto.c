@@ -301,6 +301,12 @@ sdb_proto_marshal_int32(char *buf, size_t buf_len, uint32_t v)
 	return sizeof(v);
 } /* sdb_proto_marshal_int32 */
 
+ssize_t
+sdb_proto_marshal_int64(char *buf, size_t buf_len, uint64_t v)
+{
+	return marshal_int64(buf, buf_len, (int64_t)v);
+} /* sdb_proto_marshal_int64 */
+
 ssize_t
 sdb_proto_marshal_data(char *buf, size_t buf_len, const sdb_data_t *datum)
 {
@@ -568,6 +574,18 @@ sdb_proto_unmarshal_int32(const char *buf, size_t buf_len, uint32_t *v)
 	return sizeof(n);
 } /* sdb_proto_unmarshal_int32 */
 
+ssize_t
+sdb_proto_unmarshal_int64(const char *buf, size_t buf_len, uint64_t *v)
+{
+	int64_t n;
+	ssize_t len;
+
+	len = unmarshal_int64(buf, buf_len, &n);
+	if ((len > 0) && v)
+		*v = (uint64_t)n;
+	return len;
+} /* sdb_proto_unmarshal_int64 */
+
 ssize_t
 sdb_proto_unmarshal_data(const char *buf, size_t len, sdb_data_t *datum)
 {
@@ -0,0 +1,272 @@
+/*
+ * SysDB - src/utils/slab.c
+ * Copyright (C) 2016 Sebastian 'tokkee' Harl <sh@tokkee.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#if HAVE_CONFIG_H
+#	include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include "utils/slab.h"
+
+#include <stdlib.h>
+
+#include <pthread.h>
+
+/*
+ * private data types
+ */
+
+#define CLASSES_NUM (SDB_SLAB_MAX / SDB_SLAB_ALIGN)
+#define CLASS(size) (((size) - 1) / SDB_SLAB_ALIGN)
+#define CLASS_SIZE(c) (((c) + 1) * SDB_SLAB_ALIGN)
+
+/* size of the pages that chunks are carved from */
+#define PAGE_SIZE (64 * 1024)
+
+/* number of chunks moved between a thread's cache and the shared pool */
+#define BATCH_SIZE 32
+
+/* free chunks store a pointer to the next free chunk */
+typedef struct chunk {
+	struct chunk *next;
+} chunk_t;
+
+typedef struct {
+	pthread_mutex_t lock;
+	chunk_t *free;
+
+	/* unused part of the most recent page */
+	char *cur;
+	char *end;
+} pool_t;
+
+typedef struct {
+	chunk_t *free[CLASSES_NUM];
+	size_t free_num[CLASSES_NUM];
+} cache_t;
+
+/*
+ * private variables
+ */
+
+static pthread_once_t   key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t    cache_key;
+
+static pool_t           pools[CLASSES_NUM];
+static size_t           bytes = 0;
+
+/*
+ * private helper functions
+ */
+
+/* Move the specified list of chunks into the shared pool. */
+static void
+pool_put(pool_t *pool, chunk_t *head, chunk_t *tail)
+{
+	pthread_mutex_lock(&pool->lock);
+	tail->next = pool->free;
+	pool->free = head;
+	pthread_mutex_unlock(&pool->lock);
+} /* pool_put */
+
+/* Take up to 'n' chunks from the shared pool, allocating a new page if
+ * necessary. Returns the chunks as a NULL-terminated list. */
+static chunk_t *
+pool_get(size_t c, size_t n, size_t *got)
+{
+	pool_t *pool = pools + c;
+	size_t size = CLASS_SIZE(c);
+	chunk_t *head = NULL;
+
+	*got = 0;
+	pthread_mutex_lock(&pool->lock);
+	while (pool->free && (*got < n)) {
+		chunk_t *ch = pool->free;
+		pool->free = ch->next;
+		ch->next = head;
+		head = ch;
+		++*got;
+	}
+
+	while (*got < n) {
+		chunk_t *ch;
+
+		if (pool->cur + size > pool->end) {
+			char *page;
+
+			if (*got)
+				break;
+
+			page = malloc(PAGE_SIZE);
+			if (! page)
+				break;
+			__atomic_add_fetch(&bytes, PAGE_SIZE, __ATOMIC_RELAXED);
+			pool->cur = page;
+			pool->end = page + PAGE_SIZE;
+		}
+
+		ch = (chunk_t *)pool->cur;
+		pool->cur += size;
+		ch->next = head;
+		head = ch;
+		++*got;
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return head;
+} /* pool_get */
+
+/* Return the first 'n' chunks of the cached list of class 'c' to the shared
+ * pool. */
+static void
+cache_flush(cache_t *cache, size_t c, size_t n)
+{
+	chunk_t *head = cache->free[c];
+	chunk_t *tail = head;
+	size_t i;
+
+	if (! n)
+		return;
+
+	for (i = 1; i < n; ++i)
+		tail = tail->next;
+	cache->free[c] = tail->next;
+	cache->free_num[c] -= n;
+	pool_put(pools + c, head, tail);
+} /* cache_flush */
+
+static void
+cache_destroy(void *ptr)
+{
+	cache_t *cache = ptr;
+	size_t c;
+
+	for (c = 0; c < CLASSES_NUM; ++c)
+		cache_flush(cache, c, cache->free_num[c]);
+	free(cache);
+} /* cache_destroy */
+
+static void
+key_init(void)
+{
+	size_t c;
+
+	for (c = 0; c < CLASSES_NUM; ++c) {
+		pthread_mutex_init(&pools[c].lock, /* attr = */ NULL);
+		pools[c].free = NULL;
+		pools[c].cur = pools[c].end = NULL;
+	}
+	pthread_key_create(&cache_key, cache_destroy);
+} /* key_init */
+
+static cache_t *
+cache_get(void)
+{
+	cache_t *cache;
+
+	pthread_once(&key_once, key_init);
+	cache = pthread_getspecific(cache_key);
+	if (cache)
+		return cache;
+
+	cache = calloc(1, sizeof(*cache));
+	if (cache && pthread_setspecific(cache_key, cache)) {
+		free(cache);
+		cache = NULL;
+	}
+	return cache;
+} /* cache_get */
+
+/*
+ * public API
+ */
+
+void *
+sdb_slab_alloc(size_t size)
+{
+	cache_t *cache;
+	chunk_t *ch;
+	size_t c;
+
+	if ((! size) || (size > SDB_SLAB_MAX))
+		return malloc(size);
+
+	c = CLASS(size);
+	cache = cache_get();
+	if (! cache) {
+		size_t got;
+		return pool_get(c, 1, &got);
+	}
+
+	if (! cache->free[c])
+		cache->free[c] = pool_get(c, BATCH_SIZE, &cache->free_num[c]);
+
+	ch = cache->free[c];
+	if (! ch)
+		return NULL;
+	cache->free[c] = ch->next;
+	--cache->free_num[c];
+	return ch;
+} /* sdb_slab_alloc */
+
+void
+sdb_slab_free(void *ptr, size_t size)
+{
+	cache_t *cache;
+	chunk_t *ch = ptr;
+	size_t c;
+
+	if (! ptr)
+		return;
+	if ((! size) || (size > SDB_SLAB_MAX)) {
+		free(ptr);
+		return;
+	}
+
+	c = CLASS(size);
+	cache = cache_get();
+	if (! cache) {
+		ch->next = NULL;
+		pool_put(pools + c, ch, ch);
+		return;
+	}
+
+	ch->next = cache->free[c];
+	cache->free[c] = ch;
+	++cache->free_num[c];
+
+	/* keep a batch of chunks around for future allocations */
+	if (cache->free_num[c] > 2 * BATCH_SIZE)
+		cache_flush(cache, c, BATCH_SIZE);
+} /* sdb_slab_free */
+
+size_t
+sdb_slab_bytes(void)
+{
+	return __atomic_load_n(&bytes, __ATOMIC_RELAXED);
+} /* sdb_slab_bytes */
+
+/* vim: set tw=78 sw=4 ts=4 noexpandtab : */
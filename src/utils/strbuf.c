@@ -55,6 +55,11 @@ struct sdb_strbuf {
 	size_t size;
 	size_t pos;
 
+	/* number of bytes removed from the start of the buffer; the content is
+	 * stored in string[off, pos) and moved to the front lazily, if space is
+	 * needed at the end */
+	size_t off;
+
 	/* min size to shrink the buffer to */
 	size_t min_size;
 };
@@ -90,6 +95,28 @@ strbuf_resize(sdb_strbuf_t *buf, size_t new_size)
 	return 0;
 } /* strbuf_resize */
 
+/* Make sure that at least 'n' more bytes (plus a nul-byte) may be appended
+ * to the buffer. Space of previously skipped content is reused before
+ * growing the buffer. */
+static int
+strbuf_reserve(sdb_strbuf_t *buf, size_t n)
+{
+	if (buf->pos + n + 1 <= buf->size)
+		return 0;
+
+	if (buf->off) {
+		memmove(buf->string, buf->string + buf->off, buf->pos - buf->off);
+		buf->pos -= buf->off;
+		buf->off = 0;
+		buf->string[buf->pos] = '\0';
+		if (buf->pos + n + 1 <= buf->size)
+			return 0;
+	}
+
+	/* grow exponentially to make repeated appends cheap */
+	return strbuf_resize(buf, SDB_MAX(buf->pos + n + 1, 2 * buf->size));
+} /* strbuf_reserve */
+
 /*
  * public API
  */
@@ -119,6 +146,7 @@ sdb_strbuf_create(size_t size)
 
 	buf->size = size;
 	buf->pos  = 0;
+	buf->off  = 0;
 
 	return buf;
 } /* sdb_strbuf_create */
@@ -152,7 +180,7 @@ sdb_strbuf_vappend(sdb_strbuf_t *buf, const char *fmt, va_list ap)
 	}
 	/* make sure to reserve space for the nul-byte */
 	else if (buf->pos >= buf->size - 1)
-		if (strbuf_resize(buf, 2 * buf->size))
+		if (strbuf_reserve(buf, 1))
 			return -1;
 
 	assert(buf->size && buf->string);
@@ -170,7 +198,7 @@ sdb_strbuf_vappend(sdb_strbuf_t *buf, const char *fmt, va_list ap)
 
 	/* 'status' does not include nul-byte */
 	if ((size_t)status >= buf->size - buf->pos) {
-		if (strbuf_resize(buf, buf->pos + (size_t)status + 1)) {
+		if (strbuf_reserve(buf, (size_t)status)) {
 			va_end(aq);
 			return -1;
 		}
@@ -212,7 +240,7 @@ sdb_strbuf_vsprintf(sdb_strbuf_t *buf, const char *fmt, va_list ap)
 
 	if (buf->size) {
 		buf->string[0] = '\0';
-		buf->pos = 0;
+		buf->pos = buf->off = 0;
 	}
 
 	return sdb_strbuf_vappend(buf, fmt, ap);
@@ -239,10 +267,8 @@ sdb_strbuf_memappend(sdb_strbuf_t *buf, const void *data, size_t n)
 
 	assert((buf->size == 0) || (buf->string[buf->pos] == '\0'));
 
-	if (buf->pos + n + 1 > buf->size) {
-		if (strbuf_resize(buf, buf->pos + n + 1))
-			return -1;
-	}
+	if (strbuf_reserve(buf, n))
+		return -1;
 
 	assert(buf->size && buf->string);
 	assert(buf->pos < buf->size);
@@ -266,7 +292,7 @@ sdb_strbuf_memcpy(sdb_strbuf_t *buf, const void *data, size_t n)
 
 	if (buf->size) {
 		buf->string[0] = '\0';
-		buf->pos = 0;
+		buf->pos = buf->off = 0;
 	}
 
 	return sdb_strbuf_memappend(buf, data, n);
@@ -276,20 +302,40 @@ ssize_t
 sdb_strbuf_read(sdb_strbuf_t *buf, int fd, size_t n)
 {
 	ssize_t ret;
+	char *tail;
 
-	if (! buf)
+	tail = sdb_strbuf_reserve(buf, n);
+	if (! tail)
 		return -1;
 
-	if (buf->pos + n + 1 >= buf->size)
-		if (strbuf_resize(buf, buf->pos + n + 1))
-			return -1;
-
-	ret = read(fd, buf->string + buf->pos, n);
+	ret = read(fd, tail, n);
 	if (ret > 0)
-		buf->pos += (size_t)ret;
+		sdb_strbuf_commit(buf, (size_t)ret);
 	return ret;
 } /* sdb_strbuf_read */
 
+char *
+sdb_strbuf_reserve(sdb_strbuf_t *buf, size_t n)
+{
+	if (! buf)
+		return NULL;
+
+	if (strbuf_reserve(buf, n))
+		return NULL;
+	return buf->string + buf->pos;
+} /* sdb_strbuf_reserve */
+
+void
+sdb_strbuf_commit(sdb_strbuf_t *buf, size_t n)
+{
+	if ((! buf) || (! n))
+		return;
+
+	assert(buf->pos + n < buf->size);
+	buf->pos += n;
+	buf->string[buf->pos] = '\0';
+} /* sdb_strbuf_commit */
+
 ssize_t
 sdb_strbuf_chomp(sdb_strbuf_t *buf)
 {
@@ -301,7 +347,7 @@ sdb_strbuf_chomp(sdb_strbuf_t *buf)
 	assert((!buf->size) || (buf->pos < buf->size));
 	assert(buf->pos <= buf->size);
 
-	while ((buf->pos > 0)
+	while ((buf->pos > buf->off)
 			&& (buf->string[buf->pos - 1] == '\n')) {
 		--buf->pos;
 		buf->string[buf->pos] = '\0';
@@ -320,12 +366,16 @@ sdb_strbuf_skip(sdb_strbuf_t *buf, size_t offset, size_t n)
 	if ((! buf) || (! n))
 		return;
 
-	if (offset >= buf->pos)
+	if (offset >= buf->pos - buf->off)
 		return;
 
+	offset += buf->off;
 	len = buf->pos - offset;
 
 	if (n >= len) {
+		if (offset == buf->off)
+			/* all content was removed; start over at the front */
+			offset = buf->off = 0;
 		buf->string[offset] = '\0';
 		buf->pos = offset;
 		return;
@@ -334,6 +384,13 @@ sdb_strbuf_skip(sdb_strbuf_t *buf, size_t offset, size_t n)
 	assert(offset + n < buf->pos);
 	assert(offset < buf->pos);
 
+	if (offset == buf->off) {
+		/* removing from the start of the content is cheap: the space will
+		 * be reused once needed */
+		buf->off += n;
+		return;
+	}
+
 	start = buf->string + offset;
 	memmove(start, start + n, len - n);
 	buf->pos -= n;
@@ -349,7 +406,7 @@ sdb_strbuf_clear(sdb_strbuf_t *buf)
 		return;
 
 	buf->string[0] = '\0';
-	buf->pos = 0;
+	buf->pos = buf->off = 0;
 
 	/* don't resize now but wait for the next write to avoid churn */
 } /* sdb_strbuf_clear */
@@ -361,7 +418,7 @@ sdb_strbuf_string(sdb_strbuf_t *buf)
 		return NULL;
 	if (! buf->size)
 		return "";
-	return buf->string;
+	return buf->string + buf->off;
 } /* sdb_strbuf_string */
 
 size_t
@@ -369,7 +426,7 @@ sdb_strbuf_len(sdb_strbuf_t *buf)
 {
 	if (! buf)
 		return 0;
-	return buf->pos;
+	return buf->pos - buf->off;
 } /* sdb_strbuf_string */
 
 size_t
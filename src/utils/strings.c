@@ -33,9 +33,24 @@
 
 #include <assert.h>
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <pthread.h>
+
+/*
+ * private variables
+ */
+
+/* Table of interned strings using open addressing and linear probing. The
+ * number of slots is a power of two and the table is kept at most half
+ * full. */
+static pthread_mutex_t  intern_lock = PTHREAD_MUTEX_INITIALIZER;
+static char           **interned = NULL;
+static size_t           interned_size = 0;
+static size_t           interned_num = 0;
+
 /*
  * private helper functions
  */
@@ -72,6 +87,53 @@ ensure_len(char ***s, size_t *s_len, size_t len)
 	return 0;
 } /* ensure_len */
 
+/* FNV-1a hash */
+static uint32_t
+hash(const char *s)
+{
+	uint32_t h = 2166136261U;
+
+	for ( ; *s; ++s) {
+		h ^= (uint32_t)(unsigned char)*s;
+		h *= 16777619U;
+	}
+	return h;
+} /* hash */
+
+/* Returns the slot for 's', which is either empty or contains 's'. */
+static size_t
+intern_slot(char **table, size_t size, const char *s)
+{
+	size_t mask = size - 1;
+	size_t i;
+
+	for (i = hash(s) & mask; table[i]; i = (i + 1) & mask)
+		if (! strcmp(table[i], s))
+			break;
+	return i;
+} /* intern_slot */
+
+static int
+intern_grow(void)
+{
+	size_t size = interned_size ? 2 * interned_size : 64;
+	char **table;
+	size_t i;
+
+	table = calloc(size, sizeof(*table));
+	if (! table)
+		return -1;
+
+	for (i = 0; i < interned_size; ++i)
+		if (interned[i])
+			table[intern_slot(table, size, interned[i])] = interned[i];
+
+	free(interned);
+	interned = table;
+	interned_size = size;
+	return 0;
+} /* intern_grow */
+
 /*
  * public API
  */
@@ -147,5 +209,31 @@ stringv_free(char ***s, size_t *s_len)
 	*s_len = 0;
 } /* stringv_free */
 
+const char *
+string_intern(const char *s)
+{
+	char *ret = NULL;
+	size_t i;
+
+	if (! s)
+		return NULL;
+
+	pthread_mutex_lock(&intern_lock);
+	if ((2 * (interned_num + 1) > interned_size) && intern_grow()) {
+		pthread_mutex_unlock(&intern_lock);
+		return NULL;
+	}
+
+	i = intern_slot(interned, interned_size, s);
+	if (interned[i])
+		ret = interned[i];
+	else if ((ret = strdup(s))) {
+		interned[i] = ret;
+		++interned_num;
+	}
+	pthread_mutex_unlock(&intern_lock);
+	return ret;
+} /* string_intern */
+
 /* vim: set tw=78 sw=4 ts=4 noexpandtab : */
 
@@ -0,0 +1,139 @@
+/*
+ * SysDB - t/bench/avltree_bench.c
+ * Copyright (C) 2016 Sebastian 'tokkee' Harl <sh@tokkee.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * AVL tree lookup benchmark: measures the latency of looking up random
+ * objects (using varying case) in plain and in indexed AVL trees of
+ * increasing size.
+ */
+
+#if HAVE_CONFIG_H
+#	include "config.h"
+#endif
+
+#include "sysdb.h"
+#include "core/object.h"
+#include "core/time.h"
+#include "utils/avltree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOOKUPS_NUM 1000000
+
+static char **
+make_names(size_t n)
+{
+	char **names = calloc(n, sizeof(*names));
+	size_t i;
+
+	if (! names)
+		return NULL;
+	for (i = 0; i < n; ++i) {
+		char name[64];
+		snprintf(name, sizeof(name), "host%zu.example.com", i);
+		if (! (names[i] = strdup(name)))
+			return NULL;
+	}
+	return names;
+} /* make_names */
+
+/* Returns the average lookup time in nanoseconds. */
+static double
+bench_lookup(sdb_avltree_t *tree, char **names, size_t n)
+{
+	sdb_time_t start, end;
+	size_t found = 0;
+	size_t i;
+
+	srand(42);
+	start = sdb_gettime();
+	for (i = 0; i < LOOKUPS_NUM; ++i) {
+		sdb_object_t *obj;
+
+		obj = sdb_avltree_lookup(tree, names[(size_t)rand() % n]);
+		if (obj)
+			++found;
+		sdb_object_deref(obj);
+	}
+	end = sdb_gettime();
+
+	if (found != LOOKUPS_NUM)
+		fprintf(stderr, "avltree_bench: Found %zu of %d objects\n",
+				found, LOOKUPS_NUM);
+	return (double)(end - start) / LOOKUPS_NUM;
+} /* bench_lookup */
+
+int
+main(void)
+{
+	size_t sizes[] = { 10000, 100000, 1000000 };
+	size_t i, j;
+
+	printf("%d random lookups per run\n", LOOKUPS_NUM);
+	printf("%8s %16s %16s\n", "objects", "plain (ns/op)", "indexed (ns/op)");
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(sizes); ++i) {
+		sdb_avltree_t *plain, *indexed;
+		char **names;
+
+		plain = sdb_avltree_create();
+		indexed = sdb_avltree_create_indexed();
+		names = make_names(sizes[i]);
+		if ((! plain) || (! indexed) || (! names)) {
+			fprintf(stderr, "avltree_bench: Failed to allocate memory\n");
+			return 1;
+		}
+
+		for (j = 0; j < sizes[i]; ++j) {
+			sdb_object_t *obj = sdb_object_create_T(names[j], sdb_object_t);
+			if ((! obj) || sdb_avltree_insert(plain, obj)
+					|| sdb_avltree_insert(indexed, obj)) {
+				fprintf(stderr, "avltree_bench: Failed to populate trees\n");
+				return 1;
+			}
+			sdb_object_deref(obj);
+
+			/* look up objects using different case than stored */
+			names[j][0] = 'H';
+		}
+
+		printf("%8zu %16.1f %16.1f\n", sizes[i],
+				bench_lookup(plain, names, sizes[i]),
+				bench_lookup(indexed, names, sizes[i]));
+
+		sdb_avltree_destroy(plain);
+		sdb_avltree_destroy(indexed);
+		for (j = 0; j < sizes[i]; ++j)
+			free(names[j]);
+		free(names);
+	}
+	return 0;
+} /* main */
+
+/* vim: set tw=78 sw=4 ts=4 noexpandtab : */
+
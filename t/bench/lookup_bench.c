@@ -0,0 +1,206 @@
+/*
+ * SysDB - t/bench/lookup_bench.c
+ * Copyright (C) 2016 Sebastian 'tokkee' Harl <sh@tokkee.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Memstore lookup benchmark: scans a store using a set of typical queries
+ * and reports the throughput (in objects per second) of evaluating them
+ * using the matcher trees built from the parsed query and using the
+ * compiled programs that are used when executing queries.
+ */
+
+#if HAVE_CONFIG_H
+#	include "config.h"
+#endif
+
+#include "sysdb.h"
+#include "core/memstore.h"
+#include "core/time.h"
+#include "parser/parser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define HOSTS_NUM 2000
+#define SERVICES_NUM 20
+#define METRICS_NUM 20
+#define ATTRS_NUM 5
+#define RUNTIME_SECS 1
+
+static struct {
+	int type;
+	const char *query;
+} queries[] = {
+	{ SDB_HOST,    "name = 'host42'" },
+	{ SDB_HOST,    "name =~ '^host1' AND attribute['dc'] = 'dc1'" },
+	{ SDB_HOST,    "ANY backend = 'backend::b2'" },
+	{ SDB_HOST,    "ANY service.name = 'svc19'" },
+	{ SDB_HOST,    "ANY attribute.value = 'dc3'" },
+	{ SDB_SERVICE, "name = 'svc7'" },
+	{ SDB_SERVICE, "host.attribute['dc'] = 'dc2' AND name !~ '1'" },
+	{ SDB_SERVICE, "attribute['env'] = 'prod' OR age > 1h" },
+	{ SDB_METRIC,  "attribute['unit'] IN ['bytes', 'ms'] AND timeseries IS FALSE" },
+	{ SDB_METRIC,  "name || '.' || attribute['unit'] = 'metric3.ms'" },
+};
+
+static sdb_memstore_t *store;
+
+static int
+populate(void)
+{
+	const char *backends[] = { "backend::b1", "backend::b2" };
+	const char *units[] = { "bytes", "ms", "pct" };
+	sdb_data_t value = { SDB_TYPE_STRING, { .string = NULL } };
+	char env[] = "prod";
+	size_t i, j;
+
+	for (i = 0; i < HOSTS_NUM; ++i) {
+		sdb_store_host_t host = { NULL, 1, 0, backends, 1 + i % 2 };
+		char name[32], dc[32];
+
+		snprintf(name, sizeof(name), "host%zu", i);
+		host.name = name;
+		if (sdb_memstore_writer.store_host(&host, SDB_OBJ(store)))
+			return -1;
+
+		snprintf(dc, sizeof(dc), "dc%zu", i % 4);
+		value.data.string = dc;
+		if (sdb_memstore_attribute(store, name, "dc", &value, 1, 0))
+			return -1;
+		for (j = 1; j < ATTRS_NUM; ++j) {
+			char key[32];
+			snprintf(key, sizeof(key), "key%zu", j);
+			if (sdb_memstore_attribute(store, name, key, &value, 1, 0))
+				return -1;
+		}
+
+		for (j = 0; j < SERVICES_NUM; ++j) {
+			char svc[32];
+			snprintf(svc, sizeof(svc), "svc%zu", j);
+			if (sdb_memstore_service(store, name, svc, 1, 0))
+				return -1;
+			value.data.string = env;
+			if ((j % 3 == 0) && sdb_memstore_service_attr(store, name, svc,
+						"env", &value, 1, 0))
+				return -1;
+		}
+		for (j = 0; j < METRICS_NUM; ++j) {
+			char metric[32], unit[32];
+			snprintf(metric, sizeof(metric), "metric%zu", j);
+			if (sdb_memstore_metric(store, name, metric, NULL, 1, 0))
+				return -1;
+			snprintf(unit, sizeof(unit), "%s", units[j % 3]);
+			value.data.string = unit;
+			if (sdb_memstore_metric_attr(store, name, metric, "unit",
+						&value, 1, 0))
+				return -1;
+		}
+	}
+	return 0;
+} /* populate */
+
+static int
+scan_cb(sdb_memstore_obj_t __attribute__((unused)) *obj,
+		sdb_memstore_matcher_t __attribute__((unused)) *filter,
+		void *user_data)
+{
+	++*(size_t *)user_data;
+	return 0;
+} /* scan_cb */
+
+/* Returns the number of objects scanned per second. */
+static double
+run(int type, sdb_memstore_matcher_t *m, size_t *matches)
+{
+	size_t scanned = 0;
+	sdb_time_t start, end;
+
+	start = sdb_gettime();
+	end = start + SECS_TO_SDB_TIME(RUNTIME_SECS);
+	do {
+		*matches = 0;
+		sdb_memstore_scan(store, type, m, /* filter = */ NULL,
+				scan_cb, matches);
+		scanned += HOSTS_NUM * (type == SDB_SERVICE ? SERVICES_NUM
+				: type == SDB_METRIC ? METRICS_NUM : 1);
+	} while (sdb_gettime() < end);
+	return (double)scanned / SDB_TIME_TO_DOUBLE(sdb_gettime() - start);
+} /* run */
+
+int
+main(void)
+{
+	size_t i;
+
+	store = sdb_memstore_create();
+	if ((! store) || populate()) {
+		fprintf(stderr, "lookup_bench: Failed to populate store\n");
+		return 1;
+	}
+
+	printf("%d hosts, %d services and %d metrics per host, %ds per run\n",
+			HOSTS_NUM, SERVICES_NUM, METRICS_NUM, RUNTIME_SECS);
+	printf("%-8s %8s %14s %14s %8s  %s\n", "type", "matches",
+			"tree objs/s", "prog objs/s", "speedup", "query");
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(queries); ++i) {
+		sdb_memstore_matcher_t *tree, *prog;
+		sdb_ast_node_t *ast;
+		size_t tree_matches, prog_matches;
+		double tree_rate, prog_rate;
+
+		ast = sdb_parser_parse_conditional(queries[i].type,
+				queries[i].query, -1, NULL);
+		tree = sdb_memstore_query_prepare_matcher(ast);
+		sdb_object_deref(SDB_OBJ(ast));
+		prog = sdb_memstore_matcher_compile(tree);
+		if ((! tree) || (! prog)) {
+			fprintf(stderr, "lookup_bench: Failed to prepare query %s\n",
+					queries[i].query);
+			return 1;
+		}
+
+		tree_rate = run(queries[i].type, tree, &tree_matches);
+		prog_rate = run(queries[i].type, prog, &prog_matches);
+		if (tree_matches != prog_matches) {
+			fprintf(stderr, "lookup_bench: Query %s matched %zu objects "
+					"using the matcher tree but %zu using the program\n",
+					queries[i].query, tree_matches, prog_matches);
+			return 1;
+		}
+
+		printf("%-8s %8zu %14.0f %14.0f %7.1fx  %s\n",
+				SDB_STORE_TYPE_TO_NAME(queries[i].type), prog_matches,
+				tree_rate, prog_rate, prog_rate / tree_rate, queries[i].query);
+		sdb_object_deref(SDB_OBJ(tree));
+		sdb_object_deref(SDB_OBJ(prog));
+	}
+
+	sdb_object_deref(SDB_OBJ(store));
+	return 0;
+} /* main */
+
+/* vim: set tw=78 sw=4 ts=4 noexpandtab : */
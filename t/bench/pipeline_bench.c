@@ -0,0 +1,209 @@
+/*
+ * SysDB - t/bench/pipeline_bench.c
+ * Copyright (C) 2016 Sebastian 'tokkee' Harl <sh@tokkee.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Pipelining benchmark: stores hosts in a frontend served over a UNIX
+ * domain socket, once using lock-step RPCs (waiting for each reply before
+ * sending the next command) and then keeping an increasing number of STORE
+ * commands in flight, and reports the throughput of each run.
+ */
+
+#if HAVE_CONFIG_H
+#	include "config.h"
+#endif
+
+#include "sysdb.h"
+#include "client/sock.h"
+#include "core/memstore.h"
+#include "core/plugin.h"
+#include "core/time.h"
+#include "frontend/sock.h"
+#include "utils/os.h"
+#include "utils/proto.h"
+#include "utils/strbuf.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define OPS_NUM 20000
+
+static sdb_fe_socket_t *sock;
+static sdb_fe_loop_t loop = SDB_FE_LOOP_INIT;
+
+static void *
+serve(void __attribute__((unused)) *arg)
+{
+	sdb_fe_sock_listen_and_serve(sock, &loop);
+	return NULL;
+} /* serve */
+
+static size_t
+marshal_host(char *buf, size_t buf_len, sdb_time_t ts, size_t i)
+{
+	char name[32];
+	sdb_proto_host_t host = { ts, name };
+
+	snprintf(name, sizeof(name), "host%zu", i % 1000);
+	return (size_t)sdb_proto_marshal_host(buf, buf_len, &host);
+} /* marshal_host */
+
+/* Store OPS_NUM hosts keeping up to 'depth' commands in flight; a depth of
+ * zero uses lock-step RPCs. Returns the runtime in seconds or a negative
+ * value on error. */
+static double
+run(sdb_client_t *client, size_t depth)
+{
+	sdb_strbuf_t *buf = sdb_strbuf_create(128);
+	/* updates have to be newer than those of any previous run */
+	sdb_time_t ts = sdb_gettime();
+	sdb_time_t start;
+	size_t sent = 0, collected = 0;
+
+	start = sdb_gettime();
+	while (collected < OPS_NUM) {
+		char msg[64];
+		uint32_t code = 0;
+		size_t len;
+
+		if (! depth) {
+			len = marshal_host(msg, sizeof(msg), ts, sent++);
+			sdb_strbuf_clear(buf);
+			if ((sdb_client_rpc(client, SDB_CONNECTION_STORE,
+							(uint32_t)len, msg, &code, buf) < 0)
+					|| (code != SDB_CONNECTION_OK))
+				break;
+			++collected;
+			continue;
+		}
+
+		while ((sent < OPS_NUM) && (sent - collected < depth)) {
+			len = marshal_host(msg, sizeof(msg), ts, sent++);
+			if (sdb_client_send(client, SDB_CONNECTION_STORE,
+						(uint32_t)len, msg) < 0)
+				break;
+		}
+
+		sdb_strbuf_clear(buf);
+		if ((sdb_client_collect(client, &code, buf) < 0)
+				|| (code != SDB_CONNECTION_OK))
+			break;
+		++collected;
+	}
+
+	sdb_strbuf_destroy(buf);
+	if (collected < OPS_NUM)
+		return -1.0;
+	return SDB_TIME_TO_DOUBLE(sdb_gettime() - start);
+} /* run */
+
+int
+main(void)
+{
+	size_t depths[] = { 0, 1, 4, 16, 64, 256 };
+	char tmp_file[] = "/tmp/sysdb_pipeline_bench.XXXXXX";
+	char addr[sizeof(tmp_file) + 5];
+	sdb_memstore_t *store;
+	sdb_client_t *client;
+	char *username;
+	pthread_t thr;
+	double lockstep = 0.0;
+	int fd;
+	size_t i;
+
+	store = sdb_memstore_create();
+	if ((! store) || sdb_plugin_register_writer("memstore",
+				&sdb_memstore_writer, SDB_OBJ(store))) {
+		fprintf(stderr, "pipeline_bench: Failed to set up store\n");
+		return 1;
+	}
+	sdb_object_deref(SDB_OBJ(store));
+
+	fd = mkstemp(tmp_file);
+	if (fd < 0) {
+		fprintf(stderr, "pipeline_bench: Failed to create socket name\n");
+		return 1;
+	}
+	close(fd);
+	unlink(tmp_file);
+	snprintf(addr, sizeof(addr), "unix:%s", tmp_file);
+
+	sock = sdb_fe_sock_create();
+	if ((! sock) || sdb_fe_sock_add_listener(sock, addr, NULL)
+			|| pthread_create(&thr, NULL, serve, NULL)) {
+		fprintf(stderr, "pipeline_bench: Failed to start frontend\n");
+		return 1;
+	}
+
+	username = sdb_get_current_user();
+	client = sdb_client_create(addr);
+	if ((! username) || (! client)) {
+		fprintf(stderr, "pipeline_bench: Failed to create client\n");
+		return 1;
+	}
+	/* wait for the frontend to start listening */
+	for (i = 0; sdb_client_connect(client, username); ++i) {
+		if (i >= 100) {
+			fprintf(stderr, "pipeline_bench: Failed to connect to %s\n",
+					addr);
+			return 1;
+		}
+		usleep(10000);
+	}
+
+	printf("%d STORE commands per run\n", OPS_NUM);
+	printf("%10s %16s %10s\n", "in flight", "stores/s", "speedup");
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(depths); ++i) {
+		double secs = run(client, depths[i]);
+
+		if (secs < 0.0) {
+			fprintf(stderr, "pipeline_bench: Failed to store hosts\n");
+			return 1;
+		}
+		if (! depths[i]) {
+			lockstep = secs;
+			printf("%10s %16.0f %10s\n", "lock-step",
+					OPS_NUM / secs, "1.00");
+		}
+		else
+			printf("%10zu %16.0f %10.2f\n", depths[i],
+					OPS_NUM / secs, lockstep / secs);
+	}
+
+	sdb_client_destroy(client);
+	free(username);
+
+	loop.do_loop = 0;
+	pthread_join(thr, NULL);
+	sdb_fe_sock_destroy(sock);
+	unlink(tmp_file);
+	sdb_plugin_unregister_all();
+	return 0;
+} /* main */
+
+/* vim: set tw=78 sw=4 ts=4 noexpandtab : */
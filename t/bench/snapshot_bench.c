@@ -0,0 +1,179 @@
+/*
+ * SysDB - t/bench/snapshot_bench.c
+ * Copyright (C) 2016 Sebastian 'tokkee' Harl <sh@tokkee.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Memstore snapshot benchmark: populates a store with about one million
+ * objects and reports the time used for writing a snapshot of it and for
+ * loading that snapshot into an empty store. For comparison, the time used
+ * for populating the store object by object is reported as well.
+ */
+
+#if HAVE_CONFIG_H
+#	include "config.h"
+#endif
+
+#include "sysdb.h"
+#include "core/memstore.h"
+#include "core/time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* 189 objects per host */
+#define HOSTS_NUM 5300
+#define SERVICES_NUM 10
+#define METRICS_NUM 10
+#define ATTRS_NUM 8
+
+static int
+populate(sdb_memstore_t *store, size_t hosts_num, size_t *objs_num)
+{
+	sdb_data_t value = { SDB_TYPE_INTEGER, { .integer = 42 } };
+	size_t i, j, k;
+
+	*objs_num = 0;
+	for (i = 0; i < hosts_num; ++i) {
+		char host[64];
+		snprintf(host, sizeof(host), "host%zu.example.com", i);
+		if (sdb_memstore_host(store, host, 1, 0))
+			return -1;
+		++*objs_num;
+
+		for (k = 0; k < ATTRS_NUM; ++k) {
+			char key[32];
+			snprintf(key, sizeof(key), "attribute%zu", k);
+			if (sdb_memstore_attribute(store, host, key, &value, 1, 0))
+				return -1;
+			++*objs_num;
+		}
+
+		for (j = 0; j < SERVICES_NUM + METRICS_NUM; ++j) {
+			char name[32];
+			int status;
+
+			if (j < SERVICES_NUM) {
+				snprintf(name, sizeof(name), "service%zu", j);
+				status = sdb_memstore_service(store, host, name, 1, 0);
+			}
+			else {
+				snprintf(name, sizeof(name), "metric%zu", j);
+				status = sdb_memstore_metric(store, host, name, NULL, 1, 0);
+			}
+			if (status)
+				return -1;
+			++*objs_num;
+
+			for (k = 0; k < ATTRS_NUM; ++k) {
+				char key[32];
+				snprintf(key, sizeof(key), "attribute%zu", k);
+				if (j < SERVICES_NUM)
+					status = sdb_memstore_service_attr(store, host, name,
+							key, &value, 1, 0);
+				else
+					status = sdb_memstore_metric_attr(store, host, name,
+							key, &value, 1, 0);
+				if (status)
+					return -1;
+				++*objs_num;
+			}
+		}
+	}
+	return 0;
+} /* populate */
+
+static void
+report(const char *what, sdb_time_t start, sdb_time_t end, size_t objs_num)
+{
+	printf("%-16s %10.3f %16.1f\n", what, SDB_TIME_TO_DOUBLE(end - start),
+			(double)(end - start) / (double)objs_num);
+} /* report */
+
+int
+main(void)
+{
+	char filename[] = "/tmp/snapshot_bench.XXXXXX";
+	sdb_memstore_t *store, *restored;
+	sdb_time_t start, end;
+	size_t objs_num;
+	struct stat st;
+	int fd;
+
+	if ((fd = mkstemp(filename)) < 0) {
+		fprintf(stderr, "snapshot_bench: Failed to create temporary file\n");
+		return 1;
+	}
+	close(fd);
+
+	printf("%d hosts; %d services, %d metrics, %d attributes each per host\n",
+			HOSTS_NUM, SERVICES_NUM, METRICS_NUM, ATTRS_NUM);
+
+	start = sdb_gettime();
+	store = sdb_memstore_create();
+	if ((! store) || populate(store, HOSTS_NUM, &objs_num)) {
+		fprintf(stderr, "snapshot_bench: Failed to populate store\n");
+		return 1;
+	}
+	end = sdb_gettime();
+
+	printf("%zu objects\n", objs_num);
+	printf("%-16s %10s %16s\n", "", "seconds", "ns/object");
+	report("populate", start, end, objs_num);
+
+	start = sdb_gettime();
+	if (sdb_memstore_dump(store, filename)) {
+		fprintf(stderr, "snapshot_bench: Failed to write snapshot\n");
+		unlink(filename);
+		return 1;
+	}
+	end = sdb_gettime();
+	report("dump", start, end, objs_num);
+
+	/* measure loading from the page cache rather than from disk */
+	start = sdb_gettime();
+	restored = sdb_memstore_create();
+	if ((! restored) || sdb_memstore_restore(restored, filename)) {
+		fprintf(stderr, "snapshot_bench: Failed to restore snapshot\n");
+		unlink(filename);
+		return 1;
+	}
+	end = sdb_gettime();
+	report("restore", start, end, objs_num);
+
+	if (! stat(filename, &st))
+		printf("snapshot size: %lld bytes (%.1f bytes/object)\n",
+				(long long)st.st_size, (double)st.st_size / (double)objs_num);
+
+	unlink(filename);
+	sdb_object_deref(SDB_OBJ(restored));
+	sdb_object_deref(SDB_OBJ(store));
+	return 0;
+} /* main */
+
+/* vim: set tw=78 sw=4 ts=4 noexpandtab : */
@@ -0,0 +1,192 @@
+/*
+ * SysDB - t/bench/store_bench.c
+ * Copyright (C) 2016 Sebastian 'tokkee' Harl <sh@tokkee.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Memstore contention benchmark: measures write and scan throughput while
+ * increasing the number of concurrent writer and scanner threads. Each
+ * writer updates the metrics of its own set of hosts, mimicking independent
+ * collectors, while scanners continuously iterate over all metrics.
+ */
+
+#if HAVE_CONFIG_H
+#	include "config.h"
+#endif
+
+#include "core/memstore.h"
+#include "core/time.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define HOSTS_NUM 64
+#define METRICS_NUM 256
+#define RUNTIME_SECS 2
+
+static sdb_memstore_t *store;
+static volatile bool running;
+
+typedef struct {
+	int id;
+	int threads_num;
+	unsigned long ops;
+} worker_t;
+
+static int
+populate(void)
+{
+	int i, j;
+
+	for (i = 0; i < HOSTS_NUM; ++i) {
+		char host[32];
+		snprintf(host, sizeof(host), "host%d", i);
+		if (sdb_memstore_host(store, host, 1, 0))
+			return -1;
+
+		for (j = 0; j < METRICS_NUM; ++j) {
+			char metric[32];
+			snprintf(metric, sizeof(metric), "metric%d", j);
+			if (sdb_memstore_metric(store, host, metric, NULL, 1, 0))
+				return -1;
+		}
+	}
+	return 0;
+} /* populate */
+
+static void *
+writer(void *arg)
+{
+	worker_t *w = arg;
+
+	while (running) {
+		/* updates have to be newer than those of any previous run */
+		sdb_time_t ts = sdb_gettime();
+		int i, j;
+
+		/* each writer owns every threads_num-th host */
+		for (i = w->id; running && (i < HOSTS_NUM); i += w->threads_num) {
+			char host[32];
+			snprintf(host, sizeof(host), "host%d", i);
+
+			for (j = 0; j < METRICS_NUM; ++j) {
+				char metric[32];
+				snprintf(metric, sizeof(metric), "metric%d", j);
+				sdb_memstore_metric(store, host, metric, NULL, ts, 0);
+				++w->ops;
+			}
+		}
+	}
+	return NULL;
+} /* writer */
+
+static int
+scan_cb(sdb_memstore_obj_t __attribute__((unused)) *obj,
+		sdb_memstore_matcher_t __attribute__((unused)) *filter,
+		void *user_data)
+{
+	++*(unsigned long *)user_data;
+	return 0;
+} /* scan_cb */
+
+static void *
+scanner(void *arg)
+{
+	worker_t *w = arg;
+
+	while (running)
+		sdb_memstore_scan(store, SDB_METRIC, /* m = */ NULL,
+				/* filter = */ NULL, scan_cb, &w->ops);
+	return NULL;
+} /* scanner */
+
+static double
+run(int writers_num, int scanners_num,
+		unsigned long *write_ops, unsigned long *scan_ops)
+{
+	pthread_t threads[writers_num + scanners_num];
+	worker_t workers[writers_num + scanners_num];
+	sdb_time_t start, end;
+	int i;
+
+	running = 1;
+	start = sdb_gettime();
+	for (i = 0; i < writers_num + scanners_num; ++i) {
+		workers[i].id = i < writers_num ? i : i - writers_num;
+		workers[i].threads_num = i < writers_num ? writers_num : scanners_num;
+		workers[i].ops = 0;
+		pthread_create(threads + i, NULL,
+				i < writers_num ? writer : scanner, workers + i);
+	}
+
+	sleep(RUNTIME_SECS);
+	running = 0;
+
+	*write_ops = *scan_ops = 0;
+	for (i = 0; i < writers_num + scanners_num; ++i) {
+		pthread_join(threads[i], NULL);
+		if (i < writers_num)
+			*write_ops += workers[i].ops;
+		else
+			*scan_ops += workers[i].ops;
+	}
+	end = sdb_gettime();
+	return SDB_TIME_TO_DOUBLE(end - start);
+} /* run */
+
+int
+main(void)
+{
+	int threads[] = { 1, 2, 4, 8, 16 };
+	size_t i;
+
+	store = sdb_memstore_create();
+	if ((! store) || populate()) {
+		fprintf(stderr, "store_bench: Failed to populate store\n");
+		return 1;
+	}
+
+	printf("%d hosts, %d metrics per host, %ds per run\n",
+			HOSTS_NUM, METRICS_NUM, RUNTIME_SECS);
+	printf("%8s %8s %16s %16s\n", "writers", "scanners",
+			"writes/s", "scanned objs/s");
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(threads); ++i) {
+		unsigned long write_ops, scan_ops;
+		double secs;
+
+		secs = run(threads[i], threads[i], &write_ops, &scan_ops);
+		printf("%8d %8d %16.0f %16.0f\n", threads[i], threads[i],
+				(double)write_ops / secs, (double)scan_ops / secs);
+	}
+
+	sdb_object_deref(SDB_OBJ(store));
+	return 0;
+} /* main */
+
+/* vim: set tw=78 sw=4 ts=4 noexpandtab : */
+
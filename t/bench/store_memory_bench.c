@@ -0,0 +1,160 @@
+/*
+ * SysDB - t/bench/store_memory_bench.c
+ * Copyright (C) 2016 Sebastian 'tokkee' Harl <sh@tokkee.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Memstore footprint benchmark: populates stores of increasing size and
+ * reports the resident memory and the time used per stored object. Each host
+ * has a fixed number of services and metrics, each of which has a fixed
+ * number of attributes, mimicking the shape of a typical inventory.
+ */
+
+#if HAVE_CONFIG_H
+#	include "config.h"
+#endif
+
+#include "sysdb.h"
+#include "core/memstore.h"
+#include "core/time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define SERVICES_NUM 10
+#define METRICS_NUM 10
+#define ATTRS_NUM 8
+
+/* Returns the resident set size in bytes or 0 if it is unknown. */
+static size_t
+get_rss(void)
+{
+	unsigned long size, resident;
+	FILE *f;
+
+	f = fopen("/proc/self/statm", "r");
+	if (! f)
+		return 0;
+	if (fscanf(f, "%lu %lu", &size, &resident) != 2)
+		resident = 0;
+	fclose(f);
+	return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+} /* get_rss */
+
+static int
+populate(sdb_memstore_t *store, size_t hosts_num, size_t *objs_num)
+{
+	sdb_data_t value = { SDB_TYPE_INTEGER, { .integer = 42 } };
+	size_t i, j, k;
+
+	*objs_num = 0;
+	for (i = 0; i < hosts_num; ++i) {
+		char host[64];
+		snprintf(host, sizeof(host), "host%zu.example.com", i);
+		if (sdb_memstore_host(store, host, 1, 0))
+			return -1;
+		++*objs_num;
+
+		for (k = 0; k < ATTRS_NUM; ++k) {
+			char key[32];
+			snprintf(key, sizeof(key), "attribute%zu", k);
+			if (sdb_memstore_attribute(store, host, key, &value, 1, 0))
+				return -1;
+			++*objs_num;
+		}
+
+		for (j = 0; j < SERVICES_NUM + METRICS_NUM; ++j) {
+			char name[32];
+			int status;
+
+			if (j < SERVICES_NUM) {
+				snprintf(name, sizeof(name), "service%zu", j);
+				status = sdb_memstore_service(store, host, name, 1, 0);
+			}
+			else {
+				snprintf(name, sizeof(name), "metric%zu", j);
+				status = sdb_memstore_metric(store, host, name, NULL, 1, 0);
+			}
+			if (status)
+				return -1;
+			++*objs_num;
+
+			for (k = 0; k < ATTRS_NUM; ++k) {
+				char key[32];
+				snprintf(key, sizeof(key), "attribute%zu", k);
+				if (j < SERVICES_NUM)
+					status = sdb_memstore_service_attr(store, host, name,
+							key, &value, 1, 0);
+				else
+					status = sdb_memstore_metric_attr(store, host, name,
+							key, &value, 1, 0);
+				if (status)
+					return -1;
+				++*objs_num;
+			}
+		}
+	}
+	return 0;
+} /* populate */
+
+int
+main(void)
+{
+	size_t sizes[] = { 1000, 10000 };
+	sdb_memstore_t *stores[SDB_STATIC_ARRAY_LEN(sizes)];
+	size_t i;
+
+	printf("%d services, %d metrics, %d attributes each per host\n",
+			SERVICES_NUM, METRICS_NUM, ATTRS_NUM);
+	printf("%8s %10s %16s %16s\n", "hosts", "objects",
+			"bytes/object", "ns/object");
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(sizes); ++i) {
+		sdb_time_t start, end;
+		size_t rss, objs_num;
+
+		rss = get_rss();
+		start = sdb_gettime();
+		stores[i] = sdb_memstore_create();
+		if ((! stores[i]) || populate(stores[i], sizes[i], &objs_num)) {
+			fprintf(stderr, "store_memory_bench: Failed to populate store\n");
+			return 1;
+		}
+		end = sdb_gettime();
+
+		printf("%8zu %10zu %16.1f %16.1f\n", sizes[i], objs_num,
+				(double)(get_rss() - rss) / (double)objs_num,
+				(double)(end - start) / (double)objs_num);
+	}
+
+	/* keep all stores around until the end to avoid measuring the reuse of
+	 * previously released memory */
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(sizes); ++i)
+		sdb_object_deref(SDB_OBJ(stores[i]));
+	return 0;
+} /* main */
+
+/* vim: set tw=78 sw=4 ts=4 noexpandtab : */
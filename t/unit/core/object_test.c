@@ -33,6 +33,7 @@
 #include "testutils.h"
 
 #include <check.h>
+#include <string.h>
 
 /*
  * private data types
@@ -293,6 +294,33 @@ START_TEST(test_obj_ref)
 }
 END_TEST
 
+START_TEST(test_obj_rename)
+{
+	char name[128];
+	sdb_object_t *obj;
+	void *addr;
+
+	memset(name, 'x', sizeof(name) - 1);
+	name[sizeof(name) - 1] = '\0';
+
+	/* objects may modify their name in place; they still have to be
+	 * released using the size they were allocated with, in which case the
+	 * memory will be reused by the next object of the same size */
+	obj = sdb_object_create(name, noop_type);
+	fail_unless(obj != NULL,
+			"sdb_object_create() = NULL; expected: valid object");
+	addr = obj;
+	obj->name[1] = '\0';
+	sdb_object_deref(obj);
+
+	obj = sdb_object_create(name, noop_type);
+	fail_unless(obj == addr,
+			"sdb_object_create() = %p after releasing a renamed object; "
+			"expected: %p (reused memory)", obj, addr);
+	sdb_object_deref(obj);
+}
+END_TEST
+
 START_TEST(test_obj_cmp)
 {
 	sdb_object_t *obj1, *obj2, *obj3, *obj4;
@@ -329,6 +357,7 @@ TEST_MAIN("core::object")
 	tcase_add_test(tc, test_obj_create);
 	tcase_add_test(tc, test_obj_wrapper);
 	tcase_add_test(tc, test_obj_ref);
+	tcase_add_test(tc, test_obj_rename);
 	tcase_add_test(tc, test_obj_cmp);
 	ADD_TCASE(tc);
 }
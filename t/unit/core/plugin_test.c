@@ -0,0 +1,303 @@
+/*
+ * SysDB - t/unit/core/plugin_test.c
+ * Copyright (C) 2016 Sebastian 'tokkee' Harl <sh@tokkee.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if HAVE_CONFIG_H
+#	include "config.h"
+#endif
+
+#include "core/memstore.h"
+#include "core/plugin.h"
+#include "testutils.h"
+
+#include <check.h>
+#include <string.h>
+
+/*
+ * private helpers
+ */
+
+static sdb_memstore_t *store;
+
+/* a writer without batch support recording all objects it receives */
+static sdb_strbuf_t *recorded;
+static int record_status;
+
+static int
+record_host(sdb_store_host_t *host, sdb_object_t __attribute__((unused)) *ud)
+{
+	sdb_strbuf_append(recorded, "host %s %"PRIsdbTIME"\n",
+			host->name, host->last_update);
+	return record_status;
+} /* record_host */
+
+static int
+record_service(sdb_store_service_t *service,
+		sdb_object_t __attribute__((unused)) *ud)
+{
+	sdb_strbuf_append(recorded, "service %s.%s %"PRIsdbTIME"\n",
+			service->hostname, service->name, service->last_update);
+	return record_status;
+} /* record_service */
+
+static int
+record_metric(sdb_store_metric_t *metric,
+		sdb_object_t __attribute__((unused)) *ud)
+{
+	sdb_strbuf_append(recorded, "metric %s.%s %"PRIsdbTIME,
+			metric->hostname, metric->name, metric->last_update);
+	if (metric->stores_num)
+		sdb_strbuf_append(recorded, " store=%s:%s@%"PRIsdbTIME,
+				metric->stores[0].type, metric->stores[0].id,
+				metric->stores[0].last_update);
+	sdb_strbuf_append(recorded, "\n");
+	return record_status;
+} /* record_metric */
+
+static int
+record_attribute(sdb_store_attribute_t *attr,
+		sdb_object_t __attribute__((unused)) *ud)
+{
+	char value[64];
+
+	sdb_data_format(&attr->value, value, sizeof(value), SDB_UNQUOTED);
+	sdb_strbuf_append(recorded, "attribute %s%s%s.%s=%s %"PRIsdbTIME"\n",
+			attr->hostname ? attr->hostname : "",
+			attr->hostname ? "." : "", attr->parent, attr->key,
+			value, attr->last_update);
+	return record_status;
+} /* record_attribute */
+
+static sdb_store_writer_t record_writer = {
+	record_host, record_service, record_metric, record_attribute,
+	/* store_batch = */ NULL, NULL, NULL,
+};
+
+static void
+setup(void)
+{
+	store = sdb_memstore_create();
+	ck_assert(store != NULL);
+	recorded = sdb_strbuf_create(1024);
+	ck_assert(recorded != NULL);
+	record_status = 0;
+} /* setup */
+
+static void
+turndown(void)
+{
+	sdb_plugin_unregister_all();
+	sdb_object_deref(SDB_OBJ(store));
+	store = NULL;
+	sdb_strbuf_destroy(recorded);
+	recorded = NULL;
+} /* turndown */
+
+static void
+register_writers(void)
+{
+	/* the memstore supports batches, the recorder does not */
+	ck_assert(sdb_plugin_register_writer("memstore",
+				&sdb_memstore_writer, SDB_OBJ(store)) == 0);
+	ck_assert(sdb_plugin_register_writer("recorder",
+				&record_writer, NULL) == 0);
+} /* register_writers */
+
+/*
+ * tests
+ */
+
+START_TEST(test_batch_invalid)
+{
+	sdb_plugin_batch_t *batch = sdb_plugin_store_batch_begin();
+	sdb_data_t value = { SDB_TYPE_INTEGER, { .integer = 42 } };
+
+	ck_assert(batch != NULL);
+
+	fail_unless(sdb_plugin_store_batch_host(NULL, "h1", 1) < 0,
+			"sdb_plugin_store_batch_host(NULL, ...) succeeded");
+	fail_unless(sdb_plugin_store_batch_host(batch, NULL, 1) < 0,
+			"sdb_plugin_store_batch_host(<batch>, NULL, ...) succeeded");
+	fail_unless(sdb_plugin_store_batch_service(batch, "h1", NULL, 1) < 0,
+			"sdb_plugin_store_batch_service(<batch>, <host>, NULL, ...) "
+			"succeeded");
+	fail_unless(sdb_plugin_store_batch_metric(batch, NULL, "m1", NULL, 1) < 0,
+			"sdb_plugin_store_batch_metric(<batch>, NULL, ...) succeeded");
+	fail_unless(sdb_plugin_store_batch_attribute(batch,
+				"h1", NULL, &value, 1) < 0,
+			"sdb_plugin_store_batch_attribute(<batch>, <host>, NULL, ...) "
+			"succeeded");
+	fail_unless(sdb_plugin_store_batch_service_attribute(batch,
+				"h1", "s1", "k1", NULL, 1) < 0,
+			"sdb_plugin_store_batch_service_attribute(..., NULL, ...) "
+			"succeeded");
+	fail_unless(sdb_plugin_store_batch_metric_attribute(batch,
+				"h1", NULL, "k1", &value, 1) < 0,
+			"sdb_plugin_store_batch_metric_attribute(<batch>, <host>, NULL, "
+			"...) succeeded");
+	fail_unless(sdb_plugin_store_batch_commit(NULL) < 0,
+			"sdb_plugin_store_batch_commit(NULL) succeeded");
+
+	/* nothing has been queued */
+	fail_unless(sdb_plugin_store_batch_commit(batch) == 0,
+			"sdb_plugin_store_batch_commit(<empty batch>) failed");
+
+	/* queued objects are dropped if there are no writers */
+	ck_assert(sdb_plugin_store_batch_host(batch, "h1", 1) == 0);
+	fail_unless(sdb_plugin_store_batch_commit(batch) < 0,
+			"sdb_plugin_store_batch_commit(<batch>) succeeded "
+			"without any writers");
+	register_writers();
+	fail_unless(sdb_plugin_store_batch_commit(batch) == 0,
+			"sdb_plugin_store_batch_commit(<batch>) did not clear "
+			"the batch after failing");
+	fail_unless(sdb_strbuf_len(recorded) == 0,
+			"sdb_plugin_store_batch_commit(<batch>) stored '%s'; "
+			"expected: nothing", sdb_strbuf_string(recorded));
+
+	sdb_object_deref(SDB_OBJ(batch));
+}
+END_TEST
+
+START_TEST(test_batch_commit)
+{
+	sdb_plugin_batch_t *batch = sdb_plugin_store_batch_begin();
+	sdb_metric_store_t ms = { "dummy-type", "dummy-id", NULL, 5 };
+	sdb_data_t value = { SDB_TYPE_INTEGER, { .integer = 42 } };
+	char name[16];
+
+	const char *expected =
+		"host h1 10\n"
+		"service h1.s1 10\n"
+		"attribute h1.s1.hostname=h1 10\n"
+		"metric h1.m1 10 store=dummy-type:dummy-id@10\n"
+		"attribute h1.m1.hostname=h1 10\n"
+		"attribute h1.k1=42 10\n"
+		"attribute h1.s1.k2=42 10\n"
+		"attribute h1.m1.k3=42 10\n";
+
+	sdb_memstore_obj_t *host, *obj;
+	sdb_data_t datum = SDB_DATA_INIT;
+	int check;
+
+	register_writers();
+	ck_assert(batch != NULL);
+
+	/* all arguments are copied */
+	strcpy(name, "h1");
+	ck_assert(sdb_plugin_store_batch_host(batch, name, 10) == 0);
+	ck_assert(sdb_plugin_store_batch_service(batch, name, "s1", 10) == 0);
+	ck_assert(sdb_plugin_store_batch_metric(batch, name, "m1", &ms, 10) == 0);
+	ck_assert(sdb_plugin_store_batch_attribute(batch,
+				name, "k1", &value, 10) == 0);
+	ck_assert(sdb_plugin_store_batch_service_attribute(batch,
+				name, "s1", "k2", &value, 10) == 0);
+	ck_assert(sdb_plugin_store_batch_metric_attribute(batch,
+				name, "m1", "k3", &value, 10) == 0);
+	strcpy(name, "invalid");
+	value.data.integer = 0;
+	ms.type = ms.id = NULL;
+
+	/* nothing is stored before committing the batch */
+	fail_unless(sdb_strbuf_len(recorded) == 0,
+			"sdb_plugin_store_batch_<type>() stored '%s' before committing",
+			sdb_strbuf_string(recorded));
+	host = sdb_memstore_get_host(store, "h1");
+	fail_unless(host == NULL,
+			"sdb_plugin_store_batch_host() stored the host before "
+			"committing");
+
+	check = sdb_plugin_store_batch_commit(batch);
+	fail_unless(check == 0,
+			"sdb_plugin_store_batch_commit(<batch>) = %d; expected: 0",
+			check);
+	fail_unless(! strcmp(sdb_strbuf_string(recorded), expected),
+			"sdb_plugin_store_batch_commit(<batch>) passed:\n%s\n"
+			"to writers without batch support; expected:\n%s",
+			sdb_strbuf_string(recorded), expected);
+
+	host = sdb_memstore_get_host(store, "h1");
+	fail_unless(host != NULL,
+			"sdb_plugin_store_batch_commit(<batch>) did not store host h1");
+	obj = sdb_memstore_get_child(host, SDB_SERVICE, "s1");
+	fail_unless(obj != NULL,
+			"sdb_plugin_store_batch_commit(<batch>) did not store "
+			"service h1.s1");
+	sdb_object_deref(SDB_OBJ(obj));
+	obj = sdb_memstore_get_child(host, SDB_METRIC, "m1");
+	fail_unless(obj != NULL,
+			"sdb_plugin_store_batch_commit(<batch>) did not store "
+			"metric h1.m1");
+	sdb_object_deref(SDB_OBJ(obj));
+	check = sdb_memstore_get_attr(host, "k1", &datum, NULL);
+	fail_unless((check == 0) && (datum.type == SDB_TYPE_INTEGER)
+				&& (datum.data.integer == 42),
+			"sdb_plugin_store_batch_commit(<batch>) did not store "
+			"attribute h1.k1 = 42");
+	sdb_data_free_datum(&datum);
+	sdb_object_deref(SDB_OBJ(host));
+
+	/* the batch is empty and may be reused */
+	sdb_strbuf_clear(recorded);
+	check = sdb_plugin_store_batch_commit(batch);
+	fail_unless((check == 0) && (sdb_strbuf_len(recorded) == 0),
+			"sdb_plugin_store_batch_commit(<committed batch>) = %d "
+			"and stored '%s'; expected: 0 and nothing",
+			check, sdb_strbuf_string(recorded));
+
+	/* stale updates are reported unless any writer failed */
+	ck_assert(sdb_plugin_store_batch_host(batch, "h1", 5) == 0);
+	check = sdb_plugin_store_batch_commit(batch);
+	fail_unless(check > 0,
+			"sdb_plugin_store_batch_commit(<stale host>) = %d; "
+			"expected: >0", check);
+	fail_unless(! strcmp(sdb_strbuf_string(recorded), "host h1 5\n"),
+			"sdb_plugin_store_batch_commit(<stale host>) passed '%s' to "
+			"writers without batch support; expected: 'host h1 5'",
+			sdb_strbuf_string(recorded));
+
+	record_status = -1;
+	ck_assert(sdb_plugin_store_batch_host(batch, "h1", 5) == 0);
+	check = sdb_plugin_store_batch_commit(batch);
+	fail_unless(check < 0,
+			"sdb_plugin_store_batch_commit(<stale host, failing writer>) "
+			"= %d; expected: <0", check);
+
+	sdb_object_deref(SDB_OBJ(batch));
+}
+END_TEST
+
+TEST_MAIN("core::plugin")
+{
+	TCase *tc = tcase_create("core");
+	tcase_add_checked_fixture(tc, setup, turndown);
+	tcase_add_test(tc, test_batch_invalid);
+	tcase_add_test(tc, test_batch_commit);
+	ADD_TCASE(tc);
+}
+TEST_MAIN_END
+
+/* vim: set tw=78 sw=4 ts=4 noexpandtab : */
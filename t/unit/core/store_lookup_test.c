@@ -537,6 +537,14 @@ struct {
 	{ "name =~ 'a|b'", NULL,                     2 },
 	{ "name =~ 'host'", NULL,                    0 },
 	{ "name =~ '.'", NULL,                       3 },
+	{ "name =~ '^a'", NULL,                      1 },
+	{ "name =~ '^A'", NULL,                      1 }, /* case-insensitive */
+	{ "name =~ '^ax*'", NULL,                    1 },
+	{ "name =~ '^a|b'", NULL,                    2 },
+	{ "name =~ '^x'", NULL,                      0 },
+	{ "name =~ '.'", "name =~ '^b'",             1 },
+	{ "name = 'b'", NULL,                        1 },
+	{ "name =~ '^' || 'b'", NULL,                1 }, /* folded */
 	{ "ANY backend = 'backend'", NULL,           0 },
 	{ "ALL backend = ''", NULL,                  3 }, /* backend is empty */
 	{ "backend = ['backend']", NULL,             0 },
@@ -629,6 +637,7 @@ START_TEST(test_scan)
 {
 	sdb_strbuf_t *errbuf = sdb_strbuf_create(64);
 	sdb_memstore_matcher_t *m, *filter = NULL;
+	sdb_memstore_matcher_t *prog, *prog_filter = NULL;
 	sdb_ast_node_t *ast;
 	int check, n;
 
@@ -666,12 +675,1017 @@ START_TEST(test_scan)
 			"found %d hosts; expected: %d", scan_data[_i].query,
 			scan_data[_i].filter, n, scan_data[_i].expected);
 
+	/* compiled matchers behave the same */
+	prog = sdb_memstore_matcher_compile(m);
+	fail_unless(prog != NULL,
+			"sdb_memstore_matcher_compile(matcher{%s}) = NULL; "
+			"expected: <matcher>", scan_data[_i].query);
+	if (filter) {
+		prog_filter = sdb_memstore_matcher_compile(filter);
+		fail_unless(prog_filter != NULL,
+				"sdb_memstore_matcher_compile(filter{%s}) = NULL; "
+				"expected: <matcher>", scan_data[_i].filter);
+	}
+
+	n = 0;
+	sdb_memstore_scan(store, SDB_HOST, prog, prog_filter, scan_cb, &n);
+	fail_unless(n == scan_data[_i].expected,
+			"sdb_memstore_scan(HOST, compiled matcher{%s}, filter{%s}) "
+			"found %d hosts; expected: %d", scan_data[_i].query,
+			scan_data[_i].filter, n, scan_data[_i].expected);
+
+	sdb_object_deref(SDB_OBJ(prog_filter));
+	sdb_object_deref(SDB_OBJ(prog));
 	sdb_object_deref(SDB_OBJ(filter));
 	sdb_object_deref(SDB_OBJ(m));
 	sdb_strbuf_destroy(errbuf);
 }
 END_TEST
 
+struct {
+	int type;
+	const char *query;
+	const char *host_prefix;
+	const char *prefix;
+	int expected;
+} prefix_data[] = {
+	{ SDB_HOST, "name =~ 'b|c'",                 "",  "",  2 },
+	{ SDB_HOST, "name =~ '^a.*'",                "a", "a", 1 },
+	{ SDB_HOST, "name =~ '^ab?'",                "a", "a", 1 },
+	{ SDB_HOST, "name =~ '^(a|b)'",              "",  "",  2 },
+	{ SDB_HOST, "host.name =~ '^b'",             "b", "b", 1 },
+	{ SDB_HOST, "NOT name =~ '^b'",              "",  "",  2 },
+	{ SDB_HOST, "name =~ '^b' OR name = 'c'",    "",  "",  2 },
+	{ SDB_HOST, "name =~ '.' AND name = 'c'",    "c", "c", 1 },
+	{ SDB_SERVICE, "name =~ '^s1'",              "",  "s1", 2 },
+	{ SDB_SERVICE, "host.name =~ '^a'",          "a", "",  2 },
+	{ SDB_SERVICE, "host.name = 'b' AND name =~ '^s'",
+	                                             "b", "s", 2 },
+	{ SDB_METRIC, "name =~ '^m2$'",              "",  "m2", 1 },
+	{ SDB_METRIC, "name =~ '^M'",                "",  "M", 3 },
+};
+
+START_TEST(test_prefix)
+{
+	sdb_memstore_matcher_t *m, *prog;
+	sdb_ast_node_t *ast;
+	char buf[64];
+	int n;
+
+	ast = sdb_parser_parse_conditional(prefix_data[_i].type,
+			prefix_data[_i].query, -1, NULL);
+	m = sdb_memstore_query_prepare_matcher(ast);
+	sdb_object_deref(SDB_OBJ(ast));
+	fail_unless(m != NULL,
+			"sdb_memstore_query_prepare_matcher(%s) = NULL; "
+			"expected: <matcher>", prefix_data[_i].query);
+	prog = sdb_memstore_matcher_compile(m);
+	ck_assert(prog != NULL);
+
+	memset(buf, 0, sizeof(buf));
+	sdb_memstore_matcher_prefix(prog, prefix_data[_i].type, SDB_HOST,
+			buf, sizeof(buf));
+	fail_unless(! strcmp(buf, prefix_data[_i].host_prefix),
+			"sdb_memstore_matcher_prefix(%s, %s, host) = '%s'; "
+			"expected: '%s'", prefix_data[_i].query,
+			SDB_STORE_TYPE_TO_NAME(prefix_data[_i].type), buf,
+			prefix_data[_i].host_prefix);
+
+	memset(buf, 0, sizeof(buf));
+	sdb_memstore_matcher_prefix(prog, prefix_data[_i].type,
+			prefix_data[_i].type, buf, sizeof(buf));
+	fail_unless(! strcmp(buf, prefix_data[_i].prefix),
+			"sdb_memstore_matcher_prefix(%s, %s, %s) = '%s'; "
+			"expected: '%s'", prefix_data[_i].query,
+			SDB_STORE_TYPE_TO_NAME(prefix_data[_i].type),
+			SDB_STORE_TYPE_TO_NAME(prefix_data[_i].type), buf,
+			prefix_data[_i].prefix);
+
+	/* scans skip over all other objects */
+	n = 0;
+	sdb_memstore_scan(store, prefix_data[_i].type, prog, NULL, scan_cb, &n);
+	fail_unless(n == prefix_data[_i].expected,
+			"sdb_memstore_scan(%s, matcher{%s}) found %d objects; "
+			"expected: %d", SDB_STORE_TYPE_TO_NAME(prefix_data[_i].type),
+			prefix_data[_i].query, n, prefix_data[_i].expected);
+
+	sdb_object_deref(SDB_OBJ(prog));
+	sdb_object_deref(SDB_OBJ(m));
+}
+END_TEST
+
+START_TEST(test_visibility)
+{
+	sdb_data_t v2 = { SDB_TYPE_STRING, { .string = "v2" } };
+	sdb_memstore_visibility_t scope;
+	sdb_memstore_matcher_t *filter;
+	sdb_memstore_obj_t *host;
+	sdb_ast_node_t *ast;
+	bool check;
+
+	ast = sdb_parser_parse_conditional(SDB_HOST,
+			"attribute['k1'] = 'v1'", -1, NULL);
+	filter = sdb_memstore_query_prepare_matcher(ast);
+	sdb_object_deref(SDB_OBJ(ast));
+	ck_assert(filter != NULL);
+	host = sdb_memstore_get_host(store, "a");
+	ck_assert(host != NULL);
+
+	check = sdb_memstore_visible(NULL, host);
+	fail_unless(check, "sdb_memstore_visible(NULL, a) = false; expected: true");
+
+	sdb_memstore_visibility_begin(&scope);
+	check = sdb_memstore_visible(filter, host);
+	fail_unless(check, "sdb_memstore_visible({k1 = v1}, a) = false; "
+			"expected: true");
+
+	/* the decision is memoized until the scope is reset */
+	sdb_memstore_attribute(store, "a", "k1", &v2, 2, 0);
+	check = sdb_memstore_visible(filter, host);
+	fail_unless(check, "sdb_memstore_visible({k1 = v1}, a) = false "
+			"(memoized); expected: true");
+	sdb_memstore_visibility_reset(&scope);
+	check = sdb_memstore_visible(filter, host);
+	fail_unless(! check, "sdb_memstore_visible({k1 = v1}, a) = true "
+			"after reset; expected: false");
+	sdb_memstore_visibility_end(&scope);
+
+	check = sdb_memstore_visible(filter, host);
+	fail_unless(! check, "sdb_memstore_visible({k1 = v1}, a) = true "
+			"outside of scope; expected: false");
+
+	sdb_object_deref(SDB_OBJ(host));
+	sdb_object_deref(SDB_OBJ(filter));
+}
+END_TEST
+
+struct {
+	int type;
+	const char *query;
+	bool indexed;
+	int expected;
+} index_data[] = {
+	{ SDB_HOST, "attribute['k1'] = 'v1'",                1, 1 },
+	{ SDB_HOST, "attribute['k1'] = 'V1'",                1, 1 },
+	{ SDB_HOST, "'v2' = attribute['k1']",                1, 1 },
+	{ SDB_HOST, "attribute['k2'] = 123",                 1, 1 },
+	{ SDB_HOST, "attribute['k2'] = '123'",               1, 1 },
+	{ SDB_HOST, "attribute['k2'] = 124",                 1, 0 },
+	{ SDB_HOST, "attribute['k1'] IN ['v1', 'v2', 'x']",  1, 2 },
+	{ SDB_HOST, "attribute['k1'] IN ['x']",              1, 0 },
+	{ SDB_HOST, "attribute['k3'] IN [1, 2, 3, 4]",       1, 1 },
+	{ SDB_HOST, "attribute['k3'] IN [1, 2]",             1, 0 },
+	{ SDB_HOST, "attribute['k1'] = 'v1' AND name = 'b'", 1, 0 },
+	{ SDB_HOST, "name =~ 'a' AND attribute['k1'] = 'v1'",
+	                                                     1, 1 },
+	{ SDB_HOST, "attribute['k2'] = 123 AND attribute['k1'] = 'v1'",
+	                                                     1, 1 },
+	{ SDB_HOST, "attribute['k4'] = 'v1' AND attribute['k1'] = 'v1'",
+	                                                     1, 1 },
+	{ SDB_HOST, "attribute['k4'] = 'v1'",                0, 1 },
+	{ SDB_HOST, "attribute['k1'] = 'v1' OR name = 'b'",  0, 2 },
+	{ SDB_HOST, "NOT attribute['k1'] = 'v1'",            0, 2 },
+	{ SDB_HOST, "attribute['k1'] != 'v1'",               0, 1 },
+	{ SDB_HOST, "attribute['x'] = 'v1'",                 0, 0 },
+	{ SDB_HOST, "attribute['k2'] = 123.0",               0, 1 },
+	{ SDB_SERVICE, "attribute['k1'] = 'v1'",             1, 1 },
+	{ SDB_SERVICE, "host.attribute['k1'] = 'v1'",        1, 2 },
+	{ SDB_SERVICE, "host.attribute['k1'] = 'v1' AND name = 's2'",
+	                                                     1, 1 },
+	{ SDB_METRIC, "host.attribute['k1'] = 'v2'",         1, 2 },
+	{ SDB_METRIC, "attribute['k1'] = 'v2'",              1, 0 },
+};
+
+START_TEST(test_index)
+{
+	sdb_data_t v1 = { SDB_TYPE_STRING, { .string = "v1" } };
+	int64_t ints[] = { 1, 2, 3 };
+	sdb_data_t array = { SDB_TYPE_ARRAY | SDB_TYPE_INTEGER,
+		{ .array = { SDB_STATIC_ARRAY_LEN(ints), ints } } };
+	sdb_memstore_query_t *q;
+	sdb_ast_node_t *ast;
+	int status = 1, n = 0, expected = 0;
+	size_t i;
+
+	sdb_memstore_service_attr(store, "a", "s1", "k1", &v1, 1, 0);
+	sdb_memstore_attribute(store, "c", "k3", &array, 1, 0);
+	sdb_memstore_attribute(store, "a", "k4", &v1, 1, 0);
+
+	/* index existing attributes; k3 is indexed by later updates and k4 is
+	 * not indexed at all */
+	ck_assert(sdb_memstore_index_attribute(store, "k1") == 0);
+	ck_assert(sdb_memstore_index_attribute(store, "K1") > 0);
+	ck_assert(sdb_memstore_index_attribute(store, "k2") == 0);
+	ck_assert(sdb_memstore_index_attribute(store, "k3") == 0);
+	sdb_memstore_attribute(store, "c", "k3", &array, 2, 0);
+
+	ast = sdb_parser_parse_conditional(index_data[_i].type,
+			index_data[_i].query, -1, NULL);
+	ck_assert(ast != NULL);
+	ast = sdb_ast_lookup_create(index_data[_i].type, ast, NULL);
+	q = sdb_memstore_query_prepare(ast);
+	sdb_object_deref(SDB_OBJ(ast));
+	fail_unless(q != NULL,
+			"sdb_memstore_query_prepare(LOOKUP %s MATCHING %s) = NULL; "
+			"expected: <query>", SDB_STORE_TYPE_TO_NAME(index_data[_i].type),
+			index_data[_i].query);
+
+	for (i = 0; (status > 0) && (i < q->index_num); ++i)
+		status = sdb_memstore_scan_index(store, index_data[_i].type,
+				q->index + i, q->matcher, NULL, scan_cb, NULL, &n);
+	fail_unless((status == 0) == index_data[_i].indexed,
+			"sdb_memstore_scan_index(%s, %s) = %d; expected: %s",
+			SDB_STORE_TYPE_TO_NAME(index_data[_i].type), index_data[_i].query,
+			status, index_data[_i].indexed ? "0" : "> 0");
+
+	/* the index finds the same objects as a full scan */
+	sdb_memstore_scan(store, index_data[_i].type, q->matcher, NULL,
+			scan_cb, &expected);
+	fail_unless(expected == index_data[_i].expected,
+			"sdb_memstore_scan(%s, %s) found %d objects; expected: %d",
+			SDB_STORE_TYPE_TO_NAME(index_data[_i].type), index_data[_i].query,
+			expected, index_data[_i].expected);
+	if (! status)
+		fail_unless(n == expected,
+				"sdb_memstore_scan_index(%s, %s) found %d objects; "
+				"expected: %d", SDB_STORE_TYPE_TO_NAME(index_data[_i].type),
+				index_data[_i].query, n, expected);
+
+	sdb_object_deref(SDB_OBJ(q));
+}
+END_TEST
+
+START_TEST(test_index_update)
+{
+	sdb_data_t v1 = { SDB_TYPE_STRING, { .string = "v1" } };
+	sdb_data_t v3 = { SDB_TYPE_STRING, { .string = "v3" } };
+	sdb_memstore_index_pred_t pred = { SDB_HOST, "k1", &v1, 0 };
+	sdb_memstore_expiry_t expiry = {
+		{ 0.0, 1 }, { 0.0, 0 }, { 0.0, 0 }, { 0.0, 0 },
+	};
+	int status, n;
+
+	ck_assert(sdb_memstore_index_attribute(store, "k1") == 0);
+
+	n = 0;
+	status = sdb_memstore_scan_index(store, SDB_HOST, &pred,
+			NULL, NULL, scan_cb, NULL, &n);
+	fail_unless((status == 0) && (n == 1),
+			"sdb_memstore_scan_index(k1 = v1) = %d, found %d hosts; "
+			"expected: 0, 1", status, n);
+
+	/* updated values replace the old ones */
+	sdb_memstore_attribute(store, "a", "k1", &v3, 2, 0);
+	sdb_memstore_attribute(store, "c", "k1", &v1, 2, 0);
+	n = 0;
+	sdb_memstore_scan_index(store, SDB_HOST, &pred, NULL, NULL,
+			scan_cb, NULL, &n);
+	fail_unless(n == 1, "sdb_memstore_scan_index(k1 = v1) found %d hosts "
+			"after update; expected: 1", n);
+	pred.value = &v3;
+	n = 0;
+	sdb_memstore_scan_index(store, SDB_HOST, &pred, NULL, NULL,
+			scan_cb, NULL, &n);
+	fail_unless(n == 1, "sdb_memstore_scan_index(k1 = v3) found %d hosts "
+			"after update; expected: 1", n);
+
+	/* expired hosts are removed from the index */
+	sdb_memstore_host(store, "c", 10, 0);
+	sdb_memstore_expire(store, &expiry, 10);
+	pred.value = &v1;
+	n = 0;
+	sdb_memstore_scan_index(store, SDB_HOST, &pred, NULL, NULL,
+			scan_cb, NULL, &n);
+	fail_unless(n == 1, "sdb_memstore_scan_index(k1 = v1) found %d hosts "
+			"after expiry; expected: 1", n);
+	pred.value = &v3;
+	n = 0;
+	sdb_memstore_scan_index(store, SDB_HOST, &pred, NULL, NULL,
+			scan_cb, NULL, &n);
+	fail_unless(n == 0, "sdb_memstore_scan_index(k1 = v3) found %d hosts "
+			"after expiry; expected: 0", n);
+
+	/* unindexed keys are reported as such */
+	pred.key = "k2";
+	status = sdb_memstore_scan_index(store, SDB_HOST, &pred,
+			NULL, NULL, scan_cb, NULL, &n);
+	fail_unless(status > 0, "sdb_memstore_scan_index(k2 = v3) = %d; "
+			"expected: > 0", status);
+}
+END_TEST
+
+struct {
+	int type;
+	const char *query;
+	bool indexed;
+	int expected;
+} time_data[] = {
+	{ SDB_HOST, "age < 1m",                               1, 1 },
+	/* the age of objects updated in the future wraps around */
+	{ SDB_HOST, "age > 1m",                               1, 2 },
+	{ SDB_HOST, "60s > age",                              1, 1 },
+	{ SDB_HOST, "last_update > 1s",                       1, 2 },
+	{ SDB_HOST, "last_update <= 1s",                      1, 1 },
+	{ SDB_HOST, "1s < last_update AND age < 1m",          1, 1 },
+	{ SDB_HOST, "last_update > 1s AND last_update < 1s",  1, 0 },
+	{ SDB_HOST, "age < 1m AND name = 'a'",                1, 0 },
+	{ SDB_HOST, "age < 1m OR name = 'a'",                 0, 2 },
+	{ SDB_HOST, "NOT age < 1m",                           0, 2 },
+	{ SDB_HOST, "age != 1m",                              0, 3 },
+	{ SDB_SERVICE, "age < 10m",                           1, 1 },
+	{ SDB_SERVICE, "age < 1m",                            1, 0 },
+	{ SDB_SERVICE, "last_update > 1s AND name = 's2'",    1, 1 },
+	{ SDB_SERVICE, "host.age < 1m",                       1, 2 },
+	{ SDB_SERVICE, "host.age < 1m AND name =~ '3'",       1, 1 },
+	{ SDB_SERVICE, "host.age < 1m AND age < 10m",         1, 0 },
+	{ SDB_METRIC, "age < 1m",                             1, 1 },
+	{ SDB_METRIC, "age > 1m",                             1, 2 },
+	{ SDB_METRIC, "last_update > 1s AND age > 1m",        1, 0 },
+	{ SDB_METRIC, "last_update > 1s AND host.age < 1m",   1, 1 },
+};
+
+START_TEST(test_time)
+{
+	sdb_time_t now = sdb_gettime();
+	sdb_memstore_query_t *q;
+	sdb_ast_node_t *ast;
+	int status, n = 0, expected = 0;
+
+	sdb_memstore_host(store, "b", now - SECS_TO_SDB_TIME(30), 0);
+	sdb_memstore_host(store, "c", now + SECS_TO_SDB_TIME(3600), 0);
+	sdb_memstore_service(store, "a", "s2", now - SECS_TO_SDB_TIME(300), 0);
+	sdb_memstore_metric(store, "b", "m2", NULL,
+			now - SECS_TO_SDB_TIME(30), 0);
+
+	ast = sdb_parser_parse_conditional(time_data[_i].type,
+			time_data[_i].query, -1, NULL);
+	ck_assert(ast != NULL);
+	ast = sdb_ast_lookup_create(time_data[_i].type, ast, NULL);
+	q = sdb_memstore_query_prepare(ast);
+	sdb_object_deref(SDB_OBJ(ast));
+	fail_unless(q != NULL,
+			"sdb_memstore_query_prepare(LOOKUP %s MATCHING %s) = NULL; "
+			"expected: <query>", SDB_STORE_TYPE_TO_NAME(time_data[_i].type),
+			time_data[_i].query);
+
+	status = sdb_memstore_scan_time(store, time_data[_i].type, &q->time,
+			q->matcher, NULL, scan_cb, NULL, &n);
+	fail_unless((status == 0) == time_data[_i].indexed,
+			"sdb_memstore_scan_time(%s, %s) = %d; expected: %s",
+			SDB_STORE_TYPE_TO_NAME(time_data[_i].type), time_data[_i].query,
+			status, time_data[_i].indexed ? "0" : "> 0");
+
+	/* the same objects are found as by a full scan */
+	sdb_memstore_scan(store, time_data[_i].type, q->matcher, NULL,
+			scan_cb, &expected);
+	fail_unless(expected == time_data[_i].expected,
+			"sdb_memstore_scan(%s, %s) found %d objects; expected: %d",
+			SDB_STORE_TYPE_TO_NAME(time_data[_i].type), time_data[_i].query,
+			expected, time_data[_i].expected);
+	if (! status)
+		fail_unless(n == expected,
+				"sdb_memstore_scan_time(%s, %s) found %d objects; "
+				"expected: %d", SDB_STORE_TYPE_TO_NAME(time_data[_i].type),
+				time_data[_i].query, n, expected);
+
+	sdb_object_deref(SDB_OBJ(q));
+}
+END_TEST
+
+static int
+count_index(int type, const char *key, char *value)
+{
+	sdb_data_t v = { SDB_TYPE_STRING, { .string = value } };
+	sdb_memstore_index_pred_t pred = { type, key, &v, 0 };
+	int status, n = 0;
+
+	status = sdb_memstore_scan_index(store, type, &pred,
+			NULL, NULL, scan_cb, NULL, &n);
+	fail_unless(status == 0, "sdb_memstore_scan_index(%s = %s) = %d; "
+			"expected: 0", key, value, status);
+	return n;
+} /* count_index */
+
+START_TEST(test_index_shared_values)
+{
+	char *os[] = { "linux", "bsd", "solaris" };
+	int expected[] = { 400, 300, 300 };
+	char name[16];
+	int i, n;
+
+	ck_assert(sdb_memstore_index_attribute(store, "os") == 0);
+
+	/* many objects sharing few values */
+	for (i = 0; i < 1000; ++i) {
+		sdb_data_t v = { SDB_TYPE_STRING, { .string = NULL } };
+
+		v.data.string = os[i < 400 ? 0 : i < 700 ? 1 : 2];
+		snprintf(name, sizeof(name), "m%04d", i);
+		sdb_memstore_metric(store, i % 2 ? "a" : "b", name, NULL, 1, 0);
+		sdb_memstore_metric_attr(store, i % 2 ? "a" : "b", name,
+				"os", &v, 1, 0);
+	}
+	for (i = 0; i < (int)SDB_STATIC_ARRAY_LEN(os); ++i) {
+		n = count_index(SDB_METRIC, "os", os[i]);
+		fail_unless(n == expected[i], "sdb_memstore_scan_index(os = %s) "
+				"found %d metrics; expected: %d", os[i], n, expected[i]);
+	}
+
+	/* some of them move to another value */
+	for (i = 0; i < 100; ++i) {
+		sdb_data_t v = { SDB_TYPE_STRING, { .string = "bsd" } };
+
+		snprintf(name, sizeof(name), "m%04d", 2 * i);
+		sdb_memstore_metric_attr(store, "b", name, "os", &v, 2, 0);
+	}
+	expected[0] -= 100;
+	expected[1] += 100;
+	for (i = 0; i < (int)SDB_STATIC_ARRAY_LEN(os); ++i) {
+		n = count_index(SDB_METRIC, "os", os[i]);
+		fail_unless(n == expected[i], "sdb_memstore_scan_index(os = %s) "
+				"found %d metrics after update; expected: %d",
+				os[i], n, expected[i]);
+	}
+}
+END_TEST
+
+START_TEST(test_time_update)
+{
+	sdb_memstore_time_pred_t pred = SDB_MEMSTORE_TIME_PRED_INIT;
+	sdb_memstore_expiry_t expiry = {
+		{ 0.0, 1 }, { 0.0, 1 }, { 0.0, 1 }, { 0.0, 0 },
+	};
+	const char *metrics[] = { "m1", "m3", "m4", "m5" };
+	sdb_time_t ts[] = { 40, 10, 30, 20 };
+	int status, n;
+	size_t i;
+
+	/* out-of-order updates are sorted into place */
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(metrics); ++i)
+		sdb_memstore_metric(store, "b", metrics[i], NULL, ts[i], 0);
+
+	pred.type = SDB_METRIC;
+	pred.last_update_min = 15;
+	pred.last_update_max = 35;
+	n = 0;
+	status = sdb_memstore_scan_time(store, SDB_METRIC, &pred,
+			NULL, NULL, scan_cb, NULL, &n);
+	fail_unless((status == 0) && (n == 2),
+			"sdb_memstore_scan_time(15 <= last_update <= 35) = %d, "
+			"found %d metrics; expected: 0, 2", status, n);
+
+	/* updates move objects */
+	sdb_memstore_metric(store, "b", "m4", NULL, 50, 0);
+	n = 0;
+	sdb_memstore_scan_time(store, SDB_METRIC, &pred, NULL, NULL,
+			scan_cb, NULL, &n);
+	fail_unless(n == 1, "sdb_memstore_scan_time(15 <= last_update <= 35) "
+			"found %d metrics after update; expected: 1", n);
+
+	pred.last_update_min = 0;
+	pred.last_update_max = 10;
+	n = 0;
+	sdb_memstore_scan_time(store, SDB_METRIC, &pred, NULL, NULL,
+			scan_cb, NULL, &n);
+	fail_unless(n == 3, "sdb_memstore_scan_time(last_update <= 10) "
+			"found %d metrics; expected: 3", n);
+
+	/* expired objects are removed */
+	sdb_memstore_host(store, "b", 100, 0);
+	sdb_memstore_host(store, "c", 100, 0);
+	sdb_memstore_expire(store, &expiry, 45);
+	n = 0;
+	sdb_memstore_scan_time(store, SDB_METRIC, &pred, NULL, NULL,
+			scan_cb, NULL, &n);
+	fail_unless(n == 0, "sdb_memstore_scan_time(last_update <= 10) "
+			"found %d metrics after expiry; expected: 0", n);
+	pred.last_update_max = 60;
+	n = 0;
+	sdb_memstore_scan_time(store, SDB_METRIC, &pred, NULL, NULL,
+			scan_cb, NULL, &n);
+	fail_unless(n == 1, "sdb_memstore_scan_time(last_update <= 60) "
+			"found %d metrics after expiry; expected: 1", n);
+
+	pred.type = SDB_HOST;
+	pred.last_update_max = 10;
+	n = 0;
+	sdb_memstore_scan_time(store, SDB_HOST, &pred, NULL, NULL,
+			scan_cb, NULL, &n);
+	fail_unless(n == 0, "sdb_memstore_scan_time(host.last_update <= 10) "
+			"found %d hosts after expiry; expected: 0", n);
+}
+END_TEST
+
+/* Check that the list of a host's metrics is ordered by last update and
+ * return its length. */
+static size_t
+check_metrics_by_time(const char *hostname)
+{
+	sdb_memstore_obj_t *host = sdb_memstore_get_host(store, hostname);
+	sdb_memstore_obj_t *obj, *prev = NULL;
+	size_t n = 0;
+
+	ck_assert(host != NULL);
+	for (obj = HOST(host)->metrics_by_time.oldest; obj; obj = obj->newer) {
+		fail_unless(obj->older == prev,
+				"metrics_by_time of %s is not linked correctly", hostname);
+		fail_unless((! prev) || (prev->last_update <= obj->last_update),
+				"metrics_by_time of %s is not ordered: %"PRIsdbTIME
+				" before %"PRIsdbTIME, hostname, prev ? prev->last_update : 0,
+				obj->last_update);
+		prev = obj;
+		++n;
+	}
+	fail_unless(HOST(host)->metrics_by_time.newest == prev,
+			"metrics_by_time of %s does not end at its newest object",
+			hostname);
+	sdb_object_deref(SDB_OBJ(host));
+	return n;
+} /* check_metrics_by_time */
+
+START_TEST(test_time_unordered)
+{
+	sdb_memstore_time_pred_t pred = SDB_MEMSTORE_TIME_PRED_INIT;
+	const sdb_time_t base = 1000000;
+	const int num = 2000;
+	int expected, status, n, i;
+	size_t len;
+
+	/* like loading a snapshot: objects arrive in any order of updates */
+	sdb_memstore_host(store, "many", 1, 0);
+	for (i = 0; i < num; ++i) {
+		char name[32];
+		snprintf(name, sizeof(name), "m%04d", i);
+		sdb_memstore_metric(store, "many", name, NULL,
+				base + 1 + (i * 7919) % num, 0);
+	}
+	len = check_metrics_by_time("many");
+	fail_unless(len == (size_t)num,
+			"metrics_by_time has %zu entries; expected: %d", len, num);
+
+	pred.type = SDB_METRIC;
+	pred.last_update_min = base + 101;
+	pred.last_update_max = base + 200;
+	n = 0;
+	status = sdb_memstore_scan_time(store, SDB_METRIC, &pred,
+			NULL, NULL, scan_cb, NULL, &n);
+	fail_unless((status == 0) && (n == 100),
+			"sdb_memstore_scan_time(%"PRIsdbTIME" <= last_update <= "
+			"%"PRIsdbTIME") = %d, found %d metrics; expected: 0, 100",
+			pred.last_update_min, pred.last_update_max, status, n);
+
+	/* move every other metric, again out of order */
+	expected = 0;
+	for (i = 0; i < num; i += 2) {
+		char name[32];
+		sdb_time_t ts = base + num + 1 + (i * 7919) % num;
+		snprintf(name, sizeof(name), "m%04d", i);
+		sdb_memstore_metric(store, "many", name, NULL, ts, 0);
+		if (ts <= base + num + 300)
+			++expected;
+	}
+	len = check_metrics_by_time("many");
+	fail_unless(len == (size_t)num,
+			"metrics_by_time has %zu entries after updates; expected: %d",
+			len, num);
+
+	pred.last_update_min = base + num + 1;
+	pred.last_update_max = base + num + 300;
+	n = 0;
+	status = sdb_memstore_scan_time(store, SDB_METRIC, &pred,
+			NULL, NULL, scan_cb, NULL, &n);
+	fail_unless((status == 0) && (n == expected),
+			"sdb_memstore_scan_time(%"PRIsdbTIME" <= last_update <= "
+			"%"PRIsdbTIME") = %d, found %d metrics after updates; "
+			"expected: 0, %d", pred.last_update_min, pred.last_update_max,
+			status, n, expected);
+}
+END_TEST
+
+struct {
+	int type;
+	const char *query;
+	const char *plan;
+	int expected;
+} optimize_data[] = {
+	{ SDB_HOST, "attribute['k1'] =~ 'v' AND name = 'a'",
+		"LOOKUP hosts\n  matching: name = 'a' AND attribute['k1'] =~ '/v/'\n"
+		"  host prefix: 'a'", 1 },
+	{ SDB_HOST, "name =~ 'a' OR name = 'b'",
+		"LOOKUP hosts\n  matching: name = 'b' OR name =~ '/a/'", 2 },
+	{ SDB_HOST, "name != 'c' AND attribute['k1'] = 'v1' AND name =~ 'a'",
+		"LOOKUP hosts\n  matching: "
+		"attribute['k1'] = 'v1' AND name =~ '/a/' AND name != 'c'\n"
+		"  index: host.attribute['k1'] = 'v1'", 1 },
+	{ SDB_HOST, "name = 'a' OR (name = 'b' OR name = 'c')",
+		"LOOKUP hosts\n  matching: name = 'a' OR name = 'b' OR name = 'c'",
+		3 },
+	{ SDB_HOST, "NOT NOT name = 'a'",
+		"LOOKUP hosts\n  matching: name = 'a'\n  host prefix: 'a'", 1 },
+	{ SDB_HOST, "NOT NOT NOT name = 'a'",
+		"LOOKUP hosts\n  matching: NOT name = 'a'", 2 },
+	{ SDB_HOST, "1 = 1 AND name = 'a'",
+		"LOOKUP hosts\n  matching: name = 'a'\n  host prefix: 'a'", 1 },
+	{ SDB_HOST, "name = 'a' AND 1 = 2",
+		"LOOKUP hosts\n  matching: 1 = 2", 0 },
+	{ SDB_HOST, "1 = 2 OR name = 'a'",
+		"LOOKUP hosts\n  matching: name = 'a'\n  host prefix: 'a'", 1 },
+	{ SDB_HOST, "NOT 1 = 1 OR name = 'a'",
+		"LOOKUP hosts\n  matching: name = 'a'\n  host prefix: 'a'", 1 },
+	{ SDB_HOST, "name = 'a' OR NOT 1 = 2",
+		"LOOKUP hosts\n  matching: NOT 1 = 2", 3 },
+	{ SDB_HOST, "1 = 1 AND 2 = 2",
+		"LOOKUP hosts\n  matching: 2 = 2", 3 },
+	{ SDB_SERVICE, "attribute['k1'] = 'v1' AND host.name = 'a'",
+		"LOOKUP services\n  matching: "
+		"host.name = 'a' AND attribute['k1'] = 'v1'\n"
+		"  index: service.attribute['k1'] = 'v1'\n"
+		"  host prefix: 'a'", 0 },
+	{ SDB_METRIC, "age > 1m AND name =~ '^m'",
+		"LOOKUP metrics\n  matching: "
+		"age > '1970-01-01 00:01:00 +0000' AND name =~ '/^m/'\n"
+		"  time: metric.age >= 1m.000000001s\n"
+		"  metric prefix: 'm'", 3 },
+};
+
+START_TEST(test_optimize)
+{
+	sdb_strbuf_t *buf = sdb_strbuf_create(64);
+	sdb_memstore_matcher_t *m;
+	sdb_memstore_query_t *q;
+	sdb_ast_node_t *ast;
+	int status, n = 0, expected = 0;
+
+	ast = sdb_parser_parse_conditional(optimize_data[_i].type,
+			optimize_data[_i].query, -1, NULL);
+	ck_assert(ast != NULL);
+	m = sdb_memstore_query_prepare_matcher(ast);
+	ck_assert(m != NULL);
+	ast = sdb_ast_lookup_create(optimize_data[_i].type, ast, NULL);
+	q = sdb_memstore_query_prepare(ast);
+	sdb_object_deref(SDB_OBJ(ast));
+	fail_unless(q != NULL,
+			"sdb_memstore_query_prepare(LOOKUP %s MATCHING %s) = NULL; "
+			"expected: <query>", SDB_STORE_TYPE_TO_NAME(optimize_data[_i].type),
+			optimize_data[_i].query);
+
+	status = sdb_memstore_query_explain(q, buf);
+	fail_unless((status == 0)
+			&& (! strcmp(sdb_strbuf_string(buf), optimize_data[_i].plan)),
+			"sdb_memstore_query_explain(%s) = %d, '%s'; expected: 0, '%s'",
+			optimize_data[_i].query, status, sdb_strbuf_string(buf),
+			optimize_data[_i].plan);
+
+	/* the optimized matcher finds the same objects */
+	sdb_memstore_scan(store, optimize_data[_i].type, q->matcher, NULL,
+			scan_cb, &n);
+	sdb_memstore_scan(store, optimize_data[_i].type, m, NULL,
+			scan_cb, &expected);
+	fail_unless((n == expected) && (n == optimize_data[_i].expected),
+			"sdb_memstore_scan(%s) found %d objects (%d without "
+			"optimizations); expected: %d", optimize_data[_i].query,
+			n, expected, optimize_data[_i].expected);
+
+	sdb_object_deref(SDB_OBJ(m));
+	sdb_object_deref(SDB_OBJ(q));
+	sdb_strbuf_destroy(buf);
+}
+END_TEST
+
+static int
+scan_after_cb(sdb_memstore_obj_t *obj,
+		sdb_memstore_matcher_t __attribute__((unused)) *filter,
+		void *user_data)
+{
+	sdb_strbuf_t *buf = user_data;
+	if (obj->parent)
+		sdb_strbuf_append(buf, "%s/", SDB_OBJ(obj->parent)->name);
+	sdb_strbuf_append(buf, "%s ", SDB_OBJ(obj)->name);
+	return 0;
+} /* scan_after_cb */
+
+struct {
+	int type;
+	const char *hostname;
+	const char *name;
+	const char *matcher;
+	const char *expected;
+} scan_after_data[] = {
+	{ SDB_HOST, NULL, NULL, NULL, "a b c " },
+	{ SDB_HOST, "a", NULL, NULL, "b c " },
+	{ SDB_HOST, "B", NULL, NULL, "c " },
+	{ SDB_HOST, "aa", NULL, NULL, "b c " },
+	{ SDB_HOST, "c", NULL, NULL, "" },
+	{ SDB_HOST, "a", NULL, "name =~ '^b'", "b " },
+	{ SDB_HOST, "b", NULL, "name =~ '^b'", "" },
+	{ SDB_SERVICE, "a", "s1", NULL, "a/s2 b/s1 b/s3 " },
+	{ SDB_SERVICE, "a", "s2", NULL, "b/s1 b/s3 " },
+	{ SDB_SERVICE, "a", NULL, NULL, "b/s1 b/s3 " },
+	{ SDB_SERVICE, "b", "s2", NULL, "b/s3 " },
+	{ SDB_SERVICE, "0", "x", NULL, "a/s1 a/s2 b/s1 b/s3 " },
+	{ SDB_SERVICE, "b", "s1", "name =~ '^s'", "b/s3 " },
+	{ SDB_SERVICE, "a", "s1", "host.name = 'b'", "b/s1 b/s3 " },
+	{ SDB_METRIC, "a", "m1", NULL, "b/m1 b/m2 " },
+	{ SDB_METRIC, "a", "m1", "name =~ '^m2'", "b/m2 " },
+	{ SDB_METRIC, "b", "m2", NULL, "" },
+};
+
+START_TEST(test_scan_after)
+{
+	sdb_strbuf_t *buf = sdb_strbuf_create(64);
+	sdb_memstore_matcher_t *m = NULL;
+	int status;
+
+	if (scan_after_data[_i].matcher) {
+		sdb_ast_node_t *ast;
+		ast = sdb_parser_parse_conditional(scan_after_data[_i].type,
+				scan_after_data[_i].matcher, -1, NULL);
+		ck_assert(ast != NULL);
+		m = sdb_memstore_query_prepare_matcher(ast);
+		sdb_object_deref(SDB_OBJ(ast));
+		ck_assert(m != NULL);
+	}
+
+	status = sdb_memstore_scan_after(store, scan_after_data[_i].type,
+			scan_after_data[_i].hostname, scan_after_data[_i].name,
+			m, NULL, scan_after_cb, buf);
+	fail_unless((status == 0)
+			&& (! strcmp(sdb_strbuf_string(buf), scan_after_data[_i].expected)),
+			"sdb_memstore_scan_after(%s, %s, %s, %s) = %d, found '%s'; "
+			"expected: 0, '%s'",
+			SDB_STORE_TYPE_TO_NAME(scan_after_data[_i].type),
+			scan_after_data[_i].hostname, scan_after_data[_i].name,
+			scan_after_data[_i].matcher, status, sdb_strbuf_string(buf),
+			scan_after_data[_i].expected);
+
+	sdb_object_deref(SDB_OBJ(m));
+	sdb_strbuf_destroy(buf);
+}
+END_TEST
+
+static sdb_strbuf_t *emitted = NULL;
+
+static int
+emit_host(sdb_store_host_t *host, sdb_object_t __attribute__((unused)) *ud)
+{
+	sdb_strbuf_append(emitted, "%s ", host->name);
+	return 0;
+} /* emit_host */
+
+static int
+emit_attr(sdb_store_attribute_t __attribute__((unused)) *attr,
+		sdb_object_t __attribute__((unused)) *ud)
+{
+	return 0;
+} /* emit_attr */
+
+static int
+emit_count(const sdb_data_t *value, int64_t count,
+		sdb_object_t __attribute__((unused)) *ud)
+{
+	if (value) {
+		char buf[sdb_data_strlen(value) + 1];
+		sdb_data_format(value, buf, sizeof(buf), SDB_UNQUOTED);
+		sdb_strbuf_append(emitted, "%s=", buf);
+	}
+	sdb_strbuf_append(emitted, "%"PRId64" ", count);
+	return 0;
+} /* emit_count */
+
+static sdb_store_writer_t emit_writer = {
+	emit_host, NULL, NULL, emit_attr, NULL, emit_count, NULL,
+};
+
+struct {
+	const char *query;
+	const char *plan;
+	int expected[5]; /* 'o' attribute values; -1 if unused */
+} bounds_data[] = {
+	{ "LIST hosts FILTER name =~ '^o' LIMIT 3",
+		"LIST hosts\n  filter: name =~ '/^o/'\n  limit: 3",
+		{ 0, 7, 14, -1, -1 } },
+	{ "LIST hosts FILTER name =~ '^o' LIMIT 3 OFFSET 48",
+		"LIST hosts\n  filter: name =~ '/^o/'\n  limit: 3\n  offset: 48",
+		{ 36, 43, -1, -1, -1 } },
+	{ "LOOKUP hosts MATCHING name =~ '^o' ORDER BY attribute['o'] DESC "
+			"LIMIT 5 OFFSET 3",
+		"LOOKUP hosts\n  matching: name =~ '/^o/'\n  host prefix: 'o'\n"
+		"  order by: attribute['o'] DESC\n  limit: 5\n  offset: 3",
+		{ 46, 45, 44, 43, 42 } },
+	{ "LOOKUP hosts MATCHING name =~ '^o' ORDER BY attribute['o'] "
+			"OFFSET 47",
+		"LOOKUP hosts\n  matching: name =~ '/^o/'\n  host prefix: 'o'\n"
+		"  order by: attribute['o']\n  offset: 47",
+		{ 47, 48, 49, -1, -1 } },
+	{ "LOOKUP hosts MATCHING name =~ '^o' ORDER BY attribute['o'] LIMIT 0",
+		"LOOKUP hosts\n  matching: name =~ '/^o/'\n  host prefix: 'o'\n"
+		"  order by: attribute['o']\n  limit: 0",
+		{ -1, -1, -1, -1, -1 } },
+	{ "LIST hosts FILTER name =~ '^o' AFTER 'o47'",
+		"LIST hosts\n  filter: name =~ '/^o/'\n  after: 'o47'",
+		{ 36, 43, -1, -1, -1 } },
+	{ "LOOKUP hosts MATCHING name =~ '^o' AFTER 'o01' LIMIT 2",
+		"LOOKUP hosts\n  matching: name =~ '/^o/'\n  host prefix: 'o'\n"
+		"  after: 'o01'\n  limit: 2",
+		{ 14, 21, -1, -1, -1 } },
+	{ "LOOKUP hosts MATCHING name =~ '^o' SELECT attribute['o'], name "
+			"ORDER BY attribute['o'] LIMIT 2",
+		"LOOKUP hosts\n  matching: name =~ '/^o/'\n  host prefix: 'o'\n"
+		"  select: attribute['o'], name\n"
+		"  order by: attribute['o']\n  limit: 2",
+		{ 0, 1, -1, -1, -1 } },
+	/* index scans skip objects up to the key */
+	{ "LOOKUP hosts MATCHING attribute['o'] IN [0, 14, 28] AFTER 'o00'",
+		"LOOKUP hosts\n  matching: attribute['o'] IN [0, 14, 28]\n"
+		"  index: host.attribute['o'] IN [0, 14, 28]\n  after: 'o00'",
+		{ 14, 28, -1, -1, -1 } },
+};
+
+START_TEST(test_bounds)
+{
+	sdb_strbuf_t *buf = sdb_strbuf_create(64);
+	char expected[64] = "";
+	sdb_memstore_query_t *q;
+	sdb_llist_t *ast;
+	int status, i;
+
+	/* the attribute values are a permutation of the host names */
+	ck_assert(sdb_memstore_index_attribute(store, "o") == 0);
+	for (i = 0; i < 50; ++i) {
+		char name[8];
+		sdb_data_t v = { SDB_TYPE_INTEGER, { .integer = (i * 7) % 50 } };
+		snprintf(name, sizeof(name), "o%02d", i);
+		sdb_memstore_host(store, name, 1, 0);
+		sdb_memstore_attribute(store, name, "o", &v, 1, 0);
+	}
+	for (i = 0; i < 5; ++i) {
+		int64_t v = bounds_data[_i].expected[i];
+		int j;
+		if (v < 0)
+			break;
+		/* 7 * 43 = 1 (mod 50) */
+		j = (int)((v * 43) % 50);
+		snprintf(expected + strlen(expected), sizeof(expected) - strlen(expected),
+				"o%02d ", j);
+	}
+
+	ast = sdb_parser_parse(bounds_data[_i].query, -1, NULL);
+	fail_unless(sdb_llist_len(ast) == 1,
+			"sdb_parser_parse(%s) returned %zu statements; expected: 1",
+			bounds_data[_i].query, sdb_llist_len(ast));
+	q = sdb_memstore_query_prepare(SDB_AST_NODE(sdb_llist_get(ast, 0)));
+	sdb_object_deref(sdb_llist_get(ast, 0));
+	sdb_llist_destroy(ast);
+	ck_assert(q != NULL);
+
+	status = sdb_memstore_query_explain(q, buf);
+	fail_unless((status == 0)
+			&& (! strcmp(sdb_strbuf_string(buf), bounds_data[_i].plan)),
+			"sdb_memstore_query_explain(%s) = %d, '%s'; expected: 0, '%s'",
+			bounds_data[_i].query, status, sdb_strbuf_string(buf),
+			bounds_data[_i].plan);
+
+	emitted = sdb_strbuf_create(64);
+	status = sdb_memstore_query_execute(store, q, &emit_writer, NULL, buf);
+	fail_unless((status >= 0)
+			&& (! strcmp(sdb_strbuf_string(emitted), expected)),
+			"sdb_memstore_query_execute(%s) = %d, emitted '%s'; "
+			"expected: <data>, '%s'", bounds_data[_i].query, status,
+			sdb_strbuf_string(emitted), expected);
+
+	sdb_strbuf_destroy(emitted);
+	emitted = NULL;
+	sdb_object_deref(SDB_OBJ(q));
+	sdb_strbuf_destroy(buf);
+}
+END_TEST
+
+struct {
+	const char *query;
+	const char *plan;
+	const char *expected;
+} count_data[] = {
+	{ "COUNT hosts",
+		"COUNT hosts", "3 " },
+	{ "COUNT services MATCHING host.name = 'a'",
+		"COUNT services\n  matching: host.name = 'a'\n  host prefix: 'a'",
+		"2 " },
+	{ "COUNT hosts MATCHING name = 'x'",
+		"COUNT hosts\n  matching: name = 'x'\n  host prefix: 'x'", "0 " },
+	{ "COUNT services GROUP BY name",
+		"COUNT services\n  group by: name", "s1=2 s2=1 s3=1 " },
+	{ "COUNT hosts GROUP BY attribute['k1']",
+		"COUNT hosts\n  group by: attribute['k1']", "NULL=1 v1=1 v2=1 " },
+	{ "COUNT services GROUP BY host.attribute['k2']",
+		"COUNT services\n  group by: host.attribute['k2']",
+		"NULL=2 123=2 " },
+	/* arrays are grouped by each of their elements; strings compare
+	 * case-insensitively */
+	{ "COUNT hosts GROUP BY attribute['arr']",
+		"COUNT hosts\n  group by: attribute['arr']", "NULL=1 x=2 y=1 " },
+	{ "COUNT hosts MATCHING attribute['k1'] = 'v1' FILTER age >= 0s "
+			"GROUP BY attribute['arr']",
+		"COUNT hosts\n  matching: attribute['k1'] = 'v1'\n"
+		"  filter: age >= '1970-01-01 00:00:00 +0000'\n"
+		"  index: host.attribute['k1'] = 'v1'\n"
+		"  group by: attribute['arr']",
+		"x=1 y=1 " },
+	{ "COUNT hosts MATCHING attribute['k1'] = 'v1' GROUP BY name",
+		"COUNT hosts\n  matching: attribute['k1'] = 'v1'\n"
+		"  index: host.attribute['k1'] = 'v1'\n  group by: name",
+		"a=1 " },
+};
+
+static sdb_memstore_query_t *
+prepare(const char *query)
+{
+	sdb_memstore_query_t *q;
+	sdb_llist_t *ast;
+
+	ast = sdb_parser_parse(query, -1, NULL);
+	fail_unless(sdb_llist_len(ast) == 1,
+			"sdb_parser_parse(%s) returned %zu statements; expected: 1",
+			query, sdb_llist_len(ast));
+	q = sdb_memstore_query_prepare(SDB_AST_NODE(sdb_llist_get(ast, 0)));
+	sdb_object_deref(sdb_llist_get(ast, 0));
+	sdb_llist_destroy(ast);
+	ck_assert(q != NULL);
+	return q;
+} /* prepare */
+
+START_TEST(test_count)
+{
+	sdb_strbuf_t *buf = sdb_strbuf_create(64);
+	char *arr1[] = { "x", "y" }, *arr2[] = { "X" };
+	sdb_data_t v1 = { SDB_TYPE_ARRAY | SDB_TYPE_STRING,
+		{ .array = { 2, arr1 } } };
+	sdb_data_t v2 = { SDB_TYPE_ARRAY | SDB_TYPE_STRING,
+		{ .array = { 1, arr2 } } };
+	sdb_memstore_query_t *q;
+	int status;
+
+	ck_assert(sdb_memstore_index_attribute(store, "k1") == 0);
+	sdb_memstore_attribute(store, "a", "arr", &v1, 1, 0);
+	sdb_memstore_attribute(store, "b", "arr", &v2, 1, 0);
+
+	q = prepare(count_data[_i].query);
+	status = sdb_memstore_query_explain(q, buf);
+	fail_unless((status == 0)
+			&& (! strcmp(sdb_strbuf_string(buf), count_data[_i].plan)),
+			"sdb_memstore_query_explain(%s) = %d, '%s'; expected: 0, '%s'",
+			count_data[_i].query, status, sdb_strbuf_string(buf),
+			count_data[_i].plan);
+
+	emitted = sdb_strbuf_create(64);
+	status = sdb_memstore_query_execute(store, q, &emit_writer, NULL, buf);
+	fail_unless((status >= 0)
+			&& (! strcmp(sdb_strbuf_string(emitted), count_data[_i].expected)),
+			"sdb_memstore_query_execute(%s) = %d, emitted '%s'; "
+			"expected: <data>, '%s'", count_data[_i].query, status,
+			sdb_strbuf_string(emitted), count_data[_i].expected);
+
+	sdb_strbuf_destroy(emitted);
+	emitted = NULL;
+	sdb_object_deref(SDB_OBJ(q));
+	sdb_strbuf_destroy(buf);
+}
+END_TEST
+
+START_TEST(test_count_groups)
+{
+	sdb_strbuf_t *buf = sdb_strbuf_create(64);
+	char expected[1024] = "";
+	sdb_memstore_query_t *q;
+	int status, i;
+
+	/* enough groups to grow the hash table */
+	for (i = 0; i < 100; ++i) {
+		char name[8];
+		sdb_data_t v = { SDB_TYPE_INTEGER, { .integer = i % 70 } };
+		snprintf(name, sizeof(name), "o%02d", i);
+		sdb_memstore_host(store, name, 1, 0);
+		sdb_memstore_attribute(store, name, "o", &v, 1, 0);
+	}
+	for (i = 0; i < 70; ++i)
+		snprintf(expected + strlen(expected), sizeof(expected) - strlen(expected),
+				"%d=%d ", i, i < 30 ? 2 : 1);
+
+	q = prepare("COUNT hosts MATCHING name =~ '^o' GROUP BY attribute['o']");
+	emitted = sdb_strbuf_create(64);
+	status = sdb_memstore_query_execute(store, q, &emit_writer, NULL, buf);
+	fail_unless((status >= 0)
+			&& (! strcmp(sdb_strbuf_string(emitted), expected)),
+			"sdb_memstore_query_execute(COUNT ... GROUP BY attribute['o']) "
+			"= %d, emitted '%s'; expected: <data>, '%s'", status,
+			sdb_strbuf_string(emitted), expected);
+
+	sdb_strbuf_destroy(emitted);
+	emitted = NULL;
+	sdb_object_deref(SDB_OBJ(q));
+	sdb_strbuf_destroy(buf);
+}
+END_TEST
+
 TEST_MAIN("core::store_lookup")
 {
 	TCase *tc = tcase_create("core");
@@ -680,7 +1694,20 @@ TEST_MAIN("core::store_lookup")
 	TC_ADD_LOOP_TEST(tc, cmp_attr);
 	TC_ADD_LOOP_TEST(tc, cmp_obj);
 	TC_ADD_LOOP_TEST(tc, scan);
+	TC_ADD_LOOP_TEST(tc, scan_after);
+	TC_ADD_LOOP_TEST(tc, prefix);
+	TC_ADD_LOOP_TEST(tc, index);
+	TC_ADD_LOOP_TEST(tc, time);
+	TC_ADD_LOOP_TEST(tc, optimize);
+	TC_ADD_LOOP_TEST(tc, bounds);
+	TC_ADD_LOOP_TEST(tc, count);
 	tcase_add_test(tc, test_store_match_op);
+	tcase_add_test(tc, test_visibility);
+	tcase_add_test(tc, test_index_update);
+	tcase_add_test(tc, test_index_shared_values);
+	tcase_add_test(tc, test_time_update);
+	tcase_add_test(tc, test_time_unordered);
+	tcase_add_test(tc, test_count_groups);
 	ADD_TCASE(tc);
 }
 TEST_MAIN_END
@@ -35,8 +35,11 @@
 #include "testutils.h"
 
 #include <check.h>
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 static sdb_memstore_t *store;
 
@@ -652,17 +655,16 @@ START_TEST(test_get_child)
 }
 END_TEST
 
-/* TODO: move these tests into generic store tests */
-#if 0
 START_TEST(test_interval)
 {
 	sdb_memstore_obj_t *host;
+	int check;
 
 	/* 10 us interval */
-	sdb_memstore_host(store, "host", 10);
-	sdb_memstore_host(store, "host", 20);
-	sdb_memstore_host(store, "host", 30);
-	sdb_memstore_host(store, "host", 40);
+	sdb_memstore_host(store, "host", 10, 0);
+	sdb_memstore_host(store, "host", 20, 0);
+	sdb_memstore_host(store, "host", 30, 0);
+	sdb_memstore_host(store, "host", 40, 0);
 
 	host = sdb_memstore_get_host(store, "host");
 	fail_unless(host != NULL,
@@ -673,10 +675,13 @@ START_TEST(test_interval)
 			"got: %"PRIsdbTIME"; expected: %"PRIsdbTIME, host->interval, 10);
 
 	/* multiple updates for the same timestamp don't modify the interval */
-	sdb_memstore_host(store, "host", 40);
-	sdb_memstore_host(store, "host", 40);
-	sdb_memstore_host(store, "host", 40);
-	sdb_memstore_host(store, "host", 40);
+	check = sdb_memstore_host(store, "host", 40, 0);
+	fail_unless(check > 0,
+			"sdb_memstore_host() = %d when using the same timestamp; "
+			"expected: >0", check);
+	sdb_memstore_host(store, "host", 40, 0);
+	sdb_memstore_host(store, "host", 40, 0);
+	sdb_memstore_host(store, "host", 40, 0);
 
 	fail_unless(host->interval == 10,
 			"sdb_memstore_host() changed interval when doing multiple updates "
@@ -684,10 +689,13 @@ START_TEST(test_interval)
 			"expected: %"PRIsdbTIME, host->interval, 10);
 
 	/* multiple updates using an timestamp don't modify the interval */
-	sdb_memstore_host(store, "host", 20);
-	sdb_memstore_host(store, "host", 20);
-	sdb_memstore_host(store, "host", 20);
-	sdb_memstore_host(store, "host", 20);
+	check = sdb_memstore_host(store, "host", 20, 0);
+	fail_unless(check > 0,
+			"sdb_memstore_host() = %d when using an old timestamp; "
+			"expected: >0", check);
+	sdb_memstore_host(store, "host", 20, 0);
+	sdb_memstore_host(store, "host", 20, 0);
+	sdb_memstore_host(store, "host", 20, 0);
 
 	fail_unless(host->interval == 10,
 			"sdb_memstore_host() changed interval when doing multiple updates "
@@ -695,13 +703,13 @@ START_TEST(test_interval)
 			host->interval, 10);
 
 	/* new interval: 20 us */
-	sdb_memstore_host(store, "host", 60);
+	sdb_memstore_host(store, "host", 60, 0);
 	fail_unless(host->interval == 11,
 			"sdb_memstore_host() did not calculate interval correctly: "
 			"got: %"PRIsdbTIME"; expected: %"PRIsdbTIME, host->interval, 11);
 
 	/* new interval: 40 us */
-	sdb_memstore_host(store, "host", 100);
+	sdb_memstore_host(store, "host", 100, 0);
 	fail_unless(host->interval == 13,
 			"sdb_memstore_host() did not calculate interval correctly: "
 			"got: %"PRIsdbTIME"; expected: %"PRIsdbTIME, host->interval, 11);
@@ -709,7 +717,147 @@ START_TEST(test_interval)
 	sdb_object_deref(SDB_OBJ(host));
 }
 END_TEST
-#endif
+
+START_TEST(test_backends)
+{
+	const char *b1[] = { "backend::test::one" };
+	const char *b2[] = { "BACKEND::Test::One", "backend::test::two" };
+	sdb_store_host_t host = { "host", 1, 0, b1, 1 };
+	sdb_memstore_obj_t *obj;
+	sdb_data_t value = SDB_DATA_INIT;
+	char buf[128];
+	int check;
+
+	check = sdb_memstore_writer.store_host(&host, SDB_OBJ(store));
+	fail_unless(check == 0,
+			"store_host(host, backends=%s) = %d; expected: 0", b1[0], check);
+
+	/* backends are matched case-insensitively */
+	host.last_update = 2;
+	host.backends = b2;
+	host.backends_num = 2;
+	check = sdb_memstore_writer.store_host(&host, SDB_OBJ(store));
+	fail_unless(check == 0,
+			"store_host(host, backends=%s,%s) = %d; expected: 0",
+			b2[0], b2[1], check);
+
+	obj = sdb_memstore_get_host(store, "host");
+	fail_unless(obj != NULL,
+			"INTERNAL ERROR: store doesn't have host after adding it");
+	check = sdb_memstore_get_field(obj, SDB_FIELD_BACKEND, &value);
+	fail_unless(check == 0,
+			"sdb_memstore_get_field(host, backend) = %d; expected: 0", check);
+	sdb_data_format(&value, buf, sizeof(buf), 0);
+	fail_unless(! strcmp(buf, "[backend::test::one, backend::test::two]"),
+			"sdb_memstore_get_field(host, backend) returned %s; "
+			"expected: [backend::test::one, backend::test::two]", buf);
+
+	sdb_data_free_datum(&value);
+	sdb_object_deref(SDB_OBJ(obj));
+}
+END_TEST
+
+START_TEST(test_store_batch)
+{
+	sdb_store_batch_entry_t entries[9];
+	sdb_metric_store_t ms = { "dummy-type", "dummy-id", NULL, 1 };
+	sdb_data_t value = { SDB_TYPE_INTEGER, { .integer = 42 } };
+
+	struct {
+		const char *host;
+		int type;
+		const char *name;
+	} expected[] = {
+		{ "h1", SDB_METRIC, "m1" },
+		{ "h1", SDB_METRIC, "m2" },
+		{ "h1", SDB_SERVICE, "s1" },
+		{ "h1", SDB_ATTRIBUTE, "k1" },
+		{ "h2", SDB_METRIC, "m1" },
+	};
+
+	size_t i;
+	int check;
+
+	memset(entries, 0, sizeof(entries));
+	entries[0].type = SDB_HOST;
+	entries[0].obj.host.name = "h1";
+	entries[1].type = SDB_METRIC;
+	entries[1].obj.metric.hostname = "h1";
+	entries[1].obj.metric.name = "m1";
+	entries[1].obj.metric.stores = &ms;
+	entries[1].obj.metric.stores_num = 1;
+	entries[2].type = SDB_SERVICE;
+	entries[2].obj.service.hostname = "H1";
+	entries[2].obj.service.name = "s1";
+	entries[3].type = SDB_HOST;
+	entries[3].obj.host.name = "h2";
+	entries[4].type = SDB_METRIC;
+	entries[4].obj.metric.hostname = "h2";
+	entries[4].obj.metric.name = "m1";
+	/* switch back to a previous host */
+	entries[5].type = SDB_METRIC;
+	entries[5].obj.metric.hostname = "h1";
+	entries[5].obj.metric.name = "m2";
+	entries[6].type = SDB_ATTRIBUTE;
+	entries[6].obj.attribute.parent_type = SDB_HOST;
+	entries[6].obj.attribute.parent = "h1";
+	entries[6].obj.attribute.key = "k1";
+	entries[6].obj.attribute.value = value;
+	/* unknown host */
+	entries[7].type = SDB_METRIC;
+	entries[7].obj.metric.hostname = "x";
+	entries[7].obj.metric.name = "m1";
+	/* update of a previous entry in the same batch */
+	entries[8].type = SDB_HOST;
+	entries[8].obj.host.name = "h1";
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(entries); ++i) {
+		if (entries[i].type == SDB_HOST)
+			entries[i].obj.host.last_update = i == 8 ? 2 : 1;
+		else if (entries[i].type == SDB_SERVICE)
+			entries[i].obj.service.last_update = 1;
+		else if (entries[i].type == SDB_METRIC)
+			entries[i].obj.metric.last_update = 1;
+		else
+			entries[i].obj.attribute.last_update = 1;
+	}
+
+	check = sdb_memstore_writer.store_batch(entries,
+			SDB_STATIC_ARRAY_LEN(entries), SDB_OBJ(store));
+	fail_unless(check < 0,
+			"store_batch(<entries including unknown host>) = %d; "
+			"expected: <0", check);
+
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(expected); ++i) {
+		sdb_memstore_obj_t *host, *obj;
+
+		host = sdb_memstore_get_host(store, expected[i].host);
+		fail_unless(host != NULL,
+				"store_batch() did not store host '%s'", expected[i].host);
+		obj = sdb_memstore_get_child(host, expected[i].type, expected[i].name);
+		fail_unless(obj != NULL,
+				"store_batch() did not store %s '%s/%s'",
+				SDB_STORE_TYPE_TO_NAME(expected[i].type),
+				expected[i].host, expected[i].name);
+		sdb_object_deref(SDB_OBJ(obj));
+
+		if (! strcmp(expected[i].host, "h1"))
+			fail_unless(host->last_update == 2,
+					"store_batch() did not apply the latest host update; "
+					"got last_update = %"PRIsdbTIME"; expected: 2",
+					host->last_update);
+		sdb_object_deref(SDB_OBJ(host));
+	}
+
+	/* storing the same (valid) objects again yields stale updates */
+	check = sdb_memstore_writer.store_batch(entries, 7, SDB_OBJ(store));
+	fail_unless(check > 0,
+			"store_batch(<old entries>) = %d; expected: >0", check);
+
+	check = sdb_memstore_writer.store_batch(NULL, 0, SDB_OBJ(store));
+	fail_unless(check == 0,
+			"store_batch(<empty>) = %d; expected: 0", check);
+}
+END_TEST
 
 static int
 scan_count(sdb_memstore_obj_t *obj, sdb_memstore_matcher_t *filter, void *user_data)
@@ -802,6 +950,430 @@ START_TEST(test_scan)
 }
 END_TEST
 
+static int
+scan_tojson_full(sdb_memstore_obj_t *obj, sdb_memstore_matcher_t *filter,
+		void *user_data)
+{
+	return sdb_memstore_emit_full(obj, filter, &sdb_store_json_writer, user_data);
+} /* scan_tojson_full */
+
+static void
+store_tojson(sdb_memstore_t *st, sdb_strbuf_t *buf)
+{
+	sdb_store_json_formatter_t *f;
+	int check;
+
+	sdb_strbuf_clear(buf);
+	f = sdb_store_json_formatter(buf, SDB_HOST, SDB_WANT_ARRAY);
+	ck_assert(f != NULL);
+	check = sdb_memstore_scan(st, SDB_HOST, /* m, filter = */ NULL, NULL,
+			scan_tojson_full, f);
+	fail_unless(check == 0,
+			"sdb_memstore_scan(HOST, tojson) = %d; expected: 0", check);
+	sdb_store_json_finish(f);
+	sdb_object_deref(SDB_OBJ(f));
+} /* store_tojson */
+
+START_TEST(test_snapshot)
+{
+	const char *backends[] = { "backend::test::one", "backend::test::two" };
+	sdb_store_service_t svc = { "h2", "s3", 4, 0, backends, 2 };
+	sdb_metric_store_t ms = { "dummy-type", "dummy-id", NULL, 3 };
+	char filename[] = "store_test_snapshot.XXXXXX";
+	sdb_memstore_t *restored;
+	sdb_strbuf_t *expected, *got;
+	int fd, check;
+
+	populate();
+	sdb_memstore_metric(store, "h2", "m2", &ms, 3, 0);
+	check = sdb_memstore_writer.store_service(&svc, SDB_OBJ(store));
+	fail_unless(check == 0,
+			"INTERNAL ERROR: store_service(h2, s3) = %d; expected: 0", check);
+
+	fd = mkstemp(filename);
+	fail_unless(fd >= 0, "INTERNAL ERROR: mkstemp() = %d", fd);
+	close(fd);
+
+	check = sdb_memstore_dump(store, filename);
+	fail_unless(check == 0,
+			"sdb_memstore_dump(<store>, %s) = %d; expected: 0",
+			filename, check);
+
+	restored = sdb_memstore_create();
+	ck_assert(restored != NULL);
+	check = sdb_memstore_restore(restored, filename);
+	fail_unless(check == 0,
+			"sdb_memstore_restore(<empty store>, %s) = %d; expected: 0",
+			filename, check);
+
+	expected = sdb_strbuf_create(0);
+	got = sdb_strbuf_create(0);
+	store_tojson(store, expected);
+	store_tojson(restored, got);
+	sdb_diff_strings("Restoring a snapshot returned unexpected result",
+			sdb_strbuf_string(got), sdb_strbuf_string(expected));
+
+	/* all objects are up to date already */
+	check = sdb_memstore_restore(restored, filename);
+	fail_unless(check > 0,
+			"sdb_memstore_restore(<restored store>, %s) = %d; "
+			"expected: >0 (all objects stale)", filename, check);
+	sdb_object_deref(SDB_OBJ(restored));
+
+	/* a truncated snapshot is rejected */
+	check = truncate(filename, 100);
+	fail_unless(check == 0, "INTERNAL ERROR: truncate(%s) = %d", filename, check);
+	restored = sdb_memstore_create();
+	ck_assert(restored != NULL);
+	check = sdb_memstore_restore(restored, filename);
+	fail_unless(check < 0,
+			"sdb_memstore_restore(<store>, <truncated file>) = %d; "
+			"expected: <0", check);
+	sdb_object_deref(SDB_OBJ(restored));
+
+	unlink(filename);
+	check = sdb_memstore_restore(store, filename);
+	fail_unless(check < 0,
+			"sdb_memstore_restore(<store>, <missing file>) = %d; "
+			"expected: <0", check);
+
+	sdb_strbuf_destroy(expected);
+	sdb_strbuf_destroy(got);
+}
+END_TEST
+
+START_TEST(test_snapshot_backends)
+{
+	const char *names[BACKENDS_MAX];
+	char buf[BACKENDS_MAX][32];
+	sdb_store_host_t host = { "h", 1, 0, names, BACKENDS_MAX };
+	char filename[] = "store_test_snapshot.XXXXXX";
+	sdb_memstore_t *restored;
+	sdb_memstore_obj_t *obj;
+	sdb_data_t value = SDB_DATA_INIT;
+	size_t i;
+	int fd, check;
+
+	/* make use of all backends */
+	for (i = sdb_memstore_backend_names(names); i < BACKENDS_MAX; ++i) {
+		snprintf(buf[i], sizeof(buf[i]), "backend::test::%zu", i);
+		names[i] = buf[i];
+	}
+	check = sdb_memstore_writer.store_host(&host, SDB_OBJ(store));
+	fail_unless(check == 0,
+			"INTERNAL ERROR: store_host(h, <%d backends>) = %d; "
+			"expected: 0", BACKENDS_MAX, check);
+
+	fd = mkstemp(filename);
+	fail_unless(fd >= 0, "INTERNAL ERROR: mkstemp() = %d", fd);
+	close(fd);
+
+	check = sdb_memstore_dump(store, filename);
+	fail_unless(check == 0,
+			"sdb_memstore_dump(<store>, %s) = %d; expected: 0",
+			filename, check);
+	restored = sdb_memstore_create();
+	ck_assert(restored != NULL);
+	check = sdb_memstore_restore(restored, filename);
+	fail_unless(check == 0,
+			"sdb_memstore_restore(<empty store>, %s) = %d; expected: 0",
+			filename, check);
+	unlink(filename);
+
+	obj = sdb_memstore_get_host(restored, "h");
+	fail_unless(obj != NULL, "sdb_memstore_restore() did not restore host h");
+	check = sdb_memstore_get_field(obj, SDB_FIELD_BACKEND, &value);
+	fail_unless((check == 0) && (value.data.array.length == BACKENDS_MAX),
+			"sdb_memstore_get_field(h, backend) = %d, found %zu backends; "
+			"expected: 0, %d", check, value.data.array.length, BACKENDS_MAX);
+
+	sdb_data_free_datum(&value);
+	sdb_object_deref(SDB_OBJ(obj));
+	sdb_object_deref(SDB_OBJ(restored));
+}
+END_TEST
+
+/* store all entries in the store and in the journal */
+static void
+journal_batch(sdb_memstore_journal_t *journal,
+		sdb_store_batch_entry_t *entries, size_t entries_num)
+{
+	int check;
+
+	check = sdb_memstore_writer.store_batch(entries, entries_num,
+			SDB_OBJ(store));
+	fail_unless(check == 0,
+			"INTERNAL ERROR: store_batch() = %d; expected: 0", check);
+	check = sdb_memstore_journal_writer.store_batch(entries, entries_num,
+			SDB_OBJ(journal));
+	fail_unless(check == 0,
+			"sdb_memstore_journal_writer.store_batch() = %d; expected: 0",
+			check);
+} /* journal_batch */
+
+START_TEST(test_journal)
+{
+	const char *backends[] = { "backend::test::one", "backend::test::two" };
+	sdb_metric_store_t ms[] = {
+		{ "dummy-type", "dummy-id", NULL, 1 },
+		{ "other-type", "other-id", NULL, 2 },
+	};
+	sdb_data_t value = { SDB_TYPE_STRING, { .string = "v1" } };
+	sdb_store_batch_entry_t entries[6];
+	sdb_store_host_t host = { "h2", 2, 0, backends + 1, 1 };
+
+	char filename[] = "store_test_journal.XXXXXX";
+	char snapshot[] = "store_test_snapshot.XXXXXX";
+	char oldname[sizeof(filename) + 4];
+	sdb_memstore_journal_t *journal;
+	sdb_memstore_t *restored;
+	sdb_strbuf_t *expected, *got;
+	struct stat st;
+	int fd, check;
+
+	fd = mkstemp(filename);
+	fail_unless(fd >= 0, "INTERNAL ERROR: mkstemp() = %d", fd);
+	close(fd);
+	fd = mkstemp(snapshot);
+	fail_unless(fd >= 0, "INTERNAL ERROR: mkstemp() = %d", fd);
+	close(fd);
+	snprintf(oldname, sizeof(oldname), "%s.old", filename);
+
+	journal = sdb_memstore_journal_open(filename, /* sync_interval = */ 0);
+	fail_unless(journal != NULL,
+			"sdb_memstore_journal_open(%s, 0) = NULL; expected: <journal>",
+			filename);
+
+	memset(entries, 0, sizeof(entries));
+	entries[0].type = SDB_HOST;
+	entries[0].obj.host.name = "h1";
+	entries[0].obj.host.last_update = 1;
+	entries[0].obj.host.backends = backends;
+	entries[0].obj.host.backends_num = 2;
+	entries[1].type = SDB_METRIC;
+	entries[1].obj.metric.hostname = "h1";
+	entries[1].obj.metric.name = "m1";
+	entries[1].obj.metric.stores = ms;
+	entries[1].obj.metric.stores_num = 2;
+	entries[1].obj.metric.last_update = 2;
+	entries[2].type = SDB_SERVICE;
+	entries[2].obj.service.hostname = "h1";
+	entries[2].obj.service.name = "s1";
+	entries[2].obj.service.last_update = 2;
+	entries[2].obj.service.interval = 10;
+	entries[3].type = SDB_ATTRIBUTE;
+	entries[3].obj.attribute.parent_type = SDB_HOST;
+	entries[3].obj.attribute.parent = "h1";
+	entries[3].obj.attribute.key = "k1";
+	entries[3].obj.attribute.value = value;
+	entries[3].obj.attribute.last_update = 3;
+	entries[4].type = SDB_ATTRIBUTE;
+	entries[4].obj.attribute.hostname = "h1";
+	entries[4].obj.attribute.parent_type = SDB_METRIC;
+	entries[4].obj.attribute.parent = "m1";
+	entries[4].obj.attribute.key = "k2";
+	entries[4].obj.attribute.value = value;
+	entries[4].obj.attribute.last_update = 3;
+	entries[5].type = SDB_ATTRIBUTE;
+	entries[5].obj.attribute.hostname = "h1";
+	entries[5].obj.attribute.parent_type = SDB_SERVICE;
+	entries[5].obj.attribute.parent = "s1";
+	entries[5].obj.attribute.key = "k3";
+	entries[5].obj.attribute.value = value;
+	entries[5].obj.attribute.last_update = 3;
+	journal_batch(journal, entries, SDB_STATIC_ARRAY_LEN(entries));
+
+	/* single updates and updates of existing objects */
+	check = sdb_memstore_writer.store_host(&host, SDB_OBJ(store));
+	fail_unless(check == 0,
+			"INTERNAL ERROR: store_host(h2) = %d; expected: 0", check);
+	check = sdb_memstore_journal_writer.store_host(&host, SDB_OBJ(journal));
+	fail_unless(check == 0,
+			"sdb_memstore_journal_writer.store_host(h2) = %d; expected: 0",
+			check);
+	entries[1].obj.metric.last_update = 12;
+	journal_batch(journal, entries + 1, 1);
+
+	check = sdb_memstore_journal_sync(journal);
+	fail_unless(check == 0,
+			"sdb_memstore_journal_sync() = %d; expected: 0", check);
+
+	restored = sdb_memstore_create();
+	ck_assert(restored != NULL);
+	check = sdb_memstore_journal_replay(restored, filename);
+	fail_unless(check == 0,
+			"sdb_memstore_journal_replay(<empty store>, %s) = %d; "
+			"expected: 0", filename, check);
+
+	expected = sdb_strbuf_create(0);
+	got = sdb_strbuf_create(0);
+	store_tojson(store, expected);
+	store_tojson(restored, got);
+	sdb_diff_strings("Replaying a journal returned unexpected result",
+			sdb_strbuf_string(got), sdb_strbuf_string(expected));
+	sdb_object_deref(SDB_OBJ(restored));
+
+	/* the last record was written partially; everything else is used */
+	check = stat(filename, &st);
+	fail_unless(check == 0, "INTERNAL ERROR: stat(%s) = %d", filename, check);
+	check = truncate(filename, st.st_size - 3);
+	fail_unless(check == 0, "INTERNAL ERROR: truncate(%s) = %d", filename, check);
+	restored = sdb_memstore_create();
+	ck_assert(restored != NULL);
+	check = sdb_memstore_journal_replay(restored, filename);
+	fail_unless(check == 0,
+			"sdb_memstore_journal_replay(<store>, <truncated journal>) = %d; "
+			"expected: 0", check);
+	sdb_object_deref(SDB_OBJ(restored));
+
+	/* compacting writes a snapshot and drops the journaled updates */
+	check = sdb_memstore_journal_compact(journal, store, snapshot);
+	fail_unless(check == 0,
+			"sdb_memstore_journal_compact() = %d; expected: 0", check);
+	fail_unless(access(oldname, F_OK) != 0,
+			"sdb_memstore_journal_compact() left %s behind", oldname);
+	check = stat(filename, &st);
+	fail_unless((check == 0) && (st.st_size == 12),
+			"sdb_memstore_journal_compact() left a journal of %d bytes; "
+			"expected: 12 (header only)", (int)st.st_size);
+
+	restored = sdb_memstore_create();
+	ck_assert(restored != NULL);
+	check = sdb_memstore_restore(restored, snapshot);
+	fail_unless(check == 0,
+			"sdb_memstore_restore(<store>, <compacted>) = %d; expected: 0",
+			check);
+	store_tojson(restored, got);
+	sdb_diff_strings("Restoring a compacted journal returned unexpected result",
+			sdb_strbuf_string(got), sdb_strbuf_string(expected));
+	sdb_object_deref(SDB_OBJ(restored));
+	sdb_object_deref(SDB_OBJ(journal));
+
+	/* updates are written in the background and on close */
+	journal = sdb_memstore_journal_open(filename,
+			/* sync_interval = */ SECS_TO_SDB_TIME(3600));
+	fail_unless(journal != NULL,
+			"sdb_memstore_journal_open(%s, 3600s) = NULL; expected: <journal>",
+			filename);
+	entries[1].obj.metric.last_update = 13;
+	journal_batch(journal, entries + 1, 1);
+	sdb_object_deref(SDB_OBJ(journal));
+
+	check = sdb_memstore_journal_replay(store, filename);
+	fail_unless(check > 0,
+			"sdb_memstore_journal_replay(<store>, %s) = %d; "
+			"expected: >0 (all updates stale)", filename, check);
+
+	unlink(filename);
+	unlink(snapshot);
+	sdb_strbuf_destroy(expected);
+	sdb_strbuf_destroy(got);
+}
+END_TEST
+
+START_TEST(test_expire)
+{
+	sdb_memstore_expiry_t expiry;
+	sdb_memstore_obj_t *host, *obj;
+	int check;
+
+	populate();
+	memset(&expiry, 0, sizeof(expiry));
+
+	check = sdb_memstore_expire(NULL, &expiry, 10);
+	fail_unless(check < 0,
+			"sdb_memstore_expire(NULL, <expiry>, 10) = %d; expected: <0",
+			check);
+	check = sdb_memstore_expire(store, NULL, 10);
+	fail_unless(check < 0,
+			"sdb_memstore_expire(<store>, NULL, 10) = %d; expected: <0",
+			check);
+
+	/* nothing expires by default */
+	check = sdb_memstore_expire(store, &expiry, 10);
+	fail_unless(check == 0,
+			"sdb_memstore_expire(<store>, <no expiry>, 10) = %d; expected: 0",
+			check);
+
+	/* h1.k1 and h2.s2.k2 */
+	expiry.attribute.min_age = 1;
+	check = sdb_memstore_expire(store, &expiry, 3);
+	fail_unless(check == 2,
+			"sdb_memstore_expire(<store>, <attribute expiry>, 3) = %d; "
+			"expected: 2", check);
+	host = sdb_memstore_get_host(store, "h1");
+	obj = sdb_memstore_get_child(host, SDB_ATTRIBUTE, "k1");
+	fail_unless(obj == NULL,
+			"sdb_memstore_expire() did not remove attribute h1.k1");
+	obj = sdb_memstore_get_child(host, SDB_ATTRIBUTE, "k2");
+	fail_unless(obj != NULL,
+			"sdb_memstore_expire() removed attribute h1.k2 (not expired)");
+	sdb_object_deref(SDB_OBJ(obj));
+	sdb_object_deref(SDB_OBJ(host));
+
+	/* h1.m2 and h2.m1 */
+	expiry.metric.min_age = 1;
+	check = sdb_memstore_expire(store, &expiry, 3);
+	fail_unless(check == 2,
+			"sdb_memstore_expire(<store>, <metric expiry>, 3) = %d; "
+			"expected: 2", check);
+	host = sdb_memstore_get_host(store, "h2");
+	obj = sdb_memstore_get_child(host, SDB_METRIC, "m1");
+	fail_unless(obj == NULL,
+			"sdb_memstore_expire() did not remove metric h2.m1");
+	sdb_object_deref(SDB_OBJ(host));
+
+	/* h1 (including all of its children) */
+	memset(&expiry, 0, sizeof(expiry));
+	expiry.host.min_age = 2;
+	check = sdb_memstore_expire(store, &expiry, 4);
+	fail_unless(check == 1,
+			"sdb_memstore_expire(<store>, <host expiry>, 4) = %d; "
+			"expected: 1", check);
+	host = sdb_memstore_get_host(store, "h1");
+	fail_unless(host == NULL,
+			"sdb_memstore_expire() did not remove host h1");
+	check = sdb_memstore_metric(store, "h1", "m1", NULL, 5, 0);
+	fail_unless(check < 0,
+			"sdb_memstore_metric(<expired host>, m1) = %d; expected: <0",
+			check);
+	host = sdb_memstore_get_host(store, "h2");
+	fail_unless(host != NULL,
+			"sdb_memstore_expire() removed host h2 (not expired)");
+	sdb_object_deref(SDB_OBJ(host));
+
+	/* expired hosts may be added again */
+	check = sdb_memstore_host(store, "h1", 5, 0);
+	fail_unless(check == 0,
+			"sdb_memstore_host(<expired host>) = %d; expected: 0", check);
+
+	/* the update interval takes precedence over the minimum age */
+	memset(&expiry, 0, sizeof(expiry));
+	expiry.service.factor = 2.0;
+	expiry.service.min_age = 5;
+	sdb_memstore_service(store, "h2", "s3", 20, 10);
+	/* s1 and s2 have no interval and expire based on their age */
+	check = sdb_memstore_expire(store, &expiry, 39);
+	fail_unless(check == 2,
+			"sdb_memstore_expire(<store>, <service expiry>, 39) = %d; "
+			"expected: 2", check);
+	host = sdb_memstore_get_host(store, "h2");
+	obj = sdb_memstore_get_child(host, SDB_SERVICE, "s3");
+	fail_unless(obj != NULL,
+			"sdb_memstore_expire() removed service h2.s3 (not expired)");
+	sdb_object_deref(SDB_OBJ(obj));
+
+	check = sdb_memstore_expire(store, &expiry, 41);
+	fail_unless(check == 1,
+			"sdb_memstore_expire(<store>, <service expiry>, 41) = %d; "
+			"expected: 1", check);
+	obj = sdb_memstore_get_child(host, SDB_SERVICE, "s3");
+	fail_unless(obj == NULL,
+			"sdb_memstore_expire() did not remove service h2.s3");
+	sdb_object_deref(SDB_OBJ(host));
+}
+END_TEST
+
 TEST_MAIN("core::store")
 {
 	TCase *tc = tcase_create("core");
@@ -815,7 +1387,14 @@ TEST_MAIN("core::store")
 	tcase_add_test(tc, test_store_service_attr);
 	TC_ADD_LOOP_TEST(tc, get_field);
 	tcase_add_test(tc, test_get_child);
+	tcase_add_test(tc, test_interval);
+	tcase_add_test(tc, test_backends);
+	tcase_add_test(tc, test_store_batch);
 	tcase_add_test(tc, test_scan);
+	tcase_add_test(tc, test_snapshot);
+	tcase_add_test(tc, test_snapshot_backends);
+	tcase_add_test(tc, test_journal);
+	tcase_add_test(tc, test_expire);
 	ADD_TCASE(tc);
 }
 TEST_MAIN_END
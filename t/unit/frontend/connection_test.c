@@ -32,11 +32,13 @@
 #include "frontend/connection.h"
 #include "frontend/connection-private.h"
 #include "utils/os.h"
+#include "utils/proto.h"
 #include "testutils.h"
 
 #include "utils/strbuf.h"
 
 #include <check.h>
+#include <errno.h>
 
 #include <stdlib.h>
 #include <string.h>
@@ -80,6 +82,40 @@ mock_conn_write(sdb_conn_t *conn, const void *buf, size_t len)
 	return sdb_write(conn->fd, len, buf);
 } /* conn_write */
 
+/* number of bytes the limited write functions accept before blocking */
+static size_t write_budget = 0;
+
+static ssize_t
+mock_conn_write_limited(sdb_conn_t *conn, const void *buf, size_t len)
+{
+	if (! write_budget) {
+		errno = EAGAIN;
+		return -1;
+	}
+	if (len > write_budget)
+		len = write_budget;
+	write_budget -= len;
+	return sdb_write(conn->fd, len, buf);
+} /* mock_conn_write_limited */
+
+static ssize_t
+mock_conn_writev_limited(sdb_conn_t *conn, const struct iovec *iov, int cnt)
+{
+	ssize_t total = 0;
+	int i;
+
+	for (i = 0; i < cnt; ++i) {
+		ssize_t n = mock_conn_write_limited(conn,
+				iov[i].iov_base, iov[i].iov_len);
+		if (n < 0)
+			return total ? total : n;
+		total += n;
+		if ((size_t)n < iov[i].iov_len)
+			break;
+	}
+	return total;
+} /* mock_conn_writev_limited */
+
 static sdb_conn_t *
 mock_conn_create(void)
 {
@@ -435,6 +471,68 @@ START_TEST(test_conn_io)
 }
 END_TEST
 
+/* test queuing of messages which cannot be written right away */
+START_TEST(test_conn_send_queue)
+{
+	sdb_conn_t *conn = mock_conn_create();
+	const char *msgs[] = { "abcdefghij", "0123456789", "klmnopqrst" };
+	/* each message is 18 bytes including its header */
+	struct {
+		size_t budget;
+		size_t expected;
+	} flushes[] = {
+		{ 0, 49 },
+		{ 20, 29 },
+		{ 1, 28 },
+		{ 100, 0 },
+	};
+	char expected[3 * 18];
+	char buf[sizeof(expected) + 1];
+	ssize_t check;
+	size_t i;
+
+	conn->write = mock_conn_write_limited;
+	if (_i)
+		conn->writev = mock_conn_writev_limited;
+
+	write_budget = 5;
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(msgs); ++i) {
+		check = sdb_connection_send(conn, SDB_CONNECTION_DATA,
+				(uint32_t)strlen(msgs[i]), msgs[i]);
+		fail_unless(check == 18,
+				"sdb_connection_send(%s) = %zi; expected: 18", msgs[i], check);
+		check = sdb_proto_marshal(expected + i * 18, 18, SDB_CONNECTION_DATA,
+				(uint32_t)strlen(msgs[i]), msgs[i]);
+		fail_unless(check == 18,
+				"INTERNAL ERROR: sdb_proto_marshal(%s) = %zi; expected: 18",
+				msgs[i], check);
+	}
+	fail_unless(conn->out_len == sizeof(expected) - 5,
+			"sdb_connection_send() queued %zu bytes; expected: %zu",
+			conn->out_len, sizeof(expected) - 5);
+
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(flushes); ++i) {
+		write_budget = flushes[i].budget;
+		check = sdb_connection_flush(conn);
+		fail_unless(check == (ssize_t)flushes[i].expected,
+				"sdb_connection_flush() = %zi (budget: %zu); expected: %zu",
+				check, flushes[i].budget, flushes[i].expected);
+	}
+	fail_unless(conn->out_head == NULL,
+			"sdb_connection_flush() left messages in the queue");
+
+	mock_conn_rewind(conn);
+	check = read(conn->fd, buf, sizeof(buf));
+	fail_unless(check == (ssize_t)sizeof(expected),
+			"sdb_connection_flush() wrote %zi bytes; expected: %zu",
+			check, sizeof(expected));
+	fail_unless(memcmp(buf, expected, sizeof(expected)) == 0,
+			"sdb_connection_flush() wrote unexpected data");
+
+	mock_conn_destroy(conn);
+}
+END_TEST
+
 TEST_MAIN("frontend::connection")
 {
 	TCase *tc;
@@ -447,6 +545,7 @@ TEST_MAIN("frontend::connection")
 	tcase_add_test(tc, test_conn_accept);
 	tcase_add_test(tc, test_conn_setup);
 	tcase_add_test(tc, test_conn_io);
+	tcase_add_loop_test(tc, test_conn_send_queue, 0, 2);
 	ADD_TCASE(tc);
 }
 TEST_MAIN_END
@@ -36,6 +36,9 @@
 #include "testutils.h"
 
 #include <check.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 /*
  * private helpers
@@ -254,6 +257,11 @@ turndown(void)
 typedef struct {
 	sdb_conn_t conn;
 	sdb_strbuf_t *write_buf;
+	/* simulate a slow client which accepts every other write only */
+	bool slow;
+	bool accept_write;
+	/* the maximum amount of data queued when writing */
+	size_t max_queued;
 } mock_conn_t;
 #define MOCK_CONN(obj) ((mock_conn_t *)(obj))
 #define CONN(obj) ((sdb_conn_t *)(obj))
@@ -281,6 +289,15 @@ mock_conn_write(sdb_conn_t *conn, const void *buf, size_t len)
 {
 	if (! conn)
 		return -1;
+	if (conn->out_len > MOCK_CONN(conn)->max_queued)
+		MOCK_CONN(conn)->max_queued = conn->out_len;
+	if (MOCK_CONN(conn)->slow) {
+		MOCK_CONN(conn)->accept_write = ! MOCK_CONN(conn)->accept_write;
+		if (! MOCK_CONN(conn)->accept_write) {
+			errno = EAGAIN;
+			return -1;
+		}
+	}
 	return sdb_strbuf_memappend(MOCK_CONN(conn)->write_buf, buf, len);
 } /* conn_write */
 
@@ -400,6 +417,48 @@ static struct {
 		SDB_CONNECTION_QUERY, "LIST hosts FILTER name = 's1'", -1,
 		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LIST, "[]",
 	},
+	{
+		SDB_CONNECTION_QUERY, "LIST hosts LIMIT 1", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LIST, "["HOST_H1_LISTING"]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "LIST hosts LIMIT 1 OFFSET 1", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LIST, "["HOST_H2_LISTING"]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "LIST hosts LIMIT 0", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LIST, "[]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "LIST hosts OFFSET 2", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LIST, "[]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "LIST hosts ORDER BY name", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LIST,
+		"["HOST_H1_LISTING","HOST_H2_LISTING"]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "LIST hosts ORDER BY name DESC", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LIST,
+		"["HOST_H2_LISTING","HOST_H1_LISTING"]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "LIST hosts ORDER BY last_update DESC LIMIT 1", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LIST, "["HOST_H2_LISTING"]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "LIST hosts ORDER BY age LIMIT 1 OFFSET 1", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LIST, "["HOST_H1_LISTING"]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "LIST hosts AFTER 'h1' LIMIT 1", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LIST, "["HOST_H2_LISTING"]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "LIST hosts AFTER 'h2'", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LIST, "[]",
+	},
 	/* SDB_CONNECTION_LIST doesn't support filters yet */
 	{
 		SDB_CONNECTION_QUERY, "FETCH host 'h1'", -1,
@@ -430,6 +489,95 @@ static struct {
 		SDB_CONNECTION_QUERY, "LOOKUP hosts MATCHING ANY backend = 'b'", -1,
 		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LOOKUP, "[]",
 	},
+	{
+		SDB_CONNECTION_QUERY, "LOOKUP hosts ORDER BY attribute['k1'] LIMIT 1", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LOOKUP, "["HOST_H2"]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "LOOKUP metrics MATCHING name = 'm1' "
+			"ORDER BY last_update DESC", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LOOKUP,
+		"["METRIC_H2_M1","METRIC_H1_M1"]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "LOOKUP metrics MATCHING name = 'm1' "
+			"ORDER BY host.name LIMIT 1", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LOOKUP, "["METRIC_H1_M1"]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "LOOKUP hosts ORDER BY backend", -1,
+		-1, UINT32_MAX, 0, NULL,
+	},
+	{
+		SDB_CONNECTION_QUERY, "LOOKUP metrics MATCHING name = 'm1' "
+			"AFTER 'h1'.'m1'", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LOOKUP, "["METRIC_H2_M1"]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "LOOKUP metrics MATCHING name = 'm1' "
+			"AFTER 'h0'.'m2' LIMIT 1", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LOOKUP, "["METRIC_H1_M1"]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "LOOKUP hosts MATCHING name = 'h1' "
+			"SELECT attribute['k1']", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LOOKUP,
+		"[{\"name\": \"h1\", "
+			"\"attributes\": [{\"name\": \"k1\", \"value\": \"v1\"}]}]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "LIST hosts SELECT last_update, "
+			"attribute['x']", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LIST,
+		"[{\"name\": \"h1\", \"last_update\": \"1970-01-01 00:00:01 +0000\"},"
+		"{\"name\": \"h2\", \"last_update\": \"1970-01-01 00:00:03 +0000\"}]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "LIST metrics SELECT timeseries LIMIT 1", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LIST,
+		"[{\"name\": \"h1\", \"metrics\": ["
+			"{\"name\": \"m1\", \"timeseries\": false}]}]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "COUNT hosts", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_COUNT, "{\"count\": 2}",
+	},
+	{
+		SDB_CONNECTION_QUERY, "COUNT hosts MATCHING name = 'x1'", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_COUNT, "{\"count\": 0}",
+	},
+	{
+		SDB_CONNECTION_QUERY, "COUNT metrics GROUP BY name", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_COUNT,
+		"[{\"value\": \"m1\", \"count\": 2},"
+		"{\"value\": \"m2\", \"count\": 1}]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "COUNT hosts GROUP BY attribute['k1']", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_COUNT,
+		"[{\"value\": null, \"count\": 1},"
+		"{\"value\": \"v1\", \"count\": 1}]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "COUNT metrics MATCHING name = 'x1' "
+			"GROUP BY name", -1,
+		0, SDB_CONNECTION_DATA, SDB_CONNECTION_COUNT, "[]",
+	},
+	{
+		SDB_CONNECTION_QUERY, "EXPLAIN LOOKUP hosts MATCHING name = 'h1'", -1,
+		0, SDB_CONNECTION_OK, 0,
+		"LOOKUP hosts\n"
+		"  matching: name = 'h1'\n"
+		"  host prefix: 'h1'",
+	},
+	{
+		SDB_CONNECTION_QUERY, "EXPLAIN COUNT hosts", -1,
+		0, SDB_CONNECTION_OK, 0, "COUNT hosts",
+	},
+	{
+		SDB_CONNECTION_QUERY, "EXPLAIN STORE host 'hA'", -1,
+		-1, UINT32_MAX, 0, NULL,
+	},
 	{
 		SDB_CONNECTION_QUERY, "LOOKUP hosts MATCHING ANY backend || 'b' = 'b'", -1,
 		0, SDB_CONNECTION_DATA, SDB_CONNECTION_LOOKUP, HOST_H12_ARRAY,
@@ -836,11 +984,177 @@ START_TEST(test_query)
 }
 END_TEST
 
+/* Run a query and return the (assembled) result data; also reports the
+ * number of messages sent. */
+static sdb_strbuf_t *
+run_query(const char *query, bool chunked, size_t *msg_num)
+{
+	sdb_conn_t *conn = mock_conn_create();
+	sdb_strbuf_t *result = sdb_strbuf_create(1024);
+	const char *data;
+	size_t len;
+	int check;
+
+	conn->chunked = chunked;
+	conn->cmd = SDB_CONNECTION_QUERY;
+	conn->cmd_len = (uint32_t)strlen(query);
+	sdb_strbuf_memcpy(conn->buf, query, conn->cmd_len);
+
+	check = sdb_conn_query(conn);
+	fail_unless(check == 0,
+			"sdb_conn_query(%s) = %d; expected: 0 (err: %s)",
+			query, check, sdb_strbuf_string(conn->errbuf));
+
+	data = sdb_strbuf_string(MOCK_CONN(conn)->write_buf);
+	len = sdb_strbuf_len(MOCK_CONN(conn)->write_buf);
+	*msg_num = 0;
+	while (len > 0) {
+		uint32_t code = UINT32_MAX, msg_len = 0, type = 0;
+		ssize_t tmp;
+
+		tmp = sdb_proto_unmarshal_header(data, len, &code, &msg_len);
+		ck_assert_msg(tmp == (ssize_t)(2 * sizeof(uint32_t)));
+		data += tmp;
+		len -= tmp;
+
+		fail_unless(len >= msg_len,
+				"sdb_conn_query(%s) sent truncated message", query);
+		fail_unless((code == SDB_CONNECTION_DATA)
+				|| (chunked && (code == SDB_CONNECTION_DATA_CHUNK)),
+				"sdb_conn_query(%s) sent message <%u>; expected: DATA%s",
+				query, code, chunked ? " or DATA_CHUNK" : "");
+		fail_unless((code == SDB_CONNECTION_DATA_CHUNK) || (len == msg_len),
+				"sdb_conn_query(%s) sent data after the final DATA message",
+				query);
+
+		sdb_proto_unmarshal_int32(data, msg_len, &type);
+		fail_unless(type == SDB_CONNECTION_LIST,
+				"sdb_conn_query(%s) returned %s object; expected: LIST",
+				query, SDB_CONN_MSGTYPE_TO_STRING((int)type));
+		sdb_strbuf_memappend(result, data + sizeof(uint32_t),
+				msg_len - sizeof(uint32_t));
+
+		data += msg_len;
+		len -= msg_len;
+		++*msg_num;
+	}
+
+	mock_conn_destroy(conn);
+	return result;
+} /* run_query */
+
+START_TEST(test_chunked)
+{
+	sdb_strbuf_t *full, *chunked;
+	size_t full_num = 0, chunked_num = 0;
+	int i;
+
+	/* a result of a couple of 100 KB */
+	for (i = 0; i < 2000; ++i) {
+		char name[32];
+		snprintf(name, sizeof(name), "host%04d", i);
+		sdb_plugin_store_host(name, 1 * SDB_INTERVAL_SECOND);
+	}
+
+	full = run_query("LIST hosts", 0, &full_num);
+	chunked = run_query("LIST hosts", 1, &chunked_num);
+
+	fail_unless(full_num == 1,
+			"LIST hosts returned %zu messages; expected: 1", full_num);
+	fail_unless(chunked_num > 2,
+			"LIST hosts returned %zu messages with chunking enabled; "
+			"expected: >2", chunked_num);
+	fail_unless(! strcmp(sdb_strbuf_string(full), sdb_strbuf_string(chunked)),
+			"LIST hosts returned different results with chunking enabled");
+
+	sdb_strbuf_destroy(full);
+	sdb_strbuf_destroy(chunked);
+}
+END_TEST
+
+/* Run a chunked query against a (slow) mock connection and return all data
+ * written to the connection. */
+static sdb_strbuf_t *
+run_chunked(const char *query, bool slow, size_t *max_queued)
+{
+	sdb_conn_t *conn = mock_conn_create();
+	sdb_strbuf_t *result;
+	int sv[2] = { -1, -1 };
+	int check;
+
+	if (slow) {
+		/* the connection waits for the socket to become writable */
+		ck_assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+		conn->fd = sv[0];
+		MOCK_CONN(conn)->slow = 1;
+	}
+
+	conn->chunked = 1;
+	conn->cmd = SDB_CONNECTION_QUERY;
+	conn->cmd_len = (uint32_t)strlen(query);
+	sdb_strbuf_memcpy(conn->buf, query, conn->cmd_len);
+
+	check = sdb_conn_query(conn);
+	fail_unless(check == 0,
+			"sdb_conn_query(%s) = %d for a%s client; expected: 0 (err: %s)",
+			query, check, slow ? " slow" : "",
+			sdb_strbuf_string(conn->errbuf));
+
+	/* the final message may still be queued */
+	while (conn->out_len)
+		ck_assert(sdb_connection_flush(conn) >= 0);
+
+	result = MOCK_CONN(conn)->write_buf;
+	MOCK_CONN(conn)->write_buf = NULL;
+	*max_queued = MOCK_CONN(conn)->max_queued;
+	mock_conn_destroy(conn);
+	if (slow) {
+		close(sv[0]);
+		close(sv[1]);
+	}
+	return result;
+} /* run_chunked */
+
+START_TEST(test_chunked_slow_client)
+{
+	sdb_strbuf_t *fast, *slow;
+	size_t fast_queued = 0, slow_queued = 0;
+	int i;
+
+	/* a result of a couple of MB */
+	for (i = 0; i < 20000; ++i) {
+		char name[32];
+		snprintf(name, sizeof(name), "host%05d", i);
+		sdb_plugin_store_host(name, 1 * SDB_INTERVAL_SECOND);
+	}
+
+	fast = run_chunked("LIST hosts", 0, &fast_queued);
+	slow = run_chunked("LIST hosts", 1, &slow_queued);
+
+	fail_unless(sdb_strbuf_len(fast) == sdb_strbuf_len(slow),
+			"LIST hosts sent %zu bytes to a slow client; expected: %zu",
+			sdb_strbuf_len(slow), sdb_strbuf_len(fast));
+	fail_unless(! memcmp(sdb_strbuf_string(fast), sdb_strbuf_string(slow),
+				sdb_strbuf_len(fast)),
+			"LIST hosts sent different data to a slow client");
+	/* chunks are passed on while the query is still running */
+	fail_unless(slow_queued < sdb_strbuf_len(slow) / 4,
+			"LIST hosts queued up to %zu of %zu bytes for a slow client; "
+			"expected: less than a quarter", slow_queued,
+			sdb_strbuf_len(slow));
+
+	sdb_strbuf_destroy(fast);
+	sdb_strbuf_destroy(slow);
+}
+END_TEST
+
 TEST_MAIN("frontend::query")
 {
 	TCase *tc = tcase_create("core");
 	tcase_add_checked_fixture(tc, populate, turndown);
 	TC_ADD_LOOP_TEST(tc, query);
+	tcase_add_test(tc, test_chunked);
+	tcase_add_test(tc, test_chunked_slow_client);
 	ADD_TCASE(tc);
 }
 TEST_MAIN_END
@@ -29,7 +29,9 @@
 #	include "config.h"
 #endif
 
+#include "frontend/connection.h"
 #include "frontend/sock.h"
+#include "utils/proto.h"
 #include "testutils.h"
 
 #include <check.h>
@@ -38,10 +40,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <unistd.h>
 
 #include <pthread.h>
+#include <pwd.h>
 
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -81,6 +85,65 @@ sock_listen(char *tmp_file)
 			sock_addr, check);
 } /* sock_listen */
 
+static int
+sock_connect(char *tmp_file)
+{
+	struct sockaddr_un sa;
+	int sock_fd, check;
+
+	sock_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	fail_unless(sock_fd >= 0,
+			"INTERNAL ERROR: socket() = %d; expected: >= 0", sock_fd);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	strncpy(sa.sun_path, tmp_file, sizeof(sa.sun_path) - 1);
+
+	/* wait for socket to become available */
+	errno = ECONNREFUSED;
+	while (errno == ECONNREFUSED) {
+		check = connect(sock_fd, (struct sockaddr *)&sa, sizeof(sa));
+		if (! check)
+			break;
+
+		fail_unless((errno == ECONNREFUSED) || (errno == ENOENT),
+				"INTERNAL ERROR: connect() = %d [errno=%d]; expected: 0",
+				check, errno);
+		errno = ECONNREFUSED;
+	}
+	return sock_fd;
+} /* sock_connect */
+
+static void
+sock_send(int fd, uint32_t code, const char *msg)
+{
+	uint32_t len = msg ? (uint32_t)strlen(msg) : 0;
+	char buf[2 * sizeof(uint32_t) + len];
+	ssize_t n;
+
+	sdb_proto_marshal(buf, sizeof(buf), code, len, msg);
+	n = write(fd, buf, sizeof(buf));
+	fail_unless(n == (ssize_t)sizeof(buf),
+			"INTERNAL ERROR: write() = %zd; expected: %zu", n, sizeof(buf));
+} /* sock_send */
+
+static void
+sock_expect(int fd, uint32_t expected)
+{
+	char buf[2 * sizeof(uint32_t)];
+	uint32_t code = UINT32_MAX, len = UINT32_MAX;
+	ssize_t n;
+
+	n = read(fd, buf, sizeof(buf));
+	fail_unless(n == (ssize_t)sizeof(buf),
+			"read(<conn %d>) = %zd; expected: %zu (reply header)",
+			fd, n, sizeof(buf));
+	sdb_proto_unmarshal_header(buf, sizeof(buf), &code, &len);
+	fail_unless((code == expected) && (len == 0),
+			"connection %d returned <%u, %u>; expected: <%u, 0>",
+			fd, code, len, expected);
+} /* sock_expect */
+
 /*
  * parallel testing
  */
@@ -168,11 +231,111 @@ START_TEST(test_listen_and_serve)
 }
 END_TEST
 
+START_TEST(test_serve_connections)
+{
+	sdb_fe_loop_t loop = SDB_FE_LOOP_INIT;
+
+	char tmp_file[] = "sock_test_socket.XXXXXX";
+	struct passwd *pw = getpwuid(geteuid());
+	int fds[16];
+	size_t i;
+	int check;
+
+	pthread_t thr;
+
+	fail_unless(pw != NULL,
+			"INTERNAL ERROR: getpwuid() = NULL; expected: current user");
+
+	check = mkstemp(tmp_file);
+	unlink(tmp_file);
+	close(check);
+	sock_listen(tmp_file);
+
+	check = pthread_create(&thr, /* attr = */ NULL, sock_handler, &loop);
+	fail_unless(check == 0,
+			"INTERNAL ERROR: pthread_create() = %i; expected: 0", check);
+
+	/* connections are spread across all handler threads; each of them has
+	 * to be served independently of the others */
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(fds); ++i)
+		fds[i] = sock_connect(tmp_file);
+
+	/* send all requests before reading any replies */
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(fds); ++i)
+		sock_send(fds[i], SDB_CONNECTION_STARTUP, pw->pw_name);
+	for (i = SDB_STATIC_ARRAY_LEN(fds); i > 0; --i)
+		sock_expect(fds[i - 1], SDB_CONNECTION_OK);
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(fds); ++i)
+		sock_send(fds[i], SDB_CONNECTION_PING, NULL);
+	for (i = SDB_STATIC_ARRAY_LEN(fds); i > 0; --i)
+		sock_expect(fds[i - 1], SDB_CONNECTION_OK);
+
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(fds); ++i)
+		close(fds[i]);
+
+	loop.do_loop = 0;
+	pthread_join(thr, NULL);
+}
+END_TEST
+
+START_TEST(test_pipelining)
+{
+	sdb_fe_loop_t loop = SDB_FE_LOOP_INIT;
+
+	char tmp_file[] = "sock_test_socket.XXXXXX";
+	struct passwd *pw = getpwuid(geteuid());
+	char buf[2 * sizeof(uint32_t) * 65 + 256];
+	size_t len = 0, i;
+	ssize_t n;
+	int fd, check;
+
+	pthread_t thr;
+
+	fail_unless(pw != NULL,
+			"INTERNAL ERROR: getpwuid() = NULL; expected: current user");
+
+	check = mkstemp(tmp_file);
+	unlink(tmp_file);
+	close(check);
+	sock_listen(tmp_file);
+
+	check = pthread_create(&thr, /* attr = */ NULL, sock_handler, &loop);
+	fail_unless(check == 0,
+			"INTERNAL ERROR: pthread_create() = %i; expected: 0", check);
+
+	/* send all commands at once; the server has to handle all of them,
+	 * replying in order, even though they arrive in a single read */
+	n = sdb_proto_marshal(buf, sizeof(buf), SDB_CONNECTION_STARTUP,
+			(uint32_t)strlen(pw->pw_name), pw->pw_name);
+	fail_unless((n > 0) && ((size_t)n < sizeof(buf) - 64 * 2 * sizeof(uint32_t)),
+			"INTERNAL ERROR: sdb_proto_marshal(STARTUP) = %zd", n);
+	len += (size_t)n;
+	for (i = 0; i < 64; ++i) {
+		n = sdb_proto_marshal(buf + len, sizeof(buf) - len,
+				SDB_CONNECTION_PING, 0, NULL);
+		len += (size_t)n;
+	}
+
+	fd = sock_connect(tmp_file);
+	n = write(fd, buf, len);
+	fail_unless(n == (ssize_t)len,
+			"INTERNAL ERROR: write() = %zd; expected: %zu", n, len);
+	for (i = 0; i < 65; ++i)
+		sock_expect(fd, SDB_CONNECTION_OK);
+	close(fd);
+
+	loop.do_loop = 0;
+	pthread_join(thr, NULL);
+}
+END_TEST
+
 TEST_MAIN("frontend::sock")
 {
 	TCase *tc = tcase_create("core");
 	tcase_add_checked_fixture(tc, setup, teardown);
 	tcase_add_test(tc, test_listen_and_serve);
+	tcase_add_test(tc, test_serve_connections);
+	tcase_add_test(tc, test_pipelining);
 	ADD_TCASE(tc);
 }
 TEST_MAIN_END
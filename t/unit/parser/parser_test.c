@@ -169,6 +169,96 @@ struct {
 	{ "LOOKUP metrics MATCHING ANY "
 	  "host.service.name = 'p'", -1,   1, SDB_AST_TYPE_LOOKUP, SDB_METRIC },
 
+	/* ordering and bounds */
+	{ "LIST hosts LIMIT 10",     -1,   1, SDB_AST_TYPE_LIST, SDB_HOST },
+	{ "LIST hosts LIMIT 10 "
+	  "OFFSET 5",                -1,   1, SDB_AST_TYPE_LIST, SDB_HOST },
+	{ "LIST hosts OFFSET 5",     -1,   1, SDB_AST_TYPE_LIST, SDB_HOST },
+	{ "LIST services FILTER "
+	  "age > 60s ORDER BY "
+	  "last_update DESC "
+	  "LIMIT 0",                 -1,   1, SDB_AST_TYPE_LIST, SDB_SERVICE },
+	{ "LOOKUP hosts ORDER BY "
+	  "name",                    -1,   1, SDB_AST_TYPE_LOOKUP, SDB_HOST },
+	{ "LOOKUP hosts ORDER BY "
+	  "name ASC",                -1,   1, SDB_AST_TYPE_LOOKUP, SDB_HOST },
+	{ "LOOKUP hosts MATCHING "
+	  "name =~ 'p' ORDER BY "
+	  "attribute['a'] DESC "
+	  "LIMIT 3 OFFSET 1",        -1,   1, SDB_AST_TYPE_LOOKUP, SDB_HOST },
+	{ "LOOKUP services ORDER BY "
+	  "host.name LIMIT 1",       -1,   1, SDB_AST_TYPE_LOOKUP, SDB_SERVICE },
+	{ "LOOKUP metrics MATCHING "
+	  "name = 'm' FILTER "
+	  "age < 1h ORDER BY age",   -1,   1, SDB_AST_TYPE_LOOKUP, SDB_METRIC },
+	{ "LIST hosts AFTER 'h' "
+	  "LIMIT 10",                -1,   1, SDB_AST_TYPE_LIST, SDB_HOST },
+	{ "LIST metrics AFTER "
+	  "'h'.'m' LIMIT 10",        -1,   1, SDB_AST_TYPE_LIST, SDB_METRIC },
+	{ "LOOKUP services MATCHING "
+	  "name =~ 's' AFTER 'h'",   -1,   1, SDB_AST_TYPE_LOOKUP, SDB_SERVICE },
+	{ "LIST hosts AFTER h",      -1,  -1, 0, 0 },
+	{ "LIST hosts LIMIT 1 "
+	  "AFTER 'h'",               -1,  -1, 0, 0 },
+	{ "LOOKUP hosts LIMIT -1",   -1,  -1, 0, 0 },
+	{ "LOOKUP hosts OFFSET -1",  -1,  -1, 0, 0 },
+	{ "LOOKUP hosts LIMIT 1.5",  -1,  -1, 0, 0 },
+	{ "LOOKUP hosts ORDER "
+	  "name",                    -1,  -1, 0, 0 },
+	{ "LOOKUP hosts ORDER BY "
+	  "'a'",                     -1,  -1, 0, 0 },
+	{ "LOOKUP hosts OFFSET 1 "
+	  "LIMIT 1",                 -1,  -1, 0, 0 },
+
+	{ "LOOKUP hosts SELECT "
+	  "name, attribute['ip']",   -1,   1, SDB_AST_TYPE_LOOKUP, SDB_HOST },
+	{ "LOOKUP services FILTER "
+	  "age < 1h SELECT "
+	  "last_update LIMIT 1",     -1,   1, SDB_AST_TYPE_LOOKUP, SDB_SERVICE },
+	{ "LIST metrics SELECT "
+	  "timeseries",              -1,   1, SDB_AST_TYPE_LIST, SDB_METRIC },
+	{ "LIST hosts SELECT",       -1,  -1, 0, 0 },
+	{ "LIST hosts SELECT name,", -1,  -1, 0, 0 },
+	{ "LIST hosts LIMIT 1 "
+	  "SELECT name",             -1,  -1, 0, 0 },
+
+	/* COUNT commands */
+	{ "COUNT hosts",             -1,   1, SDB_AST_TYPE_COUNT, SDB_HOST },
+	{ "COUNT hosts MATCHING "
+	  "name =~ 'p'",             -1,   1, SDB_AST_TYPE_COUNT, SDB_HOST },
+	{ "COUNT hosts MATCHING "
+	  "name =~ 'p' GROUP BY "
+	  "attribute['os']",         -1,   1, SDB_AST_TYPE_COUNT, SDB_HOST },
+	{ "COUNT hosts GROUP BY "
+	  "backend",                 -1,   1, SDB_AST_TYPE_COUNT, SDB_HOST },
+	{ "COUNT services FILTER "
+	  "age < 1h GROUP BY "
+	  "host.name",               -1,   1, SDB_AST_TYPE_COUNT, SDB_SERVICE },
+	{ "COUNT metrics MATCHING "
+	  "timeseries IS TRUE",      -1,   1, SDB_AST_TYPE_COUNT, SDB_METRIC },
+	{ "COUNT host",              -1,  -1, 0, 0 },
+	{ "COUNT hosts GROUP "
+	  "name",                    -1,  -1, 0, 0 },
+	{ "COUNT hosts GROUP BY "
+	  "name LIMIT 1",            -1,  -1, 0, 0 },
+
+	/* EXPLAIN commands */
+	{ "EXPLAIN LOOKUP hosts "
+	  "MATCHING name = 'p'",     -1,   1, SDB_AST_TYPE_EXPLAIN, SDB_AST_TYPE_LOOKUP },
+	{ "EXPLAIN LIST services "
+	  "FILTER age < 1h",         -1,   1, SDB_AST_TYPE_EXPLAIN, SDB_AST_TYPE_LIST },
+	{ "EXPLAIN COUNT hosts "
+	  "GROUP BY backend",        -1,   1, SDB_AST_TYPE_EXPLAIN, SDB_AST_TYPE_COUNT },
+	{ "EXPLAIN FETCH host "
+	  "'host'",                  -1,   1, SDB_AST_TYPE_EXPLAIN, SDB_AST_TYPE_FETCH },
+	{ "EXPLAIN",                 -1,  -1, 0, 0 },
+	{ "EXPLAIN EXPLAIN "
+	  "LIST hosts",              -1,  -1, 0, 0 },
+	{ "EXPLAIN STORE host "
+	  "'host'",                  -1,  -1, 0, 0 },
+	{ "EXPLAIN TIMESERIES "
+	  "'host'.'metric'",         -1,  -1, 0, 0 },
+
 	/* TIMESERIES commands */
 	{ "TIMESERIES 'host'.'metric' "
 	  "START 2014-01-01 "
@@ -475,6 +565,32 @@ struct {
 	  "timeseries IS TRUE",    -1, -1, 0, 0 },
 	{ "LIST services FILTER "
 	  "timeseries IS TRUE",    -1, -1, 0, 0 },
+	{ "LOOKUP hosts ORDER BY "
+	  "value",                 -1, -1, 0, 0 },
+	{ "LOOKUP hosts ORDER BY "
+	  "timeseries",            -1, -1, 0, 0 },
+	{ "LOOKUP hosts ORDER BY "
+	  "backend",               -1, -1, 0, 0 },
+	{ "LIST services ORDER BY "
+	  "host.backend",          -1, -1, 0, 0 },
+	{ "LIST hosts AFTER "
+	  "'h'.'x'",               -1, -1, 0, 0 },
+	{ "LOOKUP hosts ORDER BY "
+	  "age AFTER 'h'",         -1, -1, 0, 0 },
+	{ "LOOKUP hosts SELECT "
+	  "age",                   -1, -1, 0, 0 },
+	{ "LOOKUP hosts SELECT "
+	  "value",                 -1, -1, 0, 0 },
+	{ "LOOKUP services SELECT "
+	  "host.name",             -1, -1, 0, 0 },
+	{ "LIST hosts SELECT "
+	  "'a'",                   -1, -1, 0, 0 },
+	{ "COUNT hosts GROUP BY "
+	  "value",                 -1, -1, 0, 0 },
+	{ "COUNT hosts GROUP BY "
+	  "'a'",                   -1, -1, 0, 0 },
+	{ "COUNT hosts GROUP BY "
+	  "age + 1s",              -1, -1, 0, 0 },
 
 	/* type mismatches */
 	{ "LOOKUP hosts MATCHING "
@@ -737,6 +853,13 @@ START_TEST(test_parse)
 				parse_data[_i].query, SDB_STORE_TYPE_TO_NAME(l->obj_type),
 				SDB_STORE_TYPE_TO_NAME(parse_data[_i].expected_extra));
 	}
+	else if (node->type == SDB_AST_TYPE_COUNT) {
+		sdb_ast_count_t *c = SDB_AST_COUNT(node);
+		fail_unless(c->obj_type == parse_data[_i].expected_extra,
+				"sdb_parser_parse(%s)->obj_type = %s; expected: %s",
+				parse_data[_i].query, SDB_STORE_TYPE_TO_NAME(c->obj_type),
+				SDB_STORE_TYPE_TO_NAME(parse_data[_i].expected_extra));
+	}
 	else if (node->type == SDB_AST_TYPE_STORE) {
 		sdb_ast_store_t *s = SDB_AST_STORE(node);
 		fail_unless(s->obj_type == parse_data[_i].expected_extra,
@@ -744,6 +867,17 @@ START_TEST(test_parse)
 				parse_data[_i].query, SDB_STORE_TYPE_TO_NAME(s->obj_type),
 				SDB_STORE_TYPE_TO_NAME(parse_data[_i].expected_extra));
 	}
+	else if (node->type == SDB_AST_TYPE_EXPLAIN) {
+		sdb_ast_explain_t *e = SDB_AST_EXPLAIN(node);
+		fail_unless(e->query->type == parse_data[_i].expected_extra,
+				"sdb_parser_parse(%s)->query->type = %s (%d); expected: %d",
+				parse_data[_i].query, SDB_AST_TYPE_TO_STRING(e->query),
+				e->query->type, parse_data[_i].expected_extra);
+		/* the prepared query is the one being explained */
+		node = e->query;
+		sdb_object_ref(SDB_OBJ(node));
+		sdb_object_deref(SDB_OBJ(e));
+	}
 
 	/* TODO: this should move into front-end specific tests */
 	q = sdb_memstore_query_prepare(node);
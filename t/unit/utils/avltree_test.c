@@ -33,6 +33,8 @@
 #include "testutils.h"
 
 #include <check.h>
+#include <stdio.h>
+#include <string.h>
 
 static sdb_avltree_t *tree;
 
@@ -253,6 +255,295 @@ START_TEST(test_iter)
 }
 END_TEST
 
+START_TEST(test_iter_snapshot)
+{
+	sdb_avltree_iter_t *iter;
+	size_t i, n = 0;
+
+	/* insert half the objects; the iterator must not see any of the others
+	 * even though they're inserted while iterating */
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(test_data) / 2; ++i)
+		sdb_avltree_insert(tree, &test_data[i]);
+
+	iter = sdb_avltree_get_iter(tree);
+	fail_unless(iter != NULL,
+			"sdb_avltree_get_iter(<tree>) = NULL; expected: <iter>");
+
+	for ( ; i < SDB_STATIC_ARRAY_LEN(test_data); ++i)
+		sdb_avltree_insert(tree, &test_data[i]);
+	fail_unless(sdb_avltree_valid(tree),
+			"sdb_avltree_insert() left behind invalid tree");
+
+	while (sdb_avltree_iter_has_next(iter)) {
+		sdb_object_t *obj = sdb_avltree_iter_get_next(iter);
+		fail_unless(obj != NULL,
+				"sdb_avltree_iter_get_next(<iter>) = NULL; expected: <obj>");
+		++n;
+	}
+	sdb_avltree_iter_destroy(iter);
+
+	fail_unless(n == SDB_STATIC_ARRAY_LEN(test_data) / 2,
+			"iterator created before inserting objects returned %zu objects; "
+			"expected: %zu", n, SDB_STATIC_ARRAY_LEN(test_data) / 2);
+
+	/* clearing the tree doesn't affect existing iterators either */
+	iter = sdb_avltree_get_iter(tree);
+	sdb_avltree_clear(tree);
+	n = 0;
+	while (sdb_avltree_iter_get_next(iter))
+		++n;
+	sdb_avltree_iter_destroy(iter);
+	fail_unless(n == SDB_STATIC_ARRAY_LEN(test_data),
+			"iterator created before clearing the tree returned %zu objects; "
+			"expected: %zu", n, SDB_STATIC_ARRAY_LEN(test_data));
+}
+END_TEST
+
+START_TEST(test_iter_seek)
+{
+	struct {
+		const char *name;
+		const char *expected;
+	} golden_data[] = {
+		{ "",   "a" },
+		{ "a",  "a" },
+		{ "A",  "a" },
+		{ "ab", "b" },
+		{ "h",  "h" },
+		{ "hz", "i" },
+		{ "o",  "o" },
+		{ "oa", NULL },
+		{ "z",  NULL },
+	};
+
+	sdb_avltree_iter_t *iter;
+	size_t i;
+
+	populate();
+	iter = sdb_avltree_get_iter(tree);
+	fail_unless(iter != NULL,
+			"sdb_avltree_get_iter(<tree>) = NULL; expected: <iter>");
+
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(golden_data); ++i) {
+		sdb_object_t *obj;
+		const char *expected = golden_data[i].expected;
+
+		sdb_avltree_iter_seek(iter, golden_data[i].name);
+		obj = sdb_avltree_iter_get_next(iter);
+		if (! expected) {
+			fail_unless(obj == NULL,
+					"sdb_avltree_iter_seek(<iter>, %s) -> %s; expected: NULL",
+					golden_data[i].name, obj->name);
+			continue;
+		}
+		fail_unless((obj != NULL) && (! strcmp(obj->name, expected)),
+				"sdb_avltree_iter_seek(<iter>, %s) -> %s; expected: %s",
+				golden_data[i].name, obj ? obj->name : "NULL", expected);
+
+		/* iteration continues in order after seeking */
+		if (strcmp(expected, "o")) {
+			char next[2] = { (char)(expected[0] + 1), '\0' };
+			obj = sdb_avltree_iter_get_next(iter);
+			fail_unless((obj != NULL) && (! strcmp(obj->name, next)),
+					"sdb_avltree_iter_get_next(<iter>) after seeking to %s "
+					"= %s; expected: %s", golden_data[i].name,
+					obj ? obj->name : "NULL", next);
+		}
+	}
+	sdb_avltree_iter_destroy(iter);
+}
+END_TEST
+
+START_TEST(test_lookup_indexed)
+{
+	sdb_avltree_t *t;
+	size_t i;
+
+	t = sdb_avltree_create_indexed();
+	fail_unless(t != NULL,
+			"sdb_avltree_create_indexed() = NULL; expected AVL-tree object");
+
+	/* insert enough objects to cause the index to grow multiple times */
+	for (i = 0; i < 1000; ++i) {
+		char name[32];
+		sdb_object_t *obj;
+		int check;
+
+		snprintf(name, sizeof(name), "obj%zu", i);
+		obj = sdb_object_create_T(name, sdb_object_t);
+		check = sdb_avltree_insert(t, obj);
+		fail_unless(check == 0,
+				"sdb_avltree_insert(<indexed tree>, <%s>) = %d; expected: 0",
+				name, check);
+		sdb_object_deref(obj);
+
+		/* duplicates are detected case-insensitively */
+		snprintf(name, sizeof(name), "OBJ%zu", i);
+		obj = sdb_object_create_T(name, sdb_object_t);
+		check = sdb_avltree_insert(t, obj);
+		fail_unless(check < 0,
+				"sdb_avltree_insert(<indexed tree>, <%s>) = %d; expected: <0",
+				name, check);
+		sdb_object_deref(obj);
+	}
+	fail_unless(sdb_avltree_valid(t),
+			"sdb_avltree_insert() left behind invalid indexed tree");
+
+	for (i = 0; i < 1000; ++i) {
+		char name[32], expected[32];
+		sdb_object_t *obj;
+
+		snprintf(name, sizeof(name), "oBj%zu", i);
+		snprintf(expected, sizeof(expected), "obj%zu", i);
+		obj = sdb_avltree_lookup(t, name);
+		fail_unless(obj != NULL,
+				"sdb_avltree_lookup(<indexed tree>, %s) = NULL; "
+				"expected: <obj>", name);
+		fail_unless(!strcmp(obj->name, expected),
+				"sdb_avltree_lookup(<indexed tree>, %s) = %s; "
+				"expected: %s", name, obj->name, expected);
+		sdb_object_deref(obj);
+	}
+
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(unused_names); ++i) {
+		sdb_object_t *obj;
+
+		obj = sdb_avltree_lookup(t, unused_names[i]);
+		fail_unless(obj == NULL,
+				"sdb_avltree_lookup(<indexed tree>, %s) = %p (%s); "
+				"expected: NULL", unused_names[i],
+				obj, obj ? obj->name : "<nil>");
+	}
+
+	sdb_avltree_clear(t);
+	fail_unless(sdb_avltree_lookup(t, "obj0") == NULL,
+			"sdb_avltree_lookup(<cleared tree>, obj0) = <obj>; "
+			"expected: NULL");
+
+	/* the index is rebuilt as the tree grows again */
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(test_data); ++i)
+		sdb_avltree_insert(t, &test_data[i]);
+	fail_unless(sdb_avltree_valid(t),
+			"sdb_avltree_insert() left behind invalid indexed tree");
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(test_data); ++i) {
+		sdb_object_t *obj = sdb_avltree_lookup(t, test_data[i].name);
+		fail_unless(obj == &test_data[i],
+				"sdb_avltree_lookup(<indexed tree>, %s) = %p; expected: %p",
+				test_data[i].name, obj, &test_data[i]);
+		sdb_object_deref(obj);
+	}
+	sdb_avltree_destroy(t);
+}
+END_TEST
+
+START_TEST(test_remove)
+{
+	sdb_avltree_t *t;
+	size_t i;
+	int check;
+
+	check = sdb_avltree_remove(NULL, "a");
+	fail_unless(check < 0,
+			"sdb_avltree_remove(NULL, a) = %d; expected: <0", check);
+
+	populate();
+	check = sdb_avltree_remove(tree, unused_names[0]);
+	fail_unless(check > 0,
+			"sdb_avltree_remove(<tree>, %s) = %d; expected: >0",
+			unused_names[0], check);
+
+	/* remove leaves, inner nodes, and the root in insertion order */
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(test_data); ++i) {
+		size_t j;
+
+		check = sdb_avltree_remove(tree, test_data[i].name);
+		fail_unless(check == 0,
+				"sdb_avltree_remove(<tree>, %s) = %d; expected: 0",
+				test_data[i].name, check);
+		fail_unless(sdb_avltree_valid(tree),
+				"sdb_avltree_remove(<tree>, %s) left behind invalid tree",
+				test_data[i].name);
+		fail_unless(sdb_avltree_size(tree)
+					== SDB_STATIC_ARRAY_LEN(test_data) - i - 1,
+				"sdb_avltree_remove(<tree>, %s) resulted in tree of "
+				"size %zu; expected: %zu", test_data[i].name,
+				sdb_avltree_size(tree),
+				SDB_STATIC_ARRAY_LEN(test_data) - i - 1);
+
+		for (j = 0; j < SDB_STATIC_ARRAY_LEN(test_data); ++j) {
+			sdb_object_t *obj = sdb_avltree_lookup(tree, test_data[j].name);
+			fail_unless((j <= i) == (obj == NULL),
+					"sdb_avltree_lookup(<tree>, %s) = %p after removing %s",
+					test_data[j].name, obj, test_data[i].name);
+			sdb_object_deref(obj);
+		}
+	}
+
+	/* removals of indexed trees are visible to (indexed) lookups */
+	t = sdb_avltree_create_indexed();
+	for (i = 0; i < 1000; ++i) {
+		char name[32];
+		sdb_object_t *obj;
+
+		snprintf(name, sizeof(name), "obj%zu", i);
+		obj = sdb_object_create_T(name, sdb_object_t);
+		sdb_avltree_insert(t, obj);
+		sdb_object_deref(obj);
+	}
+	for (i = 0; i < 1000; i += 2) {
+		char name[32];
+
+		snprintf(name, sizeof(name), "OBJ%zu", i);
+		check = sdb_avltree_remove(t, name);
+		fail_unless(check == 0,
+				"sdb_avltree_remove(<indexed tree>, %s) = %d; expected: 0",
+				name, check);
+	}
+	fail_unless(sdb_avltree_valid(t),
+			"sdb_avltree_remove() left behind invalid indexed tree");
+	for (i = 0; i < 1000; ++i) {
+		char name[32];
+		sdb_object_t *obj;
+
+		snprintf(name, sizeof(name), "obj%zu", i);
+		obj = sdb_avltree_lookup(t, name);
+		fail_unless((i % 2 == 0) == (obj == NULL),
+				"sdb_avltree_lookup(<indexed tree>, %s) = %p; "
+				"expected: %s", name, obj, i % 2 ? "<obj>" : "NULL");
+		sdb_object_deref(obj);
+	}
+
+	/* re-inserting removed objects reuses the index */
+	for (i = 0; i < 1000; i += 2) {
+		char name[32];
+		sdb_object_t *obj;
+
+		snprintf(name, sizeof(name), "obj%zu", i);
+		obj = sdb_object_create_T(name, sdb_object_t);
+		check = sdb_avltree_insert(t, obj);
+		fail_unless(check == 0,
+				"sdb_avltree_insert(<indexed tree>, %s) = %d after removal; "
+				"expected: 0", name, check);
+		sdb_object_deref(obj);
+	}
+	fail_unless(sdb_avltree_size(t) == 1000,
+			"sdb_avltree_size(<indexed tree>) = %zu; expected: 1000",
+			sdb_avltree_size(t));
+	for (i = 0; i < 1000; ++i) {
+		char name[32];
+		sdb_object_t *obj;
+
+		snprintf(name, sizeof(name), "obj%zu", i);
+		obj = sdb_avltree_lookup(t, name);
+		fail_unless(obj != NULL,
+				"sdb_avltree_lookup(<indexed tree>, %s) = NULL; "
+				"expected: <obj>", name);
+		sdb_object_deref(obj);
+	}
+	sdb_avltree_destroy(t);
+}
+END_TEST
+
 TEST_MAIN("utils::avltree")
 {
 	TCase *tc = tcase_create("core");
@@ -260,7 +551,11 @@ TEST_MAIN("utils::avltree")
 	tcase_add_test(tc, test_null);
 	tcase_add_test(tc, test_insert);
 	tcase_add_test(tc, test_lookup);
+	tcase_add_test(tc, test_lookup_indexed);
+	tcase_add_test(tc, test_remove);
 	tcase_add_test(tc, test_iter);
+	tcase_add_test(tc, test_iter_snapshot);
+	tcase_add_test(tc, test_iter_seek);
 	ADD_TCASE(tc);
 }
 TEST_MAIN_END
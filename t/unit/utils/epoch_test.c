@@ -0,0 +1,142 @@
+/*
+ * SysDB - t/unit/utils/epoch_test.c
+ * Copyright (C) 2016 Sebastian 'tokkee' Harl <sh@tokkee.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if HAVE_CONFIG_H
+#	include "config.h"
+#endif
+
+#include "utils/epoch.h"
+#include "testutils.h"
+
+#include <check.h>
+#include <pthread.h>
+#include <string.h>
+
+static int released[4];
+
+static void
+release(void *data)
+{
+	++*(int *)data;
+} /* release */
+
+static void *
+reader(void *arg)
+{
+	pthread_barrier_t *barrier = arg;
+
+	sdb_epoch_enter();
+	pthread_barrier_wait(barrier);
+	/* wait for the main thread to retire data */
+	pthread_barrier_wait(barrier);
+	sdb_epoch_exit();
+	return NULL;
+} /* reader */
+
+START_TEST(test_retire)
+{
+	int check;
+
+	memset(released, 0, sizeof(released));
+
+	check = sdb_epoch_retire(NULL, release);
+	fail_unless(check < 0,
+			"sdb_epoch_retire(NULL, <destructor>) = %d; expected: <0", check);
+	check = sdb_epoch_retire(&released[0], NULL);
+	fail_unless(check < 0,
+			"sdb_epoch_retire(<data>, NULL) = %d; expected: <0", check);
+
+	/* without any readers, everything may be released eventually */
+	check = sdb_epoch_retire(&released[0], release);
+	fail_unless(check == 0,
+			"sdb_epoch_retire(<data>, <destructor>) = %d; expected: 0", check);
+	sdb_epoch_reclaim();
+	fail_unless(released[0] == 1,
+			"sdb_epoch_reclaim() released data %d times; expected: 1",
+			released[0]);
+
+	/* nothing retired while in a critical section may be released */
+	check = sdb_epoch_enter();
+	fail_unless(check == 0,
+			"sdb_epoch_enter() = %d; expected: 0", check);
+	/* nested */
+	sdb_epoch_enter();
+	sdb_epoch_retire(&released[1], release);
+	sdb_epoch_exit();
+	sdb_epoch_reclaim();
+	sdb_epoch_reclaim();
+	fail_unless(released[1] == 0,
+			"sdb_epoch_reclaim() released data while in a critical section");
+
+	sdb_epoch_exit();
+	sdb_epoch_reclaim();
+	fail_unless(released[1] == 1,
+			"sdb_epoch_reclaim() released data %d times after leaving "
+			"the critical section; expected: 1", released[1]);
+
+	/* unbalanced exit is ignored */
+	sdb_epoch_exit();
+}
+END_TEST
+
+START_TEST(test_concurrent_reader)
+{
+	pthread_barrier_t barrier;
+	pthread_t thread;
+
+	memset(released, 0, sizeof(released));
+	pthread_barrier_init(&barrier, NULL, 2);
+	pthread_create(&thread, NULL, reader, &barrier);
+
+	/* the reader has entered its critical section */
+	pthread_barrier_wait(&barrier);
+	sdb_epoch_retire(&released[2], release);
+	sdb_epoch_reclaim();
+	fail_unless(released[2] == 0,
+			"sdb_epoch_reclaim() released data in use by another thread");
+
+	pthread_barrier_wait(&barrier);
+	pthread_join(thread, NULL);
+
+	sdb_epoch_reclaim();
+	fail_unless(released[2] == 1,
+			"sdb_epoch_reclaim() released data %d times after the reader "
+			"finished; expected: 1", released[2]);
+	pthread_barrier_destroy(&barrier);
+}
+END_TEST
+
+TEST_MAIN("utils::epoch")
+{
+	TCase *tc = tcase_create("core");
+	tcase_add_test(tc, test_retire);
+	tcase_add_test(tc, test_concurrent_reader);
+	ADD_TCASE(tc);
+}
+TEST_MAIN_END
+
+/* vim: set tw=78 sw=4 ts=4 noexpandtab : */
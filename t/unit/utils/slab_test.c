@@ -0,0 +1,140 @@
+/*
+ * SysDB - t/unit/utils/slab_test.c
+ * Copyright (C) 2016 Sebastian 'tokkee' Harl <sh@tokkee.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#if HAVE_CONFIG_H
+#	include "config.h"
+#endif
+
+#include "utils/slab.h"
+#include "testutils.h"
+
+#include <check.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CHUNKS_NUM 1000
+
+static void *chunks[CHUNKS_NUM];
+
+static void *
+release_all(void *arg)
+{
+	size_t size = *(size_t *)arg;
+	size_t i;
+
+	for (i = 0; i < CHUNKS_NUM; ++i)
+		sdb_slab_free(chunks[i], size);
+	return NULL;
+} /* release_all */
+
+START_TEST(test_alloc)
+{
+	size_t sizes[] = { 1, 7, 8, 9, 40, 168, SDB_SLAB_MAX, SDB_SLAB_MAX + 1 };
+	size_t i, j;
+
+	for (i = 0; i < SDB_STATIC_ARRAY_LEN(sizes); ++i) {
+		for (j = 0; j < CHUNKS_NUM; ++j) {
+			chunks[j] = sdb_slab_alloc(sizes[i]);
+			fail_unless(chunks[j] != NULL,
+					"sdb_slab_alloc(%zu) = NULL; expected: <ptr>", sizes[i]);
+			fail_unless((uintptr_t)chunks[j] % SDB_SLAB_ALIGN == 0,
+					"sdb_slab_alloc(%zu) = %p; expected: aligned to %d "
+					"bytes", sizes[i], chunks[j], SDB_SLAB_ALIGN);
+			memset(chunks[j], (int)j, sizes[i]);
+		}
+
+		/* chunks must not overlap */
+		for (j = 0; j < CHUNKS_NUM; ++j) {
+			unsigned char *c = chunks[j];
+			size_t k;
+
+			for (k = 0; k < sizes[i]; ++k)
+				fail_unless(c[k] == (unsigned char)j,
+						"sdb_slab_alloc(%zu) returned overlapping chunks",
+						sizes[i]);
+		}
+
+		for (j = 0; j < CHUNKS_NUM; ++j)
+			sdb_slab_free(chunks[j], sizes[i]);
+	}
+
+	/* released chunks are reused */
+	chunks[0] = sdb_slab_alloc(64);
+	sdb_slab_free(chunks[0], 64);
+	chunks[1] = sdb_slab_alloc(60);
+	fail_unless(chunks[0] == chunks[1],
+			"sdb_slab_alloc(60) = %p; expected: %p (released chunk of "
+			"the same size class)", chunks[1], chunks[0]);
+	sdb_slab_free(chunks[1], 60);
+
+	fail_unless(sdb_slab_bytes() > 0,
+			"sdb_slab_bytes() = 0; expected: >0");
+
+	/* NULL is ignored */
+	sdb_slab_free(NULL, 8);
+}
+END_TEST
+
+START_TEST(test_threads)
+{
+	size_t size = 24;
+	pthread_t thread;
+	size_t i;
+
+	for (i = 0; i < CHUNKS_NUM; ++i) {
+		chunks[i] = sdb_slab_alloc(size);
+		fail_unless(chunks[i] != NULL,
+				"sdb_slab_alloc(%zu) = NULL; expected: <ptr>", size);
+	}
+
+	/* release the memory in another thread; the chunks are returned to the
+	 * shared pool when the thread exits */
+	pthread_create(&thread, NULL, release_all, &size);
+	pthread_join(thread, NULL);
+
+	for (i = 0; i < CHUNKS_NUM; ++i) {
+		chunks[i] = sdb_slab_alloc(size);
+		fail_unless(chunks[i] != NULL,
+				"sdb_slab_alloc(%zu) = NULL; expected: <ptr>", size);
+		memset(chunks[i], 0, size);
+	}
+	release_all(&size);
+}
+END_TEST
+
+TEST_MAIN("utils::slab")
+{
+	TCase *tc = tcase_create("core");
+	tcase_add_test(tc, test_alloc);
+	tcase_add_test(tc, test_threads);
+	ADD_TCASE(tc);
+}
+TEST_MAIN_END
+
+/* vim: set tw=78 sw=4 ts=4 noexpandtab : */
@@ -544,6 +544,85 @@ START_TEST(test_skip)
 }
 END_TEST
 
+START_TEST(test_skip_append)
+{
+	char expected[64];
+	size_t expected_len = 0;
+	size_t cap, i;
+
+	/* consume data from the front while appending to the end; the buffer
+	 * has to reuse skipped space rather than growing indefinitely */
+	for (i = 0; i < 1000; ++i) {
+		char data[32];
+		int n = snprintf(data, sizeof(data), "%zu;", i);
+		const char *check;
+
+		sdb_strbuf_memappend(buf, data, (size_t)n);
+		memcpy(expected + expected_len, data, (size_t)n);
+		expected_len += (size_t)n;
+
+		if (expected_len > 16) {
+			sdb_strbuf_skip(buf, 0, expected_len - 5);
+			memmove(expected, expected + expected_len - 5, 5);
+			expected_len = 5;
+		}
+		expected[expected_len] = '\0';
+
+		check = sdb_strbuf_string(buf);
+		fail_unless(sdb_strbuf_len(buf) == expected_len,
+				"sdb_strbuf_len() = %zu (iteration %zu); expected: %zu",
+				sdb_strbuf_len(buf), i, expected_len);
+		fail_unless(! strcmp(check, expected),
+				"sdb_strbuf_string() = '%s' (iteration %zu); expected: '%s'",
+				check, i, expected);
+	}
+
+	cap = sdb_strbuf_cap(buf);
+	fail_unless(cap < 1024,
+			"sdb_strbuf_cap() = %zu after skipping and appending; "
+			"expected: < 1024", cap);
+}
+END_TEST
+
+START_TEST(test_reserve)
+{
+	const char *check;
+	char *tail;
+
+	tail = sdb_strbuf_reserve(NULL, 10);
+	fail_unless(tail == NULL,
+			"sdb_strbuf_reserve(NULL, 10) = %p; expected: NULL", tail);
+
+	sdb_strbuf_sprintf(buf, "abc");
+	tail = sdb_strbuf_reserve(buf, 1000);
+	fail_unless(tail != NULL,
+			"sdb_strbuf_reserve(<buf>, 1000) = NULL; expected: <tail>");
+	fail_unless(sdb_strbuf_cap(buf) > 1003,
+			"sdb_strbuf_reserve(<buf>, 1000) left cap = %zu; "
+			"expected: > 1003", sdb_strbuf_cap(buf));
+
+	memcpy(tail, "defghi", 6);
+	sdb_strbuf_commit(buf, 3);
+	check = sdb_strbuf_string(buf);
+	fail_unless(! strcmp(check, "abcdef"),
+			"sdb_strbuf_commit(<buf>, 3) = '%s'; expected: 'abcdef'", check);
+	fail_unless(sdb_strbuf_len(buf) == 6,
+			"sdb_strbuf_len() = %zu (after commit); expected: 6",
+			sdb_strbuf_len(buf));
+
+	/* skipped space is reused */
+	sdb_strbuf_skip(buf, 0, 4);
+	tail = sdb_strbuf_reserve(buf, sdb_strbuf_cap(buf) - 3);
+	fail_unless(tail != NULL,
+			"sdb_strbuf_reserve(<buf>, cap - 3) = NULL; expected: <tail>");
+	memcpy(tail, "gh", 2);
+	sdb_strbuf_commit(buf, 2);
+	check = sdb_strbuf_string(buf);
+	fail_unless(! strcmp(check, "efgh"),
+			"sdb_strbuf_commit(<buf>, 2) = '%s'; expected: 'efgh'", check);
+}
+END_TEST
+
 START_TEST(test_clear)
 {
 	const char *data;
@@ -634,6 +713,8 @@ TEST_MAIN("utils::strbuf")
 	tcase_add_test(tc, test_memappend);
 	tcase_add_test(tc, test_chomp);
 	tcase_add_test(tc, test_skip);
+	tcase_add_test(tc, test_skip_append);
+	tcase_add_test(tc, test_reserve);
 	tcase_add_test(tc, test_clear);
 	tcase_add_test(tc, test_string);
 	tcase_add_test(tc, test_len);
@@ -157,10 +157,36 @@ START_TEST(test_stringv)
 }
 END_TEST
 
+START_TEST(test_intern)
+{
+	char buf[] = "some string";
+	const char *s1, *s2;
+
+	s1 = string_intern(buf);
+	fail_unless((s1 != NULL) && (s1 != buf) && (! strcmp(s1, buf)),
+			"string_intern(%s) = %s; expected: a copy of the string",
+			buf, s1);
+
+	s2 = string_intern("some string");
+	fail_unless(s2 == s1,
+			"string_intern(%s) = %p; expected: %p (previously interned "
+			"copy)", buf, s2, s1);
+
+	/* interned strings are compared case-sensitively */
+	s2 = string_intern("Some String");
+	fail_unless((s2 != NULL) && (s2 != s1),
+			"string_intern(Some String) returned the copy of %s", s1);
+
+	fail_unless(string_intern(NULL) == NULL,
+			"string_intern(NULL) = %p; expected: NULL", string_intern(NULL));
+}
+END_TEST
+
 TEST_MAIN("utils::strings")
 {
 	TCase *tc = tcase_create("core");
 	tcase_add_test(tc, test_stringv);
+	tcase_add_test(tc, test_intern);
 	ADD_TCASE(tc);
 }
 TEST_MAIN_END